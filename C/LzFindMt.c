@@ -32,14 +32,12 @@ extern UInt64 g_NumIters_Bytes;
 #endif
 
 #define kMtHashBlockSize ((UInt32)1 << 17)
-#define kMtHashNumBlocks (1 << 1)
 
-#define GET_HASH_BLOCK_OFFSET(i)  (((i) & (kMtHashNumBlocks - 1)) * kMtHashBlockSize)
+#define GET_HASH_BLOCK_OFFSET(mt, i)  (((i) & ((mt)->hashSync.numBlocks - 1)) * kMtHashBlockSize)
 
 #define kMtBtBlockSize ((UInt32)1 << 16)
-#define kMtBtNumBlocks (1 << 4)
 
-#define GET_BT_BLOCK_OFFSET(i)  (((i) & (kMtBtNumBlocks - 1)) * (size_t)kMtBtBlockSize)
+#define GET_BT_BLOCK_OFFSET(mt, i)  (((i) & ((mt)->btSync.numBlocks - 1)) * (size_t)kMtBtBlockSize)
 
 /*
   HASH functions:
@@ -79,6 +77,129 @@ extern UInt64 g_NumIters_Bytes;
 */
 
 
+/* ---------- lock-free ring queue ----------
+  (filledPos) is changed only by writing thread.
+  (freePos) is changed only by reading thread.
+  If one side is not ready, another side spins for (spinCount) iterations.
+  Then it sets (xxxIsWaiting) flag, checks the position again and sleeps in event.
+  The side that changes the position resets (xxxIsWaiting) flag with atomic exchange,
+  and it sets event only if the flag was set.
+  So each Event_Set() call is paired with one Event_Wait() call. */
+
+#if defined(_WIN32)
+  #define MT_ATOMIC_LOAD(a)      ((UInt32)InterlockedCompareExchange((LONG volatile *)(void *)(a), 0, 0))
+  #define MT_ATOMIC_STORE(a, v)  InterlockedExchange((LONG volatile *)(void *)(a), (LONG)(v))
+  #define MT_ATOMIC_XCHG(a, v)   ((UInt32)InterlockedExchange((LONG volatile *)(void *)(a), (LONG)(v)))
+  #define MT_PAUSE  YieldProcessor();
+#elif defined(__GNUC__) || defined(__clang__)
+  #define MT_ATOMIC_LOAD(a)      __atomic_load_n((a), __ATOMIC_SEQ_CST)
+  #define MT_ATOMIC_STORE(a, v)  __atomic_store_n((a), (v), __ATOMIC_SEQ_CST)
+  #define MT_ATOMIC_XCHG(a, v)   __atomic_exchange_n((a), (v), __ATOMIC_SEQ_CST)
+  #if defined(__i386__) || defined(__x86_64__)
+    #define MT_PAUSE  __builtin_ia32_pause();
+  #elif defined(__aarch64__)
+    #define MT_PAUSE  __asm__ __volatile__("yield" ::: "memory");
+  #else
+    #define MT_PAUSE
+  #endif
+#else
+  #error Stop_Compiling_Atomic_Operations_Are_Not_Supported
+#endif
+
+#define kMtSpinCount_Min    (1 << 4)
+#define kMtSpinCount_Start  (1 << 7)
+#define kMtSpinCount_Max    (1 << 10)
+
+/* if spinning was successful, we increase the spin limit for next waits.
+   if we had to sleep, we reduce the limit. So on systems where another side
+   is not running in parallel (single CPU), we don't waste much time in spinning */
+
+static void MtSync_UpdateSpinCount(UInt32 *spinCount, UInt32 spinMax, BoolInt success)
+{
+  UInt32 v = *spinCount;
+  if (success)
+  {
+    v <<= 1;
+    if (v > spinMax)
+      v = spinMax;
+  }
+  else
+  {
+    v >>= 1;
+    if (v < kMtSpinCount_Min)
+      v = kMtSpinCount_Min;
+  }
+  *spinCount = v;
+}
+
+
+/* the conditions for waiting threads */
+#define MT_FILLED_IS_READY(p, index)  (MT_ATOMIC_LOAD(&(p)->filledPos) != (index))
+#define MT_FREE_IS_READY(p, index) \
+    ((UInt32)((index) - MT_ATOMIC_LOAD(&(p)->freePos)) < (p)->numBlocks \
+      || MT_ATOMIC_LOAD(&(p)->stopWriting))
+
+#define MT_WAIT_IMP(p, isReady, index, isWaiting, event, spinCount, numStalls) \
+  if (!isReady(p, index)) \
+  { \
+    UInt32 spin = (p)->spinCount_Max == 0 ? 0 : (p)->spinCount; \
+    for (; spin != 0; spin--) \
+    { \
+      MT_PAUSE \
+      if (isReady(p, index)) \
+        break; \
+    } \
+    if (spin != 0) \
+      MtSync_UpdateSpinCount(&(p)->spinCount, (p)->spinCount_Max, True); \
+    else \
+    { \
+      if ((p)->spinCount_Max != 0) \
+        MtSync_UpdateSpinCount(&(p)->spinCount, (p)->spinCount_Max, False); \
+      (p)->numStalls++; \
+      for (;;) \
+      { \
+        MT_ATOMIC_STORE(&(p)->isWaiting, 1); \
+        if (isReady(p, index)) \
+        { \
+          /* if another side has reset the flag, it has called Event_Set() or it will call it */ \
+          if (MT_ATOMIC_XCHG(&(p)->isWaiting, 0) == 0) \
+            Event_Wait(&(p)->event); \
+          break; \
+        } \
+        Event_Wait(&(p)->event); \
+      } \
+    } \
+  }
+
+/* reading thread waits for block (index) to be filled */
+static void MtSync_WaitFilled(CMtSync *p, UInt32 index)
+{
+  MT_WAIT_IMP(p, MT_FILLED_IS_READY, index, readerIsWaiting, canRead, spinCount_Read, numStalls_Read)
+}
+
+/* writing thread waits for block (index) to be free or for (stopWriting) */
+static void MtSync_WaitFree(CMtSync *p, UInt32 index)
+{
+  MT_WAIT_IMP(p, MT_FREE_IS_READY, index, writerIsWaiting, canWrite, spinCount_Write, numStalls_Write)
+}
+
+/* writing thread has filled (numFilled) blocks */
+static void MtSync_PutFilled(CMtSync *p, UInt32 numFilled)
+{
+  MT_ATOMIC_STORE(&p->filledPos, numFilled);
+  if (MT_ATOMIC_XCHG(&p->readerIsWaiting, 0) != 0)
+    Event_Set(&p->canRead);
+}
+
+/* reading thread has released (numFree) blocks */
+static void MtSync_PutFree(CMtSync *p, UInt32 numFree)
+{
+  MT_ATOMIC_STORE(&p->freePos, numFree);
+  if (MT_ATOMIC_XCHG(&p->writerIsWaiting, 0) != 0)
+    Event_Set(&p->canWrite);
+}
+
+
 Z7_NO_INLINE
 static void MtSync_Construct(CMtSync *p)
 {
@@ -91,8 +212,14 @@ static void MtSync_Construct(CMtSync *p)
   Thread_CONSTRUCT(&p->thread)
   Event_Construct(&p->canStart);
   Event_Construct(&p->wasStopped);
-  Semaphore_Construct(&p->freeSemaphore);
-  Semaphore_Construct(&p->filledSemaphore);
+  Event_Construct(&p->canWrite);
+  Event_Construct(&p->canRead);
+  p->numBlocks = 0;
+  p->spinCount_Max = kMtSpinCount_Max;
+  p->spinCount_Write = kMtSpinCount_Start;
+  p->spinCount_Read = kMtSpinCount_Start;
+  p->numStalls_Write = 0;
+  p->numStalls_Read = 0;
 }
 
 
@@ -137,11 +264,11 @@ static UInt32 MtSync_GetNextBlock(CMtSync *p)
     UNLOCK_BUFFER(p)
     // we free current block
     numBlocks = p->numProcessedBlocks++;
-    Semaphore_Release1(&p->freeSemaphore);
+    MtSync_PutFree(p, numBlocks);
   }
 
   // buffer is UNLOCKED here
-  Semaphore_Wait(&p->filledSemaphore);
+  MtSync_WaitFilled(p, numBlocks);
   LOCK_BUFFER(p)
   return numBlocks;
 }
@@ -165,23 +292,24 @@ static void MtSync_StopWriting(CMtSync *p)
     UNLOCK_BUFFER(p)
   }
 
-  /* We send (p->stopWriting) message and release freeSemaphore
-     to free current block.
+  /* We send (p->stopWriting) message and wake the thread,
+     if it's waiting for free block.
      So the thread will see (p->stopWriting) at some
-     iteration after Wait(freeSemaphore).
+     iteration after MtSync_WaitFree().
      The thread doesn't need to fill all avail free blocks,
      so we can get fast thread stop.
   */
 
-  p->stopWriting = True;
-  Semaphore_Release1(&p->freeSemaphore); // check semaphore count !!!
+  MT_ATOMIC_STORE(&p->stopWriting, True);
+  if (MT_ATOMIC_XCHG(&p->writerIsWaiting, 0) != 0)
+    Event_Set(&p->canWrite);
 
     PRF(printf("\nMtSync_StopWriting %p : Event_Wait(&p->wasStopped)\n", p));
   Event_Wait(&p->wasStopped);
     PRF(printf("\nMtSync_StopWriting %p : Event_Wait() finsihed\n", p));
 
-  /* 21.03 : we don't restore samaphore counters here.
-     We will recreate and reinit samaphores in next start */
+  /* we don't restore ring positions here.
+     We will reinit them in next start */
 
   p->needStart = True;
 }
@@ -213,8 +341,8 @@ static void MtSync_Destruct(CMtSync *p)
 
   Event_Close(&p->canStart);
   Event_Close(&p->wasStopped);
-  Semaphore_Close(&p->freeSemaphore);
-  Semaphore_Close(&p->filledSemaphore);
+  Event_Close(&p->canWrite);
+  Event_Close(&p->canRead);
 
   p->wasCreated = False;
 }
@@ -227,15 +355,23 @@ static void MtSync_Destruct(CMtSync *p)
 
 // call it before each new file (when new starting is required):
 Z7_NO_INLINE
-static SRes MtSync_Init(CMtSync *p, UInt32 numBlocks)
+static SRes MtSync_Init(CMtSync *p)
 {
   WRes wres;
   // BUFFER_MUST_BE_UNLOCKED(p)
   if (!p->needStart || p->csWasEntered)
     return SZ_ERROR_FAIL;
-  wres = Semaphore_OptCreateInit(&p->freeSemaphore, numBlocks, numBlocks);
+  /* the thread is stopped here, and each Event_Set() was paired with Event_Wait().
+     But we reset events for safety */
+  wres = Event_Reset(&p->canWrite);
   if (wres == 0)
-    wres = Semaphore_OptCreateInit(&p->filledSemaphore, 0, numBlocks);
+    wres = Event_Reset(&p->canRead);
+  p->filledPos = 0;
+  p->freePos = 0;
+  p->writerIsWaiting = 0;
+  p->readerIsWaiting = 0;
+  p->numStalls_Write = 0;
+  p->numStalls_Read = 0;
   return MY_SRes_HRESULT_FROM_WRes(wres);
 }
 
@@ -253,6 +389,8 @@ static WRes MtSync_Create_WRes(CMtSync *p, THREAD_FUNC_TYPE startAddress, void *
 
   RINOK_THREAD(AutoResetEvent_CreateNotSignaled(&p->canStart))
   RINOK_THREAD(AutoResetEvent_CreateNotSignaled(&p->wasStopped))
+  RINOK_THREAD(AutoResetEvent_CreateNotSignaled(&p->canWrite))
+  RINOK_THREAD(AutoResetEvent_CreateNotSignaled(&p->canRead))
 
   p->needStart = True;
   p->exit = True;  /* p->exit is unused before (canStart) Event.
@@ -487,18 +625,18 @@ static void HashThreadFunc(CMatchFinderMt *mt)
           continue;
         }
 
-        Semaphore_Wait(&p->freeSemaphore);
+        MtSync_WaitFree(p, blockIndex);
 
         if (p->exit) // exit is unexpected here. But we check it here for some failure case
           return;
 
-        // for faster stop : we check (p->stopWriting) after Wait(freeSemaphore)
-        if (p->stopWriting)
+        // for faster stop : we check (p->stopWriting) after MtSync_WaitFree()
+        if (MT_ATOMIC_LOAD(&p->stopWriting))
           break;
 
         MatchFinder_ReadIfRequired(mf);
         {
-          UInt32 *heads = mt->hashBuf + GET_HASH_BLOCK_OFFSET(blockIndex++);
+          UInt32 *heads = mt->hashBuf + GET_HASH_BLOCK_OFFSET(mt, blockIndex++);
           UInt32 num = Inline_MatchFinder_GetNumAvailableBytes(mf);
           heads[0] = 2;
           heads[1] = num;
@@ -540,7 +678,7 @@ static void HashThreadFunc(CMatchFinderMt *mt)
         }
       }
 
-      Semaphore_Release1(&p->filledSemaphore);
+      MtSync_PutFilled(p, blockIndex);
     } // for() processing end
 
     // p->numBlocks_Sent = blockIndex;
@@ -612,7 +750,7 @@ static void BtGetMatches(CMatchFinderMt *p, UInt32 *d)
       UInt32 avail;
       {
         const UInt32 bi = MtSync_GetNextBlock(&p->hashSync);
-        const UInt32 k = GET_HASH_BLOCK_OFFSET(bi);
+        const UInt32 k = GET_HASH_BLOCK_OFFSET(p, bi);
         const UInt32 *h = p->hashBuf + k;
         avail = h[1];
         p->hashBufPosLimit = k + h[0];
@@ -748,7 +886,7 @@ static void BtFillBlock(CMatchFinderMt *p, UInt32 globalBlockIndex)
     LOCK_BUFFER(sync)
   }
   
-  BtGetMatches(p, p->btBuf + GET_BT_BLOCK_OFFSET(globalBlockIndex));
+  BtGetMatches(p, p->btBuf + GET_BT_BLOCK_OFFSET(p, globalBlockIndex));
   
   /* We suppose that we have called GetNextBlock() from start.
      So buffer is LOCKED */
@@ -770,19 +908,19 @@ static void BtThreadFunc(CMatchFinderMt *mt)
     {
         PRF(printf("  BT thread block = %d  pos = %d\n", (unsigned)blockIndex, mt->pos));
       /* (p->exit == true) is possible after (p->canStart) at first loop iteration
-         and is unexpected after more Wait(freeSemaphore) iterations */
+         and is unexpected after more MtSync_WaitFree() iterations */
       if (p->exit)
         return;
 
-      Semaphore_Wait(&p->freeSemaphore);
+      MtSync_WaitFree(p, blockIndex);
       
-      // for faster stop : we check (p->stopWriting) after Wait(freeSemaphore)
-      if (p->stopWriting)
+      // for faster stop : we check (p->stopWriting) after MtSync_WaitFree()
+      if (MT_ATOMIC_LOAD(&p->stopWriting))
         break;
 
       BtFillBlock(mt, blockIndex++);
       
-      Semaphore_Release1(&p->filledSemaphore);
+      MtSync_PutFilled(p, blockIndex);
     }
 
     // we stop HASH_THREAD here
@@ -799,6 +937,25 @@ void MatchFinderMt_Construct(CMatchFinderMt *p)
   p->hashBuf = NULL;
   MtSync_Construct(&p->hashSync);
   MtSync_Construct(&p->btSync);
+  p->numHashBlocks = kMtHashNumBlocks_Default;
+  p->numBtBlocks = kMtBtNumBlocks_Default;
+}
+
+
+static UInt32 MtSync_NormalizeNumBlocks(UInt32 num, UInt32 numDefault)
+{
+  UInt32 v = 2;
+  if (num == 0)
+    return numDefault;
+  while (v < num && v < kMtNumBlocks_Max)
+    v <<= 1;
+  return v;
+}
+
+void MatchFinderMt_SetNumBlocks(CMatchFinderMt *p, UInt32 numHashBlocks, UInt32 numBtBlocks)
+{
+  p->numHashBlocks = MtSync_NormalizeNumBlocks(numHashBlocks, kMtHashNumBlocks_Default);
+  p->numBtBlocks = MtSync_NormalizeNumBlocks(numBtBlocks, kMtBtNumBlocks_Default);
 }
 
 static void MatchFinderMt_FreeMem(CMatchFinderMt *p, ISzAllocPtr alloc)
@@ -836,8 +993,8 @@ void MatchFinderMt_Destruct(CMatchFinderMt *p, ISzAllocPtr alloc)
 }
 
 
-#define kHashBufferSize (kMtHashBlockSize * kMtHashNumBlocks)
-#define kBtBufferSize (kMtBtBlockSize * kMtBtNumBlocks)
+#define kHashBufferSize (kMtHashBlockSize * p->numHashBlocks)
+#define kBtBufferSize (kMtBtBlockSize * p->numBtBlocks)
 
 
 static THREAD_FUNC_DECL HashThreadFunc2(void *p) { HashThreadFunc((CMatchFinderMt *)p);  return 0; }
@@ -860,12 +1017,18 @@ SRes MatchFinderMt_Create(CMatchFinderMt *p, UInt32 historySize, UInt32 keepAddB
   p->historySize = historySize;
   if (kMtBtBlockSize <= matchMaxLen * 4)
     return SZ_ERROR_PARAM;
+  if (p->hashBuf
+      && (p->hashSync.numBlocks != p->numHashBlocks
+       || p->btSync.numBlocks != p->numBtBlocks))
+    MatchFinderMt_FreeMem(p, alloc);
   if (!p->hashBuf)
   {
     p->hashBuf = (UInt32 *)ISzAlloc_Alloc(alloc, ((size_t)kHashBufferSize + (size_t)kBtBufferSize) * sizeof(UInt32));
     if (!p->hashBuf)
       return SZ_ERROR_MEM;
     p->btBuf = p->hashBuf + kHashBufferSize;
+    p->hashSync.numBlocks = p->numHashBlocks;
+    p->btSync.numBlocks = p->numBtBlocks;
   }
   keepAddBufferBefore += (kHashBufferSize + kBtBufferSize);
   keepAddBufferAfter += kMtHashBlockSize;
@@ -880,8 +1043,19 @@ SRes MatchFinderMt_Create(CMatchFinderMt *p, UInt32 historySize, UInt32 keepAddB
 
 SRes MatchFinderMt_InitMt(CMatchFinderMt *p)
 {
-  RINOK(MtSync_Init(&p->hashSync, kMtHashNumBlocks))
-  return MtSync_Init(&p->btSync, kMtBtNumBlocks);
+  RINOK(MtSync_Init(&p->hashSync))
+  return MtSync_Init(&p->btSync);
+}
+
+
+void MatchFinderMt_GetStat(const CMatchFinderMt *p, CMatchFinderMt_Stat *stat)
+{
+  stat->numHashBlocks = p->hashSync.numBlocks;
+  stat->numBtBlocks = p->btSync.numBlocks;
+  stat->hashStalls_Write = p->hashSync.numStalls_Write;
+  stat->hashStalls_Read = p->hashSync.numStalls_Read;
+  stat->btStalls_Write = p->btSync.numStalls_Write;
+  stat->btStalls_Read = p->btSync.numStalls_Read;
 }
 
 
@@ -958,7 +1132,7 @@ static UInt32 MatchFinderMt_GetNextBlock_Bt(CMatchFinderMt *p)
   else
   {
     const UInt32 bi = MtSync_GetNextBlock(&p->btSync);
-    const UInt32 *bt = p->btBuf + GET_BT_BLOCK_OFFSET(bi);
+    const UInt32 *bt = p->btBuf + GET_BT_BLOCK_OFFSET(p, bi);
     {
       const UInt32 numItems = bt[0];
       p->btBufPosLimit = bt + numItems;
@@ -9,9 +9,21 @@
 
 EXTERN_C_BEGIN
 
+/* kMtCacheLineDummy must be >= size_of_CPU_cache_line */
+#define kMtCacheLineDummy 128
+
+/*
+  CMtSync is ring queue of (numBlocks) blocks between one writing thread
+  and one reading thread. Each side publishes its position with atomic store,
+  spins for some time, if another side is not ready,
+  and sleeps in event only after spinning.
+*/
+
 typedef struct
 {
   UInt32 numProcessedBlocks;
+  UInt32 numBlocks;      /* the number of blocks in ring queue : (1 << x) */
+  UInt32 spinCount_Max;  /* 0 : no spinning */
   Int32 affinityGroup;
   UInt64 affinityInGroup;
   UInt64 affinity;
@@ -27,10 +39,24 @@ typedef struct
 
   CAutoResetEvent canStart;
   CAutoResetEvent wasStopped;
-  CSemaphore freeSemaphore;
-  CSemaphore filledSemaphore;
+  CAutoResetEvent canWrite;
+  CAutoResetEvent canRead;
   CCriticalSection cs;
   // UInt32 numBlocks_Sent;
+
+  Byte writeDummy[kMtCacheLineDummy];
+  /* these fields are changed by writing thread */
+  UInt32 filledPos;      /* the number of blocks filled by writing thread */
+  UInt32 writerIsWaiting;
+  UInt32 spinCount_Write;
+  UInt32 numStalls_Write; /* the number of sleeps in writing thread, because there were no free blocks */
+
+  Byte readDummy[kMtCacheLineDummy];
+  /* these fields are changed by reading thread */
+  UInt32 freePos;        /* the number of blocks released by reading thread */
+  UInt32 readerIsWaiting;
+  UInt32 spinCount_Read;
+  UInt32 numStalls_Read; /* the number of sleeps in reading thread, because there were no filled blocks */
 } CMtSync;
 
 
@@ -38,9 +64,6 @@ struct CMatchFinderMt_;
 
 typedef UInt32 * (*Mf_Mix_Matches)(struct CMatchFinderMt_ *p, UInt32 matchMinPos, UInt32 *distances);
 
-/* kMtCacheLineDummy must be >= size_of_CPU_cache_line */
-#define kMtCacheLineDummy 128
-
 typedef void (*Mf_GetHeads)(const Byte *buffer, UInt32 pos,
   UInt32 *hash, UInt32 hashMask, UInt32 *heads, UInt32 numHeads, const UInt32 *crc);
 
@@ -95,12 +118,25 @@ typedef struct CMatchFinderMt_
   Mf_GetHeads GetHeadsFunc;
   CMatchFinder *MatchFinder;
   // CMatchFinder MatchFinder;
+
+  /* the depths of ring queues for next MatchFinderMt_Create() */
+  UInt32 numHashBlocks;
+  UInt32 numBtBlocks;
 } CMatchFinderMt;
 
+#define kMtHashNumBlocks_Default (1 << 1)
+#define kMtBtNumBlocks_Default   (1 << 4)
+#define kMtNumBlocks_Max         (1 << 6)
+
 // only for Mt part
 void MatchFinderMt_Construct(CMatchFinderMt *p);
 void MatchFinderMt_Destruct(CMatchFinderMt *p, ISzAllocPtr alloc);
 
+/* (numHashBlocks) and (numBtBlocks) : the depths of ring queues between threads.
+   They are rounded up to power of 2 in range [2, kMtNumBlocks_Max].
+   0 means default value. Call it before MatchFinderMt_Create(). */
+void MatchFinderMt_SetNumBlocks(CMatchFinderMt *p, UInt32 numHashBlocks, UInt32 numBtBlocks);
+
 SRes MatchFinderMt_Create(CMatchFinderMt *p, UInt32 historySize, UInt32 keepAddBufferBefore,
     UInt32 matchMaxLen, UInt32 keepAddBufferAfter, ISzAllocPtr alloc);
 void MatchFinderMt_CreateVTable(CMatchFinderMt *p, IMatchFinder2 *vTable);
@@ -109,6 +145,19 @@ void MatchFinderMt_CreateVTable(CMatchFinderMt *p, IMatchFinder2 *vTable);
 SRes MatchFinderMt_InitMt(CMatchFinderMt *p);
 void MatchFinderMt_ReleaseStream(CMatchFinderMt *p);
 
+typedef struct
+{
+  UInt32 numHashBlocks;
+  UInt32 numBtBlocks;
+  UInt32 hashStalls_Write; /* HASH_THREAD was waiting for free hash block */
+  UInt32 hashStalls_Read;  /* BT_THREAD was waiting for filled hash block */
+  UInt32 btStalls_Write;   /* BT_THREAD was waiting for free bt block */
+  UInt32 btStalls_Read;    /* LZ (encoder) thread was waiting for filled bt block */
+} CMatchFinderMt_Stat;
+
+/* it returns counters for latest stream. Call it after MatchFinderMt_ReleaseStream() */
+void MatchFinderMt_GetStat(const CMatchFinderMt *p, CMatchFinderMt_Stat *stat);
+
 EXTERN_C_END
 
 #endif
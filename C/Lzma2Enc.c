@@ -10,6 +10,7 @@
 #include "Lzma2Enc.h"
 
 #ifndef Z7_ST
+#include "LzFindMt.h"
 #include "MtCoder.h"
 #else
 #define MTCODER_THREADS_MAX 1
@@ -86,6 +87,9 @@ typedef struct
   Byte needInitState;
   Byte needInitProp;
   UInt64 srcPos;
+  #ifndef Z7_ST
+  CMatchFinderMt_Stat mtStat; /* the sums for the blocks of latest Lzma2Enc_Encode2() call */
+  #endif
 } CLzma2EncInt;
 
 
@@ -122,6 +126,44 @@ void LzmaEnc_Finish(CLzmaEncHandle p);
 void LzmaEnc_SaveState(CLzmaEncHandle p);
 void LzmaEnc_RestoreState(CLzmaEncHandle p);
 
+#ifndef Z7_ST
+
+void LzmaEnc_GetMtStat(CLzmaEncHandle p, CMatchFinderMt_Stat *stat);
+
+static void MtStat_Clear(CMatchFinderMt_Stat *p)
+{
+  p->numHashBlocks = 0;
+  p->numBtBlocks = 0;
+  p->hashStalls_Write = 0;
+  p->hashStalls_Read = 0;
+  p->btStalls_Write = 0;
+  p->btStalls_Read = 0;
+}
+
+// it sums the stall counters. The depths of queues are same for all blocks
+static void MtStat_Add(CMatchFinderMt_Stat *p, const CMatchFinderMt_Stat *st)
+{
+  if (p->numHashBlocks < st->numHashBlocks)
+    p->numHashBlocks = st->numHashBlocks;
+  if (p->numBtBlocks < st->numBtBlocks)
+    p->numBtBlocks = st->numBtBlocks;
+  p->hashStalls_Write += st->hashStalls_Write;
+  p->hashStalls_Read += st->hashStalls_Read;
+  p->btStalls_Write += st->btStalls_Write;
+  p->btStalls_Read += st->btStalls_Read;
+}
+
+/* the counters of match finder are reset for each block,
+   so we add them after LzmaEnc_Finish() for each block */
+static void Lzma2EncInt_AddMtStat(CLzma2EncInt *p)
+{
+  CMatchFinderMt_Stat st;
+  LzmaEnc_GetMtStat(p->enc, &st);
+  MtStat_Add(&p->mtStat, &st);
+}
+
+#endif
+
 /*
 UInt32 LzmaEnc_GetNumAvailableBytes(CLzmaEncHandle p);
 */
@@ -397,7 +439,12 @@ CLzma2EncHandle Lzma2Enc_Create(ISzAllocPtr alloc, ISzAllocPtr allocBig)
   {
     unsigned i;
     for (i = 0; i < MTCODER_THREADS_MAX; i++)
+    {
       p->coders[i].enc = NULL;
+      #ifndef Z7_ST
+      MtStat_Clear(&p->coders[i].mtStat);
+      #endif
+    }
   }
   
   #ifndef Z7_ST
@@ -619,6 +666,9 @@ static SRes Lzma2Enc_EncodeMt1(
     }
     
     LzmaEnc_Finish(p->enc);
+    #ifndef Z7_ST
+    Lzma2EncInt_AddMtStat(p);
+    #endif
     
     unpackTotal += p->srcPos;
     
@@ -732,7 +782,12 @@ SRes Lzma2Enc_Encode2(CLzma2EncHandle p,
   {
     unsigned i;
     for (i = 0; i < MTCODER_THREADS_MAX; i++)
+    {
       p->coders[i].propsAreSet = False;
+      #ifndef Z7_ST
+      MtStat_Clear(&p->coders[i].mtStat);
+      #endif
+    }
   }
 
   #ifndef Z7_ST
@@ -804,4 +859,20 @@ SRes Lzma2Enc_Encode2(CLzma2EncHandle p,
       progress);
 }
 
+
+#ifndef Z7_ST
+
+/* it returns the sums of stall counters of match finders
+   for all blocks of latest Lzma2Enc_Encode2() call */
+void Lzma2Enc_GetMtStat(CLzma2EncHandle p, CMatchFinderMt_Stat *stat);
+void Lzma2Enc_GetMtStat(CLzma2EncHandle p, CMatchFinderMt_Stat *stat)
+{
+  unsigned i;
+  MtStat_Clear(stat);
+  for (i = 0; i < MTCODER_THREADS_MAX; i++)
+    MtStat_Add(stat, &p->coders[i].mtStat);
+}
+
+#endif
+
 #undef PRF
@@ -65,6 +65,8 @@ void LzmaEncProps_Init(CLzmaEncProps *p)
   p->affinityGroup = -1;
   p->affinity = 0;
   p->affinityInGroup = 0;
+  p->mtNumHashBlocks = 0;
+  p->mtNumBtBlocks = 0;
 }
 
 void LzmaEncProps_Normalize(CLzmaEncProps *p)
@@ -604,6 +606,7 @@ SRes LzmaEnc_SetProps(CLzmaEncHandle p, const CLzmaEncProps *props2)
   p->matchFinderMt.hashSync.affinityGroup = props.affinityGroup;
   p->matchFinderMt.btSync.affinityInGroup =
   p->matchFinderMt.hashSync.affinityInGroup = props.affinityInGroup;
+  MatchFinderMt_SetNumBlocks(&p->matchFinderMt, props.mtNumHashBlocks, props.mtNumBtBlocks);
   #endif
 
   return SZ_OK;
@@ -3138,6 +3141,27 @@ SRes LzmaEncode(Byte *dest, SizeT *destLen, const Byte *src, SizeT srcLen,
 }
 
 
+#ifndef Z7_ST
+void LzmaEnc_GetMtStat(CLzmaEncHandle p, CMatchFinderMt_Stat *stat);
+void LzmaEnc_GetMtStat(CLzmaEncHandle p, CMatchFinderMt_Stat *stat)
+{
+  // GET_const_CLzmaEnc_p
+  if (p->mtMode)
+    MatchFinderMt_GetStat(&p->matchFinderMt, stat);
+  else
+  {
+    // the latest stream was encoded without match finder threads
+    stat->numHashBlocks = 0;
+    stat->numBtBlocks = 0;
+    stat->hashStalls_Write = 0;
+    stat->hashStalls_Read = 0;
+    stat->btStalls_Write = 0;
+    stat->btStalls_Read = 0;
+  }
+}
+#endif
+
+
 /*
 #ifndef Z7_ST
 void LzmaEnc_GetLzThreads(CLzmaEncHandle p, HANDLE lz_threads[2])
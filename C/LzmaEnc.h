@@ -36,6 +36,9 @@ typedef struct
 
   UInt64 affinity;
   UInt64 affinityInGroup;
+
+  UInt32 mtNumHashBlocks; /* depth of queue between hash and bt threads, 0 - default */
+  UInt32 mtNumBtBlocks;   /* depth of queue between bt thread and encoder, 0 - default */
 } CLzmaEncProps;
 
 void LzmaEncProps_Init(CLzmaEncProps *p);
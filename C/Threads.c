@@ -563,6 +563,265 @@ WRes Thread_Wait_Close(CThread *p)
 
 
 
+#ifdef Z7_THREADS_FUTEX
+
+#include <limits.h>
+#include <unistd.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+
+/*
+  The futex word of object is its state (event) or count (semaphore).
+  Set() / Release() don't call the kernel, if there are no sleeping threads.
+  Wait() doesn't call the kernel, if the object is signaled.
+  Otherwise the waiting thread checks the state for (_spinCount) iterations,
+  before it goes to sleep in FUTEX_WAIT.
+  (_spinCount) is adaptive: it follows the number of iterations that were
+  required for successful spinning, and it goes down if spinning has failed.
+  Set() of auto-reset event and Release() of semaphore wake only required
+  number of threads instead of broadcast. And they call the kernel only if
+  the object was not signaled before. So repeated Set() / Release() calls
+  don't wake the thread that was woken already but has not run yet.
+  If the semaphore is still signaled after successful Wait(), the waiting
+  thread wakes next sleeping thread.
+*/
+
+#define FUTEX_SPIN_MIN  (1 << 4)
+#define FUTEX_SPIN_MAX  (1 << 12)
+
+// 0 : not initialized, 1 : spinning is disabled (single CPU), 2 : spinning is enabled
+static UInt32 g_Futex_SpinMode;
+
+static UInt32 Futex_GetStartSpinCount(void)
+{
+  UInt32 mode = __atomic_load_n(&g_Futex_SpinMode, __ATOMIC_RELAXED);
+  if (mode == 0)
+  {
+    const long numCpus = sysconf(_SC_NPROCESSORS_ONLN);
+    mode = (numCpus > 1) ? 2 : 1;
+    __atomic_store_n(&g_Futex_SpinMode, mode, __ATOMIC_RELAXED);
+  }
+  return (mode == 2) ? FUTEX_SPIN_MIN * 4 : 0;
+}
+
+static void Futex_UpdateSpinCount(UInt32 *spinCount, UInt32 numSpins, BoolInt success)
+{
+  const UInt32 cur = __atomic_load_n(spinCount, __ATOMIC_RELAXED);
+  UInt32 target = FUTEX_SPIN_MIN;
+  if (cur == 0)
+    return;
+  if (success)
+  {
+    target = numSpins * 2;
+    if (target < FUTEX_SPIN_MIN)
+      target = FUTEX_SPIN_MIN;
+    if (target > FUTEX_SPIN_MAX)
+      target = FUTEX_SPIN_MAX;
+  }
+  if (target > cur)
+    __atomic_store_n(spinCount, cur + (target - cur + 7) / 8, __ATOMIC_RELAXED);
+  else
+    __atomic_store_n(spinCount, cur - (cur - target) / 8, __ATOMIC_RELAXED);
+}
+
+static void Futex_Pause(void)
+{
+#if defined(__i386__) || defined(__x86_64__)
+  __builtin_ia32_pause();
+#elif defined(__aarch64__)
+  __asm__ __volatile__("yield" ::: "memory");
+#endif
+}
+
+static void Futex_Wait(UInt32 *addr, UInt32 val)
+{
+  // it returns immediately, if (*addr != val). EINTR and spurious wakeups are allowed.
+  syscall(SYS_futex, addr, FUTEX_WAIT_PRIVATE, val, NULL, NULL, 0);
+}
+
+static void Futex_Wake(UInt32 *addr, UInt32 num)
+{
+  syscall(SYS_futex, addr, FUTEX_WAKE_PRIVATE, (num > INT_MAX ? INT_MAX : (int)num), NULL, NULL, 0);
+}
+
+
+static WRes Event_Create(CEvent *p, int manualReset, int signaled)
+{
+  p->_manual_reset = manualReset;
+  p->_state = (signaled ? 1 : 0);
+  p->_numWaiters = 0;
+  p->_spinCount = Futex_GetStartSpinCount();
+  p->_created = 1;
+  return 0;
+}
+
+WRes ManualResetEvent_Create(CManualResetEvent *p, int signaled)
+  { return Event_Create(p, True, signaled); }
+WRes ManualResetEvent_CreateNotSignaled(CManualResetEvent *p)
+  { return ManualResetEvent_Create(p, 0); }
+WRes AutoResetEvent_Create(CAutoResetEvent *p, int signaled)
+  { return Event_Create(p, False, signaled); }
+WRes AutoResetEvent_CreateNotSignaled(CAutoResetEvent *p)
+  { return AutoResetEvent_Create(p, 0); }
+
+WRes Event_Set(CEvent *p)
+{
+  // SEQ_CST order for (_state) store and (_numWaiters) load is paired with Event_Wait()
+  if (__atomic_exchange_n(&p->_state, 1, __ATOMIC_SEQ_CST) == 0)
+    if (__atomic_load_n(&p->_numWaiters, __ATOMIC_SEQ_CST) != 0)
+      Futex_Wake(&p->_state, p->_manual_reset ? (UInt32)INT_MAX : 1);
+  return 0;
+}
+
+WRes Event_Reset(CEvent *p)
+{
+  __atomic_store_n(&p->_state, 0, __ATOMIC_SEQ_CST);
+  return 0;
+}
+
+static BoolInt Event_TryWait(CEvent *p)
+{
+  UInt32 expected = 1;
+  if (p->_manual_reset)
+    return __atomic_load_n(&p->_state, __ATOMIC_ACQUIRE) != 0;
+  return __atomic_compare_exchange_n(&p->_state, &expected, 0, False, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED);
+}
+
+WRes Event_Wait(CEvent *p)
+{
+  if (Event_TryWait(p))
+    return 0;
+  {
+    const UInt32 spinCount = __atomic_load_n(&p->_spinCount, __ATOMIC_RELAXED);
+    UInt32 i;
+    for (i = 0; i < spinCount; i++)
+    {
+      Futex_Pause();
+      if (__atomic_load_n(&p->_state, __ATOMIC_RELAXED) != 0 && Event_TryWait(p))
+      {
+        Futex_UpdateSpinCount(&p->_spinCount, i, True);
+        return 0;
+      }
+    }
+    Futex_UpdateSpinCount(&p->_spinCount, i, False);
+  }
+  for (;;)
+  {
+    __atomic_add_fetch(&p->_numWaiters, 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&p->_state, __ATOMIC_SEQ_CST) == 0)
+      Futex_Wait(&p->_state, 0);
+    __atomic_sub_fetch(&p->_numWaiters, 1, __ATOMIC_SEQ_CST);
+    if (Event_TryWait(p))
+      return 0;
+  }
+}
+
+WRes Event_Close(CEvent *p)
+{
+  p->_created = 0;
+  return 0;
+}
+
+
+WRes Semaphore_Create(CSemaphore *p, UInt32 initCount, UInt32 maxCount)
+{
+  if (initCount > maxCount || maxCount < 1)
+    return EINVAL;
+  p->_count = initCount;
+  p->_maxCount = maxCount;
+  p->_numWaiters = 0;
+  p->_spinCount = Futex_GetStartSpinCount();
+  p->_created = 1;
+  return 0;
+}
+
+
+WRes Semaphore_OptCreateInit(CSemaphore *p, UInt32 initCount, UInt32 maxCount)
+{
+  if (Semaphore_IsCreated(p))
+  {
+    if (initCount > maxCount || maxCount < 1)
+      return EINVAL;
+    p->_count = initCount;
+    p->_maxCount = maxCount;
+    return 0;
+  }
+  return Semaphore_Create(p, initCount, maxCount);
+}
+
+
+WRes Semaphore_ReleaseN(CSemaphore *p, UInt32 releaseCount)
+{
+  UInt32 count;
+  if (releaseCount < 1)
+    return EINVAL;
+  count = __atomic_load_n(&p->_count, __ATOMIC_RELAXED);
+  do
+  {
+    if (releaseCount > p->_maxCount - count)
+      return ERROR_TOO_MANY_POSTS;
+  }
+  while (!__atomic_compare_exchange_n(&p->_count, &count, count + releaseCount,
+      True, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED));
+  if (count == 0)
+    if (__atomic_load_n(&p->_numWaiters, __ATOMIC_SEQ_CST) != 0)
+      Futex_Wake(&p->_count, releaseCount);
+  return 0;
+}
+
+static BoolInt Semaphore_TryWait(CSemaphore *p)
+{
+  UInt32 count = __atomic_load_n(&p->_count, __ATOMIC_RELAXED);
+  while (count != 0)
+    if (__atomic_compare_exchange_n(&p->_count, &count, count - 1,
+        True, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED))
+    {
+      // Semaphore_ReleaseN() doesn't wake threads, if (count != 0) before release.
+      if (count != 1)
+        if (__atomic_load_n(&p->_numWaiters, __ATOMIC_SEQ_CST) != 0)
+          Futex_Wake(&p->_count, 1);
+      return True;
+    }
+  return False;
+}
+
+WRes Semaphore_Wait(CSemaphore *p)
+{
+  if (Semaphore_TryWait(p))
+    return 0;
+  {
+    const UInt32 spinCount = __atomic_load_n(&p->_spinCount, __ATOMIC_RELAXED);
+    UInt32 i;
+    for (i = 0; i < spinCount; i++)
+    {
+      Futex_Pause();
+      if (__atomic_load_n(&p->_count, __ATOMIC_RELAXED) != 0 && Semaphore_TryWait(p))
+      {
+        Futex_UpdateSpinCount(&p->_spinCount, i, True);
+        return 0;
+      }
+    }
+    Futex_UpdateSpinCount(&p->_spinCount, i, False);
+  }
+  for (;;)
+  {
+    __atomic_add_fetch(&p->_numWaiters, 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&p->_count, __ATOMIC_SEQ_CST) == 0)
+      Futex_Wait(&p->_count, 0);
+    __atomic_sub_fetch(&p->_numWaiters, 1, __ATOMIC_SEQ_CST);
+    if (Semaphore_TryWait(p))
+      return 0;
+  }
+}
+
+WRes Semaphore_Close(CSemaphore *p)
+{
+  p->_created = 0;
+  return 0;
+}
+
+#else // Z7_THREADS_FUTEX
+
 static WRes Event_Create(CEvent *p, int manualReset, int signaled)
 {
   RINOK(pthread_mutex_init(&p->_mutex, NULL))
@@ -714,6 +973,8 @@ WRes Semaphore_Close(CSemaphore *p)
   }
 }
 
+#endif // Z7_THREADS_FUTEX
+
 
 
 WRes CriticalSection_Init(CCriticalSection *p)
@@ -192,6 +192,25 @@ WRes CriticalSection_Init(CCriticalSection *p);
 
 #else // _WIN32
 
+/* Linux: events and semaphores use futex() syscall directly.
+   Define Z7_THREADS_FUTEX_DISABLE to use pthread mutex and condition variable instead. */
+#if defined(__linux__) && defined(__GNUC__) && !defined(Z7_THREADS_FUTEX_DISABLE)
+#define Z7_THREADS_FUTEX
+#endif
+
+#ifdef Z7_THREADS_FUTEX
+
+typedef struct
+{
+  int _created;
+  int _manual_reset;
+  UInt32 _state;       // futex word: 0 - not signaled, 1 - signaled
+  UInt32 _numWaiters;  // the number of threads that can sleep in futex
+  UInt32 _spinCount;   // adaptive number of spin iterations before sleeping
+} CEvent;
+
+#else
+
 typedef struct
 {
   int _created;
@@ -201,6 +220,8 @@ typedef struct
   pthread_cond_t _cond;
 } CEvent;
 
+#endif
+
 typedef CEvent CAutoResetEvent;
 typedef CEvent CManualResetEvent;
 
@@ -218,6 +239,19 @@ WRes Event_Wait(CEvent *p);
 WRes Event_Close(CEvent *p);
 
 
+#ifdef Z7_THREADS_FUTEX
+
+typedef struct
+{
+  int _created;
+  UInt32 _count;       // futex word
+  UInt32 _maxCount;
+  UInt32 _numWaiters;
+  UInt32 _spinCount;
+} CSemaphore;
+
+#else
+
 typedef struct
 {
   int _created;
@@ -227,6 +261,8 @@ typedef struct
   pthread_cond_t _cond;
 } CSemaphore;
 
+#endif
+
 #define Semaphore_Construct(p) (p)->_created = 0
 #define Semaphore_IsCreated(p) ((p)->_created)
 
@@ -807,6 +807,8 @@ $O/ShrinkDecoder.o: ../../Compress/ShrinkDecoder.cpp
 	$(CXX) $(CXXFLAGS) $<
 $O/XpressDecoder.o: ../../Compress/XpressDecoder.cpp
 	$(CXX) $(CXXFLAGS) $<
+$O/XpressEncoder.o: ../../Compress/XpressEncoder.cpp
+	$(CXX) $(CXXFLAGS) $<
 $O/XzDecoder.o: ../../Compress/XzDecoder.cpp
 	$(CXX) $(CXXFLAGS) $<
 $O/XzEncoder.o: ../../Compress/XzEncoder.cpp
@@ -958,6 +960,10 @@ $O/ExtractCallbackConsole.o: ../../UI/Console/ExtractCallbackConsole.cpp
 	$(CXX) $(CXXFLAGS) $<
 $O/HashCon.o: ../../UI/Console/HashCon.cpp
 	$(CXX) $(CXXFLAGS) $<
+$O/IoBenchCon.o: ../../UI/Console/IoBenchCon.cpp
+	$(CXX) $(CXXFLAGS) $<
+$O/JsonProgress.o: ../../UI/Console/JsonProgress.cpp
+	$(CXX) $(CXXFLAGS) $<
 $O/List.o: ../../UI/Console/List.cpp
 	$(CXX) $(CXXFLAGS) $<
 $O/Main.o: ../../UI/Console/Main.cpp ../../../../C/7zVersion.h
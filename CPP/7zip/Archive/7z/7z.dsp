@@ -580,6 +580,14 @@ SOURCE=..\..\..\Windows\System.h
 
 SOURCE=..\..\..\Windows\Thread.h
 # End Source File
+# Begin Source File
+
+SOURCE=..\..\..\Windows\TimeUtils.cpp
+# End Source File
+# Begin Source File
+
+SOURCE=..\..\..\Windows\TimeUtils.h
+# End Source File
 # End Group
 # Begin Group "Compress"
 
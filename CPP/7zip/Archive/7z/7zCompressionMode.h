@@ -6,6 +6,8 @@
 #include "../../Common/MethodId.h"
 #include "../../Common/MethodProps.h"
 
+#include "../Common/CoderMixer2.h"
+
 namespace NArchive {
 namespace N7z {
 
@@ -58,6 +60,7 @@ struct CCompressionMethodMode
   #ifndef Z7_ST
   bool NumThreads_WasForced;
   bool MultiThreadMixer;
+  UInt32 BinderRingSize;
   UInt32 NumThreads;
   UInt32 NumThreadGroups;
   #endif
@@ -74,6 +77,7 @@ struct CCompressionMethodMode
       #ifndef Z7_ST
       , NumThreads_WasForced(false)
       , MultiThreadMixer(true)
+      , BinderRingSize(NCoderMixer2::kBinderRingSize_Default)
       , NumThreads(1)
       , NumThreadGroups(0)
       #endif
@@ -108,7 +108,9 @@ static bool AreBindInfoExEqual(const CBindInfoEx &a1, const CBindInfoEx &a2)
 }
 
 CDecoder::CDecoder(bool useMixerMT):
-    _bindInfoPrev_Defined(false)
+    _bindInfoPrev_Defined(false),
+    StatMode(false),
+    BinderRingSize(NCoderMixer2::kBinderRingSize_Default)
 {
   #if defined(USE_MIXER_ST) && defined(USE_MIXER_MT)
   _useMixerMT = useMixerMT;
@@ -270,15 +272,19 @@ HRESULT CDecoder::Decode(
   if (!_bindInfoPrev_Defined || !AreBindInfoExEqual(bindInfo, _bindInfoPrev))
   {
     _bindInfoPrev_Defined = false;
-    _mixerRef.Release();
 
     #ifdef USE_MIXER_MT
     #ifdef USE_MIXER_ST
     if (_useMixerMT)
     #endif
     {
-      _mixerMT = new NCoderMixer2::CMixerMT(false);
-      _mixerRef = _mixerMT;
+      /* we reuse CMixerMT object for new bind info,
+         so coder threads are not recreated for each change of folder structure */
+      if (!_mixerRef)
+      {
+        _mixerMT = new NCoderMixer2::CMixerMT(false);
+        _mixerRef = _mixerMT;
+      }
       _mixer = _mixerMT;
     }
     #ifdef USE_MIXER_ST
@@ -287,6 +293,7 @@ HRESULT CDecoder::Decode(
     #endif
     {
       #ifdef USE_MIXER_ST
+      _mixerRef.Release();
       _mixerST = new NCoderMixer2::CMixerST(false);
       _mixerRef = _mixerST;
       _mixer = _mixerST;
@@ -342,6 +349,13 @@ HRESULT CDecoder::Decode(
     _bindInfoPrev_Defined = true;
   }
 
+  #ifdef USE_MIXER_MT
+  #ifdef USE_MIXER_ST
+  if (_useMixerMT)
+  #endif
+    _mixerMT->BinderRingSize = BinderRingSize;
+  #endif
+
   RINOK(_mixer->ReInit2())
   
   UInt32 packStreamIndex = 0;
@@ -584,6 +598,7 @@ HRESULT CDecoder::Decode(
       progress2 = new CDecProgress(compressProgress);
 
     ISequentialOutStream *outStreamPointer = outStream;
+    _mixer->StatMode = StatMode;
     return _mixer->Code(inStreamPointers, &outStreamPointer,
         progress2 ? (ICompressProgressInfo *)progress2 : compressProgress,
         dataAfterEnd_Error);
@@ -596,4 +611,18 @@ HRESULT CDecoder::Decode(
   #endif
 }
 
+
+HRESULT CDecoder::ReportCoderStat(IArchiveCoderStatCallback *callback)
+{
+  if (!_bindInfoPrev_Defined)
+    return S_OK;
+  FOR_VECTOR (i, _bindInfoPrev.Coders)
+  {
+    UInt64 values[NCoderStat::kNumValues];
+    _mixer->GetCoder(i).Stat.GetValues(values);
+    RINOK(callback->ReportCoderStat(_bindInfoPrev.CoderMethodIDs[i], values, NCoderStat::kNumValues))
+  }
+  return S_OK;
+}
+
 }}
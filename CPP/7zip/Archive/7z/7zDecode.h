@@ -43,8 +43,14 @@ class CDecoder
   CMyComPtr<IUnknown> _mixerRef;
 
 public:
+  /* if (StatMode) is set, Decode() collects the statistics for each coder.
+     ReportCoderStat() reports the statistics of last Decode() call. */
+  bool StatMode;
+  // the size of ring buffer in stream binders of multithreaded mixer
+  UInt32 BinderRingSize;
 
   CDecoder(bool useMixerMT);
+  HRESULT ReportCoderStat(IArchiveCoderStatCallback *callback);
   
   HRESULT Decode(
       DECL_EXTERNAL_CODECS_LOC_VARS
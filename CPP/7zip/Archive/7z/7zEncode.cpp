@@ -134,6 +134,7 @@ HRESULT CEncoder::CreateMixerCoder(
   #endif
   {
     _mixerMT = new NCoderMixer2::CMixerMT(true);
+    _mixerMT->BinderRingSize = _options.BinderRingSize;
     _mixerRef = _mixerMT;
     _mixer = _mixerMT;
   }
@@ -479,6 +480,7 @@ HRESULT CEncoder::Encode1(
 
   bool dataAfterEnd_Error;
 
+  _mixer->StatMode = StatMode;
   RINOK(_mixer->Code(
       &inStreamPointer,
       outStreamPointers.ConstData(),
@@ -529,8 +531,23 @@ void CEncoder::Encode_Post(
 }
 
 
+HRESULT CEncoder::ReportCoderStat(IArchiveCoderStatCallback *callback)
+{
+  if (!_mixer)
+    return S_OK;
+  FOR_VECTOR (i, _options.Methods)
+  {
+    UInt64 values[NCoderStat::kNumValues];
+    _mixer->GetCoder(i).Stat.GetValues(values);
+    RINOK(callback->ReportCoderStat(_options.Methods[i].Id, values, NCoderStat::kNumValues))
+  }
+  return S_OK;
+}
+
+
 CEncoder::CEncoder(const CCompressionMethodMode &options):
-    _constructed(false)
+    _constructed(false),
+    StatMode(false)
 {
   if (options.IsEmpty())
     throw 1;
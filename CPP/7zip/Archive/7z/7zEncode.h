@@ -67,10 +67,14 @@ class CEncoder Z7_final MY_UNCOPYABLE
 
   bool _constructed;
 public:
+  /* if (StatMode) is set, Encode1() collects the statistics for each coder.
+     ReportCoderStat() reports the statistics of last Encode1() call. */
+  bool StatMode;
 
   CEncoder(const CCompressionMethodMode &options);
   ~CEncoder();
   HRESULT EncoderConstr();
+  HRESULT ReportCoderStat(IArchiveCoderStatCallback *callback);
   HRESULT Encode1(
       DECL_EXTERNAL_CODECS_LOC_VARS
       ISequentialInStream *inStream,
@@ -295,6 +295,13 @@ Z7_COM7F_IMF(CHandler::Extract(const UInt32 *indices, UInt32 numItems,
   CMyComPtr<IArchiveExtractCallbackMessage2> callbackMessage;
   extractCallback.QueryInterface(IID_IArchiveExtractCallbackMessage2, &callbackMessage);
 
+  CMyComPtr<IArchiveCoderStatCallback> coderStatCallback;
+  extractCallback.QueryInterface(IID_IArchiveCoderStatCallback, &coderStatCallback);
+  decoder.StatMode = (coderStatCallback != NULL);
+  #ifdef Z7_7Z_SET_PROPERTIES
+  decoder.BinderRingSize = _binderRingSize;
+  #endif
+
   CFolderOutStream *folderOutStream = new CFolderOutStream;
   CMyComPtr<ISequentialOutStream> outStream(folderOutStream);
 
@@ -394,6 +401,11 @@ Z7_COM7F_IMF(CHandler::Extract(const UInt32 *indices, UInt32 numItems,
           #endif
           );
 
+      if (result == S_OK && coderStatCallback)
+      {
+        RINOK(decoder.ReportCoderStat(coderStatCallback))
+      }
+
       if (result == S_FALSE || result == E_NOTIMPL || dataAfterEnd_Error)
       {
         const bool wasFinished = folderOutStream->WasWritingFinished();
@@ -41,6 +41,7 @@ CHandler::CHandler()
   
   #ifdef Z7_7Z_SET_PROPERTIES
   _useMultiThreadMixer = true;
+  _binderRingSize = NCoderMixer2::kBinderRingSize_Default;
   #endif
   
   #endif
@@ -747,6 +748,16 @@ Z7_COM7F_IMF(CHandler::Close())
 }
 
 #ifdef Z7_7Z_SET_PROPERTIES
+
+HRESULT ParseBinderRingSize(const wchar_t *s, const PROPVARIANT &prop, UInt32 &res)
+{
+  UInt64 v;
+  if (!ParseSizeString(s, prop, 0, v) || v > NCoderMixer2::kBinderRingSize_MAX)
+    return E_INVALIDARG;
+  res = (UInt32)v;
+  return S_OK;
+}
+
 #ifdef Z7_EXTRACT_ONLY
 
 Z7_COM7F_IMF(CHandler::SetProperties(const wchar_t * const *names, const PROPVARIANT *values, UInt32 numProps))
@@ -755,6 +766,7 @@ Z7_COM7F_IMF(CHandler::SetProperties(const wchar_t * const *names, const PROPVAR
   
   InitCommon();
   _useMultiThreadMixer = true;
+  _binderRingSize = NCoderMixer2::kBinderRingSize_Default;
 
   for (UInt32 i = 0; i < numProps; i++)
   {
@@ -772,6 +784,11 @@ Z7_COM7F_IMF(CHandler::SetProperties(const wchar_t * const *names, const PROPVAR
         RINOK(PROPVARIANT_to_bool(value, _useMultiThreadMixer))
         continue;
       }
+      if (name.IsPrefixedBy_Ascii_NoCase("mtb"))
+      {
+        RINOK(ParseBinderRingSize(name.Ptr(3), value, _binderRingSize))
+        continue;
+      }
       {
         HRESULT hres;
         if (SetCommonProperty(name, value, hres))
@@ -30,6 +30,11 @@
 namespace NArchive {
 namespace N7z {
 
+#ifdef Z7_7Z_SET_PROPERTIES
+// it parses the size of ring buffer in stream binders of multithreaded mixer ("mtb" property)
+HRESULT ParseBinderRingSize(const wchar_t *s, const PROPVARIANT &prop, UInt32 &res);
+#endif
+
 
 #ifndef Z7_EXTRACT_ONLY
 
@@ -55,6 +60,7 @@ public:
 
   bool _useMultiThreadMixer;
   bool _removeSfxBlock;
+  UInt32 _binderRingSize;
   // bool _volumeMode;
 
   UInt32 _decoderCompatibilityVersion;
@@ -139,6 +145,7 @@ private:
   
   #ifdef Z7_7Z_SET_PROPERTIES
   bool _useMultiThreadMixer;
+  UInt32 _binderRingSize;
   #endif
 
   UInt32 _crcSize;
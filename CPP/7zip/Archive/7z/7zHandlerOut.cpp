@@ -705,11 +705,13 @@ Z7_COM7F_IMF(CHandler::UpdateItems(ISequentialOutStream *outStream, UInt32 numIt
     methodMode.NumThreads = numThreads;
     methodMode.NumThreads_WasForced = _numThreads_WasForced;
     methodMode.MultiThreadMixer = _useMultiThreadMixer;
+    methodMode.BinderRingSize = _binderRingSize;
 #ifdef _WIN32
     methodMode.NumThreadGroups = _numThreadGroups; // _change it
 #endif
     // headerMethod.NumThreads = 1;
     headerMethod.MultiThreadMixer = _useMultiThreadMixer;
+    headerMethod.BinderRingSize = _binderRingSize;
   }
   #endif
 
@@ -803,6 +805,7 @@ Z7_COM7F_IMF(CHandler::UpdateItems(ISequentialOutStream *outStream, UInt32 numIt
   // options.VolumeMode = _volumeMode;
 
   options.MultiThreadMixer = _useMultiThreadMixer;
+  options.BinderRingSize = _binderRingSize;
 
   /*
   if (secureBlocks.Sorted.Size() > 1)
@@ -865,6 +868,7 @@ void COutHandler::InitProps7z()
   Write_Attrib.Init();
 
   _useMultiThreadMixer = true;
+  _binderRingSize = NCoderMixer2::kBinderRingSize_Default;
 
   // _volumeMode = false;
 
@@ -1041,6 +1045,8 @@ HRESULT COutHandler::SetProperty(const wchar_t *nameSpec, const PROPVARIANT &val
     
     if (name.IsEqualTo("mtf")) return PROPVARIANT_to_bool(value, _useMultiThreadMixer);
 
+    if (name.IsPrefixedBy_Ascii_NoCase("mtb")) return ParseBinderRingSize(name.Ptr(3), value, _binderRingSize);
+
     if (name.IsEqualTo("qs")) return PROPVARIANT_to_bool(value, _useTypeSorting);
 
     if (name.IsPrefixedBy_Ascii_NoCase("yv"))
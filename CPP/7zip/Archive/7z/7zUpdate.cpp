@@ -1912,6 +1912,10 @@ HRESULT Update(
       IArchiveExtractCallbackMessage2,
       extractCallback, updateCallback)
 
+  Z7_DECL_CMyComPtr_QI_FROM(
+      IArchiveCoderStatCallback,
+      coderStatCallback, updateCallback)
+
   /*
   Z7_DECL_CMyComPtr_QI_FROM(
       IArchiveUpdateCallbackArcProp,
@@ -2105,6 +2109,7 @@ HRESULT Update(
   #endif
 
   CThreadDecoder threadDecoder(options.MultiThreadMixer);
+  threadDecoder.Decoder.BinderRingSize = options.BinderRingSize;
   
   #ifndef Z7_ST
   if (options.MultiThreadMixer && thereAreRepacks)
@@ -2358,6 +2363,7 @@ HRESULT Update(
     }
 
     CEncoder encoder(method);
+    encoder.StatMode = (coderStatCallback != NULL);
 
     // ---------- Repack and copy old solid blocks ----------
 
@@ -2589,6 +2595,10 @@ HRESULT Update(
           if (encodeRes == S_OK)
           {
             encoder.Encode_Post(curUnpackSize, newDatabase.CoderUnpackSizes);
+            if (coderStatCallback)
+            {
+              RINOK(encoder.ReportCoderStat(coderStatCallback))
+            }
           }
 
           #ifndef Z7_ST
@@ -2818,6 +2828,10 @@ HRESULT Update(
 
       const UInt64 curFolderUnpackSize = inStreamSpec->Get_TotalSize_for_Coder();
       encoder.Encode_Post(curFolderUnpackSize, newDatabase.CoderUnpackSizes);
+      if (coderStatCallback)
+      {
+        RINOK(encoder.ReportCoderStat(coderStatCallback))
+      }
 
       UInt64 packSize = 0;
       // const UInt32 numStreams = newDatabase.PackSizes.Size() - startPackIndex;
@@ -102,6 +102,7 @@ struct CUpdateOptions
   
   bool RemoveSfxBlock;
   bool MultiThreadMixer;
+  UInt32 BinderRingSize;
 
   bool Need_CTime;
   bool Need_ATime;
@@ -142,6 +143,7 @@ struct CUpdateOptions
       UseTypeSorting(true),
       RemoveSfxBlock(false),
       MultiThreadMixer(true),
+      BinderRingSize(NCoderMixer2::kBinderRingSize_Default),
       Need_CTime(false),
       Need_ATime(false),
       Need_MTime(false),
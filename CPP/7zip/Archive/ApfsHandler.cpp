@@ -34,6 +34,7 @@
 
 #include "Common/ItemNameUtils.h"
 
+#include "HandlerCont.h"
 #include "HfsHandler.h"
 
 // if APFS_SHOW_ALT_STREAMS is defined, the handler will show attribute files.
@@ -1963,6 +1964,9 @@ struct CMap
 
 
 
+static const unsigned kBlockCache_ChunkBits_Min = 16;
+static const unsigned kBlockCache_NumChunks = 64;
+
 struct CDatabase
 {
   CRecordVector<CRef2> Refs2;
@@ -1982,6 +1986,12 @@ struct CDatabase
   UInt64 ProgressVal_NumFilesTotal;
   CObjectVector<CByteBuffer> Buffers;
 
+  /* B-tree nodes are read via LRU cache of (1 << BlockCache_ChunkBits) chunks.
+     So neighbouring nodes are read with one read call. */
+  UInt64 OpenFileSize;
+  unsigned BlockCache_ChunkBits;
+  CImgClusterCache BlockCache;
+
   UInt32 MethodsMask;
   UInt64 GetSize(const UInt32 index) const;
 
@@ -2001,6 +2011,7 @@ struct CDatabase
     Vols.Clear();
     Refs2.Clear();
     Buffers.Clear();
+    BlockCache.Free();
   }
 
   HRESULT SeekReadBlock_FALSE(UInt64 oid, void *data);
@@ -2037,8 +2048,30 @@ HRESULT CDatabase::SeekReadBlock_FALSE(UInt64 oid, void *data)
   }
   if (oid == 0 || oid >= sb.block_count)
     return S_FALSE;
-  RINOK(InStream_SeekSet(OpenInStream, oid << sb.block_size_Log))
-  return ReadStream_FALSE(OpenInStream, data, sb.block_size);
+  const UInt64 pos = oid << sb.block_size_Log;
+  if (pos + sb.block_size > OpenFileSize)
+    return S_FALSE;
+  const UInt64 chunk = pos >> BlockCache_ChunkBits;
+  int index = BlockCache.Find(0, chunk);
+  if (index < 0)
+  {
+    const unsigned index2 = BlockCache.Alloc_Item(0, chunk);
+    const UInt64 chunkPos = chunk << BlockCache_ChunkBits;
+    UInt64 chunkEnd = chunkPos + ((UInt64)1 << BlockCache_ChunkBits);
+    if (chunkEnd > OpenFileSize)
+      chunkEnd = OpenFileSize;
+    HRESULT res = InStream_SeekSet(OpenInStream, chunkPos);
+    if (res == S_OK)
+      res = ReadStream_FALSE(OpenInStream, BlockCache.GetBuf(index2), (size_t)(chunkEnd - chunkPos));
+    if (res != S_OK)
+    {
+      BlockCache.Free_Item(index2);
+      return res;
+    }
+    index = (int)index2;
+  }
+  memcpy(data, BlockCache.GetBuf((unsigned)index) + (size_t)(pos - (chunk << BlockCache_ChunkBits)), sb.block_size);
+  return S_OK;
 }
 
 
@@ -2360,6 +2393,12 @@ HRESULT CDatabase::Open2()
     sb2.Parse(buf);
   }
 
+  RINOK(InStream_GetSize_SeekToEnd(OpenInStream, OpenFileSize))
+  BlockCache_ChunkBits = sb.block_size_Log;
+  if (BlockCache_ChunkBits < kBlockCache_ChunkBits_Min)
+    BlockCache_ChunkBits = kBlockCache_ChunkBits_Min;
+  BlockCache.Alloc(BlockCache_ChunkBits, kBlockCache_NumChunks);
+
   {
     CObjectMap omap;
     RINOK(ReadObjectMap(sb.omap_oid,
@@ -3448,7 +3487,10 @@ Z7_COM7F_IMF(CHandler::Open(IInStream *inStream,
   Close();
   OpenInStream = inStream;
   OpenCallback = callback;
-  RINOK(Open2())
+  const HRESULT res = Open2();
+  // B-tree nodes are not read after Open()
+  BlockCache.Free();
+  RINOK(res)
   _stream = inStream;
   return S_OK;
   COM_TRY_END
@@ -2,16 +2,28 @@
 
 #include "StdAfx.h"
 
+#include "../../../Windows/System.h"
+#include "../../../Windows/TimeUtils.h"
+
 #include "CoderMixer2.h"
 
-#ifdef USE_MIXER_ST
+using namespace NWindows;
 
 Z7_COM7F_IMF(CSequentialInStreamCalcSize::Read(void *data, UInt32 size, UInt32 *processedSize))
 {
   UInt32 realProcessed = 0;
   HRESULT result = S_OK;
   if (_stream)
-    result = _stream->Read(data, size, &realProcessed);
+  {
+    if (_measureTime)
+    {
+      const UInt64 startTime = NTime::GetMonotonicTime();
+      result = _stream->Read(data, size, &realProcessed);
+      _time += NTime::GetMonotonicTime() - startTime;
+    }
+    else
+      result = _stream->Read(data, size, &realProcessed);
+  }
   _size += realProcessed;
   if (size != 0 && realProcessed == 0)
     _wasFinished = true;
@@ -20,12 +32,28 @@ Z7_COM7F_IMF(CSequentialInStreamCalcSize::Read(void *data, UInt32 size, UInt32 *
   return result;
 }
 
+Z7_COM7F_IMF(CSequentialInStreamCalcSize::GetSubStreamSize(UInt64 subStream, UInt64 *value))
+{
+  if (!_getSubStreamSize)
+    return E_NOTIMPL;
+  return _getSubStreamSize->GetSubStreamSize(subStream, value);
+}
+
 
 Z7_COM7F_IMF(COutStreamCalcSize::Write(const void *data, UInt32 size, UInt32 *processedSize))
 {
   HRESULT result = S_OK;
   if (_stream)
-    result = _stream->Write(data, size, &size);
+  {
+    if (_measureTime)
+    {
+      const UInt64 startTime = NTime::GetMonotonicTime();
+      result = _stream->Write(data, size, &size);
+      _time += NTime::GetMonotonicTime() - startTime;
+    }
+    else
+      result = _stream->Write(data, size, &size);
+  }
   _size += size;
   if (processedSize)
     *processedSize = size;
@@ -45,8 +73,6 @@ Z7_COM7F_IMF(COutStreamCalcSize::OutStreamFinish())
   return result;
 }
 
-#endif
-
 
 
 
@@ -116,6 +142,17 @@ HRESULT CCoder::CheckDataAfterEnd(bool &dataAfterEnd_Error /* , bool &InternalPa
 }
 
 
+void CCoder::GetMtStat()
+{
+  CMyComPtr<ICompressGetMtStat> getMtStat;
+  QueryInterface(IID_ICompressGetMtStat, (void **)&getMtStat);
+  if (getMtStat)
+    if (getMtStat->GetMtStat(Stat.MtStat, NCoderMtStat::kNumValues) != S_OK)
+      for (unsigned i = 0; i < NCoderMtStat::kNumValues; i++)
+        Stat.MtStat[i] = 0;
+}
+
+
 
 class CBondsChecks
 {
@@ -312,6 +349,87 @@ bool CMixer::IsThere_ExternalCoder_in_PackTree(UInt32 coderIndex)
 }
 
 
+ISequentialInStream *CMixer::AddExtInStream(ISequentialInStream *stream, UInt32 coderIndex)
+{
+  CStatStream &ss = _extStreams.AddNew();
+  CSequentialInStreamCalcSize *spec = new CSequentialInStreamCalcSize;
+  ss.StreamRef = (ISequentialInStream *)spec;
+  ss.InStreamSpec = spec;
+  ss.CallerCoder = (int)coderIndex;
+  spec->SetStream(stream);
+  spec->Init(true); // measureTime
+  return spec;
+}
+
+ISequentialOutStream *CMixer::AddExtOutStream(ISequentialOutStream *stream, UInt32 coderIndex)
+{
+  CStatStream &ss = _extStreams.AddNew();
+  COutStreamCalcSize *spec = new COutStreamCalcSize;
+  ss.StreamRef = (ISequentialOutStream *)spec;
+  ss.OutStreamSpec = spec;
+  ss.CallerCoder = (int)coderIndex;
+  spec->SetStream(stream);
+  spec->Init(true); // measureTime
+  return spec;
+}
+
+/* the time of Read() / Write() call is the blocking time for caller coder,
+   and it's the time of work for callee coder that provides the data. */
+
+void CMixer::AddStatStream_to_Stat(const CStatStream &ss)
+{
+  UInt64 size, time;
+  if (ss.InStreamSpec)
+  {
+    size = ss.InStreamSpec->GetSize();
+    time = ss.InStreamSpec->GetTime();
+  }
+  else if (ss.OutStreamSpec)
+  {
+    size = ss.OutStreamSpec->GetSize();
+    time = ss.OutStreamSpec->GetTime();
+  }
+  else
+    return;
+  const bool isIn = (ss.InStreamSpec != NULL);
+  if (ss.CallerCoder >= 0)
+  {
+    CCoderStat &st = GetCoder((unsigned)ss.CallerCoder).Stat;
+    if (isIn)
+    {
+      st.InSize += size;
+      st.InWaitTime += time;
+    }
+    else
+    {
+      st.OutSize += size;
+      st.OutWaitTime += time;
+    }
+  }
+  if (ss.CalleeCoder >= 0)
+  {
+    CCoderStat &st = GetCoder((unsigned)ss.CalleeCoder).Stat;
+    if (isIn)
+      st.OutSize += size;
+    else
+      st.InSize += size;
+    st.Time += time;
+  }
+}
+
+void CMixer::ReleaseExtStreams()
+{
+  FOR_VECTOR (i, _extStreams)
+  {
+    const CStatStream &ss = _extStreams[i];
+    if (StatMode)
+      AddStatStream_to_Stat(ss);
+    ss.ReleaseStream();
+  }
+  _extStreams.Clear();
+}
+
+
 
 
 #ifdef USE_MIXER_ST
@@ -437,6 +555,9 @@ HRESULT CMixerST::GetInStream(
     if (index >= 0)
     {
       seqInStream = inStreams[(unsigned)index];
+      if (StatMode)
+        seqInStream = AddExtInStream(seqInStream,
+            EncodeMode ? inStreamIndex : _bi.Stream_to_Coder[inStreamIndex]);
       *inStreamRes = seqInStream.Detach();
       return S_OK;
     }
@@ -448,22 +569,26 @@ HRESULT CMixerST::GetInStream(
   if (bond < 0)
     return E_INVALIDARG;
 
+  const UInt32 outStreamIndex = _bi.Bonds[(unsigned)bond].Get_OutIndex(EncodeMode);
+
   RINOK(GetInStream2(inStreams, /* inSizes, */
-      _bi.Bonds[(unsigned)bond].Get_OutIndex(EncodeMode), &seqInStream))
+      outStreamIndex, &seqInStream))
 
   while (_binderStreams.Size() <= (unsigned)bond)
     _binderStreams.AddNew();
-  CStBinderStream &bs = _binderStreams[(unsigned)bond];
+  CStatStream &bs = _binderStreams[(unsigned)bond];
 
   if (bs.StreamRef || bs.InStreamSpec)
     return E_NOTIMPL;
   
   CSequentialInStreamCalcSize *spec = new CSequentialInStreamCalcSize;
-  bs.StreamRef = spec;
+  bs.StreamRef = (ISequentialInStream *)spec;
   bs.InStreamSpec = spec;
+  bs.CallerCoder = (int)(EncodeMode ? inStreamIndex : _bi.Stream_to_Coder[inStreamIndex]);
+  bs.CalleeCoder = (int)(EncodeMode ? _bi.Stream_to_Coder[outStreamIndex] : outStreamIndex);
   
   spec->SetStream(seqInStream);
-  spec->Init();
+  spec->Init(StatMode);
   
   seqInStream = bs.InStreamSpec;
 
@@ -491,6 +616,9 @@ HRESULT CMixerST::GetOutStream(
     if (index >= 0)
     {
       seqOutStream = outStreams[(unsigned)index];
+      if (StatMode)
+        seqOutStream = AddExtOutStream(seqOutStream,
+            EncodeMode ? _bi.Stream_to_Coder[outStreamIndex] : outStreamIndex);
       *outStreamRes = seqOutStream.Detach();
       return S_OK;
     }
@@ -558,7 +686,7 @@ HRESULT CMixerST::GetOutStream(
 
   while (_binderStreams.Size() <= (unsigned)bond)
     _binderStreams.AddNew();
-  CStBinderStream &bs = _binderStreams[(unsigned)bond];
+  CStatStream &bs = _binderStreams[(unsigned)bond];
 
   if (bs.StreamRef || bs.OutStreamSpec)
     return E_NOTIMPL;
@@ -566,9 +694,11 @@ HRESULT CMixerST::GetOutStream(
   COutStreamCalcSize *spec = new COutStreamCalcSize;
   bs.StreamRef = (ISequentialOutStream *)spec;
   bs.OutStreamSpec = spec;
+  bs.CallerCoder = (int)(EncodeMode ? _bi.Stream_to_Coder[outStreamIndex] : outStreamIndex);
+  bs.CalleeCoder = (int)coderIndex;
   
   spec->SetStream(seqOutStream);
-  spec->Init();
+  spec->Init(StatMode);
 
   seqOutStream = bs.OutStreamSpec;
   
@@ -704,6 +834,7 @@ HRESULT CMixerST::Code(
   dataAfterEnd_Error = false;
 
   _binderStreams.Clear();
+  _extStreams.Clear();
   const unsigned ci = MainCoderIndex;
  
   const CCoder &mainCoder = _coders[MainCoderIndex];
@@ -772,6 +903,14 @@ HRESULT CMixerST::Code(
   const UInt64 * const *isSizes2 = EncodeMode ? &mainCoder.UnpackSizePointer : mainCoder.PackSizePointers.ConstData();
   const UInt64 * const *outSizes2 = EncodeMode ? mainCoder.PackSizePointers.ConstData() : &mainCoder.UnpackSizePointer;
 
+  UInt64 startTime = 0;
+  if (StatMode)
+  {
+    for (i = 0; i < _coders.Size(); i++)
+      _coders[i].Stat.Clear();
+    startTime = NTime::GetMonotonicTime();
+  }
+
   HRESULT res;
   if (mainCoder.Coder)
   {
@@ -788,6 +927,9 @@ HRESULT CMixerST::Code(
         progress);
   }
 
+  if (StatMode)
+    _coders[ci].Stat.Time = NTime::GetMonotonicTime() - startTime;
+
   if (res == k_My_HRESULT_WritingWasCut)
     res = S_OK;
 
@@ -798,12 +940,15 @@ HRESULT CMixerST::Code(
 
   for (i = 0; i < _binderStreams.Size(); i++)
   {
-    const CStBinderStream &bs = _binderStreams[i];
-    if (bs.InStreamSpec)
-      bs.InStreamSpec->ReleaseStream();
-    else
-      bs.OutStreamSpec->ReleaseStream();
+    const CStatStream &bs = _binderStreams[i];
+    if (StatMode)
+      AddStatStream_to_Stat(bs);
+    bs.ReleaseStream();
   }
+  if (StatMode)
+    for (i = 0; i < _coders.Size(); i++)
+      _coders[i].GetMtStat();
+  ReleaseExtStreams();
 
   if (res == k_My_HRESULT_WritingWasCut)
     res = S_OK;
@@ -847,7 +992,7 @@ HRESULT CMixerST::GetMainUnpackStream(
 
 UInt64 CMixerST::GetBondStreamSize(unsigned bondIndex) const
 {
-  const CStBinderStream &bs = _binderStreams[bondIndex];
+  const CStatStream &bs = _binderStreams[bondIndex];
   if (bs.InStreamSpec)
     return bs.InStreamSpec->GetSize();
   return bs.OutStreamSpec->GetSize();
@@ -863,6 +1008,11 @@ UInt64 CMixerST::GetBondStreamSize(unsigned bondIndex) const
 #ifdef USE_MIXER_MT
 
 
+void CCoderThread::Execute()
+{
+  Coder->Execute();
+}
+
 void CCoderMT::Execute()
 {
   try
@@ -902,6 +1052,14 @@ void CCoderMT::Code(ICompressProgressInfo *progress)
 
   CReleaser releaser(*this);
   
+  UInt64 startTime = 0;
+  UInt64 startCpuTime = 0;
+  if (StatMode)
+  {
+    startTime = NTime::GetMonotonicTime();
+    startCpuTime = NTime::GetCurThreadCpuTime();
+  }
+
   if (Coder)
     Result = Coder->Code(InStreamPointers[0], OutStreamPointers[0],
         EncodeMode ? UnpackSizePointer : PackSizePointers[0],
@@ -912,14 +1070,24 @@ void CCoderMT::Code(ICompressProgressInfo *progress)
         InStreamPointers.ConstData(),  EncodeMode ? &UnpackSizePointer : PackSizePointers.ConstData(), numInStreams,
         OutStreamPointers.ConstData(), EncodeMode ? PackSizePointers.ConstData(): &UnpackSizePointer, numOutStreams,
         progress);
+
+  if (StatMode)
+  {
+    Stat.Time = NTime::GetMonotonicTime() - startTime;
+    Stat.CpuTime = NTime::GetCurThreadCpuTime() - startCpuTime;
+    GetMtStat();
+  }
 }
 
 HRESULT CMixerMT::SetBindInfo(const CBindInfo &bindInfo)
 {
   CMixer::SetBindInfo(bindInfo);
+  _coders.Clear();
   
-  _streamBinders.Clear();
-  FOR_VECTOR (i, _bi.Bonds)
+  // we reuse the events and ring buffers of stream binders from previous bind info
+  if (_streamBinders.Size() > _bi.Bonds.Size())
+    _streamBinders.DeleteFrom(_bi.Bonds.Size());
+  while (_streamBinders.Size() < _bi.Bonds.Size())
   {
     // RINOK(_streamBinders.AddNew().CreateEvents())
     _streamBinders.AddNew();
@@ -944,11 +1112,19 @@ CCoder &CMixerMT::GetCoder(unsigned index)
   return _coders[index];
 }
 
+// the number of checks of binder state before waiting for event
+static const unsigned kBinderSpinCount = 64;
+
 HRESULT CMixerMT::ReInit2()
 {
+  // spinning is useless, if the threads can't run simultaneously
+  const unsigned spinCount = (NWindows::NSystem::GetNumberOfProcessors() > 1) ? kBinderSpinCount : 0;
   FOR_VECTOR (i, _streamBinders)
   {
-    RINOK(_streamBinders[i].Create_ReInit())
+    CStreamBinder &sb = _streamBinders[i];
+    sb.RingSize = BinderRingSize;
+    sb.SpinCount = spinCount;
+    RINOK(sb.Create_ReInit())
   }
   return S_OK;
 }
@@ -1002,22 +1178,11 @@ HRESULT CMixerMT::Init(ISequentialInStream * const *inStreams, ISequentialOutStr
 
   for (i = 0; i < _bi.Bonds.Size(); i++)
   {
-    const CBond &bond = _bi.Bonds[i];
-   
     UInt32 inCoderIndex, inCoderStreamIndex;
     UInt32 outCoderIndex, outCoderStreamIndex;
-    
-    {
-      UInt32 coderIndex, coderStreamIndex;
-      _bi.GetCoder_for_Stream(bond.PackIndex, coderIndex, coderStreamIndex);
-
-      inCoderIndex = EncodeMode ? bond.UnpackIndex : coderIndex;
-      outCoderIndex = EncodeMode ? coderIndex : bond.UnpackIndex;
-
-      inCoderStreamIndex = EncodeMode ? 0 : coderStreamIndex;
-      outCoderStreamIndex = EncodeMode ? coderStreamIndex : 0;
-    }
+    GetBondCoders(i, inCoderIndex, inCoderStreamIndex, outCoderIndex, outCoderStreamIndex);
 
+    _streamBinders[i].StatMode = StatMode;
     _streamBinders[i].CreateStreams2(
         _coders[inCoderIndex].InStreams[inCoderStreamIndex],
         _coders[outCoderIndex].OutStreams[outCoderStreamIndex]);
@@ -1033,12 +1198,14 @@ HRESULT CMixerMT::Init(ISequentialInStream * const *inStreams, ISequentialOutStr
     }
   }
 
+  _extStreams.Clear();
+
   {
     CCoderMT &cod = _coders[_bi.UnpackCoder];
     if (EncodeMode)
-      cod.InStreams[0] = inStreams[0];
+      cod.InStreams[0] = StatMode ? AddExtInStream(inStreams[0], _bi.UnpackCoder) : inStreams[0];
     else
-      cod.OutStreams[0] = outStreams[0];
+      cod.OutStreams[0] = StatMode ? AddExtOutStream(outStreams[0], _bi.UnpackCoder) : outStreams[0];
   }
 
   for (i = 0; i < _bi.PackStreams.Size(); i++)
@@ -1047,14 +1214,63 @@ HRESULT CMixerMT::Init(ISequentialInStream * const *inStreams, ISequentialOutStr
     _bi.GetCoder_for_Stream(_bi.PackStreams[i], coderIndex, coderStreamIndex);
     CCoderMT &cod = _coders[coderIndex];
     if (EncodeMode)
-      cod.OutStreams[coderStreamIndex] = outStreams[i];
+      cod.OutStreams[coderStreamIndex] = StatMode ? AddExtOutStream(outStreams[i], coderIndex) : outStreams[i];
     else
-      cod.InStreams[coderStreamIndex] = inStreams[i];
+      cod.InStreams[coderStreamIndex] = StatMode ? AddExtInStream(inStreams[i], coderIndex) : inStreams[i];
   }
   
+  for (i = 0; i < _coders.Size(); i++)
+  {
+    CCoderMT &cod = _coders[i];
+    cod.StatMode = StatMode;
+    cod.Stat.Clear();
+  }
+
   return S_OK;
 }
 
+
+void CMixerMT::GetBondCoders(unsigned bondIndex,
+    UInt32 &inCoderIndex, UInt32 &inCoderStreamIndex,
+    UInt32 &outCoderIndex, UInt32 &outCoderStreamIndex) const
+{
+  const CBond &bond = _bi.Bonds[bondIndex];
+  UInt32 coderIndex, coderStreamIndex;
+  _bi.GetCoder_for_Stream(bond.PackIndex, coderIndex, coderStreamIndex);
+
+  inCoderIndex = EncodeMode ? bond.UnpackIndex : coderIndex;
+  outCoderIndex = EncodeMode ? coderIndex : bond.UnpackIndex;
+
+  inCoderStreamIndex = EncodeMode ? 0 : coderStreamIndex;
+  outCoderStreamIndex = EncodeMode ? coderStreamIndex : 0;
+}
+
+
+/* CalcStat() is called after all threads were finished.
+   The reader of binder waits for writer (InWaitTime),
+   and the writer waits for reader (OutWaitTime). */
+
+void CMixerMT::CalcStat()
+{
+  FOR_VECTOR (i, _streamBinders)
+  {
+    const CStreamBinder &sb = _streamBinders[i];
+    UInt32 inCoderIndex, inCoderStreamIndex;
+    UInt32 outCoderIndex, outCoderStreamIndex;
+    GetBondCoders(i, inCoderIndex, inCoderStreamIndex, outCoderIndex, outCoderStreamIndex);
+    {
+      CCoderStat &st = _coders[inCoderIndex].Stat;
+      st.InSize += sb.ProcessedSize;
+      st.InWaitTime += sb.ReadWaitTime;
+    }
+    {
+      CCoderStat &st = _coders[outCoderIndex].Stat;
+      st.OutSize += sb.ProcessedSize;
+      st.OutWaitTime += sb.WriteWaitTime;
+    }
+  }
+}
+
 HRESULT CMixerMT::ReturnIfError(HRESULT code)
 {
   FOR_VECTOR (i, _coders)
@@ -1075,35 +1291,42 @@ HRESULT CMixerMT::Code(
   Init(inStreams, outStreams);
 
   unsigned i;
+  unsigned numThreads = 0;
   for (i = 0; i < _coders.Size(); i++)
     if (i != MainCoderIndex)
     {
-      const WRes wres = _coders[i].Create();
+      if (numThreads == _threads.Size())
+        _threads.AddNew();
+      CCoderThread &t = _threads[numThreads++];
+      t.Coder = &_coders[i];
+      const WRes wres = t.Create();
       if (wres != 0)
         return HRESULT_FROM_WIN32(wres);
     }
 
-  for (i = 0; i < _coders.Size(); i++)
-    if (i != MainCoderIndex)
-    {
-      const WRes wres = _coders[i].Start();
-      if (wres != 0)
-        return HRESULT_FROM_WIN32(wres);
-    }
+  for (i = 0; i < numThreads; i++)
+  {
+    const WRes wres = _threads[i].Start();
+    if (wres != 0)
+      return HRESULT_FROM_WIN32(wres);
+  }
 
   _coders[MainCoderIndex].Code(progress);
 
   WRes wres = 0;
-  for (i = 0; i < _coders.Size(); i++)
-    if (i != MainCoderIndex)
-    {
-      WRes wres2 = _coders[i].WaitExecuteFinish();
-      if (wres == 0)
-        wres = wres2;
-    }
+  for (i = 0; i < numThreads; i++)
+  {
+    WRes wres2 = _threads[i].WaitExecuteFinish();
+    if (wres == 0)
+      wres = wres2;
+  }
   if (wres != 0)
     return HRESULT_FROM_WIN32(wres);
 
+  if (StatMode)
+    CalcStat();
+  ReleaseExtStreams();
+
   RINOK(ReturnIfError(E_ABORT))
   RINOK(ReturnIfError(E_OUTOFMEMORY))
 
@@ -10,6 +10,8 @@
 
 #include "../../Common/CreateCoder.h"
 
+#include "../IArchive.h"
+
 #ifdef Z7_ST
   #define USE_MIXER_ST
 #else
@@ -26,24 +28,39 @@
 
 
 
-#ifdef USE_MIXER_ST
+/* CSequentialInStreamCalcSize and COutStreamCalcSize count the size of data.
+   If (measureTime) is set in Init(), they also accumulate the time of
+   Read() / Write() calls of (_stream) in 100-ns units. */
 
-Z7_CLASS_IMP_COM_1(
+Z7_CLASS_IMP_COM_2(
   CSequentialInStreamCalcSize
   , ISequentialInStream
+  , ICompressGetSubStreamSize
 )
   bool _wasFinished;
+  bool _measureTime;
   CMyComPtr<ISequentialInStream> _stream;
+  CMyComPtr<ICompressGetSubStreamSize> _getSubStreamSize;
   UInt64 _size;
+  UInt64 _time;
 public:
-  void SetStream(ISequentialInStream *stream) { _stream = stream;  }
-  void Init()
+  void SetStream(ISequentialInStream *stream)
+  {
+    _stream = stream;
+    _getSubStreamSize.Release();
+    if (stream)
+      _stream.QueryInterface(IID_ICompressGetSubStreamSize, &_getSubStreamSize);
+  }
+  void Init(bool measureTime = false)
   {
     _size = 0;
+    _time = 0;
     _wasFinished = false;
+    _measureTime = measureTime;
   }
-  void ReleaseStream() { _stream.Release(); }
+  void ReleaseStream() { _stream.Release(); _getSubStreamSize.Release(); }
   UInt64 GetSize() const { return _size; }
+  UInt64 GetTime() const { return _time; }
   bool WasFinished() const { return _wasFinished; }
 };
 
@@ -53,21 +70,33 @@ Z7_CLASS_IMP_COM_2(
   , ISequentialOutStream
   , IOutStreamFinish
 )
+  bool _measureTime;
   CMyComPtr<ISequentialOutStream> _stream;
   UInt64 _size;
+  UInt64 _time;
 public:
   void SetStream(ISequentialOutStream *stream) { _stream = stream; }
   void ReleaseStream() { _stream.Release(); }
-  void Init() { _size = 0; }
+  void Init(bool measureTime = false)
+  {
+    _size = 0;
+    _time = 0;
+    _measureTime = measureTime;
+  }
   UInt64 GetSize() const { return _size; }
+  UInt64 GetTime() const { return _time; }
 };
 
-#endif
-
 
   
 namespace NCoderMixer2 {
 
+/* the size of ring buffer in each stream binder of CMixerMT.
+   0 : synchronous binders without buffers.
+   (kBinderRingSize_MAX) is the limit of CStreamBinder. */
+const UInt32 kBinderRingSize_Default = (UInt32)1 << 20;
+const UInt32 kBinderRingSize_MAX = (UInt32)1 << 30;
+
 struct CBond
 {
   UInt32 PackIndex;
@@ -177,6 +206,51 @@ struct CBindInfo
 
 
 
+/* CCoderStat : the statistics of coder for last CMixer::Code() call in StatMode.
+   Time values are in 100-ns units.
+   (Time) includes the time of blocking in Read() / Write() calls,
+   so the active time of coder is (Time - InWaitTime - OutWaitTime). */
+
+struct CCoderStat
+{
+  UInt64 Time;
+  UInt64 CpuTime;      // caller-thread cpu time (NCoderStat::kCpuTime). It's 0, if it's not supported
+  UInt64 InSize;
+  UInt64 OutSize;
+  UInt64 InWaitTime;
+  UInt64 OutWaitTime;
+  UInt64 MtStat[NCoderMtStat::kNumValues]; // stalls of internal threads of coder
+
+  void Clear()
+  {
+    Time = 0;
+    CpuTime = 0;
+    InSize = 0;
+    OutSize = 0;
+    InWaitTime = 0;
+    OutWaitTime = 0;
+    for (unsigned i = 0; i < NCoderMtStat::kNumValues; i++)
+      MtStat[i] = 0;
+  }
+  CCoderStat() { Clear(); }
+
+  // values[NCoderStat::kNumValues]
+  void GetValues(UInt64 *values) const
+  {
+    values[NCoderStat::kTime] = Time;
+    values[NCoderStat::kCpuTime] = CpuTime;
+    values[NCoderStat::kInSize] = InSize;
+    values[NCoderStat::kOutSize] = OutSize;
+    values[NCoderStat::kInWaitTime] = InWaitTime;
+    values[NCoderStat::kOutWaitTime] = OutWaitTime;
+    values[NCoderStat::kHashStalls_Write] = MtStat[NCoderMtStat::kHashStalls_Write];
+    values[NCoderStat::kHashStalls_Read] = MtStat[NCoderMtStat::kHashStalls_Read];
+    values[NCoderStat::kBtStalls_Write] = MtStat[NCoderMtStat::kBtStalls_Write];
+    values[NCoderStat::kBtStalls_Read] = MtStat[NCoderMtStat::kBtStalls_Read];
+  }
+};
+
+
 class CCoder
 {
   Z7_CLASS_NO_COPY(CCoder)
@@ -192,12 +266,17 @@ public:
   CRecordVector<UInt64> PackSizes;
   CRecordVector<const UInt64 *> PackSizePointers;
 
+  CCoderStat Stat;
+
   CCoder(): Finish(false) {}
 
   void SetCoderInfo(const UInt64 *unpackSize, const UInt64 * const *packSizes, bool finish);
 
   HRESULT CheckDataAfterEnd(bool &dataAfterEnd_Error /* , bool &InternalPackSizeError */) const;
 
+  // it gets (Stat.MtStat) from coder that supports ICompressGetMtStat
+  void GetMtStat();
+
   IUnknown *GetUnknown() const
   {
     return Coder ? (IUnknown *)Coder : (IUnknown *)Coder2;
@@ -211,6 +290,30 @@ public:
 
 
 
+/* CStatStream : the stream wrapper that is used to measure the sizes and times
+   of data transfers between coders (CMixerST) or between coder and external stream.
+   (CallerCoder) calls Read() or Write() of wrapper.
+   (CalleeCoder) is the coder that provides the wrapped stream, or -1 for external stream. */
+
+struct CStatStream
+{
+  CSequentialInStreamCalcSize *InStreamSpec;
+  COutStreamCalcSize *OutStreamSpec;
+  CMyComPtr<IUnknown> StreamRef;
+  int CallerCoder;
+  int CalleeCoder;
+
+  CStatStream(): InStreamSpec(NULL), OutStreamSpec(NULL), CallerCoder(-1), CalleeCoder(-1) {}
+  void ReleaseStream() const
+  {
+    if (InStreamSpec)
+      InStreamSpec->ReleaseStream();
+    else if (OutStreamSpec)
+      OutStreamSpec->ReleaseStream();
+  }
+};
+
+
 class CMixer
 {
   bool Is_PackSize_Correct_for_Stream(UInt32 streamIndex);
@@ -218,6 +321,14 @@ class CMixer
 protected:
   CBindInfo _bi;
 
+  // the wrappers for external streams in StatMode
+  CObjectVector<CStatStream> _extStreams;
+
+  ISequentialInStream *AddExtInStream(ISequentialInStream *stream, UInt32 coderIndex);
+  ISequentialOutStream *AddExtOutStream(ISequentialOutStream *stream, UInt32 coderIndex);
+  void AddStatStream_to_Stat(const CStatStream &ss);
+  void ReleaseExtStreams();
+
   int FindBond_for_Stream(bool forInputStream, UInt32 streamIndex) const
   {
     if (EncodeMode == forInputStream)
@@ -232,11 +343,16 @@ protected:
 public:
   unsigned MainCoderIndex;
 
+  /* if (StatMode) is set, Code() fills (CCoder::Stat) for each coder.
+     The streams are wrapped for measurement, so Code() can be slower in that mode. */
+  bool StatMode;
+
   // bool InternalPackSizeError;
 
   CMixer(bool encodeMode):
       EncodeMode(encodeMode),
-      MainCoderIndex(0)
+      MainCoderIndex(0),
+      StatMode(false)
       // , InternalPackSizeError(false)
       {}
 
@@ -297,16 +413,6 @@ struct CCoderST: public CCoder
 };
 
 
-struct CStBinderStream
-{
-  CSequentialInStreamCalcSize *InStreamSpec;
-  COutStreamCalcSize *OutStreamSpec;
-  CMyComPtr<IUnknown> StreamRef;
-
-  CStBinderStream(): InStreamSpec(NULL), OutStreamSpec(NULL) {}
-};
-
-
 class CMixerST:
   public IUnknown,
   public CMixer,
@@ -328,7 +434,7 @@ class CMixerST:
 public:
   CObjectVector<CCoderST> _coders;
   
-  CObjectVector<CStBinderStream> _binderStreams;
+  CObjectVector<CStatStream> _binderStreams;
 
   CMixerST(bool encodeMode);
   ~CMixerST() Z7_DESTRUCTOR_override;
@@ -358,14 +464,12 @@ public:
 
 #ifdef USE_MIXER_MT
 
-class CCoderMT: public CCoder, public CVirtThread
+class CCoderMT: public CCoder
 {
   Z7_CLASS_NO_COPY(CCoderMT)
   CRecordVector<ISequentialInStream*> InStreamPointers;
   CRecordVector<ISequentialOutStream*> OutStreamPointers;
 
-private:
-  virtual void Execute() Z7_override;
 public:
   bool EncodeMode;
   HRESULT Result;
@@ -392,17 +496,32 @@ public:
     ~CReleaser() { _c.Release(); }
   };
 
-  CCoderMT(): EncodeMode(false) {}
-  ~CCoderMT() Z7_DESTRUCTOR_override
+  CCoderMT(): EncodeMode(false), StatMode(false) {}
+  
+  void Execute();
+  void Code(ICompressProgressInfo *progress);
+  bool StatMode;
+};
+
+
+/* CCoderThread is not bound to one coder.
+   CMixerMT assigns the coder to thread before each Start(),
+   so the threads are reused for all folders, even if bind info was changed. */
+
+class CCoderThread: public CVirtThread
+{
+  Z7_CLASS_NO_COPY(CCoderThread)
+  virtual void Execute() Z7_override;
+public:
+  CCoderMT *Coder;
+
+  CCoderThread(): Coder(NULL) {}
+  ~CCoderThread() Z7_DESTRUCTOR_override
   {
     /* WaitThreadFinish() will be called in ~CVirtThread().
-       But we need WaitThreadFinish() call before CCoder destructor,
-       and before destructors of this class members.
-    */
+       But we need WaitThreadFinish() call before destructors of this class members. */
     CVirtThread::WaitThreadFinish();
   }
-  
-  void Code(ICompressProgressInfo *progress);
 };
 
 
@@ -418,11 +537,22 @@ class CMixerMT:
 
   HRESULT Init(ISequentialInStream * const *inStreams, ISequentialOutStream * const *outStreams);
   HRESULT ReturnIfError(HRESULT code);
+  void GetBondCoders(unsigned bondIndex,
+      UInt32 &inCoderIndex, UInt32 &inCoderStreamIndex,
+      UInt32 &outCoderIndex, UInt32 &outCoderStreamIndex) const;
+  void CalcStat();
 
   // virtual ~CMixerMT() {}
 public:
   CObjectVector<CCoderMT> _coders;
+private:
+  // it must be declared after (_coders) to be destroyed before (_coders)
+  CObjectVector<CCoderThread> _threads;
+public:
 
+  /* SetBindInfo() can be called again for new bind info.
+     Then AddCoder() calls must be repeated for new coders.
+     The threads and stream binders of previous bind info are reused. */
   virtual HRESULT SetBindInfo(const CBindInfo &bindInfo) Z7_override;
   virtual void AddCoder(const CCreatedCoder &cod) Z7_override;
   virtual CCoder &GetCoder(unsigned index) Z7_override;
@@ -437,7 +567,10 @@ public:
       bool &dataAfterEnd_Error) Z7_override;
   virtual UInt64 GetBondStreamSize(unsigned bondIndex) const Z7_override;
 
-  CMixerMT(bool encodeMode): CMixer(encodeMode) {}
+  // the size of ring buffer in each CStreamBinder. 0 : synchronous binders without buffers
+  UInt32 BinderRingSize;
+
+  CMixerMT(bool encodeMode): CMixer(encodeMode), BinderRingSize(kBinderRingSize_Default) {}
 };
 
 #endif
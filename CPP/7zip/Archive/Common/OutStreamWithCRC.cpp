@@ -16,3 +16,34 @@ Z7_COM7F_IMF(COutStreamWithCRC::Write(const void *data, UInt32 size, UInt32 *pro
     *processedSize = size;
   return result;
 }
+
+Z7_COM7F_IMF(COutStreamWithCRC::KernelCopy_GetFd(Int32 *fd, UInt64 *limit, Int32 *needData))
+{
+  *fd = -1;
+  *limit = 0;
+  *needData = 0;
+  if (!_stream)
+    return S_FALSE;
+  Z7_DECL_CMyComPtr_QI_FROM(IStreamKernelCopy, kernelCopy, _stream)
+  if (!kernelCopy)
+    return S_FALSE;
+  RINOK(kernelCopy->KernelCopy_GetFd(fd, limit, needData))
+  if (_calculate)
+    *needData = 1;
+  return S_OK;
+}
+
+Z7_COM7F_IMF(COutStreamWithCRC::KernelCopy_Processed(const void *data, UInt32 size))
+{
+  if (_calculate)
+  {
+    if (!data)
+      return E_FAIL;
+    _crc = CrcUpdate(_crc, data, size);
+  }
+  _size += size;
+  Z7_DECL_CMyComPtr_QI_FROM(IStreamKernelCopy, kernelCopy, _stream)
+  if (!kernelCopy)
+    return E_FAIL;
+  return kernelCopy->KernelCopy_Processed(data, size);
+}
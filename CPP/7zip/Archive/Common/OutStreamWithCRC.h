@@ -9,9 +9,10 @@
 
 #include "../../IStream.h"
 
-Z7_CLASS_IMP_NOQIB_1(
+Z7_CLASS_IMP_NOQIB_2(
   COutStreamWithCRC
   , ISequentialOutStream
+  , IStreamKernelCopy
 )
   CMyComPtr<ISequentialOutStream> _stream;
   UInt64 _size;
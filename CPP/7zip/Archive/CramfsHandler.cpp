@@ -12,8 +12,10 @@
 #include "../../Common/StringConvert.h"
 
 #include "../../Windows/PropVariantUtils.h"
+#include "../../Windows/System.h"
 
 #include "../Common/LimitedStreams.h"
+#include "../Common/MethodProps.h"
 #include "../Common/ProgressUtils.h"
 #include "../Common/RegisterArc.h"
 #include "../Common/StreamObjects.h"
@@ -22,6 +24,8 @@
 #include "../Compress/CopyCoder.h"
 #include "../Compress/ZlibDecoder.h"
 
+#include "Common/HandlerOut.h"
+
 namespace NArchive {
 namespace NCramfs {
 
@@ -170,11 +174,71 @@ struct CHeader
 
 
 
-Z7_CLASS_IMP_CHandler_IInArchive_1(
-  IInArchiveGetStream
+// it decodes zlib block from memory
+
+struct CZlibBlockDecoder
+{
+  CMyComPtr2<ICompressCoder, NCompress::NZlib::CDecoder> ZlibDecoder;
+  CMyComPtr2_Create<ISequentialInStream, CBufInStream> InStream;
+  CMyComPtr2_Create<ISequentialOutStream, CBufPtrSeqOutStream> OutStream;
+
+  HRESULT Decode(const Byte *src, UInt32 inSize, Byte *dest, size_t blockSize);
+};
+
+HRESULT CZlibBlockDecoder::Decode(const Byte *src, UInt32 inSize, Byte *dest, size_t blockSize)
+{
+  ZlibDecoder.Create_if_Empty();
+  InStream->Init(src, inSize);
+  OutStream->Init(dest, blockSize);
+  RINOK(ZlibDecoder.Interface()->Code(InStream, OutStream, NULL, NULL, NULL))
+  return (inSize == ZlibDecoder->GetInputProcessedSize() &&
+      OutStream->GetPos() == blockSize) ? S_OK : S_FALSE;
+}
+
+
+// the data of archive is shared by handler and streams
+
+Z7_CLASS_IMP_COM_0(
+  CArcData
 )
+public:
+  Byte *Data;
+  CArcData(): Data(NULL) {}
+  ~CArcData() { MidFree(Data); }
+};
+
+// the data that is required to decode the blocks of file
+
+struct CBlocksReader
+{
+  const Byte *Data;
+  UInt32 Size;
+  unsigned Method;
+  bool Be;
+
+  HRESULT ReadBlock(CZlibBlockDecoder &zlibDecoder,
+      UInt32 blocksOffset, UInt32 numBlocks,
+      UInt64 blockIndex, Byte *dest, size_t blockSize) const;
+};
+
+
+// "mt" and "memuse" properties are parsed by CCommonMethodProps
+
+Z7_class_CHandler_final:
+  public IInArchive,
+  public IInArchiveGetStream,
+  public ISetProperties,
+  public CMyUnknownImp,
+  public CCommonMethodProps
+{
+  Z7_IFACES_IMP_UNK_3(
+      IInArchive,
+      IInArchiveGetStream,
+      ISetProperties)
+
   CRecordVector<CItem> _items;
   CMyComPtr<IInStream> _stream;
+  CMyComPtr<IUnknown> _dataRef;
   Byte *_data;
   UInt32 _size;
   UInt32 _headersSize;
@@ -188,19 +252,11 @@ Z7_CLASS_IMP_CHandler_IInArchive_1(
   unsigned _method;
   unsigned _blockSizeLog;
 
-  // Current file
-
-  NCompress::NZlib::CDecoder *_zlibDecoderSpec;
-  CMyComPtr<ICompressCoder> _zlibDecoder;
-
-  CBufInStream *_inStreamSpec;
-  CMyComPtr<ISequentialInStream> _inStream;
-
-  CBufPtrSeqOutStream *_outStreamSpec;
-  CMyComPtr<ISequentialOutStream> _outStream;
-
-  UInt32 _curBlocksOffset;
-  UInt32 _curNumBlocks;
+  CZlibBlockDecoder _zlibDecoder;
+ #ifndef Z7_ST
+  CReadAheadPool _readAheadPool;
+  CObjectVector<CZlibBlockDecoder> _mtDecoders; // one decoder per thread of _readAheadPool
+ #endif
 
   HRESULT OpenDir(int parent, UInt32 baseOffsetBase, unsigned level);
   HRESULT Open2(IInStream *inStream);
@@ -222,7 +278,18 @@ Z7_CLASS_IMP_CHandler_IInArchive_1(
 public:
   CHandler(): _data(NULL) {}
   ~CHandler() { Free(); }
-  HRESULT ReadBlock(UInt64 blockIndex, Byte *dest, size_t blockSize);
+  void GetBlocksReader(CBlocksReader &r) const
+  {
+    r.Data = _data;
+    r.Size = _size;
+    r.Method = _method;
+    r.Be = _h.be;
+  }
+  CZlibBlockDecoder &GetDecoder() { return _zlibDecoder; }
+ #ifndef Z7_ST
+  // the array of (_mtDecoders) is not changed, see GetStream()
+  CZlibBlockDecoder &GetMtDecoder(unsigned threadIndex) { return _mtDecoders[threadIndex]; }
+ #endif
 };
 
 static const Byte kProps[] =
@@ -321,7 +388,12 @@ HRESULT CHandler::Open2(IInStream *inStream)
     _h.Size = (UInt32)size;
     RINOK(InStream_SeekSet(inStream, kHeaderSize))
   }
-  _data = (Byte *)MidAlloc(_h.Size);
+  {
+    CArcData *dataSpec = new CArcData;
+    _dataRef = dataSpec;
+    dataSpec->Data = (Byte *)MidAlloc(_h.Size);
+    _data = dataSpec->Data;
+  }
   if (!_data)
     return E_OUTOFMEMORY;
   memcpy(_data, buf, kHeaderSize);
@@ -462,7 +534,7 @@ Z7_COM7F_IMF(CHandler::Open(IInStream *stream, const UInt64 *, IArchiveOpenCallb
 
 void CHandler::Free()
 {
-  MidFree(_data);
+  _dataRef.Release();
   _data = NULL;
 }
 
@@ -552,48 +624,63 @@ Z7_COM7F_IMF(CHandler::GetProperty(UInt32 index, PROPID propID, PROPVARIANT *val
 class CCramfsInStream: public CCachedInStream
 {
   HRESULT ReadBlock(UInt64 blockIndex, Byte *dest, size_t blockSize) Z7_override;
+ #ifndef Z7_ST
+  HRESULT ReadBlock_Mt(unsigned threadIndex, UInt64 blockIndex, Byte *dest, size_t blockSize) Z7_override;
+ #endif
 public:
   CHandler *Handler;
+  CMyComPtr<IUnknown> HandlerRef;
+  UInt32 BlocksOffset;
+  UInt32 NumBlocks;
+  /* the stream and read-ahead threads use only these copies and the decoders of handler.
+     So CHandler::Close() and next Open() don't free the data of running jobs. */
+  CMyComPtr<IUnknown> DataRef;
+  CBlocksReader Reader;
+ #ifndef Z7_ST
+  ~CCramfsInStream() { StopReadAhead(); }
+ #endif
 };
 
 HRESULT CCramfsInStream::ReadBlock(UInt64 blockIndex, Byte *dest, size_t blockSize)
 {
-  return Handler->ReadBlock(blockIndex, dest, blockSize);
+  return Reader.ReadBlock(Handler->GetDecoder(), BlocksOffset, NumBlocks, blockIndex, dest, blockSize);
 }
 
-HRESULT CHandler::ReadBlock(UInt64 blockIndex, Byte *dest, size_t blockSize)
+#ifndef Z7_ST
+HRESULT CCramfsInStream::ReadBlock_Mt(unsigned threadIndex, UInt64 blockIndex, Byte *dest, size_t blockSize)
 {
-  if (_method == k_Flags_Method_ZLIB)
-  {
-    if (!_zlibDecoder)
-    {
-      _zlibDecoderSpec = new NCompress::NZlib::CDecoder();
-      _zlibDecoder = _zlibDecoderSpec;
-    }
-  }
-  else
+  return Reader.ReadBlock(Handler->GetMtDecoder(threadIndex), BlocksOffset, NumBlocks, blockIndex, dest, blockSize);
+}
+#endif
+
+// CBlocksReader::ReadBlock() uses only the data that is not changed while the stream exists.
+// So it can be called from read-ahead threads.
+
+HRESULT CBlocksReader::ReadBlock(CZlibBlockDecoder &zlibDecoder,
+    UInt32 blocksOffset, UInt32 numBlocks,
+    UInt64 blockIndex, Byte *dest, size_t blockSize) const
+{
+  if (Method != k_Flags_Method_ZLIB &&
+      Method != k_Flags_Method_LZMA)
   {
-    if (_method != k_Flags_Method_LZMA)
-    {
-      // probably we must support no-compression archives here.
-      return E_NOTIMPL;
-    }
+    // probably we must support no-compression archives here.
+    return E_NOTIMPL;
   }
 
-  const bool be = _h.be;
-  const Byte *p2 = _data + (_curBlocksOffset + (UInt32)blockIndex * 4);
-  const UInt32 start = (blockIndex == 0 ? _curBlocksOffset + _curNumBlocks * 4: Get32(p2 - 4));
+  const bool be = Be;
+  const Byte *p2 = Data + (blocksOffset + (UInt32)blockIndex * 4);
+  const UInt32 start = (blockIndex == 0 ? blocksOffset + numBlocks * 4: Get32(p2 - 4));
   const UInt32 end = Get32(p2);
-  if (end < start || end > _size)
+  if (end < start || end > Size)
     return S_FALSE;
   const UInt32 inSize = end - start;
 
-  if (_method == k_Flags_Method_LZMA)
+  if (Method == k_Flags_Method_LZMA)
   {
     const unsigned kLzmaHeaderSize = LZMA_PROPS_SIZE + 4;
     if (inSize < kLzmaHeaderSize)
       return S_FALSE;
-    const Byte *p = _data + start;
+    const Byte *p = Data + start;
     UInt32 destSize32 = GetUi32(p + LZMA_PROPS_SIZE);
     if (destSize32 > blockSize)
       return S_FALSE;
@@ -611,21 +698,7 @@ HRESULT CHandler::ReadBlock(UInt64 blockIndex, Byte *dest, size_t blockSize)
     return S_OK;
   }
 
-  if (!_inStream)
-  {
-    _inStreamSpec = new CBufInStream();
-    _inStream = _inStreamSpec;
-  }
-  if (!_outStream)
-  {
-    _outStreamSpec = new CBufPtrSeqOutStream();
-    _outStream = _outStreamSpec;
-  }
-  _inStreamSpec->Init(_data + start, inSize);
-  _outStreamSpec->Init(dest, blockSize);
-  RINOK(_zlibDecoder->Code(_inStream, _outStream, NULL, NULL, NULL))
-  return (inSize == _zlibDecoderSpec->GetInputProcessedSize() &&
-      _outStreamSpec->GetPos() == blockSize) ? S_OK : S_FALSE;
+  return zlibDecoder.Decode(Data + start, inSize, dest, blockSize);
 }
 
 Z7_COM7F_IMF(CHandler::Extract(const UInt32 *indices, UInt32 numItems,
@@ -762,18 +835,60 @@ Z7_COM7F_IMF(CHandler::GetStream(UInt32 index, ISequentialInStream **stream))
 
   CCramfsInStream *streamSpec = new CCramfsInStream;
   CMyComPtr<IInStream> streamTemp = streamSpec;
-  _curNumBlocks = numBlocks;
-  _curBlocksOffset = offset;
   streamSpec->Handler = this;
+  streamSpec->HandlerRef = (IInArchive *)this;
+  streamSpec->BlocksOffset = offset;
+  streamSpec->NumBlocks = numBlocks;
+  streamSpec->DataRef = _dataRef;
+  GetBlocksReader(streamSpec->Reader);
   if (!streamSpec->Alloc(_blockSizeLog, 21 - _blockSizeLog))
     return E_OUTOFMEMORY;
   streamSpec->Init(size);
+
+ #ifndef Z7_ST
+  {
+    // we decode next blocks in parallel for sequential reading
+    const UInt32 kNumReadAheadThreads_Max = 8;
+    UInt32 numThreads = _numThreads;
+    if (numThreads > kNumReadAheadThreads_Max)
+      numThreads = kNumReadAheadThreads_Max;
+    if (numThreads > 1 && numBlocks > 1)
+    {
+      // the threads are shared by all streams of the archive.
+      // The threads of other streams can use (_mtDecoders) now,
+      // so we create all decoders once, and the array is not changed later.
+      if (_mtDecoders.IsEmpty())
+        for (unsigned i = 0; i < kNumReadAheadThreads_Max; i++)
+          _mtDecoders.AddNew();
+      RINOK(_readAheadPool.Create(numThreads))
+      streamSpec->SetReadAhead(&_readAheadPool, numThreads, _memUsage_Decompress);
+    }
+  }
+ #endif
+
   *stream = streamTemp.Detach();
 
   return S_OK;
   COM_TRY_END
 }
 
+Z7_COM7F_IMF(CHandler::SetProperties(const wchar_t * const *names, const PROPVARIANT *values, UInt32 numProps))
+{
+  InitCommon();
+
+  for (UInt32 i = 0; i < numProps; i++)
+  {
+    const UString name = names[i];
+    const PROPVARIANT &prop = values[i];
+    // "memuse" limits the size of blocks that are decoded ahead
+    HRESULT hres;
+    if (!SetCommonProperty(name, prop, hres))
+      return E_INVALIDARG;
+    RINOK(hres)
+  }
+  return S_OK;
+}
+
 REGISTER_ARC_I(
   "CramFS", "cramfs", NULL, 0xD3,
   kSignature,
@@ -13,8 +13,14 @@
 #include "../../Common/UTFConvert.h"
 
 #include "../../Windows/PropVariant.h"
+#include "../../Windows/System.h"
+#ifndef Z7_ST
+#include "../../Windows/Synchronization.h"
+#include "../../Windows/Thread.h"
+#endif
 
 #include "../Common/LimitedStreams.h"
+#include "../Common/MethodProps.h"
 #include "../Common/ProgressUtils.h"
 #include "../Common/RegisterArc.h"
 #include "../Common/StreamObjects.h"
@@ -26,6 +32,7 @@
 #include "../Compress/XzDecoder.h"
 #include "../Compress/ZlibDecoder.h"
 
+#include "Common/HandlerOut.h"
 #include "Common/OutStreamWithCRC.h"
 
 // #define DMG_SHOW_RAW
@@ -70,6 +77,10 @@ static const size_t k_Chunk_Size_MAX = (size_t)1 << 28;
 //   4 GB cache for 64-bit:
 static const size_t k_Chunks_TotalSize_MAX = (size_t)1 << (sizeof(size_t) + 24);
 
+// multithreaded decoding is used only for blocks that are not larger than that limit:
+static const size_t k_MtBlock_Size_MAX = (size_t)1 << 26;
+static const UInt32 k_NumThreads_MAX = 32;
+
 // 2 GB limit for 32-bit:
 // 4 GB limit for 64-bit:
 // that limit can be increased for 64-bit mode, if there are such dmg files
@@ -313,9 +324,24 @@ void CForkPair::Print(AString &s, const char *name) const
 }
 
 
-Z7_CLASS_IMP_CHandler_IInArchive_1(
-  IInArchiveGetStream
-)
+#ifndef Z7_ST
+class CMtDecoder;
+#endif
+
+// "mt" and "memuse" properties are parsed by CCommonMethodProps
+
+Z7_class_CHandler_final:
+  public IInArchive,
+  public IInArchiveGetStream,
+  public ISetProperties,
+  public CMyUnknownImp,
+  public CCommonMethodProps
+{
+  Z7_IFACES_IMP_UNK_3(
+      IInArchive,
+      IInArchiveGetStream,
+      ISetProperties)
+
   bool _masterCrcError;
   bool _headersError;
   bool _dataForkError;
@@ -346,10 +372,19 @@ Z7_CLASS_IMP_CHandler_IInArchive_1(
   CObjectVector<CExtraFile> _extras;
 #endif
 
+ #ifndef Z7_ST
+  // the threads are shared by Extract() and by streams from GetStream()
+  CMyUniquePtr<CMtDecoder> _mtDecoder;
+ #endif
+
   HRESULT ReadData(IInStream *stream, const CForkPair &pair, CByteBuffer &buf);
   bool ParseBlob(const CByteBuffer &data);
   HRESULT Open2(IInStream *stream, IArchiveOpenCallback *openArchiveCallback);
   HRESULT Extract(IInStream *stream);
+public:
+ #ifndef Z7_ST
+  ~CHandler();
+ #endif
 };
 
 
@@ -1790,6 +1825,192 @@ HRESULT CDecoders::Code(ISequentialInStream *inStream, ISequentialOutStream *out
 }
 
 
+#ifndef Z7_ST
+
+static bool IsMtBlock(const CBlock &block, UInt64 unpSize)
+{
+  return !block.IsZeroMethod()
+      && block.Type != METHOD_COPY
+      && unpSize <= k_MtBlock_Size_MAX
+      && block.PackSize <= k_MtBlock_Size_MAX;
+}
+
+/*
+CMtDecoder decodes independent compressed blocks in parallel threads.
+The caller thread reads packed data to PackBuf, calls Start() and
+then Wait() for each thread, so the caller controls the order of blocks.
+*/
+
+struct CMtDecoderThread
+{
+  CDecoders Decoders;
+  CMyComPtr2_Create<ISequentialInStream, CBufInStream> InStream;
+  CMyComPtr2_Create<ISequentialOutStream, CBufPtrSeqOutStream> OutStream;
+  CByteBuffer PackBuf;
+  CByteBuffer UnpackBuf;
+
+  CBlock Block;
+  size_t PackSize;
+  Byte *Dest;
+  size_t UnpSize;
+  size_t OutSize;
+  HRESULT Result;
+  bool Busy;
+  bool Exit;
+
+  NWindows::NSynchronization::CAutoResetEvent StartEvent;
+  NWindows::NSynchronization::CAutoResetEvent FinishedEvent;
+  NWindows::CThread Thread;
+
+  static THREAD_FUNC_DECL ThreadFunc(void *param);
+  
+  // it reads packed data of block from (stream) that was seeked to start of block
+  HRESULT ReadPacked(ISequentialInStream *stream, const CBlock &block);
+};
+
+THREAD_FUNC_DECL CMtDecoderThread::ThreadFunc(void *param)
+{
+  CMtDecoderThread *t = (CMtDecoderThread *)param;
+  for (;;)
+  {
+    t->StartEvent.Lock();
+    if (t->Exit)
+      return THREAD_FUNC_RET_ZERO;
+    HRESULT res;
+    try
+    {
+      t->InStream->Init(t->PackBuf, t->PackSize);
+      t->OutStream->Init(t->Dest, t->UnpSize);
+      const UInt64 unpSize = t->UnpSize;
+      res = t->Decoders.Code(t->InStream, t->OutStream, t->Block, &unpSize, NULL);
+    }
+    catch(...) { res = E_OUTOFMEMORY; }
+    t->OutSize = t->OutStream->GetPos();
+    t->Result = res;
+    t->FinishedEvent.Set();
+  }
+}
+
+HRESULT CMtDecoderThread::ReadPacked(ISequentialInStream *stream, const CBlock &block)
+{
+  Block = block;
+  PackBuf.AllocAtLeast((size_t)block.PackSize);
+  // the decoder will see the end of stream, if the archive is truncated
+  PackSize = (size_t)block.PackSize;
+  return ReadStream(stream, PackBuf, &PackSize);
+}
+
+
+class CMtDecoder
+{
+public:
+  CObjectVector<CMtDecoderThread> Threads;
+
+  HRESULT Create(unsigned numThreads);
+  void Start(unsigned i)
+  {
+    CMtDecoderThread &t = Threads[i];
+    t.Busy = true;
+    t.StartEvent.Set();
+  }
+  void Wait(unsigned i)
+  {
+    CMtDecoderThread &t = Threads[i];
+    if (!t.Busy)
+      return;
+    t.FinishedEvent.Lock();
+    t.Busy = false;
+  }
+  void WaitAll()
+  {
+    FOR_VECTOR (i, Threads)
+      Wait(i);
+  }
+  void Stop();
+  ~CMtDecoder() { Stop(); }
+};
+
+// it creates new threads, if (numThreads) is larger than the number of created threads
+
+HRESULT CMtDecoder::Create(unsigned numThreads)
+{
+  while (Threads.Size() < numThreads)
+  {
+    CMtDecoderThread &t = Threads.AddNew();
+    t.Busy = false;
+    t.Exit = false;
+    WRes wres = t.StartEvent.CreateIfNotCreated_Reset();
+    if (wres == 0)
+      wres = t.FinishedEvent.CreateIfNotCreated_Reset();
+    if (wres == 0)
+      wres = t.Thread.Create(CMtDecoderThread::ThreadFunc, &t);
+    if (wres != 0)
+    {
+      Stop();
+      return HRESULT_FROM_WIN32(wres);
+    }
+  }
+  return S_OK;
+}
+
+void CMtDecoder::Stop()
+{
+  WaitAll();
+  FOR_VECTOR (i, Threads)
+  {
+    CMtDecoderThread &t = Threads[i];
+    t.Exit = true;
+    if (t.StartEvent.IsCreated())
+      t.StartEvent.Set();
+    if (t.Thread.IsCreated())
+      t.Thread.Wait_Close();
+  }
+  Threads.Clear();
+}
+
+CHandler::~CHandler() {}
+
+/* it returns the number of threads for multithreaded decoding of blocks of (file),
+   or 0, if multithreaded decoding is not used.
+   Each thread needs the buffers for packed and unpacked data of block.
+   So the number of threads is reduced as in LZMA2 decoder,
+   if the buffers of all threads exceed (memUsage). */
+
+static unsigned GetNumMtThreads(const CFile &file, UInt32 numThreads, UInt64 memUsage)
+{
+  if (numThreads > k_NumThreads_MAX)
+    numThreads = k_NumThreads_MAX;
+  if (numThreads <= 1)
+    return 0;
+  unsigned numMtBlocks = 0;
+  UInt64 blockMemMax = 0;
+  FOR_VECTOR (i, file.Blocks)
+  {
+    const CBlock &block = file.Blocks[i];
+    const UInt64 unpSize = file.GetUnpackSize_of_Block(i);
+    if (!IsMtBlock(block, unpSize))
+      continue;
+    numMtBlocks++;
+    const UInt64 blockMem = block.PackSize + unpSize;
+    if (blockMemMax < blockMem)
+      blockMemMax = blockMem;
+  }
+  if (numMtBlocks <= 1)
+    return 0;
+  if (numThreads > numMtBlocks)
+    numThreads = numMtBlocks;
+  const size_t kOverheadSize = 1 << 16;
+  const UInt64 okThreads = memUsage / (blockMemMax + kOverheadSize);
+  if (numThreads > okThreads)
+    numThreads = (UInt32)okThreads;
+  if (numThreads <= 1)
+    return 0;
+  return numThreads;
+}
+
+#endif
+
+
 Z7_COM7F_IMF(CHandler::Extract(const UInt32 *indices, UInt32 numItems,
     Int32 testMode, IArchiveExtractCallback *extractCallback))
 {
@@ -1829,6 +2050,11 @@ Z7_COM7F_IMF(CHandler::Extract(const UInt32 *indices, UInt32 numItems,
   CMyComPtr2_Create<ISequentialInStream, CLimitedSequentialInStream> inStream;
   inStream->SetStream(_inStream);
 
+ #ifndef Z7_ST
+  _mtDecoder.Create_if_Empty();
+  CMtDecoder &mtDecoder = *_mtDecoder;
+ #endif
+
   UInt64 total_PackSize = 0;
   UInt64 total_UnpackSize = 0;
   UInt64 cur_PackSize = 0;
@@ -1890,8 +2116,47 @@ Z7_COM7F_IMF(CHandler::Extract(const UInt32 *indices, UInt32 numItems,
         UInt64 unpPos = 0;
         UInt64 packPos = 0;
 
+       #ifndef Z7_ST
+        /* the blocks that are suitable for multithreaded decoding are
+           submitted in order of blocks to threads (0, 1, ..., numThreads - 1, 0, ...).
+           And we get the results in same order. */
+        const unsigned numMtThreads = GetNumMtThreads(item, _numThreads, _memUsage_Decompress);
+        unsigned submitIndex = 0;
+        unsigned submitThread = 0;
+        unsigned waitThread = 0;
+        unsigned numSubmitted = 0;
+        if (numMtThreads != 0)
+        {
+          RINOK(mtDecoder.Create(numMtThreads))
+        }
+       #endif
+
         FOR_VECTOR (blockIndex, item.Blocks)
         {
+         #ifndef Z7_ST
+          if (numMtThreads != 0)
+          {
+            // we submit next blocks before processing of current block
+            for (; submitIndex < item.Blocks.Size() && numSubmitted < numMtThreads; submitIndex++)
+            {
+              const CBlock &b = item.Blocks[submitIndex];
+              const UInt64 bUnpSize = item.GetUnpackSize_of_Block(submitIndex);
+              if (!IsMtBlock(b, bUnpSize))
+                continue;
+              CMtDecoderThread &t = mtDecoder.Threads[submitThread];
+              RINOK(InStream_SeekSet(_inStream, _startPos + _dataForkPair.Offset + item.StartPackPos + b.PackPos))
+              RINOK(t.ReadPacked(_inStream, b))
+              t.UnpackBuf.AllocAtLeast((size_t)bUnpSize);
+              t.Dest = t.UnpackBuf;
+              t.UnpSize = (size_t)bUnpSize;
+              mtDecoder.Start(submitThread);
+              if (++submitThread == numMtThreads)
+                submitThread = 0;
+              numSubmitted++;
+            }
+          }
+         #endif
+
           lps->InSize = total_PackSize + packPos;
           lps->OutSize = total_UnpackSize + unpPos;
           RINOK(lps->SetCur())
@@ -1906,9 +2171,6 @@ Z7_COM7F_IMF(CHandler::Extract(const UInt32 *indices, UInt32 numItems,
             break;
           }
 
-          RINOK(InStream_SeekSet(_inStream, _startPos + _dataForkPair.Offset + item.StartPackPos + block.PackPos))
-          inStream->Init(block.PackSize);
-
           const UInt64 unpSize = item.GetUnpackSize_of_Block(blockIndex);
 
           outStream->Init(unpSize);
@@ -1926,10 +2188,38 @@ Z7_COM7F_IMF(CHandler::Extract(const UInt32 *indices, UInt32 numItems,
             if (unpSize != block.PackSize)
               opRes = NExtract::NOperationResult::kUnsupportedMethod;
             else
+            {
+              RINOK(InStream_SeekSet(_inStream, _startPos + _dataForkPair.Offset + item.StartPackPos + block.PackPos))
+              inStream->Init(block.PackSize);
               res = copyCoder.Interface()->Code(inStream, outStream, NULL, NULL, lps);
+            }
           }
           else
-            res = decoders.Code(inStream, outStream, block, &unpSize, lps);
+          {
+           #ifndef Z7_ST
+            if (numMtThreads != 0 && IsMtBlock(block, unpSize))
+            {
+              mtDecoder.Wait(waitThread);
+              CMtDecoderThread &t = mtDecoder.Threads[waitThread];
+              if (++waitThread == numMtThreads)
+                waitThread = 0;
+              numSubmitted--;
+              res = t.Result;
+              if (t.OutSize != 0)
+              {
+                const HRESULT res2 = WriteStream(outStream, t.UnpackBuf, t.OutSize);
+                if (res == S_OK)
+                  res = res2;
+              }
+            }
+            else
+           #endif
+            {
+              RINOK(InStream_SeekSet(_inStream, _startPos + _dataForkPair.Offset + item.StartPackPos + block.PackPos))
+              inStream->Init(block.PackSize);
+              res = decoders.Code(inStream, outStream, block, &unpSize, lps);
+            }
+          }
 
           if (res != S_OK)
           {
@@ -1968,6 +2258,10 @@ Z7_COM7F_IMF(CHandler::Extract(const UInt32 *indices, UInt32 numItems,
             }
           }
         }
+       #ifndef Z7_ST
+        // some blocks can be still in progress after break
+        mtDecoder.WaitAll();
+       #endif
         if (needCrc && opRes == NExtract::NOperationResult::kOK)
         {
           if (outCrcStream->GetCRC() != item.Checksum.GetCrc32())
@@ -2018,6 +2312,7 @@ Z7_CLASS_IMP_IInStream(
 
 public:
   CMyComPtr<IInStream> Stream;
+  CMyComPtr<IUnknown> HandlerRef;
   const CFile *File;
   UInt64 Size;
 private:
@@ -2027,7 +2322,17 @@ private:
   CMyComPtr2<ISequentialOutStream, CBufPtrSeqOutStream> outStream;
   CMyComPtr2<ISequentialInStream, CLimitedSequentialInStream> inStream;
   CDecoders decoders;
+ #ifndef Z7_ST
+  HRESULT DecodeBlocks_Mt(unsigned blockIndex);
+ #endif
+
+  int FindChunk(unsigned blockIndex) const;
+  HRESULT AllocChunk(UInt64 unpSize, unsigned &chunkIndex);
 public:
+ #ifndef Z7_ST
+  CMtDecoder *MtDecoder; // it's owned by handler
+  unsigned NumThreads;   // the number of threads for multithreaded decoding, or 0
+ #endif
 
   // HRESULT
   void Init(UInt64 startPos)
@@ -2056,6 +2361,167 @@ CInStream::~CInStream()
     _chunks[--i].Free();
 }
 
+int CInStream::FindChunk(unsigned blockIndex) const
+{
+  unsigned numChunks = _chunks.Size();
+  if (numChunks)
+  {
+    const CChunk *chunk = _chunks.ConstData();
+    do
+    {
+      if (chunk->BlockIndex == (int)blockIndex)
+        return (int)(_chunks.Size() - numChunks);
+      chunk++;
+    }
+    while (--numChunks);
+  }
+  return -1;
+}
+
+// it returns the chunk with (chunk.BufSize >= unpSize) and (chunk.BlockIndex == -1).
+// It can free the least recently used chunks.
+
+HRESULT CInStream::AllocChunk(UInt64 unpSize, unsigned &chunkIndex)
+{
+  for (;;)
+  {
+    if (_chunks.IsEmpty() ||
+        (_chunks.Size() < k_NumChunks_MAX
+        && _chunks_TotalSize + unpSize <= k_Chunks_TotalSize_MAX))
+    {
+      CChunk chunk;
+      chunk.Buf = NULL;
+      chunk.BufSize = 0;
+      chunk.BlockIndex = -1;
+      chunk.AccessMark = 0;
+      chunkIndex = _chunks.Add(chunk);
+      break;
+    }
+    chunkIndex = 0;
+    if (_chunks.Size() == 1)
+      break;
+    {
+      const CChunk *chunks = _chunks.ConstData();
+      UInt64 accessMark_min = chunks[chunkIndex].AccessMark;
+      const unsigned numChunks = _chunks.Size();
+      for (unsigned i = 1; i < numChunks; i++)
+      {
+        if (chunks[i].AccessMark < accessMark_min)
+        {
+          chunkIndex = i;
+          accessMark_min = chunks[i].AccessMark;
+        }
+      }
+    }
+    {
+      CChunk &chunk = _chunks[chunkIndex];
+      const UInt64 newTotalSize = _chunks_TotalSize - chunk.BufSize;
+      if (newTotalSize + unpSize <= k_Chunks_TotalSize_MAX)
+        break;
+      _chunks_TotalSize = newTotalSize;
+      chunk.Free();
+    }
+    // we have called chunk.Free() before, because
+    // _chunks.Delete() doesn't call chunk.Free().
+    _chunks.Delete(chunkIndex);
+    PRF(printf("\n++num_chunks=%u, _chunks_TotalSize = %u\n", (unsigned)_chunks.Size(), (unsigned)_chunks_TotalSize);)
+  }
+  
+  CChunk &chunk = _chunks[chunkIndex];
+  chunk.BlockIndex = -1;
+  chunk.AccessMark = 0;
+  
+  if (chunk.BufSize < unpSize)
+  {
+    _chunks_TotalSize -= chunk.BufSize;
+    chunk.Free();
+    // if (unpSize > k_Chunk_Size_MAX) return E_FAIL;
+    chunk.Alloc((size_t)unpSize);
+    if (!chunk.Buf)
+      return E_OUTOFMEMORY;
+    chunk.BufSize = (size_t)unpSize;
+    _chunks_TotalSize += chunk.BufSize;
+  }
+  return S_OK;
+}
+
+#ifndef Z7_ST
+
+/* DecodeBlocks_Mt() decodes the block (blockIndex) and next blocks
+   in parallel threads to chunks.
+   If some block can't be decoded here, we don't store it to chunks,
+   and the caller will decode it again in single-thread mode to get the error code. */
+
+HRESULT CInStream::DecodeBlocks_Mt(unsigned blockIndex)
+{
+  const unsigned numThreads = NumThreads;
+  CMtDecoder &mtDecoder = *MtDecoder;
+  RINOK(mtDecoder.Create(numThreads))
+
+  // we don't want to evict the chunks of current batch from cache
+  const UInt64 kBatchSize_MAX = k_Chunks_TotalSize_MAX / 2;
+  UInt64 batchSize = 0;
+  unsigned blockIndexes[k_NumThreads_MAX];
+  unsigned numStarted = 0;
+
+  for (unsigned i = blockIndex; i < File->Blocks.Size() && numStarted < numThreads; i++)
+  {
+    const CBlock &block = File->Blocks[i];
+    const UInt64 unpSize = File->GetUnpackSize_of_Block(i);
+    if (!IsMtBlock(block, unpSize))
+    {
+      if (block.IsZeroMethod())
+        continue;
+      break;
+    }
+    if (FindChunk(i) >= 0)
+      continue;
+    batchSize += unpSize;
+    if (numStarted != 0 && batchSize > kBatchSize_MAX)
+      break;
+
+    unsigned chunkIndex;
+    RINOK(AllocChunk(unpSize, chunkIndex))
+    CChunk &chunk = _chunks[chunkIndex];
+    /* AllocChunk() can delete chunks, so chunk indexes can be changed.
+       So we set BlockIndex here, and we reset it, if decoding fails.
+       And we set new AccessMark to protect the chunk from eviction in AllocChunk(). */
+    chunk.BlockIndex = (int)i;
+    chunk.AccessMark = _accessMark++;
+
+    CMtDecoderThread &t = mtDecoder.Threads[numStarted];
+    HRESULT res = InStream_SeekSet(Stream, _startPos + File->StartPackPos + block.PackPos);
+    if (res == S_OK)
+      res = t.ReadPacked(Stream, block);
+    if (res != S_OK)
+    {
+      // we wait for started blocks
+      chunk.BlockIndex = -1;
+      break;
+    }
+    t.Dest = chunk.Buf;
+    t.UnpSize = (size_t)unpSize;
+    blockIndexes[numStarted] = i;
+    mtDecoder.Start(numStarted);
+    numStarted++;
+  }
+
+  for (unsigned k = 0; k < numStarted; k++)
+  {
+    mtDecoder.Wait(k);
+    const CMtDecoderThread &t = mtDecoder.Threads[k];
+    if (t.Result != S_OK || t.OutSize != t.UnpSize)
+    {
+      const int chunkIndex = FindChunk(blockIndexes[k]);
+      if (chunkIndex >= 0)
+        _chunks[(unsigned)chunkIndex].BlockIndex = -1;
+    }
+  }
+  return S_OK;
+}
+
+#endif
+
 static unsigned FindBlock(const CRecordVector<CBlock> &blocks, UInt64 pos)
 {
   unsigned left = 0, right = blocks.Size();
@@ -2109,86 +2575,19 @@ Z7_COM7F_IMF(CInStream::Read(void *data, UInt32 size, UInt32 *processedSize))
     if (block.NeedAllocateBuffer()
         && unpSize <= k_Chunk_Size_MAX)
     {
-      unsigned i = 0;
+      _latestChunk = FindChunk(blockIndex);
+     #ifndef Z7_ST
+      if (_latestChunk < 0 && NumThreads != 0 && IsMtBlock(block, unpSize))
       {
-        unsigned numChunks = _chunks.Size();
-        if (numChunks)
-        {
-          const CChunk *chunk = _chunks.ConstData();
-          do
-          {
-            if (chunk->BlockIndex == (int)blockIndex)
-              break;
-            chunk++;
-          }
-          while (--numChunks);
-          i = _chunks.Size() - numChunks;
-        }
+        RINOK(DecodeBlocks_Mt(blockIndex))
+        _latestChunk = FindChunk(blockIndex);
       }
-      if (i != _chunks.Size())
-        _latestChunk = (int)i;
-      else
+     #endif
+      if (_latestChunk < 0)
       {
         unsigned chunkIndex;
-        for (;;)
-        {
-          if (_chunks.IsEmpty() ||
-              (_chunks.Size() < k_NumChunks_MAX
-              && _chunks_TotalSize + unpSize <= k_Chunks_TotalSize_MAX))
-          {
-            CChunk chunk;
-            chunk.Buf = NULL;
-            chunk.BufSize = 0;
-            chunk.BlockIndex = -1;
-            chunk.AccessMark = 0;
-            chunkIndex = _chunks.Add(chunk);
-            break;
-          }
-          chunkIndex = 0;
-          if (_chunks.Size() == 1)
-            break;
-          {
-            const CChunk *chunks = _chunks.ConstData();
-            UInt64 accessMark_min = chunks[chunkIndex].AccessMark;
-            const unsigned numChunks = _chunks.Size();
-            for (i = 1; i < numChunks; i++)
-            {
-              if (chunks[i].AccessMark < accessMark_min)
-              {
-                chunkIndex = i;
-                accessMark_min = chunks[i].AccessMark;
-              }
-            }
-          }
-          {
-            CChunk &chunk = _chunks[chunkIndex];
-            const UInt64 newTotalSize = _chunks_TotalSize - chunk.BufSize;
-            if (newTotalSize + unpSize <= k_Chunks_TotalSize_MAX)
-              break;
-            _chunks_TotalSize = newTotalSize;
-            chunk.Free();
-          }
-          // we have called chunk.Free() before, because
-          // _chunks.Delete() doesn't call chunk.Free().
-          _chunks.Delete(chunkIndex);
-          PRF(printf("\n++num_chunks=%u, _chunks_TotalSize = %u\n", (unsigned)_chunks.Size(), (unsigned)_chunks_TotalSize);)
-        }
-        
+        RINOK(AllocChunk(unpSize, chunkIndex))
         CChunk &chunk = _chunks[chunkIndex];
-        chunk.BlockIndex = -1;
-        chunk.AccessMark = 0;
-        
-        if (chunk.BufSize < unpSize)
-        {
-          _chunks_TotalSize -= chunk.BufSize;
-          chunk.Free();
-          // if (unpSize > k_Chunk_Size_MAX) return E_FAIL;
-          chunk.Alloc((size_t)unpSize);
-          if (!chunk.Buf)
-            return E_OUTOFMEMORY;
-          chunk.BufSize = (size_t)unpSize;
-          _chunks_TotalSize += chunk.BufSize;
-        }
         
         RINOK(InStream_SeekSet(Stream, _startPos + File->StartPackPos + block.PackPos))
 
@@ -2317,6 +2716,12 @@ Z7_COM7F_IMF(CHandler::GetStream(UInt32 index, ISequentialInStream **stream))
   
   spec->Stream = _inStream;
   spec->Size = spec->File->Size;
+ #ifndef Z7_ST
+  _mtDecoder.Create_if_Empty();
+  spec->MtDecoder = _mtDecoder.get();
+  spec->NumThreads = GetNumMtThreads(file, _numThreads, _memUsage_Decompress);
+ #endif
+  spec->HandlerRef = (IInArchive *)this;
   // RINOK(
   spec->Init(_startPos + _dataForkPair.Offset);
   *stream = spec.Detach();
@@ -2325,6 +2730,23 @@ Z7_COM7F_IMF(CHandler::GetStream(UInt32 index, ISequentialInStream **stream))
   COM_TRY_END
 }
 
+Z7_COM7F_IMF(CHandler::SetProperties(const wchar_t * const *names, const PROPVARIANT *values, UInt32 numProps))
+{
+  InitCommon();
+
+  for (UInt32 i = 0; i < numProps; i++)
+  {
+    const UString name = names[i];
+    const PROPVARIANT &prop = values[i];
+    // "memuse" is memory limit for the buffers of threads in multithreaded decoding
+    HRESULT hres;
+    if (!SetCommonProperty(name, prop, hres))
+      return E_INVALIDARG;
+    RINOK(hres)
+  }
+  return S_OK;
+}
+
 REGISTER_ARC_I(
   "Dmg", "dmg", NULL, 0xE4,
   k_Signature,
@@ -35,6 +35,8 @@
 
 #include "../Compress/CopyCoder.h"
 
+#include "HandlerCont.h"
+
 using namespace NWindows;
 
 UInt32 LzhCrc16Update(UInt32 crc, const void *data, size_t size);
@@ -584,7 +586,7 @@ struct CExtentIndexNode
 struct CExtent
 {
   UInt32 VirtBlock;
-  UInt16 Len;
+  UInt32 Len;  // 16-bit in ext4 structure, but extents can be merged in stream
   bool IsInited;
   UInt64 PhyStart;
 
@@ -599,7 +601,7 @@ struct CExtent
     if (Len > (UInt32)0x8000)
     {
       IsInited = false;
-      Len = (UInt16)(Len - (UInt32)0x8000);
+      Len -= (UInt32)0x8000;
     }
     LE_32 (0x08, PhyStart)
     UInt16 hi;
@@ -784,6 +786,9 @@ struct CItem
 
 static const unsigned kNumTreeLevelsMax = 6; // must be >= 3
 
+// the number of extent tree blocks (index and leaf nodes) in cache
+static const unsigned kNumCachedTreeBlocks = 64;
+
 
 Z7_CLASS_IMP_CHandler_IInArchive_2(
   IArchiveGetRawProps,
@@ -814,6 +819,8 @@ Z7_CLASS_IMP_CHandler_IInArchive_2(
   UInt64 _totalReadPrev;
 
   CByteBuffer _tempBufs[kNumTreeLevelsMax];
+  // extent tree blocks that were read for previous files
+  CImgClusterCache _treeBlockCache;
 
   
   HRESULT CheckProgress2()
@@ -845,12 +852,14 @@ Z7_CLASS_IMP_CHandler_IInArchive_2(
   }
 
   HRESULT SeekAndRead(IInStream *inStream, UInt64 block, Byte *data, size_t size);
+  HRESULT ReadTreeBlock(UInt64 block, Byte *data);
   HRESULT ParseDir(const Byte *data, size_t size, unsigned iNodeDir);
   int FindTargetItem_for_SymLink(unsigned dirNode, const AString &path) const;
 
   HRESULT FillFileBlocks2(UInt32 block, unsigned level, unsigned numBlocks, CRecordVector<UInt32> &blocks);
   HRESULT FillFileBlocks(const Byte *p, unsigned numBlocks, CRecordVector<UInt32> &blocks);
   HRESULT FillExtents(const Byte *p, size_t size, CRecordVector<CExtent> &extents, int parentDepth);
+  UInt64 GetNodePhyStart(const CNode &node) const;
 
   HRESULT GetStream_Node(unsigned nodeIndex, ISequentialInStream **stream);
   HRESULT ExtractNode(unsigned nodeIndex, CByteBuffer &data);
@@ -1122,6 +1131,22 @@ HRESULT CHandler::SeekAndRead(IInStream *inStream, UInt64 block, Byte *data, siz
   return ReadStream_FALSE(inStream, data, size);
 }
 
+HRESULT CHandler::ReadTreeBlock(UInt64 block, Byte *data)
+{
+  const size_t blockSize = (size_t)1 << _h.BlockBits;
+  {
+    const int cacheIndex = _treeBlockCache.Find(0, block);
+    if (cacheIndex >= 0)
+    {
+      memcpy(data, _treeBlockCache.GetBuf((unsigned)cacheIndex), blockSize);
+      return S_OK;
+    }
+  }
+  RINOK(SeekAndRead(_stream, block, data, blockSize))
+  memcpy(_treeBlockCache.GetBuf(_treeBlockCache.Alloc_Item(0, block)), data, blockSize);
+  return S_OK;
+}
+
 
 static const unsigned kHeaderSize = 2 * 1024;
 static const unsigned kHeaderDataOffset = 1024;
@@ -1136,6 +1161,8 @@ HRESULT CHandler::Open2(IInStream *inStream)
     if (_h.BlockGroupNr != 0)
       return S_FALSE; // it's just copy of super block
   }
+
+  _treeBlockCache.Alloc(_h.BlockBits, kNumCachedTreeBlocks);
   
   {
     // ---------- Read groups and nodes ----------
@@ -1614,6 +1641,7 @@ Z7_COM7F_IMF(CHandler::Close())
   _isUTF = true;
 
   ClearRefs();
+  _treeBlockCache.Clear();
   return S_OK;
 }
 
@@ -2217,7 +2245,9 @@ Z7_COM7F_IMF(CClusterInStream2::Read(void *data, UInt32 size, UInt32 *processedS
     
     _curRem = blockSize - offsetInBlock;
     
-    for (unsigned i = 1; i < 64 && (virtBlock + i) < (UInt32)Vector.Size() && phyBlock + i == Vector[virtBlock + i]; i++)
+    // we read contiguous blocks with one read (up to 1 GiB)
+    const UInt32 numBlocksMax = (UInt32)1 << (30 - BlockBits);
+    for (UInt32 i = 1; i < numBlocksMax && (virtBlock + i) < (UInt32)Vector.Size() && phyBlock + i == Vector[virtBlock + i]; i++)
       _curRem += (UInt32)1 << BlockBits;
   }
 
@@ -2477,7 +2507,7 @@ static void AddSkipExtents(CRecordVector<CExtent> &extents, UInt32 virtBlock, UI
       len = kLenMax;
     CExtent e;
     e.VirtBlock = virtBlock;
-    e.Len = (UInt16)len;
+    e.Len = len;
     e.IsInited = false;
     e.PhyStart = 0;
     extents.Add(e);
@@ -2556,7 +2586,7 @@ HRESULT CHandler::FillExtents(const Byte *p, size_t size, CRecordVector<CExtent>
     if (!UpdateExtents(extents, e.VirtBlock))
       return S_FALSE;
 
-    RINOK(SeekAndRead(_stream, e.PhyLeaf, tempBuf, blockSize))
+    RINOK(ReadTreeBlock(e.PhyLeaf, tempBuf))
     RINOK(FillExtents(tempBuf, blockSize, extents, eth.Depth))
   }
 
@@ -2564,6 +2594,35 @@ HRESULT CHandler::FillExtents(const Byte *p, size_t size, CRecordVector<CExtent>
 }
 
 
+/* ext4 limits the length of extent to 32768 blocks, and the files
+   that are contiguous on disk are often split to many extents.
+   We merge neighboring extents to read such data with big sequential reads. */
+
+static void MergeExtents(CRecordVector<CExtent> &extents)
+{
+  const UInt32 kLenMax = (UInt32)1 << 30;
+  unsigned dest = 0;
+  FOR_VECTOR (i, extents)
+  {
+    const CExtent &e = extents[i];
+    if (dest != 0)
+    {
+      CExtent &prev = extents[dest - 1];
+      if (prev.IsInited == e.IsInited
+          && prev.GetVirtEnd() == e.VirtBlock
+          && (!e.IsInited || prev.PhyStart + prev.Len == e.PhyStart)
+          && prev.Len <= kLenMax - e.Len)
+      {
+        prev.Len += e.Len;
+        continue;
+      }
+    }
+    extents[dest++] = e;
+  }
+  extents.DeleteFrom(dest);
+}
+
+
 HRESULT CHandler::GetStream_Node(unsigned nodeIndex, ISequentialInStream **stream)
 {
   COM_TRY_BEGIN
@@ -2617,6 +2676,8 @@ HRESULT CHandler::GetStream_Node(unsigned nodeIndex, ISequentialInStream **strea
       // return S_FALSE;
     }
 
+    MergeExtents(streamSpec->Extents);
+
     RINOK(streamSpec->StartSeek())
   }
   else
@@ -2695,6 +2756,43 @@ HRESULT CHandler::ExtractNode(unsigned nodeIndex, CByteBuffer &data)
 }
 
 
+// it returns the first physical block of file data or (0), if it's unknown
+UInt64 CHandler::GetNodePhyStart(const CNode &node) const
+{
+  if (node.IsFlags_EXTENTS())
+  {
+    CExtentTreeHeader eth;
+    if (!eth.Parse(node.Block) || eth.NumEntries == 0)
+      return 0;
+    if (eth.Depth == 0)
+    {
+      CExtent e;
+      e.Parse(node.Block + 12);
+      return e.PhyStart;
+    }
+    CExtentIndexNode e;
+    e.Parse(node.Block + 12);
+    return e.PhyLeaf;
+  }
+  if (node.NumBlocks == 0 && node.FileSize < kNodeBlockFieldSize)
+    return 0;
+  return GetUi32(node.Block);
+}
+
+struct CExtractItem
+{
+  UInt64 Phy;
+  UInt32 Index;
+};
+
+static int CompareExtractItems(const CExtractItem *a1, const CExtractItem *a2, void *)
+{
+  if (a1->Phy != a2->Phy)
+    return MyCompare(a1->Phy, a2->Phy);
+  return MyCompare(a1->Index, a2->Index);
+}
+
+
 Z7_COM7F_IMF(CHandler::Extract(const UInt32 *indices, UInt32 numItems,
     Int32 testMode, IArchiveExtractCallback *extractCallback))
 {
@@ -2721,6 +2819,25 @@ Z7_COM7F_IMF(CHandler::Extract(const UInt32 *indices, UInt32 numItems,
   
   RINOK(extractCallback->SetTotal(totalSize))
 
+  /* we extract files in order of their physical position in image
+     to reduce the number of seeks. Directories and another items without data go first. */
+  CRecordVector<CExtractItem> extractItems;
+  extractItems.ClearAndReserve(numItems);
+  for (i = 0; i < numItems; i++)
+  {
+    CExtractItem ei;
+    ei.Index = allFilesMode ? i : indices[i];
+    ei.Phy = 0;
+    if (ei.Index < _items.Size())
+    {
+      const CNode &node = _nodes[_refs[_items[ei.Index].Node]];
+      if (!node.IsDir())
+        ei.Phy = GetNodePhyStart(node);
+    }
+    extractItems.AddInReserved(ei);
+  }
+  extractItems.Sort(CompareExtractItems, NULL);
+
   UInt64 totalPackSize;
   totalSize = totalPackSize = 0;
   
@@ -2743,7 +2860,7 @@ Z7_COM7F_IMF(CHandler::Extract(const UInt32 *indices, UInt32 numItems,
         NExtract::NAskMode::kTest :
         NExtract::NAskMode::kExtract;
     
-    const UInt32 index = allFilesMode ? i : indices[i];
+    const UInt32 index = extractItems[i].Index;
     
     RINOK(extractCallback->GetStream(index, &outStream, askMode))
 
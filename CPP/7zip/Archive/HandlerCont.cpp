@@ -106,11 +106,127 @@ Z7_COM7F_IMF(CHandlerCont::GetStream(UInt32 index, ISequentialInStream **stream)
 
 
 
-CHandlerImg::CHandlerImg()
+CHandlerImg::CHandlerImg():
+    _isMtSupported(false),
+    _numMtThreads(1)
 {
   Clear_HandlerImg_Vars();
 }
 
+static const unsigned k_NumThreads_MAX = 32;
+
+unsigned CHandlerImg::GetNumMtThreads(unsigned clusterBits) const
+{
+ #ifdef Z7_ST
+  UNUSED_VAR(clusterBits)
+  return 1;
+ #else
+  UInt32 numThreads = _numThreads;
+  if (numThreads > k_NumThreads_MAX)
+    numThreads = k_NumThreads_MAX;
+  const UInt64 okThreads = _memUsage_Decompress / ((UInt64)4 << clusterBits);
+  if (numThreads > okThreads)
+    numThreads = (UInt32)okThreads;
+  if (numThreads == 0)
+    numThreads = 1;
+  return numThreads;
+ #endif
+}
+
+
+#ifndef Z7_ST
+
+void CImgDecoderThread::Execute()
+{
+  try
+  {
+    DataError = false;
+    Result = Decoder->Decode(PackBuf + PackOffset, PackSize, Dest, UnitSize, DataError);
+  }
+  catch(...)
+  {
+    Result = E_FAIL;
+  }
+}
+
+HRESULT CHandlerImg::DecodeUnits_Mt(CImgClusterCache &cache, unsigned extent,
+    UInt64 unit, UInt64 numUnits, unsigned unitBits)
+{
+  unsigned numThreads = _numMtThreads;
+  if (numThreads > cache.Size())
+    numThreads = cache.Size();
+
+  while (_decoderThreads.Size() < numThreads)
+  {
+    CImgDecoderThread &t = _decoderThreads.AddNew();
+    t.Decoder = CreateUnitDecoder();
+    const WRes wres = t.Create();
+    if (wres != 0)
+    {
+      _decoderThreads.DeleteBack();
+      return HRESULT_FROM_WIN32(wres);
+    }
+  }
+
+  unsigned numJobs = 0;
+  
+  for (UInt64 c = unit; numJobs < numThreads
+      && c < numUnits
+      && c - unit < (UInt64)numThreads * 2; c++)
+  {
+    if (!Is_PackedUnit(extent, c))
+      continue;
+    if (c != unit && cache.IsCached(extent, c))
+      continue;
+    CImgDecoderThread &t = _decoderThreads[numJobs];
+    const HRESULT hres = ReadPackedUnit(extent, c, t.PackBuf, t.PackOffset, t.PackSize);
+    if (hres != S_OK)
+    {
+      if (numJobs != 0)
+        break;
+      return hres;
+    }
+    t.UnitSize = (size_t)1 << unitBits;
+    t.CacheIndex = cache.Alloc_Item(extent, c);
+    t.Dest = cache.GetBuf(t.CacheIndex);
+    numJobs++;
+  }
+
+  HRESULT res = S_OK;
+  unsigned numStarted;
+  for (numStarted = 0; numStarted < numJobs; numStarted++)
+  {
+    const WRes wres = _decoderThreads[numStarted].Start();
+    if (wres != 0)
+    {
+      res = HRESULT_FROM_WIN32(wres);
+      break;
+    }
+  }
+
+  for (unsigned i = 0; i < numJobs; i++)
+  {
+    CImgDecoderThread &t = _decoderThreads[i];
+    if (i < numStarted)
+    {
+      t.WaitExecuteFinish();
+      if (t.Result == S_OK)
+        continue;
+      if (i == 0)
+      {
+        res = t.Result;
+        if (t.DataError)
+          _stream_dataError = true;
+      }
+    }
+    cache.Free_Item(t.CacheIndex);
+  }
+  
+  return res;
+}
+
+#endif
+
 Z7_COM7F_IMF(CHandlerImg::Seek(Int64 offset, UInt32 seekOrigin, UInt64 *newPosition))
 {
   switch (seekOrigin)
@@ -168,6 +284,7 @@ void CHandlerImg::Clear_HandlerImg_Vars()
 {
   _imgExt = NULL;
   _size = 0;
+  _allocUnitBits = 0;
   ClearStreamVars();
   Reset_VirtPos();
   Reset_PosInArc();
@@ -218,6 +335,132 @@ Z7_COM7F_IMF(CHandlerImg::GetNumberOfItems(UInt32 *numItems))
 }
 
 
+Z7_COM7F_IMF(CHandlerImg::SetProperties(const wchar_t * const *names, const PROPVARIANT *values, UInt32 numProps))
+{
+  InitCommon();
+
+  for (UInt32 i = 0; i < numProps; i++)
+  {
+    const UString name = names[i];
+    const PROPVARIANT &prop = values[i];
+    // "memuse" is memory limit for the cache and for the buffers of threads
+    HRESULT hres;
+    if (!SetCommonProperty(name, prop, hres))
+      return E_INVALIDARG;
+    RINOK(hres)
+  }
+  return S_OK;
+}
+
+
+Z7_COM7F_IMF(CHandlerImg::GetDataRange(UInt64 pos, UInt64 *dataStart, UInt64 *dataEnd))
+{
+  *dataStart = _size;
+  *dataEnd = _size;
+  if (pos >= _size)
+    return S_OK;
+  if (_allocUnitBits == 0)
+  {
+    *dataStart = pos;
+    return S_OK;
+  }
+  const UInt64 numUnits = ((_size - 1) >> _allocUnitBits) + 1;
+  UInt64 unit = pos >> _allocUnitBits;
+  for (;; unit++)
+  {
+    if (unit == numUnits)
+      return S_OK;
+    if (Get_AllocUnit_IsData(unit))
+      break;
+  }
+  const UInt64 start = unit << _allocUnitBits;
+  *dataStart = MyMax(start, pos);
+  for (unit++; unit < numUnits; unit++)
+    if (!Get_AllocUnit_IsData(unit))
+    {
+      *dataEnd = unit << _allocUnitBits;
+      break;
+    }
+  return S_OK;
+}
+
+
+/*
+CopySparse() copies data ranges reported by (getDataRange).
+Holes are skipped in (outStream) with IOutStreamWriteHole, if it's supported.
+Otherwise it writes zeros for holes to (outStream).
+(outStream) can be NULL in test mode.
+*/
+
+static HRESULT CopySparse(IInStream *inStream, IStreamGetDataRange *getDataRange,
+    ISequentialOutStream *outStream, UInt64 size,
+    CLocalProgress *lps, ICompressProgressInfo *progress,
+    UInt64 &processed)
+{
+  processed = 0;
+  CMyComPtr<IOutStreamWriteHole> writeHole;
+  if (outStream)
+    outStream->QueryInterface(IID_IOutStreamWriteHole, (void **)&writeHole);
+  CMyComPtr2_Create<ICompressCoder, NCompress::CCopyCoder> copyCoder;
+  CByteBuffer zeros;
+  const size_t kZerosSize = 1 << 16;
+
+  while (processed < size)
+  {
+    UInt64 dataStart, dataEnd;
+    RINOK(getDataRange->GetDataRange(processed, &dataStart, &dataEnd))
+    if (dataStart < processed || dataStart > size)
+      dataStart = size;
+    if (dataEnd <= dataStart || dataEnd > size)
+      dataEnd = size;
+
+    if (dataStart != processed)
+    {
+      UInt64 rem = dataStart - processed;
+      if (outStream)
+      {
+        HRESULT res = S_FALSE;
+        if (writeHole)
+          res = writeHole->WriteHole(rem);
+        if (res == S_FALSE)
+        {
+          if (zeros.Size() == 0)
+          {
+            zeros.Alloc(kZerosSize);
+            memset(zeros, 0, kZerosSize);
+          }
+          while (rem != 0)
+          {
+            const size_t cur = (size_t)MyMin(rem, (UInt64)kZerosSize);
+            RINOK(WriteStream(outStream, zeros, cur))
+            rem -= cur;
+          }
+        }
+        else
+        {
+          RINOK(res)
+        }
+      }
+      processed = dataStart;
+      lps->OutSize = processed;
+      RINOK(lps->SetCur())
+      if (processed == size)
+        break;
+    }
+
+    RINOK(InStream_SeekSet(inStream, processed))
+    const UInt64 cur = dataEnd - processed;
+    lps->OutSize = processed;
+    RINOK(copyCoder.Interface()->Code(inStream, outStream, NULL, &cur, progress))
+    processed += copyCoder->TotalSize;
+    if (copyCoder->TotalSize != cur)
+      break;
+  }
+  lps->OutSize = 0;
+  return S_OK;
+}
+
+
 Z7_CLASS_IMP_NOQIB_1(
   CHandlerImgProgress
   , ICompressProgressInfo
@@ -282,12 +525,23 @@ Z7_COM7F_IMF(CHandlerImg::Extract(const UInt32 *indices, UInt32 numItems,
       progress = imgProgress;
     }
 
-    CMyComPtr2_Create<ICompressCoder, NCompress::CCopyCoder> copyCoder;
-
-    hres = copyCoder.Interface()->Code(inStream, outStream, NULL, &_size, progress);
+    UInt64 totalSize = 0;
+    CMyComPtr<IInStream> inStreamSeek;
+    CMyComPtr<IStreamGetDataRange> getDataRange;
+    inStream.QueryInterface(IID_IInStream, &inStreamSeek);
+    if (inStreamSeek)
+      inStream.QueryInterface(IID_IStreamGetDataRange, &getDataRange);
+    if (getDataRange)
+      hres = CopySparse(inStreamSeek, getDataRange, outStream, _size, lps, progress, totalSize);
+    else
+    {
+      CMyComPtr2_Create<ICompressCoder, NCompress::CCopyCoder> copyCoder;
+      hres = copyCoder.Interface()->Code(inStream, outStream, NULL, &_size, progress);
+      totalSize = copyCoder->TotalSize;
+    }
     if (hres == S_OK)
     {
-      if (copyCoder->TotalSize == _size)
+      if (totalSize == _size)
         opRes = NExtract::NOperationResult::kOK;
       
       if (_stream_unavailData)
@@ -296,7 +550,7 @@ Z7_COM7F_IMF(CHandlerImg::Extract(const UInt32 *indices, UInt32 numItems,
         opRes = NExtract::NOperationResult::kUnsupportedMethod;
       else if (_stream_dataError)
         opRes = NExtract::NOperationResult::kDataError;
-      else if (copyCoder->TotalSize < _size)
+      else if (totalSize < _size)
         opRes = NExtract::NOperationResult::kUnexpectedEnd;
     }
   }
@@ -318,4 +572,91 @@ Z7_COM7F_IMF(CHandlerImg::Extract(const UInt32 *indices, UInt32 numItems,
   COM_TRY_END
 }
 
+
+
+void CImgClusterCache::Alloc(unsigned clusterBits, unsigned numItems)
+{
+  if (numItems == 0)
+    numItems = 1;
+  if (_clusterBits == clusterBits && _items.Size() >= numItems)
+  {
+    Clear();
+    return;
+  }
+  _items.Clear();
+  _buf.Free();
+  _clusterBits = clusterBits;
+  _buf.Alloc((size_t)numItems << clusterBits);
+  _items.ClearAndReserve(numItems);
+  for (unsigned i = 0; i < numItems; i++)
+  {
+    CItem item;
+    item.Cluster = (UInt64)(Int64)-1;
+    item.Extent = (unsigned)(int)-1;
+    item.UseStamp = 0;
+    _items.AddInReserved(item);
+  }
+  _useStamp = 0;
+}
+
+void CImgClusterCache::Clear()
+{
+  FOR_VECTOR (i, _items)
+    Free_Item(i);
+  _useStamp = 0;
+}
+
+void CImgClusterCache::Free()
+{
+  _items.Clear();
+  _buf.Free();
+  _useStamp = 0;
+}
+
+int CImgClusterCache::Find(unsigned extent, UInt64 cluster)
+{
+  FOR_VECTOR (i, _items)
+  {
+    CItem &item = _items[i];
+    if (item.Cluster == cluster && item.Extent == extent)
+    {
+      item.UseStamp = ++_useStamp;
+      return (int)i;
+    }
+  }
+  return -1;
+}
+
+bool CImgClusterCache::IsCached(unsigned extent, UInt64 cluster) const
+{
+  FOR_VECTOR (i, _items)
+  {
+    const CItem &item = _items[i];
+    if (item.Cluster == cluster && item.Extent == extent)
+      return true;
+  }
+  return false;
+}
+
+unsigned CImgClusterCache::Alloc_Item(unsigned extent, UInt64 cluster)
+{
+  unsigned best = 0;
+  for (unsigned i = 1; i < _items.Size(); i++)
+    if (_items[i].UseStamp < _items[best].UseStamp)
+      best = i;
+  CItem &item = _items[best];
+  item.Cluster = cluster;
+  item.Extent = extent;
+  item.UseStamp = ++_useStamp;
+  return best;
+}
+
+void CImgClusterCache::Free_Item(unsigned index)
+{
+  CItem &item = _items[index];
+  item.Cluster = (UInt64)(Int64)-1;
+  item.Extent = (unsigned)(int)-1;
+  item.UseStamp = 0;
+}
+
 }
@@ -3,7 +3,15 @@
 #ifndef ZIP7_INC_HANDLER_CONT_H
 #define ZIP7_INC_HANDLER_CONT_H
 
+#include "../../Common/MyBuffer.h"
 #include "../../Common/MyCom.h"
+#include "../../Common/MyVector.h"
+
+#ifndef Z7_ST
+#include "../Common/VirtThread.h"
+#endif
+
+#include "Common/HandlerOut.h"
 
 #include "IArchive.h"
 
@@ -62,22 +70,79 @@ protected:
   x(GetArchivePropertyInfo(UInt32 index, BSTR *name, PROPID *propID, VARTYPE *varType)) \
 
 
+/*
+CImgUnitDecoder : decoder of one compressed unit (cluster or grain) of image.
+  (dataError) is set, if the packed data doesn't match the unit.
+*/
+
+class CImgUnitDecoder
+{
+public:
+  virtual HRESULT Decode(const Byte *src, size_t srcSize, Byte *dest, size_t destSize, bool &dataError) = 0;
+  virtual ~CImgUnitDecoder() {}
+};
+
+class CImgClusterCache;
+
+#ifndef Z7_ST
+
+class CImgDecoderThread Z7_final: public CVirtThread
+{
+public:
+  CImgUnitDecoder *Decoder;
+  CByteBuffer PackBuf;
+  size_t PackOffset;
+  size_t PackSize;
+  Byte *Dest;
+  size_t UnitSize;
+  unsigned CacheIndex;
+  HRESULT Result;
+  bool DataError;
+
+  CImgDecoderThread(): Decoder(NULL) {}
+  ~CImgDecoderThread() Z7_DESTRUCTOR_override
+  {
+    /* WaitThreadFinish() will be called in ~CVirtThread().
+       But we need WaitThreadFinish() call before
+       destructors of this class members.
+    */
+    CVirtThread::WaitThreadFinish();
+    delete Decoder;
+  }
+private:
+  virtual void Execute() Z7_override;
+};
+
+#endif
+
+
 class CHandlerImg:
   public IInArchive,
   public IInArchiveGetStream,
   public IInStream,
-  public CMyUnknownImp
+  public ISetProperties,
+  public IStreamGetDataRange,
+  public CMyUnknownImp,
+  public CCommonMethodProps
 {
-  Z7_COM_UNKNOWN_IMP_4(
-      IInArchive,
-      IInArchiveGetStream,
-      ISequentialInStream,
-      IInStream)
+  Z7_COM_QI_BEGIN2(IInArchive)
+    Z7_COM_QI_ENTRY(IInArchiveGetStream)
+    Z7_COM_QI_ENTRY(ISequentialInStream)
+    Z7_COM_QI_ENTRY(IInStream)
+    // ISetProperties is exposed only by handlers that support multithreaded decoding
+    else if (iid == IID_ISetProperties && _isMtSupported)
+      { ISetProperties *ti = this;  *outObject = ti; }
+    Z7_COM_QI_ENTRY(IStreamGetDataRange)
+  Z7_COM_QI_END
+  Z7_COM_ADDREF_RELEASE
 
   Z7_COM7F_IMP(Open(IInStream *stream, const UInt64 *maxCheckStartPosition, IArchiveOpenCallback *openCallback))
   Z7_COM7F_IMP(GetNumberOfItems(UInt32 *numItems))
   Z7_COM7F_IMP(Extract(const UInt32 *indices, UInt32 numItems, Int32 testMode, IArchiveExtractCallback *extractCallback))
   Z7_IFACE_COM7_IMP(IInStream)
+  Z7_IFACE_COM7_IMP(ISetProperties)
+  // default GetDataRange() uses (_allocUnitBits) and Get_AllocUnit_IsData()
+  Z7_IFACE_COM7_IMP_NONFINAL(IStreamGetDataRange)
   // Z7_IFACEM_IInArchive_Img(Z7_COM7F_PUREO)
 
 protected:
@@ -91,6 +156,15 @@ protected:
   UInt64 _size;
   CMyComPtr<IInStream> Stream;
   const char *_imgExt;
+  bool _isMtSupported; // the handler supports "mt" and "memuse" properties
+  /* (_allocUnitBits) is size of unit in allocation table of image.
+     (_allocUnitBits == 0) means that allocation table is not supported,
+     and all stream is reported as data by GetDataRange(). */
+  unsigned _allocUnitBits;
+  unsigned _numMtThreads; // it's set in GetStream() of handler that supports multithreading
+ #ifndef Z7_ST
+  CObjectVector<CImgDecoderThread> _decoderThreads;
+ #endif
   
   void Reset_PosInArc() { _posInArc = (UInt64)0 - 1; }
   void Reset_VirtPos() { _virtPos = (UInt64)0; }
@@ -106,8 +180,49 @@ protected:
 
   void Clear_HandlerImg_Vars(); // it doesn't Release (Stream) var.
 
+  /* it returns the number of threads for multithreaded decoding of clusters,
+     or 1, if multithreaded decoding is not used.
+     Each thread needs (4) buffers of cluster size: two items in cache and packed data.
+     So the number of threads is reduced, if these buffers exceed (_memUsage_Decompress). */
+  unsigned GetNumMtThreads(unsigned clusterBits) const;
+
+ #ifndef Z7_ST
+  /* the hooks for DecodeUnits_Mt().
+     Is_PackedUnit() returns (true), if (unit) of (extent) is stored compressed.
+     ReadPackedUnit() reads packed data of (unit) to (buf),
+       and it returns the position and the size of packed data in (buf). */
+  virtual bool Is_PackedUnit(unsigned /* extent */, UInt64 /* unit */) const
+  {
+    return false;
+  }
+  virtual HRESULT ReadPackedUnit(unsigned /* extent */, UInt64 /* unit */,
+      CByteBuffer & /* buf */, size_t & /* offset */, size_t & /* size */)
+  {
+    return E_NOTIMPL;
+  }
+  virtual CImgUnitDecoder *CreateUnitDecoder()
+  {
+    return NULL;
+  }
+
+  /* DecodeUnits_Mt() reads packed data of (unit) and of next packed units
+     that are not in (cache), and unpacks these units to (cache) in parallel threads.
+     (numUnits) is the number of units in (extent); all units are (1 << unitBits) bytes.
+     It returns S_OK, only if (unit) was unpacked to cache.
+     Errors in additional units are ignored here:
+     these units will be unpacked again in Read() call. */
+  HRESULT DecodeUnits_Mt(CImgClusterCache &cache, unsigned extent,
+      UInt64 unit, UInt64 numUnits, unsigned unitBits);
+ #endif
+
   virtual HRESULT Open2(IInStream *stream, IArchiveOpenCallback *openCallback) = 0;
   virtual void CloseAtError();
+
+  // returns (false), if unit is not allocated, and it's read as zeros
+  virtual bool Get_AllocUnit_IsData(UInt64 /* unit */) const
+  {
+    return true;
+  }
   
   // returns (true), if Get_PackSizeProcessed() is required in Extract()
   virtual bool Init_PackSizeProcessed()
@@ -127,6 +242,47 @@ public:
 };
 
 
+/*
+CImgClusterCache : LRU cache of unpacked clusters for image handlers
+  that store compressed clusters (QCOW, VMDK).
+  File system handlers also use it as cache of metadata blocks.
+  (Extent) and (Cluster) are the key of cached item.
+  All items are (1 << clusterBits) bytes.
+*/
+
+class CImgClusterCache
+{
+  struct CItem
+  {
+    UInt64 Cluster;
+    unsigned Extent;
+    UInt64 UseStamp;
+  };
+
+  CRecordVector<CItem> _items;
+  CByteBuffer _buf;
+  unsigned _clusterBits;
+  UInt64 _useStamp;
+public:
+  CImgClusterCache(): _clusterBits(0), _useStamp(0) {}
+
+  unsigned Size() const { return _items.Size(); }
+  Byte *GetBuf(unsigned index) { return _buf + ((size_t)index << _clusterBits); }
+
+  // it doesn't reallocate buffer, if there are enough items of required size
+  void Alloc(unsigned clusterBits, unsigned numItems);
+  void Clear();
+  void Free();
+  // returns -1, if there is no such cluster in cache
+  int Find(unsigned extent, UInt64 cluster);
+  bool IsCached(unsigned extent, UInt64 cluster) const;
+  // returns index of least recently used item that is reassigned to new key
+  unsigned Alloc_Item(unsigned extent, UInt64 cluster);
+  // call it, if unpacking to allocated item was not successful
+  void Free_Item(unsigned index);
+};
+
+
 HRESULT ReadZeroTail(ISequentialInStream *stream, bool &areThereNonZeros, UInt64 &numZeros, UInt64 maxSize);
 
 }
@@ -14,6 +14,7 @@
 #include "../Common/StreamObjects.h"
 #include "../Common/StreamUtils.h"
 
+#include "HandlerCont.h"
 #include "HfsHandler.h"
 
 /* if HFS_SHOW_ALT_STREAMS is defined, the handler will show attribute files
@@ -444,9 +445,11 @@ struct CRef
 };
 
 
+class CBTreeReader;
+
 class CDatabase
 {
-  HRESULT ReadFile(const CFork &fork, CByteBuffer &buf, IInStream *inStream);
+  HRESULT OpenBTree(const CFork &fork, CBTreeReader &tree, IInStream *inStream);
   HRESULT LoadExtentFile(const CFork &fork, IInStream *inStream, CObjectVector<CIdExtents> *overflowExtentsArray);
   HRESULT LoadAttrs(const CFork &fork, IInStream *inStream, IArchiveOpenCallback *progress);
   HRESULT LoadCatalog(const CFork &fork, const CObjectVector<CIdExtents> *overflowExtentsArray, IInStream *inStream, IArchiveOpenCallback *progress);
@@ -590,38 +593,6 @@ void CDatabase::GetItemPath(unsigned index, NWindows::NCOM::CPropVariant &path)
   }
 }
 
-// Actually we read all blocks. It can be larger than fork.Size
-
-HRESULT CDatabase::ReadFile(const CFork &fork, CByteBuffer &buf, IInStream *inStream)
-{
-  if (fork.NumBlocks >= Header.NumBlocks)
-    return S_FALSE;
-  if (((ArcFileSize - SpecOffset) >> Header.BlockSizeLog) + 1 < fork.NumBlocks)
-    return S_FALSE;
-
-  const size_t totalSize = (size_t)fork.NumBlocks << Header.BlockSizeLog;
-  if ((totalSize >> Header.BlockSizeLog) != fork.NumBlocks)
-    return S_FALSE;
-  buf.Alloc(totalSize);
-  UInt32 curBlock = 0;
-  FOR_VECTOR (i, fork.Extents)
-  {
-    if (curBlock >= fork.NumBlocks)
-      return S_FALSE;
-    const CExtent &e = fork.Extents[i];
-    if (e.Pos > Header.NumBlocks ||
-        e.NumBlocks > fork.NumBlocks - curBlock ||
-        e.NumBlocks > Header.NumBlocks - e.Pos)
-      return S_FALSE;
-    RINOK(InStream_SeekSet(inStream, SpecOffset + ((UInt64)e.Pos << Header.BlockSizeLog)))
-    RINOK(ReadStream_FALSE(inStream,
-        (Byte *)buf + ((size_t)curBlock << Header.BlockSizeLog),
-        (size_t)e.NumBlocks << Header.BlockSizeLog))
-    curBlock += e.NumBlocks;
-  }
-  return S_OK;
-}
-
 static const unsigned kNodeDescriptor_Size = 14;
 
 struct CNodeDescriptor
@@ -682,14 +653,17 @@ struct CHeaderRec
   // UInt32 Attributes;
   // UInt32 Reserved3[16];
   
-  HRESULT Parse2(const CByteBuffer &buf);
+  // (p) must contain at least (kHeaderRec_MinSize) bytes of header node
+  HRESULT Parse2(const Byte *p, UInt64 fileSize);
 };
 
-HRESULT CHeaderRec::Parse2(const CByteBuffer &buf)
+static const unsigned kHeaderRec_MinSize = kNodeDescriptor_Size + 0x2A + 16 * 4;
+
+HRESULT CHeaderRec::Parse2(const Byte *p, UInt64 fileSize)
 {
-  if (buf.Size() < kNodeDescriptor_Size + 0x2A + 16 * 4)
+  if (fileSize < kHeaderRec_MinSize)
     return S_FALSE;
-  const Byte * p = (const Byte *)buf + kNodeDescriptor_Size;
+  p += kNodeDescriptor_Size;
   // TreeDepth = Get16(p);
   // RootNode = Get32(p + 2);
   // LeafRecords = Get32(p + 6);
@@ -716,13 +690,146 @@ HRESULT CHeaderRec::Parse2(const CByteBuffer &buf)
     Reserved3[i] = Get32(p + 0x2A + i * 4);
   */
 
-  if ((buf.Size() >> NodeSizeLog) < TotalNodes)
+  if ((fileSize >> NodeSizeLog) < TotalNodes)
     return S_FALSE;
 
   return S_OK;
 }
 
 
+/* CBTreeReader reads the nodes of B-tree file on demand.
+   We don't load whole B-tree file to memory. The file is read by
+   chunks of (1 << _chunkBits) bytes, and recent chunks are kept in LRU cache.
+   Leaf nodes are linked mostly in disk order, so one chunk read
+   usually serves many sequential nodes. */
+
+static const unsigned kBTreeChunkBits_Min = 16;
+static const unsigned kNumCachedBTreeChunks = 16;
+
+class CBTreeReader
+{
+  const CFork *_fork;
+  IInStream *_stream;
+  UInt64 _offset;
+  UInt64 _fileSize;
+  unsigned _blockSizeLog;
+  unsigned _chunkBits;
+  CImgClusterCache _cache;
+
+  HRESULT ReadData(UInt64 pos, Byte *dest, size_t size);
+public:
+  CHeaderRec Hr;
+
+  UInt64 GetFileSize() const { return _fileSize; }
+  HRESULT Open(const CFork &fork, IInStream *stream, UInt64 offset, unsigned blockSizeLog);
+  // returned pointer is valid until next GetNode() call
+  HRESULT GetNode(UInt32 node, const Byte *&p);
+};
+
+
+HRESULT CBTreeReader::ReadData(UInt64 pos, Byte *dest, size_t size)
+{
+  UInt64 extentStart = 0;
+  FOR_VECTOR (i, _fork->Extents)
+  {
+    if (size == 0)
+      break;
+    const CExtent &e = _fork->Extents[i];
+    const UInt64 extentEnd = extentStart + ((UInt64)e.NumBlocks << _blockSizeLog);
+    if (pos < extentEnd)
+    {
+      size_t cur = size;
+      if (cur > extentEnd - pos)
+        cur = (size_t)(extentEnd - pos);
+      RINOK(InStream_SeekSet(_stream, _offset + ((UInt64)e.Pos << _blockSizeLog) + (pos - extentStart)))
+      RINOK(ReadStream_FALSE(_stream, dest, cur))
+      dest += cur;
+      pos += cur;
+      size -= cur;
+    }
+    extentStart = extentEnd;
+  }
+  // the blocks that are not covered by extents are zeros
+  if (size != 0)
+    memset(dest, 0, size);
+  return S_OK;
+}
+
+
+HRESULT CBTreeReader::Open(const CFork &fork, IInStream *stream, UInt64 offset, unsigned blockSizeLog)
+{
+  _fork = &fork;
+  _stream = stream;
+  _offset = offset;
+  _blockSizeLog = blockSizeLog;
+  _fileSize = (UInt64)fork.NumBlocks << blockSizeLog;
+  {
+    Byte buf[kHeaderRec_MinSize];
+    if (_fileSize < kHeaderRec_MinSize)
+      return S_FALSE;
+    RINOK(ReadData(0, buf, kHeaderRec_MinSize))
+    RINOK(Hr.Parse2(buf, _fileSize))
+  }
+  _chunkBits = Hr.NodeSizeLog;
+  if (_chunkBits < kBTreeChunkBits_Min)
+    _chunkBits = kBTreeChunkBits_Min;
+  // small B-tree file is read as one chunk
+  while (_chunkBits > Hr.NodeSizeLog && (_fileSize - 1) >> (_chunkBits - 1) == 0)
+    _chunkBits--;
+  _cache.Alloc(_chunkBits, kNumCachedBTreeChunks);
+  return S_OK;
+}
+
+
+HRESULT CBTreeReader::GetNode(UInt32 node, const Byte *&p)
+{
+  p = NULL;
+  const UInt64 pos = (UInt64)node << Hr.NodeSizeLog;
+  const UInt64 chunk = pos >> _chunkBits;
+  int index = _cache.Find(0, chunk);
+  if (index < 0)
+  {
+    const unsigned index2 = _cache.Alloc_Item(0, chunk);
+    const UInt64 chunkPos = chunk << _chunkBits;
+    size_t size = (size_t)1 << _chunkBits;
+    if (size > _fileSize - chunkPos)
+      size = (size_t)(_fileSize - chunkPos);
+    const HRESULT res = ReadData(chunkPos, _cache.GetBuf(index2), size);
+    if (res != S_OK)
+    {
+      _cache.Free_Item(index2);
+      return res;
+    }
+    index = (int)index2;
+  }
+  p = _cache.GetBuf((unsigned)index) + (size_t)(pos - (chunk << _chunkBits));
+  return S_OK;
+}
+
+
+HRESULT CDatabase::OpenBTree(const CFork &fork, CBTreeReader &tree, IInStream *inStream)
+{
+  if (fork.NumBlocks >= Header.NumBlocks)
+    return S_FALSE;
+  if (((ArcFileSize - SpecOffset) >> Header.BlockSizeLog) + 1 < fork.NumBlocks)
+    return S_FALSE;
+
+  UInt32 curBlock = 0;
+  FOR_VECTOR (i, fork.Extents)
+  {
+    if (curBlock >= fork.NumBlocks)
+      return S_FALSE;
+    const CExtent &e = fork.Extents[i];
+    if (e.Pos > Header.NumBlocks ||
+        e.NumBlocks > fork.NumBlocks - curBlock ||
+        e.NumBlocks > Header.NumBlocks - e.Pos)
+      return S_FALSE;
+    curBlock += e.NumBlocks;
+  }
+  return tree.Open(fork, inStream, SpecOffset, Header.BlockSizeLog);
+}
+
+
 static const Byte kNodeType_Leaf   = 0xFF;
 // static const Byte kNodeType_Index  = 0;
 // static const Byte kNodeType_Header = 1;
@@ -738,14 +845,9 @@ HRESULT CDatabase::LoadExtentFile(const CFork &fork, IInStream *inStream, CObjec
 {
   if (fork.NumBlocks == 0)
     return S_OK;
-  CByteBuffer buf;
-  RINOK(ReadFile(fork, buf, inStream))
-  const Byte *p = (const Byte *)buf;
-
-  // CNodeDescriptor nodeDesc;
-  // nodeDesc.Parse(p);
-  CHeaderRec hr;
-  RINOK(hr.Parse2(buf))
+  CBTreeReader tree;
+  RINOK(OpenBTree(fork, tree, inStream))
+  const CHeaderRec &hr = tree.Hr;
 
   UInt32 node = hr.FirstLeafNode;
   if (node == 0)
@@ -762,9 +864,10 @@ HRESULT CDatabase::LoadExtentFile(const CFork &fork, IInStream *inStream, CObjec
       return S_FALSE;
     usedBuf[node] = 1;
 
-    const size_t nodeOffset = (size_t)node << hr.NodeSizeLog;
+    const Byte *p;
+    RINOK(tree.GetNode(node, p))
     CNodeDescriptor desc;
-    if (!desc.Parse(p + nodeOffset, hr.NodeSizeLog))
+    if (!desc.Parse(p, hr.NodeSizeLog))
       return S_FALSE;
     if (desc.Kind != kNodeType_Leaf)
       return S_FALSE;
@@ -774,7 +877,7 @@ HRESULT CDatabase::LoadExtentFile(const CFork &fork, IInStream *inStream, CObjec
     for (unsigned i = 0; i < desc.NumRecords; i++)
     {
       const UInt32 nodeSize = ((UInt32)1 << hr.NodeSizeLog);
-      const Byte *r = p + nodeOffset + nodeSize - i * 2;
+      const Byte *r = p + nodeSize - i * 2;
       const UInt32 offs = Get16(r - 2);
       UInt32 recSize = Get16(r - 4) - offs;
       const unsigned kKeyLen = 10;
@@ -782,7 +885,7 @@ HRESULT CDatabase::LoadExtentFile(const CFork &fork, IInStream *inStream, CObjec
       if (recSize != 2 + kKeyLen + kNumFixedExtents * 8)
         return S_FALSE;
 
-      r = p + nodeOffset + offs;
+      r = p + offs;
       if (Get16(r) != kKeyLen)
         return S_FALSE;
       
@@ -877,14 +980,9 @@ HRESULT CDatabase::LoadAttrs(const CFork &fork, IInStream *inStream, IArchiveOpe
   if (fork.NumBlocks == 0)
     return S_OK;
 
-  CByteBuffer AttrBuf;
-  RINOK(ReadFile(fork, AttrBuf, inStream))
-  const Byte *p = (const Byte *)AttrBuf;
-
-  // CNodeDescriptor nodeDesc;
-  // nodeDesc.Parse(p);
-  CHeaderRec hr;
-  RINOK(hr.Parse2(AttrBuf))
+  CBTreeReader tree;
+  RINOK(OpenBTree(fork, tree, inStream))
+  const CHeaderRec &hr = tree.Hr;
   
   // CaseSensetive = (Header.IsHfsX() && hr.KeyCompareType == 0xBC);
 
@@ -905,9 +1003,10 @@ HRESULT CDatabase::LoadAttrs(const CFork &fork, IInStream *inStream, IArchiveOpe
       return S_FALSE;
     usedBuf[node] = 1;
     
-    const size_t nodeOffset = (size_t)node << hr.NodeSizeLog;
+    const Byte *p;
+    RINOK(tree.GetNode(node, p))
     CNodeDescriptor desc;
-    if (!desc.Parse(p + nodeOffset, hr.NodeSizeLog))
+    if (!desc.Parse(p, hr.NodeSizeLog))
       return S_FALSE;
     if (desc.Kind != kNodeType_Leaf)
       return S_FALSE;
@@ -915,14 +1014,14 @@ HRESULT CDatabase::LoadAttrs(const CFork &fork, IInStream *inStream, IArchiveOpe
     for (unsigned i = 0; i < desc.NumRecords; i++)
     {
       const UInt32 nodeSize = ((UInt32)1 << hr.NodeSizeLog);
-      const Byte *r = p + nodeOffset + nodeSize - i * 2;
+      const Byte *r = p + nodeSize - i * 2;
       const UInt32 offs = Get16(r - 2);
       UInt32 recSize = Get16(r - 4) - offs;
       const unsigned kHeadSize = 14;
       if (recSize < kHeadSize)
         return S_FALSE;
 
-      r = p + nodeOffset + offs;
+      r = p + offs;
       const UInt32 keyLen = Get16(r);
 
       // UInt16 pad = Get16(r + 2);
@@ -997,7 +1096,7 @@ HRESULT CDatabase::LoadAttrs(const CFork &fork, IInStream *inStream, IArchiveOpe
         return S_FALSE;
 
       attr.Data.CopyFrom(r, dataSize);
-      // attr.DataPos = nodeOffset + offs + 2 + keyLen + kRecordHeaderSize;
+      // attr.DataPos = ((UInt64)node << hr.NodeSizeLog) + offs + 2 + keyLen + kRecordHeaderSize;
       // attr.Size = dataSize;
     }
 
@@ -1030,14 +1129,9 @@ bool CDatabase::Parse_decmpgfs(unsigned attrIndex, CItem &item, bool &skip)
 
 HRESULT CDatabase::LoadCatalog(const CFork &fork, const CObjectVector<CIdExtents> *overflowExtentsArray, IInStream *inStream, IArchiveOpenCallback *progress)
 {
-  CByteBuffer buf;
-  RINOK(ReadFile(fork, buf, inStream))
-  const Byte *p = (const Byte *)buf;
-
-  // CNodeDescriptor nodeDesc;
-  // nodeDesc.Parse(p);
-  CHeaderRec hr;
-  RINOK(hr.Parse2(buf))
+  CBTreeReader tree;
+  RINOK(OpenBTree(fork, tree, inStream))
+  const CHeaderRec &hr = tree.Hr;
 
   CRecordVector<CIdIndexPair> IdToIndexMap;
 
@@ -1046,7 +1140,7 @@ HRESULT CDatabase::LoadCatalog(const CFork &fork, const CObjectVector<CIdExtents
   const unsigned kBasicRecSize = 0x58;
   const unsigned kMinRecSize = kBasicRecSize + 10;
 
-  if ((UInt64)reserveSize * kMinRecSize < buf.Size())
+  if ((UInt64)reserveSize * kMinRecSize < tree.GetFileSize())
   {
     Items.ClearAndReserve(reserveSize);
     Refs.ClearAndReserve(reserveSize);
@@ -1071,9 +1165,10 @@ HRESULT CDatabase::LoadCatalog(const CFork &fork, const CObjectVector<CIdExtents
       return S_FALSE;
     usedBuf[node] = 1;
     
-    const size_t nodeOffset = (size_t)node << hr.NodeSizeLog;
+    const Byte *p;
+    RINOK(tree.GetNode(node, p))
     CNodeDescriptor desc;
-    if (!desc.Parse(p + nodeOffset, hr.NodeSizeLog))
+    if (!desc.Parse(p, hr.NodeSizeLog))
       return S_FALSE;
     if (desc.Kind != kNodeType_Leaf)
       return S_FALSE;
@@ -1081,13 +1176,13 @@ HRESULT CDatabase::LoadCatalog(const CFork &fork, const CObjectVector<CIdExtents
     for (unsigned i = 0; i < desc.NumRecords; i++)
     {
       const UInt32 nodeSize = (1 << hr.NodeSizeLog);
-      const Byte *r = p + nodeOffset + nodeSize - i * 2;
+      const Byte *r = p + nodeSize - i * 2;
       const UInt32 offs = Get16(r - 2);
       UInt32 recSize = Get16(r - 4) - offs;
       if (recSize < 6)
         return S_FALSE;
 
-      r = p + nodeOffset + offs;
+      r = p + offs;
       UInt32 keyLen = Get16(r);
       UInt32 parentID = Get32(r + 2);
       if (keyLen < 6 || (keyLen & 1) != 0 || keyLen + 2 > recSize)
@@ -259,6 +259,48 @@ Z7_IFACE_CONSTR_ARCHIVE_SUB(IArchiveExtractCallbackMessage, IProgress, 0x21)
   x(ReportExtractResult(UInt32 indexType, UInt32 index, Int32 opRes))
 Z7_IFACE_CONSTR_ARCHIVE(IArchiveExtractCallbackMessage2, 0x22)
 
+
+/*
+IArchiveCoderStatCallback can be requested from IArchiveExtractCallback or
+  IArchiveUpdateCallback object by Extract() or UpdateItems() functions.
+  If the callback supports that interface, the handler collects
+  the statistics for each coder in coder chain (that can be slower),
+  and it reports the statistics after each processed folder (block).
+ReportCoderStat()
+  UInt64 methodId : the id of coder method
+  values[numValues] : (NCoderStat::EEnum) values.
+     Time values are in 100-ns units.
+     The handler can report only some first values of the list.
+     If the value is not supported, it's 0.
+*/
+namespace NCoderStat
+{
+  enum EEnum
+  {
+    kTime,         // time from start to end of coder's Code() call
+    kCpuTime,      // cpu time of the thread that called coder's Code().
+                   //   It doesn't include the cpu time of internal threads of coder
+                   //   (threads of LZ match finder, block threads of LZMA2 / BZip2 encoders).
+                   //   It's 0 for coders of single-threaded mixer (CMixerST).
+    kInSize,       // total size of input streams
+    kOutSize,      // total size of output streams
+    kInWaitTime,   // time of blocking in Read() calls of input streams
+    kOutWaitTime,  // time of blocking in Write() calls of output streams
+
+    // the numbers of stalls of LZ match finder threads (NCoderMtStat in ICoder.h)
+    kHashStalls_Write,
+    kHashStalls_Read,
+    kBtStalls_Write,
+    kBtStalls_Read,
+
+    kNumValues
+  };
+}
+
+#define Z7_IFACEM_IArchiveCoderStatCallback(x) \
+  x(ReportCoderStat(UInt64 methodId, const UInt64 *values, UInt32 numValues))
+Z7_IFACE_CONSTR_ARCHIVE(IArchiveCoderStatCallback, 0x23)
+
 #define Z7_IFACEM_IArchiveOpenVolumeCallback(x) \
   x(GetProperty(PROPID propID, PROPVARIANT *value)) \
   x(GetStream(const wchar_t *name, IInStream **inStream))
@@ -17,6 +17,7 @@
 #include "../../Common/MyCom.h"
 
 #include "../../Windows/PropVariant.h"
+#include "../../Windows/System.h"
 #include "../../Windows/TimeUtils.h"
 
 #include "../Common/MethodProps.h"
@@ -24,10 +25,14 @@
 #include "../Common/RegisterArc.h"
 #include "../Common/StreamObjects.h"
 #include "../Common/StreamUtils.h"
+#include "../Common/VirtThread.h"
 
 #include "../Compress/CopyCoder.h"
 
 #include "Common/DummyOutStream.h"
+#include "Common/HandlerOut.h"
+
+#include "HandlerCont.h"
 
 #ifdef SHOW_DEBUG_INFO
 #define PRF(x) x
@@ -657,8 +662,84 @@ bool CAttr::ParseExtents(CRecordVector<CExtent> &extents, UInt64 numClustersMax,
 
 static const UInt64 kEmptyTag = (UInt64)(Int64)-1;
 
-static const unsigned kNumCacheChunksLog = 1;
-static const size_t kNumCacheChunks = (size_t)1 << kNumCacheChunksLog;
+// the cache of unpacked compression units
+static const unsigned kNumCacheChunks_Min = 2;
+static const unsigned kNumCacheChunks_MAX = 1 << 10;
+static const UInt64 kCacheSize_Default = (UInt64)1 << 24;
+
+#ifndef Z7_ST
+static const unsigned k_NumThreads_MAX = 32;
+#endif
+
+static size_t Lznt1Dec(Byte *dest, size_t outBufLim, size_t destLen, const Byte *src, size_t srcLen);
+
+#ifndef Z7_ST
+
+class CUnitDecoderThread Z7_final: public CVirtThread
+{
+public:
+  CByteBuffer PackBuf;
+  size_t PackSize;
+  Byte *Dest;
+  size_t DestLenMax;
+  size_t DestLen;
+  unsigned CacheIndex;
+  bool DataError;
+
+  ~CUnitDecoderThread() Z7_DESTRUCTOR_override
+  {
+    CVirtThread::WaitThreadFinish();
+  }
+private:
+  virtual void Execute() Z7_override
+  {
+    DataError = (Lznt1Dec(Dest, DestLenMax, DestLen, PackBuf, PackSize) < DestLen);
+  }
+};
+
+/*
+CUnitDecoderThreads is owned by handler, and all streams of handler share these threads.
+It's reference counted, because the streams can be used after the handler was released.
+The streams use the threads from one thread only,
+and DecodeUnits_Mt() waits for all jobs before return.
+*/
+
+Z7_CLASS_IMP_COM_0(
+  CUnitDecoderThreads
+)
+public:
+  CObjectVector<CUnitDecoderThread> Threads;
+  // it creates new threads, if (numThreads) is larger than the number of created threads
+  HRESULT Create(unsigned numThreads);
+};
+
+HRESULT CUnitDecoderThreads::Create(unsigned numThreads)
+{
+  while (Threads.Size() < numThreads)
+  {
+    CUnitDecoderThread &t = Threads.AddNew();
+    const WRes wres = t.Create();
+    if (wres != 0)
+    {
+      Threads.DeleteBack();
+      return HRESULT_FROM_WIN32(wres);
+    }
+  }
+  return S_OK;
+}
+
+#endif
+
+// the parameters for streams of compressed attributes
+
+struct CStreamParams
+{
+  UInt32 NumThreads;
+  UInt64 CacheSize;
+ #ifndef Z7_ST
+  CUnitDecoderThreads *Threads;
+ #endif
+};
 
 Z7_CLASS_IMP_IInStream(
   CInStream
@@ -672,19 +753,39 @@ public:
 private:
   unsigned _chunkSizeLog;
   CByteBuffer _inBuf;
-  CByteBuffer _outBuf;
+  CImgClusterCache _cache;
+  // compression unit of previous unpacking. It's used to detect sequential reading
+  UInt64 _prevUnit;
 public:
   UInt64 Size;
   UInt64 InitializedSize;
   unsigned BlockSizeLog;
   unsigned CompressionUnit;
+  UInt32 NumThreads;
+  UInt64 CacheSize;
+ #ifndef Z7_ST
+  CMyComPtr2<IUnknown, CUnitDecoderThreads> DecoderThreads;
+ #endif
   CRecordVector<CExtent> Extents;
   CMyComPtr<IInStream> Stream;
 private:
-  UInt64 _tags[kNumCacheChunks];
-
   HRESULT SeekToPhys() { return InStream_SeekSet(Stream, _physPos); }
   UInt32 GetCuSize() const { return (UInt32)1 << (BlockSizeLog + CompressionUnit); }
+
+  unsigned FindExtent(UInt64 virtBlock) const;
+  void GetUnitType(unsigned left, UInt64 virtBlock2End, bool &isCompressed, bool &thereArePhy) const;
+  HRESULT ReadPackedUnit(unsigned left, UInt64 virtBlock2, Byte *dest, size_t &packSize);
+  size_t GetUnitDestLen(UInt64 virtBlock2) const
+  {
+    size_t destLen = GetCuSize();
+    const UInt64 rem = Size - (virtBlock2 << BlockSizeLog);
+    if (destLen > rem)
+      destLen = (size_t)rem;
+    return destLen;
+  }
+ #ifndef Z7_ST
+  HRESULT DecodeUnits_Mt(UInt64 unit);
+ #endif
 public:
   HRESULT InitAndSeek(unsigned compressionUnit)
   {
@@ -694,10 +795,31 @@ public:
     {
       UInt32 cuSize = GetCuSize();
       _inBuf.Alloc(cuSize);
-      _outBuf.Alloc(kNumCacheChunks << _chunkSizeLog);
+      UInt64 numItems = CacheSize >> _chunkSizeLog;
+      if (numItems < kNumCacheChunks_Min)
+        numItems = kNumCacheChunks_Min;
+     #ifndef Z7_ST
+      {
+        unsigned numThreads = NumThreads;
+        if (numThreads > k_NumThreads_MAX)
+          numThreads = k_NumThreads_MAX;
+        if (numThreads > 1 && numItems < numThreads * 2)
+          numItems = numThreads * 2;
+      }
+     #endif
+      {
+        // we don't need more items than the number of units in stream
+        const UInt64 numUnits = (Size + cuSize - 1) >> _chunkSizeLog;
+        if (numItems > numUnits)
+          numItems = numUnits;
+      }
+      if (numItems > kNumCacheChunks_MAX)
+        numItems = kNumCacheChunks_MAX;
+      _cache.Alloc(_chunkSizeLog, (unsigned)numItems);
     }
-    for (size_t i = 0; i < kNumCacheChunks; i++)
-      _tags[i] = kEmptyTag;
+    else
+      _cache.Clear();
+    _prevUnit = kEmptyTag;
 
     _sparseMode = false;
     _curRem = 0;
@@ -826,19 +948,21 @@ Z7_COM7F_IMF(CInStream::Read(void *data, UInt32 size, UInt32 *processedSize))
   while (_curRem == 0)
   {
     const UInt64 cacheTag = _virtPos >> _chunkSizeLog;
-    const size_t cacheIndex = (size_t)cacheTag & (kNumCacheChunks - 1);
-    
-    if (_tags[cacheIndex] == cacheTag)
-    {
-      const size_t chunkSize = (size_t)1 << _chunkSizeLog;
-      const size_t offset = (size_t)_virtPos & (chunkSize - 1);
-      size_t cur = chunkSize - offset;
-      if (cur > size)
-        cur = size;
-      memcpy(data, _outBuf + (cacheIndex << _chunkSizeLog) + offset, cur);
-      *processedSize = (UInt32)cur;
-      _virtPos += cur;
-      return S_OK;
+    {
+      const int cacheIndex = _cache.Find(0, cacheTag);
+      if (cacheIndex >= 0)
+      {
+        const size_t chunkSize = (size_t)1 << _chunkSizeLog;
+        const size_t offset = (size_t)_virtPos & (chunkSize - 1);
+        size_t cur = chunkSize - offset;
+        if (cur > size)
+          cur = size;
+        memcpy(data, _cache.GetBuf((unsigned)cacheIndex) + offset, cur);
+        *processedSize = (UInt32)cur;
+        _virtPos += cur;
+        _prevUnit = cacheTag;
+        return S_OK;
+      }
     }
 
     PRF2(printf("\nVirtPos = %6d", _virtPos));
@@ -846,33 +970,13 @@ Z7_COM7F_IMF(CInStream::Read(void *data, UInt32 size, UInt32 *processedSize))
     const UInt32 comprUnitSize = (UInt32)1 << CompressionUnit;
     const UInt64 virtBlock = _virtPos >> BlockSizeLog;
     const UInt64 virtBlock2 = virtBlock & ~((UInt64)comprUnitSize - 1);
-    
-    unsigned left = 0, right = Extents.Size();
-    for (;;)
-    {
-      unsigned mid = (left + right) / 2;
-      if (mid == left)
-        break;
-      if (virtBlock2 < Extents[mid].Virt)
-        right = mid;
-      else
-        left = mid;
-    }
+    const unsigned left = FindExtent(virtBlock2);
     
     bool isCompressed = false;
+    bool thereArePhy = false;
     const UInt64 virtBlock2End = virtBlock2 + comprUnitSize;
     if (CompressionUnit != 0)
-      for (unsigned i = left; i < Extents.Size(); i++)
-      {
-        const CExtent &e = Extents[i];
-        if (e.Virt >= virtBlock2End)
-          break;
-        if (e.IsEmpty())
-        {
-          isCompressed = true;
-          break;
-        }
-      }
+      GetUnitType(left, virtBlock2End, isCompressed, thereArePhy);
 
     unsigned i;
     for (i = left; Extents[i + 1].Virt <= virtBlock; i++);
@@ -897,62 +1001,35 @@ Z7_COM7F_IMF(CInStream::Read(void *data, UInt32 size, UInt32 *processedSize))
       break;
     }
     
-    bool thereArePhy = false;
-    
-    for (unsigned i2 = left; i2 < Extents.Size(); i2++)
-    {
-      const CExtent &e = Extents[i2];
-      if (e.Virt >= virtBlock2End)
-        break;
-      if (!e.IsEmpty())
-      {
-        thereArePhy = true;
-        break;
-      }
-    }
-    
     if (!thereArePhy)
     {
       _curRem = (Extents[i + 1].Virt << BlockSizeLog) - _virtPos;
       _sparseMode = true;
       break;
     }
-    
-    size_t offs = 0;
-    UInt64 curVirt = virtBlock2;
-    
-    for (i = left; i < Extents.Size(); i++)
+
+    const bool isSequential = (cacheTag == _prevUnit + 1);
+    _prevUnit = cacheTag;
+
+   #ifndef Z7_ST
+    if (isSequential && NumThreads > 1)
     {
-      const CExtent &e = Extents[i];
-      if (e.IsEmpty())
-        break;
-      if (e.Virt >= virtBlock2End)
-        return S_FALSE;
-      const UInt64 newPos = (e.Phy + (curVirt - e.Virt)) << BlockSizeLog;
-      if (newPos != _physPos)
-      {
-        _physPos = newPos;
-        RINOK(SeekToPhys())
-      }
-      UInt64 numChunks = Extents[i + 1].Virt - curVirt;
-      if (curVirt + numChunks > virtBlock2End)
-        numChunks = virtBlock2End - curVirt;
-      const size_t compressed = (size_t)numChunks << BlockSizeLog;
-      RINOK(ReadStream_FALSE(Stream, _inBuf + offs, compressed))
-      curVirt += numChunks;
-      _physPos += compressed;
-      offs += compressed;
+      // DecodeUnits_Mt() returns S_OK only if (cacheTag) unit was added to cache
+      RINOK(DecodeUnits_Mt(cacheTag))
+      continue;
     }
+   #else
+    UNUSED_VAR(isSequential)
+   #endif
+    
+    size_t offs;
+    RINOK(ReadPackedUnit(left, virtBlock2, _inBuf, offs))
     
     const size_t destLenMax = GetCuSize();
-    size_t destLen = destLenMax;
-    const UInt64 rem = Size - (virtBlock2 << BlockSizeLog);
-    if (destLen > rem)
-      destLen = (size_t)rem;
+    const size_t destLen = GetUnitDestLen(virtBlock2);
 
-    Byte *dest = _outBuf + (cacheIndex << _chunkSizeLog);
+    Byte *dest = _cache.GetBuf(_cache.Alloc_Item(0, cacheTag));
     const size_t destSizeRes = Lznt1Dec(dest, destLenMax, destLen, _inBuf, offs);
-    _tags[cacheIndex] = cacheTag;
 
     // some files in Vista have destSize > destLen
     if (destSizeRes < destLen)
@@ -979,6 +1056,170 @@ Z7_COM7F_IMF(CInStream::Read(void *data, UInt32 size, UInt32 *processedSize))
   _curRem -= size;
   return res;
 }
+unsigned CInStream::FindExtent(UInt64 virtBlock) const
+{
+  unsigned left = 0, right = Extents.Size();
+  for (;;)
+  {
+    unsigned mid = (left + right) / 2;
+    if (mid == left)
+      break;
+    if (virtBlock < Extents[mid].Virt)
+      right = mid;
+    else
+      left = mid;
+  }
+  return left;
+}
+
+void CInStream::GetUnitType(unsigned left, UInt64 virtBlock2End, bool &isCompressed, bool &thereArePhy) const
+{
+  isCompressed = false;
+  thereArePhy = false;
+  for (unsigned i = left; i < Extents.Size(); i++)
+  {
+    const CExtent &e = Extents[i];
+    if (e.Virt >= virtBlock2End)
+      break;
+    if (e.IsEmpty())
+      isCompressed = true;
+    else
+      thereArePhy = true;
+  }
+}
+
+// it reads packed data of compression unit that starts at (virtBlock2) block
+HRESULT CInStream::ReadPackedUnit(unsigned left, UInt64 virtBlock2, Byte *dest, size_t &packSize)
+{
+  packSize = 0;
+  const UInt64 virtBlock2End = virtBlock2 + ((UInt64)1 << CompressionUnit);
+  UInt64 curVirt = virtBlock2;
+  
+  for (unsigned i = left; i < Extents.Size(); i++)
+  {
+    const CExtent &e = Extents[i];
+    if (e.IsEmpty())
+      break;
+    if (e.Virt >= virtBlock2End)
+      return S_FALSE;
+    const UInt64 newPos = (e.Phy + (curVirt - e.Virt)) << BlockSizeLog;
+    if (newPos != _physPos)
+    {
+      _physPos = newPos;
+      RINOK(SeekToPhys())
+    }
+    UInt64 numChunks = Extents[i + 1].Virt - curVirt;
+    if (curVirt + numChunks > virtBlock2End)
+      numChunks = virtBlock2End - curVirt;
+    const size_t compressed = (size_t)numChunks << BlockSizeLog;
+    RINOK(ReadStream_FALSE(Stream, dest + packSize, compressed))
+    curVirt += numChunks;
+    _physPos += compressed;
+    packSize += compressed;
+  }
+  return S_OK;
+}
+
+
+#ifndef Z7_ST
+
+/*
+DecodeUnits_Mt() reads packed data of (unit) and of next compressed units
+that are not in cache, and unpacks these units to cache in parallel threads.
+It returns S_OK, only if (unit) was unpacked to cache.
+Data errors in additional units are not reported here:
+these units will be unpacked again in Read() call.
+*/
+
+HRESULT CInStream::DecodeUnits_Mt(UInt64 unit)
+{
+  const size_t unitSize = GetCuSize();
+  const UInt64 numUnits = (InitializedSize + unitSize - 1) >> _chunkSizeLog;
+  
+  unsigned numThreads = NumThreads;
+  if (numThreads > k_NumThreads_MAX)
+    numThreads = k_NumThreads_MAX;
+  if (numThreads > _cache.Size())
+    numThreads = _cache.Size();
+
+  RINOK(DecoderThreads->Create(numThreads))
+  CObjectVector<CUnitDecoderThread> &threads = DecoderThreads->Threads;
+
+  unsigned numJobs = 0;
+
+  for (UInt64 u = unit; numJobs < numThreads
+      && u < numUnits
+      && u - unit < (UInt64)numThreads * 2; u++)
+  {
+    if (u != unit && _cache.IsCached(0, u))
+      continue;
+    const UInt64 virtBlock2 = u << CompressionUnit;
+    const unsigned left = FindExtent(virtBlock2);
+    bool isCompressed, thereArePhy;
+    GetUnitType(left, virtBlock2 + ((UInt64)1 << CompressionUnit), isCompressed, thereArePhy);
+    if (!isCompressed || !thereArePhy)
+    {
+      // the caller checks that (unit) is compressed
+      if (u == unit)
+        return E_FAIL;
+      continue;
+    }
+    
+    CUnitDecoderThread &t = threads[numJobs];
+    t.PackBuf.AllocAtLeast(unitSize);
+    const HRESULT hres = ReadPackedUnit(left, virtBlock2, t.PackBuf, t.PackSize);
+    if (hres != S_OK)
+    {
+      if (numJobs != 0)
+        break;
+      return hres;
+    }
+    t.DestLenMax = unitSize;
+    t.DestLen = GetUnitDestLen(virtBlock2);
+    t.CacheIndex = _cache.Alloc_Item(0, u);
+    t.Dest = _cache.GetBuf(t.CacheIndex);
+    numJobs++;
+  }
+
+  HRESULT res = S_OK;
+  unsigned numStarted;
+  for (numStarted = 0; numStarted < numJobs; numStarted++)
+  {
+    const WRes wres = threads[numStarted].Start();
+    if (wres != 0)
+    {
+      res = HRESULT_FROM_WIN32(wres);
+      break;
+    }
+  }
+
+  for (unsigned i = 0; i < numJobs; i++)
+  {
+    CUnitDecoderThread &t = threads[i];
+    if (i < numStarted)
+    {
+      t.WaitExecuteFinish();
+      if (!t.DataError)
+        continue;
+      // some files in Vista have destSize > destLen
+      memset(t.Dest, 0, unitSize);
+      if (!InUse)
+        continue;
+      if (i == 0)
+      {
+        if (res == S_OK)
+          res = S_FALSE;
+        continue;
+      }
+    }
+    _cache.Free_Item(t.CacheIndex);
+  }
+
+  return res;
+}
+
+#endif
+
  
 Z7_COM7F_IMF(CInStream::Seek(Int64 offset, UInt32 seekOrigin, UInt64 *newPosition))
 {
@@ -1170,7 +1411,8 @@ struct CMftRec
 
   void ParseDataNames();
   HRESULT GetStream(IInStream *mainStream, int dataIndex,
-      unsigned clusterSizeLog, UInt64 numPhysClusters, IInStream **stream) const;
+      unsigned clusterSizeLog, UInt64 numPhysClusters,
+      const CStreamParams &params, IInStream **stream) const;
   unsigned GetNumExtents(int dataIndex, unsigned clusterSizeLog, UInt64 numPhysClusters) const;
 
   UInt64 GetSize(unsigned dataIndex) const { return DataAttrs[DataRefs[dataIndex].Start].GetSize(); }
@@ -1200,7 +1442,8 @@ void CMftRec::ParseDataNames()
 }
 
 HRESULT CMftRec::GetStream(IInStream *mainStream, int dataIndex,
-    unsigned clusterSizeLog, UInt64 numPhysClusters, IInStream **destStream) const
+    unsigned clusterSizeLog, UInt64 numPhysClusters,
+    const CStreamParams &params, IInStream **destStream) const
 {
   *destStream = NULL;
   CBufferInStream *streamSpec = new CBufferInStream;
@@ -1230,6 +1473,11 @@ HRESULT CMftRec::GetStream(IInStream *mainStream, int dataIndex,
       ss->Stream = mainStream;
       ss->BlockSizeLog = clusterSizeLog;
       ss->InUse = InUse();
+      ss->NumThreads = params.NumThreads;
+      ss->CacheSize = params.CacheSize;
+     #ifndef Z7_ST
+      ss->DecoderThreads.SetFromCls(params.Threads);
+     #endif
       RINOK(ss->InitAndSeek(attr0.CompressionUnit))
       *destStream = streamTemp2.Detach();
       return S_OK;
@@ -1442,7 +1690,106 @@ struct CItem
         // But it doesn't do it for $Secure:$SDS
 };
 
-struct CDatabase
+#ifndef Z7_ST
+
+/* MFT records are independent from each other at parsing stage:
+   fixups, attribute decoding and name extraction use only the data of record.
+   So CMftThread parses some range of records from read buffer
+   to already allocated CMftRec objects. */
+
+static const unsigned k_NumRecs_Mt_Min = 1 << 12;
+static const unsigned k_MftBufSizePerThread_Log = 20;
+
+class CMftThread Z7_final: public CVirtThread
+{
+public:
+  CObjectVector<CMftRec> *Recs;
+  CObjectVector<CAttr> *VolAttrs;
+  Byte *Buf;  // if (Buf == NULL), we call ParseDataNames() for already parsed records
+  unsigned StartRec;
+  unsigned NumRecs;
+  unsigned SectorSizeLog;
+  unsigned RecSizeLog;
+  UInt32 NumSectorsInRec;
+  HRESULT Result;
+
+  ~CMftThread() Z7_DESTRUCTOR_override
+  {
+    CVirtThread::WaitThreadFinish();
+  }
+private:
+  virtual void Execute() Z7_override;
+};
+
+void CMftThread::Execute()
+{
+  Result = S_OK;
+  try
+  {
+    for (unsigned i = 0; i < NumRecs; i++)
+    {
+      const unsigned recIndex = StartRec + i;
+      CMftRec &rec = (*Recs)[recIndex];
+      if (!Buf)
+      {
+        if (rec.Is_Magic_FILE())
+          rec.ParseDataNames();
+        continue;
+      }
+      if (!rec.Parse(Buf + ((size_t)i << RecSizeLog), SectorSizeLog, NumSectorsInRec, recIndex,
+          recIndex == kRecIndex_Volume ? VolAttrs : NULL))
+      {
+        Result = S_FALSE;
+        return;
+      }
+    }
+  }
+  catch(...)
+  {
+    Result = E_OUTOFMEMORY;
+  }
+}
+
+static HRESULT StartThreads(CObjectVector<CMftThread> &threads, unsigned numJobs, unsigned &numStarted)
+{
+  for (numStarted = 0; numStarted < numJobs; numStarted++)
+  {
+    const WRes wres = threads[numStarted].Start();
+    if (wres != 0)
+      return HRESULT_FROM_WIN32(wres);
+  }
+  return S_OK;
+}
+
+// it returns the result of first failed thread
+static HRESULT WaitThreads(CObjectVector<CMftThread> &threads, unsigned numStarted)
+{
+  HRESULT res = S_OK;
+  for (unsigned i = 0; i < numStarted; i++)
+  {
+    CMftThread &t = threads[i];
+    t.WaitExecuteFinish();
+    if (res == S_OK)
+      res = t.Result;
+  }
+  return res;
+}
+
+static HRESULT RunThreads(CObjectVector<CMftThread> &threads, unsigned numJobs)
+{
+  unsigned numStarted;
+  const HRESULT res = StartThreads(threads, numJobs, numStarted);
+  const HRESULT res2 = WaitThreads(threads, numStarted);
+  RINOK(res)
+  return res2;
+}
+
+#endif
+
+// "mt" and "memuse" properties are parsed by CCommonMethodProps.
+// "memuse" is memory limit for the cache of unpacked compression units.
+
+struct CDatabase: public CCommonMethodProps
 {
   CRecordVector<CItem> Items;
   CObjectVector<CMftRec> Recs;
@@ -1464,6 +1811,10 @@ struct CDatabase
 
   bool _showSystemFiles;
   bool _showDeletedFiles;
+ #ifndef Z7_ST
+  // the threads are shared by all streams of compressed attributes
+  CMyComPtr2<IUnknown, CUnitDecoderThreads> _unitDecoderThreads;
+ #endif
   CObjectVector<UString2> VirtFolderNames;
   UString EmptyString;
 
@@ -1477,6 +1828,22 @@ struct CDatabase
     // we show SystemFiles by default since it's difficult to track $Extend\* system files
     // it must be fixed later
     _showDeletedFiles = false;
+    InitCommon();
+    _memUsage_Decompress = kCacheSize_Default;
+  }
+
+  CStreamParams GetStreamParams()
+  {
+    CStreamParams params;
+    params.CacheSize = _memUsage_Decompress;
+   #ifndef Z7_ST
+    params.NumThreads = _numThreads;
+    _unitDecoderThreads.Create_if_Empty();
+    params.Threads = _unitDecoderThreads.ClsPtr();
+   #else
+    params.NumThreads = 1;
+   #endif
+    return params;
   }
 
   CDatabase() { InitProps(); }
@@ -1487,6 +1854,10 @@ struct CDatabase
 
   void GetItemPath(unsigned index, NCOM::CPropVariant &path) const;
   HRESULT Open();
+ #ifndef Z7_ST
+  HRESULT ReadMft_Mt(ISequentialInStream *mftStream, UInt64 mftSize,
+      CObjectVector<CMftThread> &threads, unsigned numThreads);
+ #endif
 
   HRESULT SeekToCluster(UInt64 cluster);
 
@@ -1767,6 +2138,91 @@ HRESULT CDatabase::ParseSecuritySDS_2()
   return S_OK;
 }
 
+#ifndef Z7_ST
+
+/*
+ReadMft_Mt() reads MFT by big blocks. Each block is split to (numThreads) ranges
+of records that are parsed in parallel threads.
+The main thread reads next block, while the threads parse current block.
+*/
+
+HRESULT CDatabase::ReadMft_Mt(ISequentialInStream *mftStream, UInt64 mftSize,
+    CObjectVector<CMftThread> &threads, unsigned numThreads)
+{
+  const unsigned recSizeLog = Header.MftRecordSizeLog;
+  const unsigned numRecsPerThread = recSizeLog < k_MftBufSizePerThread_Log ?
+      1u << (k_MftBufSizePerThread_Log - recSizeLog) : 1;
+  const unsigned numRecsInBlock = numRecsPerThread * numThreads;
+
+  while (threads.Size() < numThreads)
+  {
+    CMftThread &t = threads.AddNew();
+    t.Recs = &Recs;
+    t.VolAttrs = &VolAttrs;
+    t.SectorSizeLog = Header.SectorSizeLog;
+    t.RecSizeLog = recSizeLog;
+    t.NumSectorsInRec = (UInt32)1 << (recSizeLog - Header.SectorSizeLog);
+    const WRes wres = t.Create();
+    if (wres != 0)
+    {
+      threads.DeleteBack();
+      return HRESULT_FROM_WIN32(wres);
+    }
+  }
+
+  CByteBuffer bufs[2];
+  bufs[0].Alloc((size_t)numRecsInBlock << recSizeLog);
+  bufs[1].Alloc((size_t)numRecsInBlock << recSizeLog);
+
+  const UInt64 numRecsTotal = mftSize >> recSizeLog;
+  unsigned bufIndex = 0;
+  unsigned numRecs = (unsigned)MyMin((UInt64)numRecsInBlock, numRecsTotal);
+  RINOK(ReadStream_FALSE(mftStream, bufs[0], (size_t)numRecs << recSizeLog))
+
+  while (numRecs != 0)
+  {
+    const unsigned start = Recs.Size();
+    for (unsigned k = 0; k < numRecs; k++)
+      Recs.AddNew();
+
+    unsigned numJobs = 0;
+    for (unsigned k = 0; k < numRecs; k += numRecsPerThread)
+    {
+      CMftThread &t = threads[numJobs++];
+      t.Buf = bufs[bufIndex] + ((size_t)k << recSizeLog);
+      t.StartRec = start + k;
+      t.NumRecs = MyMin(numRecsPerThread, numRecs - k);
+    }
+
+    unsigned numStarted;
+    const HRESULT startRes = StartThreads(threads, numJobs, numStarted);
+
+    const unsigned numRecsNext = (unsigned)MyMin((UInt64)numRecsInBlock, numRecsTotal - Recs.Size());
+    HRESULT readRes = S_OK;
+    if (startRes == S_OK && numRecsNext != 0)
+      readRes = ReadStream_FALSE(mftStream, bufs[bufIndex ^ 1], (size_t)numRecsNext << recSizeLog);
+
+    const HRESULT waitRes = WaitThreads(threads, numStarted);
+    RINOK(startRes)
+    RINOK(waitRes)
+    RINOK(readRes)
+
+    if (OpenCallback)
+    {
+      const UInt64 numFiles = Recs.Size();
+      const UInt64 pos64 = numFiles << recSizeLog;
+      RINOK(OpenCallback->SetCompleted(&numFiles, &pos64))
+    }
+    
+    numRecs = numRecsNext;
+    bufIndex ^= 1;
+  }
+  return S_OK;
+}
+
+#endif
+
+
 HRESULT CDatabase::Open()
 {
   Clear();
@@ -1837,7 +2293,7 @@ HRESULT CDatabase::Open()
     mftRec.ParseDataNames();
     if (mftRec.DataRefs.IsEmpty())
       return S_FALSE;
-    RINOK(mftRec.GetStream(InStream, 0, Header.ClusterSizeLog, Header.NumClusters, &mftStream))
+    RINOK(mftRec.GetStream(InStream, 0, Header.ClusterSizeLog, Header.NumClusters, GetStreamParams(), &mftStream))
     if (!mftStream)
       return S_FALSE;
   }
@@ -1858,7 +2314,18 @@ HRESULT CDatabase::Open()
     }
     Recs.ClearAndReserve((unsigned)numFiles);
   }
-  
+
+ #ifndef Z7_ST
+  CObjectVector<CMftThread> threads;
+  unsigned numThreads = _numThreads;
+  if (numThreads > k_NumThreads_MAX)
+    numThreads = k_NumThreads_MAX;
+  if (numThreads > 1 && (mftSize >> Header.MftRecordSizeLog) >= k_NumRecs_Mt_Min)
+  {
+    RINOK(ReadMft_Mt(mftStream, mftSize, threads, numThreads))
+  }
+  else
+ #endif
   for (UInt64 pos64 = 0;;)
   {
     if (OpenCallback)
@@ -1978,6 +2445,24 @@ HRESULT CDatabase::Open()
     }
   }
 
+  // ParseDataNames() sorts attributes of each record. So it also can be done in parallel.
+ #ifndef Z7_ST
+  if (threads.Size() > 1)
+  {
+    const unsigned numRecs = Recs.Size();
+    unsigned start = 0;
+    FOR_VECTOR (k, threads)
+    {
+      CMftThread &t = threads[k];
+      t.Buf = NULL;
+      t.StartRec = start;
+      t.NumRecs = (numRecs - start) / (threads.Size() - k);
+      start += t.NumRecs;
+    }
+    RINOK(RunThreads(threads, threads.Size()))
+  }
+  else
+ #endif
   for (i = 0; i < Recs.Size(); i++)
   {
     CMftRec &rec = Recs[i];
@@ -2111,7 +2596,7 @@ HRESULT CDatabase::Open()
       if (attr.Name == L"$SDS")
       {
         CMyComPtr<IInStream> sdsStream;
-        RINOK(rec.GetStream(InStream, (int)di, Header.ClusterSizeLog, Header.NumClusters, &sdsStream))
+        RINOK(rec.GetStream(InStream, (int)di, Header.ClusterSizeLog, Header.NumClusters, GetStreamParams(), &sdsStream))
         if (sdsStream)
         {
           const UInt64 size64 = attr.GetSize();
@@ -2324,7 +2809,7 @@ Z7_COM7F_IMF(CHandler::GetStream(UInt32 index, ISequentialInStream **stream))
   IInStream *stream2;
   const CItem &item = Items[index];
   const CMftRec &rec = Recs[item.RecIndex];
-  HRESULT res = rec.GetStream(InStream, item.DataIndex, Header.ClusterSizeLog, Header.NumClusters, &stream2);
+  HRESULT res = rec.GetStream(InStream, item.DataIndex, Header.ClusterSizeLog, Header.NumClusters, GetStreamParams(), &stream2);
   *stream = (ISequentialInStream *)stream2;
   return res;
   COM_TRY_END
@@ -2817,7 +3302,7 @@ Z7_COM7F_IMF(CHandler::Extract(const UInt32 *indices, UInt32 numItems,
     int res = NExtract::NOperationResult::kDataError;
     {
       CMyComPtr<IInStream> inStream;
-      HRESULT hres = rec.GetStream(InStream, item.DataIndex, Header.ClusterSizeLog, Header.NumClusters, &inStream);
+      HRESULT hres = rec.GetStream(InStream, item.DataIndex, Header.ClusterSizeLog, Header.NumClusters, GetStreamParams(), &inStream);
       if (hres == S_FALSE)
         res = NExtract::NOperationResult::kUnsupportedMethod;
       else
@@ -2871,14 +3356,13 @@ Z7_COM7F_IMF(CHandler::SetProperties(const wchar_t * const *names, const PROPVAR
     {
       RINOK(PROPVARIANT_to_bool(prop, _showSystemFiles))
     }
-    else if (IsString1PrefixedByString2_NoCase_Ascii(name, "mt"))
-    {
-    }
-    else if (IsString1PrefixedByString2_NoCase_Ascii(name, "memuse"))
+    else
     {
+      HRESULT hres;
+      if (!SetCommonProperty(UString(name), prop, hres))
+        return E_INVALIDARG;
+      RINOK(hres)
     }
-    else
-      return E_INVALIDARG;
   }
   return S_OK;
 }
@@ -31,6 +31,8 @@ namespace NQcow {
 
 static const Byte k_Signature[] =  { 'Q', 'F', 'I', 0xFB, 0, 0, 0 };
 
+static const UInt32 kEmptyDirItem = (UInt32)0 - 1;
+
 /*
 VA to PA maps:
   high bits (L1) :              : index in L1 (_dir) : _dir[high_index] points to Table.
@@ -38,6 +40,45 @@ VA to PA maps:
   low bits       : _clusterBits : offset inside cluster.
 */
 
+static const unsigned kNumCachedClusters_Min = 4;
+static const size_t k_Cache_Size_MAX = (size_t)1 << 26;
+
+struct CClusterDecoder Z7_final: public CImgUnitDecoder
+{
+  CMyComPtr2<ISequentialInStream, CBufInStream> InStream;
+  CMyComPtr2<ISequentialOutStream, CBufPtrSeqOutStream> OutStream;
+  CMyComPtr2<ICompressCoder, NCompress::NDeflate::NDecoder::CCOMCoder> Deflate;
+
+  void Create()
+  {
+    InStream.Create_if_Empty();
+    OutStream.Create_if_Empty();
+    Deflate.Create_if_Empty();
+    Deflate->Set_NeedFinishInput(true);
+  }
+
+  HRESULT Decode(const Byte *src, size_t srcSize, Byte *dest, size_t clusterSize, bool &dataError) Z7_override;
+};
+
+HRESULT CClusterDecoder::Decode(const Byte *src, size_t srcSize, Byte *dest, size_t clusterSize, bool &dataError)
+{
+  dataError = false;
+  InStream->Init(src, srcSize);
+  OutStream->Init(dest, clusterSize);
+  // Do we need to use smaller block than clusterSize for last cluster?
+  const UInt64 blockSize64 = clusterSize;
+  HRESULT res = Deflate.Interface()->Code(InStream, OutStream, NULL, &blockSize64, NULL);
+  if (res == S_OK)
+    if (!Deflate->IsFinished()
+        || OutStream->GetPos() != clusterSize)
+    {
+      dataError = true;
+      res = S_FALSE;
+    }
+  return res;
+}
+
+
 Z7_class_CHandler_final: public CHandlerImg
 {
   Z7_IFACE_COM7_IMP(IInArchive_Img)
@@ -50,9 +91,10 @@ Z7_class_CHandler_final: public CHandlerImg
 
   CObjArray2<UInt32> _dir;
   CAlignedBuffer _table;
-  CByteBuffer _cache;
+  CImgClusterCache _cache;
   CByteBuffer _cacheCompressed;
-  UInt64 _cacheCluster;
+  // cluster of previous Read() call. It's used to detect sequential reading
+  UInt64 _prevCluster;
 
   UInt64 _comprPos;
   size_t _comprSize;
@@ -64,9 +106,7 @@ Z7_class_CHandler_final: public CHandlerImg
 
   UInt64 _phySize;
 
-  CMyComPtr2<ISequentialInStream, CBufInStream> _bufInStream;
-  CMyComPtr2<ISequentialOutStream, CBufPtrSeqOutStream> _bufOutStream;
-  CMyComPtr2<ICompressCoder, NCompress::NDeflate::NDecoder::CCOMCoder> _deflateDecoder;
+  CClusterDecoder _decoder;
 
   UInt32 _version;
   UInt32 _cryptMethod;
@@ -81,14 +121,99 @@ Z7_class_CHandler_final: public CHandlerImg
   HRESULT InitAndSeek()
   {
     _virtPos = 0;
+    _prevCluster = (UInt64)(Int64)-1;
     return Seek2(0);
   }
 
+  UInt64 GetClusterRecord(UInt64 cluster) const
+  {
+    const UInt64 high = cluster >> _numMidBits;
+    if (high >= _dir.Size())
+      return 0;
+    const UInt32 tabl = _dir[(size_t)high];
+    if (tabl == kEmptyDirItem)
+      return 0;
+    const size_t midBits = (size_t)cluster & (((size_t)1 << _numMidBits) - 1);
+    return Get64(_table + ((((size_t)tabl << _numMidBits) + midBits) << 3));
+  }
+
+ #ifndef Z7_ST
+  bool Is_PackedUnit(unsigned /* extent */, UInt64 unit) const Z7_override
+  {
+    return (GetClusterRecord(unit) & _compressedFlag) != 0;
+  }
+  HRESULT ReadPackedUnit(unsigned extent, UInt64 unit,
+      CByteBuffer &buf, size_t &offset, size_t &size) Z7_override;
+  CImgUnitDecoder *CreateUnitDecoder() Z7_override
+  {
+    CClusterDecoder *decoder = new CClusterDecoder;
+    decoder->Create();
+    return decoder;
+  }
+ #endif
+
   HRESULT Open2(IInStream *stream, IArchiveOpenCallback *openCallback) Z7_override;
+  bool Get_AllocUnit_IsData(UInt64 unit) const Z7_override
+  {
+    const UInt64 v = GetClusterRecord(unit);
+    if (v == 0)
+      return false;
+    // version_3 supports zero clusters
+    return (v & _compressedFlag) != 0 || ((UInt32)v & 511) != 1;
+  }
+public:
+  CHandler() { _isMtSupported = true; }
 };
 
 
-static const UInt32 kEmptyDirItem = (UInt32)0 - 1;
+/*
+the example of table record for 12-bit clusters (4KB uncompressed):
+  2 bits : isCompressed status
+  (4 == _clusterBits - 8) bits : (num_sectors - 1)
+      packSize = num_sectors * 512;
+      it uses one additional bit over unpacked cluster_bits.
+  (49 == 61 - _clusterBits) bits : offset of 512-byte sector
+  9 bits : offset in 512-byte sector
+*/
+
+static void GetComprBlock(UInt64 v, unsigned clusterBits,
+    UInt64 &sectorOffset, size_t &dataSize, size_t &offsetInSector)
+{
+  const unsigned numOffsetBits = 62 - (clusterBits - 8);
+  const UInt64 offset = v & (((UInt64)1 << 62) - 1);
+  dataSize = ((size_t)(offset >> numOffsetBits) + 1) << 9;
+  sectorOffset = offset & (((UInt64)1 << numOffsetBits) - (1 << 9));
+  const size_t kSectorMask = (1 << 9) - 1;
+  offsetInSector = (size_t)offset & kSectorMask;
+}
+
+
+#ifndef Z7_ST
+
+HRESULT CHandler::ReadPackedUnit(unsigned /* extent */, UInt64 unit,
+    CByteBuffer &buf, size_t &offset, size_t &size)
+{
+  UInt64 sectorOffset;
+  size_t dataSize, offsetInSector;
+  GetComprBlock(GetClusterRecord(unit), _clusterBits, sectorOffset, dataSize, offsetInSector);
+  buf.AllocAtLeast((size_t)2 << _clusterBits);
+  if (sectorOffset != _posInArc)
+  {
+    RINOK(Seek2(sectorOffset))
+  }
+  size_t processed = dataSize;
+  const HRESULT hres = ReadStream(Stream, buf, &processed);
+  _posInArc += processed;
+  RINOK(hres)
+  if (processed != dataSize)
+    return E_FAIL;
+  offset = offsetInSector;
+  size = dataSize - offsetInSector;
+  return S_OK;
+}
+
+#endif
+
 
 Z7_COM7F_IMF(CHandler::Read(void *data, UInt32 size, UInt32 *processedSize))
 {
@@ -115,129 +240,118 @@ Z7_COM7F_IMF(CHandler::Read(void *data, UInt32 size, UInt32 *processedSize))
       if (size > rem)
         size = (UInt32)rem;
     }
-    if (cluster == _cacheCluster)
+    // we don't use multithreading for first cluster that is read by GetImgExt() in Open()
+    const bool isSequential = (cluster != 0 && cluster == _prevCluster + 1);
+    _prevCluster = cluster;
     {
-      memcpy(data, _cache + lowBits, size);
-      break;
+      const int index = _cache.Find(0, cluster);
+      if (index >= 0)
+      {
+        memcpy(data, _cache.GetBuf((unsigned)index) + lowBits, size);
+        break;
+      }
     }
    
-    const UInt64 high = cluster >> _numMidBits;
- 
-    if (high < _dir.Size())
+    UInt64 v = GetClusterRecord(cluster);
+        
+    if (v)
     {
-      const UInt32 tabl = _dir[(size_t)high];
-      if (tabl != kEmptyDirItem)
+      if (v & _compressedFlag)
       {
-        const size_t midBits = (size_t)cluster & (((size_t)1 << _numMidBits) - 1);
-        const Byte *p = _table + ((((size_t)tabl << _numMidBits) + midBits) << 3);
-        UInt64 v = Get64(p);
+        if (_version <= 1)
+          return E_FAIL;
+
+       #ifndef Z7_ST
+        if (isSequential && _numMtThreads > 1)
+        {
+          RINOK(DecodeUnits_Mt(_cache, 0, cluster,
+              (_size + clusterSize - 1) >> _clusterBits, _clusterBits))
+          continue;
+        }
+       #else
+        UNUSED_VAR(isSequential)
+       #endif
+
+        UInt64 sectorOffset;
+        size_t dataSize, offsetInSector;
+        GetComprBlock(v, _clusterBits, sectorOffset, dataSize, offsetInSector);
+        const UInt64 offset2inCache = sectorOffset - _comprPos;
         
-        if (v)
+        // _comprPos is aligned for 512-bytes
+        // we try to use previous _cacheCompressed that contains compressed data
+        // that was read for previous unpacking
+
+        if (sectorOffset >= _comprPos && offset2inCache < _comprSize)
         {
-          if (v & _compressedFlag)
+          if (offset2inCache)
           {
-            if (_version <= 1)
-              return E_FAIL;
-            /*
-            the example of table record for 12-bit clusters (4KB uncompressed):
-              2 bits : isCompressed status
-              (4 == _clusterBits - 8) bits : (num_sectors - 1)
-                  packSize = num_sectors * 512;
-                  it uses one additional bit over unpacked cluster_bits.
-              (49 == 61 - _clusterBits) bits : offset of 512-byte sector
-              9 bits : offset in 512-byte sector
-            */
-            const unsigned numOffsetBits = 62 - (_clusterBits - 8);
-            const UInt64 offset = v & (((UInt64)1 << 62) - 1);
-            const size_t dataSize = ((size_t)(offset >> numOffsetBits) + 1) << 9;
-            UInt64 sectorOffset = offset & (((UInt64)1 << numOffsetBits) - (1 << 9));
-            const UInt64 offset2inCache = sectorOffset - _comprPos;
-            
-            // _comprPos is aligned for 512-bytes
-            // we try to use previous _cacheCompressed that contains compressed data
-            // that was read for previous unpacking
-
-            if (sectorOffset >= _comprPos && offset2inCache < _comprSize)
-            {
-              if (offset2inCache)
-              {
-                _comprSize -= (size_t)offset2inCache;
-                memmove(_cacheCompressed, _cacheCompressed + (size_t)offset2inCache, _comprSize);
-                _comprPos = sectorOffset;
-              }
-              sectorOffset += _comprSize;
-            }
-            else
-            {
-              _comprPos = sectorOffset;
-              _comprSize = 0;
-            }
-            
-            if (dataSize > _comprSize)
-            {
-              if (sectorOffset != _posInArc)
-              {
-                // printf("\nDeflate-Seek %12I64x %12I64x\n", sectorOffset, sectorOffset - _posInArc);
-                RINOK(Seek2(sectorOffset))
-              }
-              if (_cacheCompressed.Size() < dataSize)
-                return E_FAIL;
-              const size_t dataSize3 = dataSize - _comprSize;
-              size_t dataSize2 = dataSize3;
-              // printf("\n\n=======\nReadStream = %6d _comprPos = %6d \n", (UInt32)dataSize2, (UInt32)_comprPos);
-              const HRESULT hres = ReadStream(Stream, _cacheCompressed + _comprSize, &dataSize2);
-              _posInArc += dataSize2;
-              RINOK(hres)
-              if (dataSize2 != dataSize3)
-                return E_FAIL;
-              _comprSize += dataSize2;
-            }
-            
-            const size_t kSectorMask = (1 << 9) - 1;
-            const size_t offsetInSector = (size_t)offset & kSectorMask;
-            _bufInStream->Init(_cacheCompressed + offsetInSector, dataSize - offsetInSector);
-            _cacheCluster = (UInt64)(Int64)-1;
-            if (_cache.Size() < clusterSize)
-              return E_FAIL;
-            _bufOutStream->Init(_cache, clusterSize);
-            // Do we need to use smaller block than clusterSize for last cluster?
-            const UInt64 blockSize64 = clusterSize;
-            HRESULT res = _deflateDecoder.Interface()->Code(_bufInStream, _bufOutStream, NULL, &blockSize64, NULL);
-            /*
-            if (_bufOutStreamSpec->GetPos() != clusterSize)
-              memset(_cache + _bufOutStreamSpec->GetPos(), 0, clusterSize - _bufOutStreamSpec->GetPos());
-            */
-            if (res == S_OK)
-              if (!_deflateDecoder->IsFinished()
-                  || _bufOutStream->GetPos() != clusterSize)
-                res = S_FALSE;
-            RINOK(res)
-            _cacheCluster = cluster;
-            continue;
-            /*
-            memcpy(data, _cache + lowBits, size);
-            break;
-            */
+            _comprSize -= (size_t)offset2inCache;
+            memmove(_cacheCompressed, _cacheCompressed + (size_t)offset2inCache, _comprSize);
+            _comprPos = sectorOffset;
           }
-
-          // version_3 supports zero clusters
-          if (((UInt32)v & 511) != 1)
+          sectorOffset += _comprSize;
+        }
+        else
+        {
+          _comprPos = sectorOffset;
+          _comprSize = 0;
+        }
+        
+        if (dataSize > _comprSize)
+        {
+          if (sectorOffset != _posInArc)
           {
-            v &= _compressedFlag - 1;
-            v += lowBits;
-            if (v != _posInArc)
-            {
-              // printf("\n%12I64x\n", v - _posInArc);
-              RINOK(Seek2(v))
-            }
-            const HRESULT res = Stream->Read(data, size, &size);
-            _posInArc += size;
-            _virtPos += size;
-            if (processedSize)
-              *processedSize = size;
-            return res;
+            // printf("\nDeflate-Seek %12I64x %12I64x\n", sectorOffset, sectorOffset - _posInArc);
+            RINOK(Seek2(sectorOffset))
           }
+          if (_cacheCompressed.Size() < dataSize)
+            return E_FAIL;
+          const size_t dataSize3 = dataSize - _comprSize;
+          size_t dataSize2 = dataSize3;
+          // printf("\n\n=======\nReadStream = %6d _comprPos = %6d \n", (UInt32)dataSize2, (UInt32)_comprPos);
+          const HRESULT hres = ReadStream(Stream, _cacheCompressed + _comprSize, &dataSize2);
+          _posInArc += dataSize2;
+          RINOK(hres)
+          if (dataSize2 != dataSize3)
+            return E_FAIL;
+          _comprSize += dataSize2;
+        }
+        
+        const unsigned index = _cache.Alloc_Item(0, cluster);
+        bool dataError;
+        const HRESULT res = _decoder.Decode(
+            _cacheCompressed + offsetInSector, dataSize - offsetInSector,
+            _cache.GetBuf(index), clusterSize, dataError);
+        if (res != S_OK)
+        {
+          _cache.Free_Item(index);
+          if (dataError)
+            _stream_dataError = true;
+          return res;
         }
+        continue;
+        /*
+        memcpy(data, _cache + lowBits, size);
+        break;
+        */
+      }
+
+      // version_3 supports zero clusters
+      if (((UInt32)v & 511) != 1)
+      {
+        v &= _compressedFlag - 1;
+        v += lowBits;
+        if (v != _posInArc)
+        {
+          // printf("\n%12I64x\n", v - _posInArc);
+          RINOK(Seek2(v))
+        }
+        const HRESULT res = Stream->Read(data, size, &size);
+        _posInArc += size;
+        _virtPos += size;
+        if (processedSize)
+          *processedSize = size;
+        return res;
       }
     }
     
@@ -636,6 +750,8 @@ HRESULT CHandler::Open2(IInStream *stream, IArchiveOpenCallback *openCallback)
   if (curTable != numTables)
     return E_FAIL;
 
+  _allocUnitBits = _clusterBits;
+
   if (_cryptMethod)
     _unsupported = true;
   if (_needCompression && _version <= 1) // that case was not implemented
@@ -656,7 +772,8 @@ Z7_COM7F_IMF(CHandler::Close())
   // _cacheCompressed.Free();
   _phySize = 0;
 
-  _cacheCluster = (UInt64)(Int64)-1;
+  _cache.Clear();
+  _prevCluster = (UInt64)(Int64)-1;
   _comprPos = 0;
   _comprSize = 0;
 
@@ -684,12 +801,15 @@ Z7_COM7F_IMF(CHandler::GetStream(UInt32 /* index */, ISequentialInStream **strea
   {
     if (_version <= 1 || _compressionType)
       return S_FALSE;
-    _bufInStream.Create_if_Empty();
-    _bufOutStream.Create_if_Empty();
-    _deflateDecoder.Create_if_Empty();
-    _deflateDecoder->Set_NeedFinishInput(true);
+    _decoder.Create();
     const size_t clusterSize = (size_t)1 << _clusterBits;
-    _cache.AllocAtLeast(clusterSize);
+    _numMtThreads = GetNumMtThreads(_clusterBits);
+    unsigned numItems = kNumCachedClusters_Min;
+    if (numItems < _numMtThreads * 2)
+      numItems = _numMtThreads * 2;
+    if (numItems > (k_Cache_Size_MAX >> _clusterBits))
+      numItems = (unsigned)(k_Cache_Size_MAX >> _clusterBits);
+    _cache.Alloc(_clusterBits, numItems);
     _cacheCompressed.AllocAtLeast(clusterSize * 2);
   }
   CMyComPtr<ISequentialInStream> streamTemp = this;
@@ -15,10 +15,12 @@
 #include "../../Common/UTFConvert.h"
 
 #include "../../Windows/PropVariantUtils.h"
+#include "../../Windows/System.h"
 #include "../../Windows/TimeUtils.h"
 
 #include "../Common/CWrappers.h"
 #include "../Common/LimitedStreams.h"
+#include "../Common/MethodProps.h"
 #include "../Common/ProgressUtils.h"
 #include "../Common/RegisterArc.h"
 #include "../Common/StreamObjects.h"
@@ -28,6 +30,8 @@
 #include "../Compress/ZlibDecoder.h"
 // #include "../Compress/LzmaDecoder.h"
 
+#include "Common/HandlerOut.h"
+
 namespace NArchive {
 namespace NSquashfs {
 
@@ -836,10 +840,68 @@ struct CFrag
   UInt32 Size;
 };
 
+struct CCachedBlock
+{
+  CByteBuffer Data;
+  UInt64 StartPos;
+  UInt32 PackSize;
+  UInt32 UnpackSize;
+  UInt32 UseStamp;
+
+  void Clear()
+  {
+    StartPos = 0;
+    PackSize = 0;
+    UnpackSize = 0;
+  }
+  CCachedBlock() { Clear(); UseStamp = 0; }
+};
+
+// one fragment block contains the tails of many files.
+// So we cache several decoded fragment blocks for all items of archive.
+static const unsigned kNumCachedFragBlocks = 8;
+
+
+// decoder state for in-memory packed blocks (LZO, LZMA, XZ, ZSTD, ZLIB).
+// Each read-ahead thread uses its own CBlockDecoder.
+
+struct CBlockDecoder
+{
+  CXzUnpacker Xz;
+  CZstdDecHandle Zstd;
+  CByteBuffer InputBuffer;
+  CByteBuffer OutBuffer;
+  CMyComPtr2<ICompressCoder, NCompress::NZlib::CDecoder> ZlibDecoder;
+
+  CBlockDecoder(): Zstd(NULL) { XzUnpacker_Construct(&Xz, &g_Alloc); }
+  ~CBlockDecoder()
+  {
+    XzUnpacker_Free(&Xz);
+    if (Zstd)
+      ZstdDec_Destroy(Zstd);
+  }
+
+  HRESULT Decode(UInt32 method, bool noPropsLZMA, UInt32 dicSize,
+      const Byte *src, UInt32 inSize, Byte *dest, SizeT &destLen, UInt32 outSizeMax);
+};
+
+
+class CSquashfsInStream;
+
+// "mt" and "memuse" properties are parsed by CCommonMethodProps
+
+Z7_class_CHandler_final:
+  public IInArchive,
+  public IInArchiveGetStream,
+  public ISetProperties,
+  public CMyUnknownImp,
+  public CCommonMethodProps
+{
+  Z7_IFACES_IMP_UNK_3(
+      IInArchive,
+      IInArchiveGetStream,
+      ISetProperties)
 
-Z7_CLASS_IMP_CHandler_IInArchive_1(
-  IInArchiveGetStream
-)
   bool _noPropsLZMA;
   bool _needCheckLzma;
 
@@ -860,14 +922,13 @@ Z7_CLASS_IMP_CHandler_IInArchive_1(
   IArchiveOpenCallback *_openCallback;
 
   UInt32 _openCodePage;
-  int _nodeIndex;
+  // the block table of file that is filled by GetPackSize()
   CRecordVector<bool> _blockCompressed;
   CRecordVector<UInt64> _blockOffsets;
   
-  CByteBuffer _cachedBlock;
-  UInt64 _cachedBlockStartPos;
-  UInt32 _cachedPackBlockSize;
-  UInt32 _cachedUnpackBlockSize;
+  CCachedBlock _cachedBlock; // the last data block
+  CObjectVector<CCachedBlock> _fragBlocks; // LRU cache of fragment blocks
+  UInt32 _fragUseStamp;
 
   CMyComPtr2_Create<ISequentialInStream, CLimitedSequentialInStream> _limitedInStream;
   CMyComPtr2_Create<ISequentialOutStream, CBufPtrSeqOutStream> _outStream;
@@ -876,16 +937,18 @@ Z7_CLASS_IMP_CHandler_IInArchive_1(
   // CMyComPtr2<ICompressCoder, NCompress::NLzma::CDecoder> _lzmaDecoder;
   CMyComPtr2<ICompressCoder, NCompress::NZlib::CDecoder> _zlibDecoder;
   
-  CXzUnpacker _xz;
-  CZstdDecHandle _zstd;
-
-  CByteBuffer _inputBuffer;
+  CBlockDecoder _decoder;
 
+ #ifndef Z7_ST
+  CReadAheadPool _readAheadPool;
+  CObjectVector<CBlockDecoder> _mtDecoders; // one decoder per thread of _readAheadPool
+  NWindows::NSynchronization::CCriticalSection _streamCS;
+ #endif
   void ClearCache()
   {
-    _cachedBlockStartPos = 0;
-    _cachedPackBlockSize = 0;
-    _cachedUnpackBlockSize = 0;
+    _cachedBlock.Clear();
+    FOR_VECTOR (i, _fragBlocks)
+      _fragBlocks[i].Clear();
   }
 
   HRESULT Seek2(UInt64 offset)
@@ -897,6 +960,9 @@ Z7_CLASS_IMP_CHandler_IInArchive_1(
       UInt32 inSize, UInt32 outSizeMax);
   HRESULT ReadMetadataBlock(UInt32 &packSize);
   HRESULT ReadMetadataBlock2();
+  HRESULT DecodeMetadataBlock(const Byte *src, UInt32 &packSize);
+  HRESULT LoadBlock(CCachedBlock &cb, UInt64 blockOffset, UInt32 packBlockSize, bool compressed);
+  CCachedBlock &GetFragBlock(UInt64 blockOffset, UInt32 packBlockSize);
   HRESULT ReadData(CData &data, UInt64 start, UInt64 end);
 
   HRESULT OpenDir(int parent, UInt32 startBlock, UInt32 offset, unsigned level, int &nodeIndex);
@@ -907,24 +973,12 @@ Z7_CLASS_IMP_CHandler_IInArchive_1(
   bool GetPackSize(unsigned index, UInt64 &res, bool fillOffsets);
 
 public:
-  CHandler();
-  ~CHandler()
-  {
-    XzUnpacker_Free(&_xz);
-    if (_zstd)
-      ZstdDec_Destroy(_zstd);
-  }
+  CHandler(): _fragUseStamp(0) {}
 
-  HRESULT ReadBlock(UInt64 blockIndex, Byte *dest, size_t blockSize);
+  HRESULT ReadBlock(const CSquashfsInStream &s, UInt64 blockIndex, Byte *dest, size_t blockSize);
+  friend class CSquashfsInStream;
 };
 
-
-CHandler::CHandler():
-    _zstd(NULL)
-{
-  XzUnpacker_Construct(&_xz, &g_Alloc);
-}
-
 static const Byte kProps[] =
 {
   kpidPath,
@@ -1182,9 +1236,10 @@ HRESULT CHandler::Decompress(ISequentialOutStream *outStream, Byte *outBuf, bool
   */
   else
   {
-    if (_inputBuffer.Size() < inSize)
-      _inputBuffer.Alloc(inSize);
-    RINOK(ReadStream_FALSE(_stream, _inputBuffer, inSize))
+    CByteBuffer &inputBuffer = _decoder.InputBuffer;
+    if (inputBuffer.Size() < inSize)
+      inputBuffer.Alloc(inSize);
+    RINOK(ReadStream_FALSE(_stream, inputBuffer, inSize))
 
     Byte *dest = outBuf;
     if (!outBuf)
@@ -1194,129 +1249,150 @@ HRESULT CHandler::Decompress(ISequentialOutStream *outStream, Byte *outBuf, bool
         return E_OUTOFMEMORY;
     }
     
-    SizeT destLen = outSizeMax, srcLen = inSize;
-
-    if (method == kMethod_LZO)
-    {
-      RINOK(LzoDecode(dest, &destLen, _inputBuffer, &srcLen))
-    }
-    else if (method == kMethod_LZMA)
+    SizeT destLen = outSizeMax;
+    RINOK(_decoder.Decode(method, _noPropsLZMA, _h.BlockSize, inputBuffer, inSize, dest, destLen, outSizeMax))
+    if (outBuf)
     {
-      Byte props[5];
-      const Byte *src = _inputBuffer;
-
-      if (_noPropsLZMA)
-      {
-        props[0] = 0x5D;
-        SetUi32(&props[1], _h.BlockSize)
-      }
-      else
-      {
-        const UInt32 kPropsSize = LZMA_PROPS_SIZE + 8;
-        if (inSize < kPropsSize)
-          return S_FALSE;
-        memcpy(props, src, LZMA_PROPS_SIZE);
-        UInt64 outSize = GetUi64(src + LZMA_PROPS_SIZE);
-        if (outSize > outSizeMax)
-          return S_FALSE;
-        destLen = (SizeT)outSize;
-        src += kPropsSize;
-        inSize -= kPropsSize;
-        srcLen = inSize;
-      }
-
-      ELzmaStatus status;
-      SRes res = LzmaDecode(dest, &destLen,
-          src, &srcLen,
-          props, LZMA_PROPS_SIZE,
-          LZMA_FINISH_END,
-          &status, &g_Alloc);
-      if (res != 0)
-        return SResToHRESULT(res);
-      if (status != LZMA_STATUS_FINISHED_WITH_MARK
-          && status != LZMA_STATUS_MAYBE_FINISHED_WITHOUT_MARK)
-        return S_FALSE;
+      *outBufWasWritten = true;
+      *outBufWasWrittenSize = (UInt32)destLen;
     }
-    else if (method == kMethod_ZSTD)
-    {
-      const Byte *src = _inputBuffer;
+    else
+      _dynOutStream->UpdateSize(destLen);
+  }
+  return S_OK;
+}
 
-      if (!_zstd)
-      {
-        _zstd = ZstdDec_Create(&g_AlignedAlloc, &g_AlignedAlloc);
-        if (!_zstd)
-          return E_OUTOFMEMORY;
-      }
 
-      CZstdDecState state;
-      ZstdDecState_Clear(&state);
+HRESULT CBlockDecoder::Decode(UInt32 method, bool noPropsLZMA, UInt32 dicSize,
+    const Byte *src, UInt32 inSize, Byte *dest, SizeT &destLen, UInt32 outSizeMax)
+{
+  destLen = outSizeMax;
+  SizeT srcLen = inSize;
 
-      state.inBuf = src;
-      state.inLim = srcLen; //  + 1; for debug
-      // state.outStep = outSizeMax;
-      
-      state.outBuf_fromCaller = dest;
-      state.outBufSize_fromCaller = outSizeMax;
-      // state.mustBeFinished = True;
+  if (method == kMethod_ZLIB)
+  {
+    ZlibDecoder.Create_if_Empty();
+    CMyComPtr2_Create<ISequentialInStream, CBufInStream> inStream;
+    CMyComPtr2_Create<ISequentialOutStream, CBufPtrSeqOutStream> outStream;
+    inStream->Init(src, inSize);
+    outStream->Init(dest, outSizeMax);
+    RINOK(ZlibDecoder.Interface()->Code(inStream, outStream, NULL, NULL, NULL))
+    if (inSize != ZlibDecoder->GetInputProcessedSize())
+      return S_FALSE;
+    destLen = outStream->GetPos();
+    return S_OK;
+  }
 
-      ZstdDec_Init(_zstd);
-      SRes sres;
-      for (;;)
-      {
-        sres = ZstdDec_Decode(_zstd, &state);
-        if (sres != SZ_OK)
-          break;
-        if (state.inLim == state.inPos
-            && (state.status == ZSTD_STATUS_NEEDS_MORE_INPUT ||
-                state.status == ZSTD_STATUS_FINISHED_FRAME))
-          break;
-        // sres = sres;
-        // break; // for debug
-      }
+  if (method == kMethod_LZO)
+  {
+    RINOK(LzoDecode(dest, &destLen, src, &srcLen))
+  }
+  else if (method == kMethod_LZMA)
+  {
+    Byte props[5];
 
-      CZstdDecResInfo info;
-      // ZstdDecInfo_Clear(&stat);
-      // stat->InSize = state.inPos;
-      ZstdDec_GetResInfo(_zstd, &state, sres, &info);
-      sres = info.decode_SRes;
-      if (sres == SZ_OK)
-      {
-        if (state.status != ZSTD_STATUS_FINISHED_FRAME
-            // ||stat.UnexpededEnd
-            || info.extraSize != 0
-            || state.inLim != state.inPos)
-          sres = SZ_ERROR_DATA;
-      }
-      if (sres != SZ_OK)
-        return SResToHRESULT(sres);
-      if (state.winPos > outSizeMax)
-        return E_FAIL;
-      // memcpy(dest, state.dic, state.dicPos);
-      destLen = state.winPos;
+    if (noPropsLZMA)
+    {
+      props[0] = 0x5D;
+      SetUi32(&props[1], dicSize)
     }
     else
     {
-      ECoderStatus status;
-      const SRes res = XzUnpacker_CodeFull(&_xz,
-          dest, &destLen,
-          _inputBuffer, &srcLen,
-          CODER_FINISH_END, &status);
-      if (res != 0)
-        return SResToHRESULT(res);
-      if (status != CODER_STATUS_NEEDS_MORE_INPUT || !XzUnpacker_IsStreamWasFinished(&_xz))
+      const UInt32 kPropsSize = LZMA_PROPS_SIZE + 8;
+      if (inSize < kPropsSize)
         return S_FALSE;
-    }
-    
-    if (inSize != srcLen)
+      memcpy(props, src, LZMA_PROPS_SIZE);
+      UInt64 outSize = GetUi64(src + LZMA_PROPS_SIZE);
+      if (outSize > outSizeMax)
+        return S_FALSE;
+      destLen = (SizeT)outSize;
+      src += kPropsSize;
+      inSize -= kPropsSize;
+      srcLen = inSize;
+    }
+
+    ELzmaStatus status;
+    SRes res = LzmaDecode(dest, &destLen,
+        src, &srcLen,
+        props, LZMA_PROPS_SIZE,
+        LZMA_FINISH_END,
+        &status, &g_Alloc);
+    if (res != 0)
+      return SResToHRESULT(res);
+    if (status != LZMA_STATUS_FINISHED_WITH_MARK
+        && status != LZMA_STATUS_MAYBE_FINISHED_WITHOUT_MARK)
       return S_FALSE;
-    if (outBuf)
+  }
+  else if (method == kMethod_ZSTD)
+  {
+    if (!Zstd)
     {
-      *outBufWasWritten = true;
-      *outBufWasWrittenSize = (UInt32)destLen;
+      Zstd = ZstdDec_Create(&g_AlignedAlloc, &g_AlignedAlloc);
+      if (!Zstd)
+        return E_OUTOFMEMORY;
     }
-    else
-      _dynOutStream->UpdateSize(destLen);
+
+    CZstdDecState state;
+    ZstdDecState_Clear(&state);
+
+    state.inBuf = src;
+    state.inLim = srcLen; //  + 1; for debug
+    // state.outStep = outSizeMax;
+    
+    state.outBuf_fromCaller = dest;
+    state.outBufSize_fromCaller = outSizeMax;
+    // state.mustBeFinished = True;
+
+    ZstdDec_Init(Zstd);
+    SRes sres;
+    for (;;)
+    {
+      sres = ZstdDec_Decode(Zstd, &state);
+      if (sres != SZ_OK)
+        break;
+      if (state.inLim == state.inPos
+          && (state.status == ZSTD_STATUS_NEEDS_MORE_INPUT ||
+              state.status == ZSTD_STATUS_FINISHED_FRAME))
+        break;
+      // sres = sres;
+      // break; // for debug
+    }
+
+    CZstdDecResInfo info;
+    // ZstdDecInfo_Clear(&stat);
+    // stat->InSize = state.inPos;
+    ZstdDec_GetResInfo(Zstd, &state, sres, &info);
+    sres = info.decode_SRes;
+    if (sres == SZ_OK)
+    {
+      if (state.status != ZSTD_STATUS_FINISHED_FRAME
+          // ||stat.UnexpededEnd
+          || info.extraSize != 0
+          || state.inLim != state.inPos)
+        sres = SZ_ERROR_DATA;
+    }
+    if (sres != SZ_OK)
+      return SResToHRESULT(sres);
+    if (state.winPos > outSizeMax)
+      return E_FAIL;
+    // memcpy(dest, state.dic, state.dicPos);
+    destLen = state.winPos;
+  }
+  else
+  {
+    ECoderStatus status;
+    const SRes res = XzUnpacker_CodeFull(&Xz,
+        dest, &destLen,
+        src, &srcLen,
+        CODER_FINISH_END, &status);
+    if (res != 0)
+      return SResToHRESULT(res);
+    if (status != CODER_STATUS_NEEDS_MORE_INPUT || !XzUnpacker_IsStreamWasFinished(&Xz))
+      return S_FALSE;
   }
+  
+  if (inSize != srcLen)
+    return S_FALSE;
   return S_OK;
 }
 
@@ -1362,13 +1438,68 @@ HRESULT CHandler::ReadMetadataBlock2()
   return ReadMetadataBlock(packSize);
 }
 
+HRESULT CHandler::DecodeMetadataBlock(const Byte *src, UInt32 &packSize)
+{
+  const unsigned offset = _h.NeedCheckData() ? 3 : 2;
+  if (offset > packSize)
+    return S_FALSE;
+  const bool be = _h.be;
+  UInt32 size = Get16(src);
+  const bool isCompressed = ((size & kNotCompressedBit16) == 0);
+  if (size != kNotCompressedBit16)
+    size &= ~kNotCompressedBit16;
+
+  if (size > kMetadataBlockSize || offset + size > packSize)
+    return S_FALSE;
+  packSize = offset + size;
+  src += offset;
+  
+  Byte *dest = _dynOutStream->GetBufPtrForWriting(kMetadataBlockSize);
+  if (!dest)
+    return E_OUTOFMEMORY;
+  SizeT destLen = size;
+  if (!isCompressed)
+    memcpy(dest, src, size);
+  else
+  {
+    if (size == 0)
+      return S_FALSE;
+    UInt32 method = _h.Method;
+    if (_h.SeveralMethods)
+      method = (src[0] == 0x5D ? kMethod_LZMA : kMethod_ZLIB);
+    if (method == kMethod_ZLIB && _needCheckLzma)
+    {
+      if (src[0] == 0)
+      {
+        _noPropsLZMA = true;
+        method = _h.Method = kMethod_LZMA;
+      }
+      _needCheckLzma = false;
+    }
+    RINOK(_decoder.Decode(method, _noPropsLZMA, _h.BlockSize, src, size, dest, destLen, kMetadataBlockSize))
+  }
+  _dynOutStream->UpdateSize(destLen);
+  return S_OK;
+}
+
 HRESULT CHandler::ReadData(CData &data, UInt64 start, UInt64 end)
 {
   if (end < start || end - start >= ((UInt64)1 << 32))
     return S_FALSE;
   const UInt32 size = (UInt32)(end - start);
+  {
+    UInt64 fileSize;
+    RINOK(InStream_GetSize_SeekToEnd(_stream, fileSize))
+    if (end > fileSize)
+      return S_FALSE;
+  }
   RINOK(Seek2(start))
   _dynOutStream->Init();
+  // we read all packed metadata blocks of table with one call,
+  // and then we decode the blocks from memory.
+  CByteBuffer packed;
+  packed.Alloc(size);
+  RINOK(ReadStream_FALSE(_stream, packed, size))
   UInt32 packPos = 0;
   while (packPos != size)
   {
@@ -1377,7 +1508,7 @@ HRESULT CHandler::ReadData(CData &data, UInt64 start, UInt64 end)
     if (packPos > size)
       return S_FALSE;
     UInt32 packSize = size - packPos;
-    RINOK(ReadMetadataBlock(packSize))
+    RINOK(DecodeMetadataBlock(packed + packPos, packSize))
     {
       const size_t tSize = _dynOutStream->GetSize();
       if (tSize != (UInt32)tSize)
@@ -1842,7 +1973,8 @@ Z7_COM7F_IMF(CHandler::Close())
   _uids.Free();
   _gids.Free();
 
-  _cachedBlock.Free();
+  _cachedBlock.Data.Free();
+  _fragBlocks.Clear();
   ClearCache();
 
   return S_OK;
@@ -2122,27 +2254,110 @@ Z7_COM7F_IMF(CHandler::GetProperty(UInt32 index, PROPID propID, PROPVARIANT *val
 class CSquashfsInStream: public CCachedInStream
 {
   HRESULT ReadBlock(UInt64 blockIndex, Byte *dest, size_t blockSize) Z7_override;
+ #ifndef Z7_ST
+  HRESULT ReadBlock_Mt(unsigned threadIndex, UInt64 blockIndex, Byte *dest, size_t blockSize) Z7_override;
+ #endif
 public:
   CHandler *Handler;
+  CMyComPtr<IUnknown> HandlerRef;
+  // the block table of file. Each stream keeps own copy,
+  // because CHandler::GetPackSize() changes the tables in CHandler.
+  unsigned NodeIndex;
+  CRecordVector<bool> BlockCompressed;
+  CRecordVector<UInt64> BlockOffsets;
+ #ifndef Z7_ST
+  /* read-ahead threads use only these copies and the decoders of handler.
+     So CHandler::Close() and next Open() don't change the data of running jobs. */
+  CMyComPtr<IInStream> Stream;
+  UInt64 StartBlock;
+  UInt32 BlockSize;
+  UInt32 Method;
+  bool SeveralMethods;
+  bool NoPropsLZMA;
+ #endif
+
+ #ifndef Z7_ST
+  ~CSquashfsInStream() { StopReadAhead(); }
+ #endif
 };
 
 HRESULT CSquashfsInStream::ReadBlock(UInt64 blockIndex, Byte *dest, size_t blockSize)
 {
-  return Handler->ReadBlock(blockIndex, dest, blockSize);
+ #ifndef Z7_ST
+  NWindows::NSynchronization::CCriticalSectionLock lock(Handler->_streamCS);
+ #endif
+  return Handler->ReadBlock(*this, blockIndex, dest, blockSize);
+}
+
+#ifndef Z7_ST
+
+// ReadBlock_Mt() reads only full data blocks. The fragment block (the tail of file)
+// is shared by many files, and it's read via CHandler::ReadBlock() that caches it.
+
+HRESULT CSquashfsInStream::ReadBlock_Mt(unsigned threadIndex, UInt64 blockIndex, Byte *dest, size_t blockSize)
+{
+  if (blockIndex >= BlockCompressed.Size())
+    return E_NOTIMPL;
+  const UInt64 blockOffset = BlockOffsets[(unsigned)blockIndex];
+  const UInt32 packBlockSize = (UInt32)(BlockOffsets[(unsigned)blockIndex + 1] - blockOffset);
+  if (packBlockSize == 0)
+  {
+    // sparse file ???
+    memset(dest, 0, blockSize);
+    return S_OK;
+  }
+  if (packBlockSize > BlockSize)
+    return E_NOTIMPL;
+  
+  // the array of (_mtDecoders) is not changed, see CHandler::GetStream()
+  CBlockDecoder &decoder = Handler->_mtDecoders[threadIndex];
+  CByteBuffer &inputBuffer = decoder.InputBuffer;
+  if (inputBuffer.Size() < packBlockSize)
+    inputBuffer.Alloc(packBlockSize);
+  {
+    NWindows::NSynchronization::CCriticalSectionLock lock(Handler->_streamCS);
+    RINOK(InStream_SeekSet(Stream, StartBlock + blockOffset))
+    RINOK(ReadStream_FALSE(Stream, inputBuffer, packBlockSize))
+  }
+
+  if (!BlockCompressed[(unsigned)blockIndex])
+  {
+    if (packBlockSize < blockSize)
+      return S_FALSE;
+    memcpy(dest, inputBuffer, blockSize);
+    return S_OK;
+  }
+
+  UInt32 method = Method;
+  if (SeveralMethods)
+    method = (inputBuffer[0] == 0x5D ? kMethod_LZMA : kMethod_ZLIB);
+  
+  const UInt32 outSizeMax = BlockSize;
+  CByteBuffer &outBuffer = decoder.OutBuffer;
+  if (outBuffer.Size() != outSizeMax)
+    outBuffer.Alloc(outSizeMax);
+  SizeT destLen = 0;
+  RINOK(decoder.Decode(method, NoPropsLZMA, outSizeMax, inputBuffer, packBlockSize, outBuffer, destLen, outSizeMax))
+  if (destLen < blockSize)
+    return S_FALSE;
+  memcpy(dest, outBuffer, blockSize);
+  return S_OK;
 }
 
-HRESULT CHandler::ReadBlock(UInt64 blockIndex, Byte *dest, size_t blockSize)
+#endif
+
+HRESULT CHandler::ReadBlock(const CSquashfsInStream &s, UInt64 blockIndex, Byte *dest, size_t blockSize)
 {
-  const CNode &node = _nodes[_nodeIndex];
+  const CNode &node = _nodes[s.NodeIndex];
   UInt64 blockOffset;
   UInt32 packBlockSize;
   UInt32 offsetInBlock = 0;
   bool compressed;
-  if (blockIndex < _blockCompressed.Size())
+  if (blockIndex < s.BlockCompressed.Size())
   {
-    compressed = _blockCompressed[(unsigned)blockIndex];
-    blockOffset = _blockOffsets[(unsigned)blockIndex];
-    packBlockSize = (UInt32)(_blockOffsets[(unsigned)blockIndex + 1] - blockOffset);
+    compressed = s.BlockCompressed[(unsigned)blockIndex];
+    blockOffset = s.BlockOffsets[(unsigned)blockIndex];
+    packBlockSize = (UInt32)(s.BlockOffsets[(unsigned)blockIndex + 1] - blockOffset);
     blockOffset += node.StartBlock;
   }
   else
@@ -2163,39 +2378,73 @@ HRESULT CHandler::ReadBlock(UInt64 blockIndex, Byte *dest, size_t blockSize)
     return S_OK;
   }
 
-  if (blockOffset != _cachedBlockStartPos ||
-      packBlockSize != _cachedPackBlockSize)
+  CCachedBlock &cb = (blockIndex < s.BlockCompressed.Size()) ?
+      _cachedBlock :
+      GetFragBlock(blockOffset, packBlockSize);
+
+  if (blockOffset != cb.StartPos ||
+      packBlockSize != cb.PackSize)
   {
-    ClearCache();
-    RINOK(Seek2(blockOffset))
-    _limitedInStream->Init(packBlockSize);
-    
-    if (compressed)
-    {
-      _outStream->Init((Byte *)_cachedBlock, _h.BlockSize);
-      bool outBufWasWritten;
-      UInt32 outBufWasWrittenSize;
-      HRESULT res = Decompress(_outStream, _cachedBlock, &outBufWasWritten, &outBufWasWrittenSize, packBlockSize, _h.BlockSize);
-      RINOK(res)
-      if (outBufWasWritten)
-        _cachedUnpackBlockSize = outBufWasWrittenSize;
-      else
-        _cachedUnpackBlockSize = (UInt32)_outStream->GetPos();
-    }
-    else
-    {
-      if (packBlockSize > _h.BlockSize)
-        return S_FALSE;
-      RINOK(ReadStream_FALSE(_limitedInStream, _cachedBlock, packBlockSize))
-      _cachedUnpackBlockSize = packBlockSize;
-    }
-    _cachedBlockStartPos = blockOffset;
-    _cachedPackBlockSize = packBlockSize;
+    RINOK(LoadBlock(cb, blockOffset, packBlockSize, compressed))
   }
-  if (offsetInBlock + blockSize > _cachedUnpackBlockSize)
+  if (offsetInBlock + blockSize > cb.UnpackSize)
     return S_FALSE;
   if (blockSize != 0)
-    memcpy(dest, _cachedBlock + offsetInBlock, blockSize);
+    memcpy(dest, cb.Data + offsetInBlock, blockSize);
+  return S_OK;
+}
+
+CCachedBlock &CHandler::GetFragBlock(UInt64 blockOffset, UInt32 packBlockSize)
+{
+  _fragUseStamp++;
+  unsigned best = 0;
+  FOR_VECTOR (i, _fragBlocks)
+  {
+    CCachedBlock &cb = _fragBlocks[i];
+    if (cb.StartPos == blockOffset && cb.PackSize == packBlockSize)
+    {
+      cb.UseStamp = _fragUseStamp;
+      return cb;
+    }
+    if (_fragUseStamp - cb.UseStamp > _fragUseStamp - _fragBlocks[best].UseStamp)
+      best = i;
+  }
+  if (_fragBlocks.Size() < kNumCachedFragBlocks)
+    best = _fragBlocks.Add(CCachedBlock());
+  CCachedBlock &cb = _fragBlocks[best];
+  cb.UseStamp = _fragUseStamp;
+  return cb;
+}
+
+HRESULT CHandler::LoadBlock(CCachedBlock &cb, UInt64 blockOffset, UInt32 packBlockSize, bool compressed)
+{
+  cb.Clear();
+  if (cb.Data.Size() != _h.BlockSize)
+    cb.Data.Alloc(_h.BlockSize);
+  RINOK(Seek2(blockOffset))
+  _limitedInStream->Init(packBlockSize);
+  
+  if (compressed)
+  {
+    _outStream->Init((Byte *)cb.Data, _h.BlockSize);
+    bool outBufWasWritten;
+    UInt32 outBufWasWrittenSize;
+    HRESULT res = Decompress(_outStream, cb.Data, &outBufWasWritten, &outBufWasWrittenSize, packBlockSize, _h.BlockSize);
+    RINOK(res)
+    if (outBufWasWritten)
+      cb.UnpackSize = outBufWasWrittenSize;
+    else
+      cb.UnpackSize = (UInt32)_outStream->GetPos();
+  }
+  else
+  {
+    if (packBlockSize > _h.BlockSize)
+      return S_FALSE;
+    RINOK(ReadStream_FALSE(_limitedInStream, cb.Data, packBlockSize))
+    cb.UnpackSize = packBlockSize;
+  }
+  cb.StartPos = blockOffset;
+  cb.PackSize = packBlockSize;
   return S_OK;
 }
 
@@ -2329,24 +2578,48 @@ Z7_COM7F_IMF(CHandler::GetStream(UInt32 index, ISequentialInStream **stream))
   if (!GetPackSize(index, packSize, true))
     return S_FALSE;
 
-  _nodeIndex = item.Node;
-
-  size_t cacheSize = _h.BlockSize;
-  if (_cachedBlock.Size() != cacheSize)
-  {
-    ClearCache();
-    _cachedBlock.Alloc(cacheSize);
-  }
-
   CSquashfsInStream *streamSpec = new CSquashfsInStream;
   CMyComPtr<IInStream> streamTemp = streamSpec;
   streamSpec->Handler = this;
+  streamSpec->HandlerRef = (IInArchive *)this;
+  streamSpec->NodeIndex = item.Node;
+  streamSpec->BlockCompressed = _blockCompressed;
+  streamSpec->BlockOffsets = _blockOffsets;
   unsigned cacheSizeLog = 22;
   if (cacheSizeLog <= _h.BlockSizeLog)
     cacheSizeLog = _h.BlockSizeLog + 1;
   if (!streamSpec->Alloc(_h.BlockSizeLog, cacheSizeLog - _h.BlockSizeLog))
     return E_OUTOFMEMORY;
   streamSpec->Init(node.FileSize);
+
+ #ifndef Z7_ST
+  if (!_needCheckLzma)
+  {
+    // we decode next blocks in parallel for sequential reading
+    const UInt32 kNumReadAheadThreads_Max = 8;
+    UInt32 numThreads = _numThreads;
+    if (numThreads > kNumReadAheadThreads_Max)
+      numThreads = kNumReadAheadThreads_Max;
+    if (numThreads > 1 && _blockCompressed.Size() > 1)
+    {
+      // the threads are shared by all streams of the archive.
+      // The threads of other streams can use (_mtDecoders) now,
+      // so we create all decoders once, and the array is not changed later.
+      if (_mtDecoders.IsEmpty())
+        for (unsigned i = 0; i < kNumReadAheadThreads_Max; i++)
+          _mtDecoders.AddNew();
+      RINOK(_readAheadPool.Create(numThreads))
+      streamSpec->Stream = _stream;
+      streamSpec->StartBlock = node.StartBlock;
+      streamSpec->BlockSize = _h.BlockSize;
+      streamSpec->Method = _h.Method;
+      streamSpec->SeveralMethods = _h.SeveralMethods;
+      streamSpec->NoPropsLZMA = _noPropsLZMA;
+      streamSpec->SetReadAhead(&_readAheadPool, numThreads, _memUsage_Decompress);
+    }
+  }
+ #endif
+
   *stream = streamTemp.Detach();
 
   return S_OK;
@@ -2360,6 +2633,23 @@ static const Byte k_Signature[] = {
     4, 's', 'h', 's', 'q',
     4, 'q', 's', 'h', 's' };
 
+Z7_COM7F_IMF(CHandler::SetProperties(const wchar_t * const *names, const PROPVARIANT *values, UInt32 numProps))
+{
+  InitCommon();
+
+  for (UInt32 i = 0; i < numProps; i++)
+  {
+    const UString name = names[i];
+    const PROPVARIANT &prop = values[i];
+    // "memuse" limits the size of blocks that are decoded ahead
+    HRESULT hres;
+    if (!SetCommonProperty(name, prop, hres))
+      return E_INVALIDARG;
+    RINOK(hres)
+  }
+  return S_OK;
+}
+
 REGISTER_ARC_I(
   "SquashFS", "squashfs", NULL, 0xD2,
   k_Signature,
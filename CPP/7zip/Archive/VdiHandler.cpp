@@ -107,6 +107,7 @@ Z7_class_CHandler_final: public CHandlerImg
   }
 
   HRESULT Open2(IInStream *stream, IArchiveOpenCallback *openCallback) Z7_override;
+  bool Get_AllocUnit_IsData(UInt64 unit) const Z7_override;
 
 public:
   Z7_IFACE_COM7_IMP(IInArchive_Img)
@@ -170,6 +171,15 @@ Z7_COM7F_IMF(CHandler::Read(void *data, UInt32 size, UInt32 *processedSize))
 }
 
 
+bool CHandler::Get_AllocUnit_IsData(UInt64 unit) const
+{
+  unit <<= 2;
+  if (unit >= _table.Size())
+    return false;
+  return IS_CLUSTER_ALLOCATED(Get32((const Byte *)_table + (size_t)unit));
+}
+
+
 static const Byte kProps[] =
 {
   kpidSize,
@@ -392,6 +402,7 @@ HRESULT CHandler::Open2(IInStream *stream, IArchiveOpenCallback * /* openCallbac
     }
   }
   
+  _allocUnitBits = k_ClusterBits;
   Stream = stream;
   return S_OK;
 }
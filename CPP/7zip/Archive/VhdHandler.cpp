@@ -307,6 +307,7 @@ Z7_class_CHandler_final: public CHandlerImg
     return Open2(stream, NULL, openArchiveCallback, 0);
   }
   void CloseAtError() Z7_override;
+  bool Get_AllocUnit_IsData(UInt64 unit) const Z7_override;
 
 public:
   Z7_IFACE_COM7_IMP(IInArchive_Img)
@@ -483,6 +484,7 @@ HRESULT CHandler::Open3()
         break;
     }
   }
+  _allocUnitBits = Dyn.BlockSizeLog;
 
   if (headerAndFooterAreEqual)
     return S_OK;
@@ -527,6 +529,14 @@ HRESULT CHandler::Open3()
   return S_OK;
 }
 
+bool CHandler::Get_AllocUnit_IsData(UInt64 unit) const
+{
+  if (unit >= Bat.Size())
+    return true; // Read() will report error for such block
+  // unused block is read from parent, if there is parent
+  return Bat[(unsigned)unit] != kUnusedBlock || ParentStream;
+}
+
 Z7_COM7F_IMF(CHandler::Read(void *data, UInt32 size, UInt32 *processedSize))
 {
   if (processedSize)
@@ -755,6 +755,7 @@ Z7_class_CHandler_final: public CHandlerImg
   HRESULT Open2(IInStream *stream, IArchiveOpenCallback *openArchiveCallback) Z7_override;
   HRESULT OpenParent(IArchiveOpenCallback *openArchiveCallback, bool &_parentFileWasOpen);
   virtual void CloseAtError() Z7_override;
+  virtual bool Get_AllocUnit_IsData(UInt64 unit) const Z7_override;
 
 public:
   Z7_IFACE_COM7_IMP(IInArchive_Img)
@@ -1304,6 +1305,7 @@ HRESULT CHandler::Open3()
         // _batOverlap = true;
         // return S_FALSE;
       }
+      _allocUnitBits = Meta.BlockSize_Log;
     }
   }
 
@@ -1511,6 +1513,21 @@ Z7_COM7F_IMF(CHandler::Read(void *data, UInt32 size, UInt32 *processedSize))
 }
 
 
+bool CHandler::Get_AllocUnit_IsData(UInt64 unit) const
+{
+  const UInt64 chunkIndex = unit >> ChunkRatio_Log;
+  const UInt64 blockIndex2 = chunkIndex * (ChunkRatio + 1) + (unit & (ChunkRatio - 1));
+  if (blockIndex2 >= TotalBatEntries)
+    return true; // Read() will check such block
+  const UInt32 blockState = BAT_GET_STATE(Bat.GetItem((size_t)blockIndex2));
+  if (blockState == PAYLOAD_BLOCK_FULLY_PRESENT
+      || blockState == PAYLOAD_BLOCK_PARTIALLY_PRESENT)
+    return true;
+  // NOT_PRESENT block of differencing VHDX is read from parent
+  return blockState == PAYLOAD_BLOCK_NOT_PRESENT && IsDiff();
+}
+
+
 enum
 {
   kpidParent = kpidUserDefined
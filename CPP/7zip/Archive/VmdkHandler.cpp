@@ -414,6 +414,21 @@ struct CExtent
     return S_OK;
   }
 
+  UInt32 GetGrainSector(UInt64 cluster) const
+  {
+    const UInt64 high = cluster >> k_NumMidBits;
+    if (high >= Tables.Size())
+      return 0;
+    const CByteBuffer &table = Tables[(unsigned)high];
+    if (table.Size() == 0)
+      return 0;
+    const size_t midBits = (size_t)cluster & ((1 << k_NumMidBits) - 1);
+    return Get32((const Byte *)table + (midBits << 2));
+  }
+
+  // it reads compressed grain to (buf) and returns S_FALSE for incorrect grain marker
+  HRESULT ReadGrain(UInt64 cluster, UInt32 sector, CByteBuffer &buf, UInt32 &dataSize);
+
   HRESULT Read(void *data, size_t *size)
   {
     HRESULT res = ReadStream(Stream, data, size);
@@ -421,6 +436,89 @@ struct CExtent
     return res;
   }
 };
+
+
+HRESULT CExtent::ReadGrain(UInt64 cluster, UInt32 sector, CByteBuffer &buf, UInt32 &dataSize)
+{
+  const UInt64 offset = (UInt64)sector << 9;
+  if (offset != PosInArc)
+  {
+    // printf("\n%12x %12x\n", (unsigned)offset, (unsigned)(offset - PosInArc));
+    RINOK(Seek(offset))
+  }
+  
+  const size_t kStartSize = 1 << 9;
+  {
+    size_t curSize = kStartSize;
+    RINOK(Read(buf, &curSize))
+    // _stream_PackSize += curSize;
+    if (curSize != kStartSize)
+      return S_FALSE;
+  }
+
+  if (Get64(buf) != (cluster << (ClusterBits - 9)))
+    return S_FALSE;
+
+  dataSize = Get32(buf + 8);
+  if (dataSize > ((UInt32)1 << 31))
+    return S_FALSE;
+
+  size_t dataSize2 = (size_t)dataSize + 12;
+  
+  if (dataSize2 > kStartSize)
+  {
+    dataSize2 = (dataSize2 + 511) & ~(size_t)511;
+    if (dataSize2 > buf.Size())
+      return S_FALSE;
+    size_t curSize = dataSize2 - kStartSize;
+    const size_t curSize2 = curSize;
+    RINOK(Read(buf + kStartSize, &curSize))
+    // _stream_PackSize += curSize;
+    if (curSize != curSize2)
+      return S_FALSE;
+  }
+  return S_OK;
+}
+
+
+static const unsigned kNumCachedClusters_Min = 4;
+static const size_t k_Cache_Size_MAX = (size_t)1 << 26;
+
+struct CGrainDecoder Z7_final: public CImgUnitDecoder
+{
+  CMyComPtr2<ISequentialInStream, CBufInStream> InStream;
+  CMyComPtr2<ISequentialOutStream, CBufPtrSeqOutStream> OutStream;
+  CMyComPtr2<ICompressCoder, NCompress::NZlib::CDecoder> Zlib;
+
+  void Create()
+  {
+    InStream.Create_if_Empty();
+    OutStream.Create_if_Empty();
+    Zlib.Create_if_Empty();
+  }
+
+  HRESULT Decode(const Byte *src, size_t srcSize, Byte *dest, size_t clusterSize, bool &dataError) Z7_override;
+};
+
+HRESULT CGrainDecoder::Decode(const Byte *src, size_t srcSize, Byte *dest, size_t clusterSize, bool &dataError)
+{
+  dataError = false;
+  InStream->Init(src, srcSize);
+  OutStream->Init(dest, clusterSize);
+  // Do we need to use smaller block than clusterSize for last cluster?
+  const UInt64 blockSize64 = clusterSize;
+  HRESULT res = Zlib.Interface()->Code(InStream, OutStream, NULL, &blockSize64, NULL);
+  if (OutStream->GetPos() != clusterSize
+      || Zlib->GetInputProcessedSize() != srcSize)
+  {
+    dataError = true;
+    if (res == S_OK)
+      res = S_FALSE;
+  }
+  return res;
+}
+
+
   
 
 Z7_class_CHandler_final: public CHandlerImg
@@ -433,45 +531,94 @@ Z7_class_CHandler_final: public CHandlerImg
   bool _isMultiVol;
   bool _needDeflate;
 
-  UInt64 _cacheCluster;
-  unsigned _cacheExtent;
-  CByteBuffer _cache;
+  CImgClusterCache _cache;
   CByteBuffer _cacheCompressed;
+  // grain of previous Read() call. It's used to detect sequential reading
+  UInt64 _prevCluster;
+  unsigned _prevExtent;
   
   unsigned _clusterBitsMax;
   UInt64 _phySize;
 
   CObjectVector<CExtent> _extents;
 
-  CBufInStream *_bufInStreamSpec;
-  CMyComPtr<ISequentialInStream> _bufInStream;
-
-  CBufPtrSeqOutStream *_bufOutStreamSpec;
-  CMyComPtr<ISequentialOutStream> _bufOutStream;
-
-  NCompress::NZlib::CDecoder *_zlibDecoderSpec;
-  CMyComPtr<ICompressCoder> _zlibDecoder;
+  CGrainDecoder _decoder;
 
   CByteBuffer _descriptorBuf;
   CDescriptor _descriptor;
 
   UString _missingVolName;
   
+  unsigned FindExtent(UInt64 pos) const
+  {
+    unsigned left = 0, right = _extents.Size();
+    for (;;)
+    {
+      const unsigned mid = (left + right) / 2;
+      if (mid == left)
+        return left;
+      if (pos < _extents[mid].StartOffset)
+        right = mid;
+      else
+        left = mid;
+    }
+  }
+
   void InitAndSeekMain()
   {
     _virtPos = 0;
+    _prevCluster = (UInt64)(Int64)-1;
+    _prevExtent = (unsigned)(int)-1;
   }
 
+ #ifndef Z7_ST
+  bool Is_PackedUnit(unsigned extentIndex, UInt64 unit) const Z7_override
+  {
+    const CExtent &extent = _extents[extentIndex];
+    const UInt32 v = extent.GetGrainSector(unit);
+    return v != 0 && v != extent.ZeroSector;
+  }
+  HRESULT ReadPackedUnit(unsigned extentIndex, UInt64 unit,
+      CByteBuffer &buf, size_t &offset, size_t &size) Z7_override;
+  CImgUnitDecoder *CreateUnitDecoder() Z7_override
+  {
+    CGrainDecoder *decoder = new CGrainDecoder;
+    decoder->Create();
+    return decoder;
+  }
+ #endif
+
   virtual HRESULT Open2(IInStream *stream, IArchiveOpenCallback *openCallback) Z7_override;
   virtual void CloseAtError() Z7_override;
 public:
+  CHandler() { _isMtSupported = true; }
+
   Z7_IFACE_COM7_IMP(IInArchive_Img)
 
   Z7_IFACE_COM7_IMP(IInArchiveGetStream)
   Z7_IFACE_COM7_IMP(ISequentialInStream)
+  Z7_IFACE_COM7_IMP(IStreamGetDataRange)
 };
 
 
+#ifndef Z7_ST
+
+HRESULT CHandler::ReadPackedUnit(unsigned extentIndex, UInt64 unit,
+    CByteBuffer &buf, size_t &offset, size_t &size)
+{
+  CExtent &extent = _extents[extentIndex];
+  buf.AllocAtLeast((size_t)2 << _clusterBitsMax);
+  UInt32 dataSize;
+  RINOK(extent.ReadGrain(unit, extent.GetGrainSector(unit), buf, dataSize))
+  // the grain marker (12 bytes) precedes compressed data
+  offset = 12;
+  size = dataSize;
+  return S_OK;
+}
+
+#endif
+
+
 Z7_COM7F_IMF(CHandler::Read(void *data, UInt32 size, UInt32 *processedSize))
 {
   if (processedSize)
@@ -486,21 +633,7 @@ Z7_COM7F_IMF(CHandler::Read(void *data, UInt32 size, UInt32 *processedSize))
       return S_OK;
   }
 
-  unsigned extentIndex;
-  {
-    unsigned left = 0, right = _extents.Size();
-    for (;;)
-    {
-      unsigned mid = (left + right) / 2;
-      if (mid == left)
-        break;
-      if (_virtPos < _extents[mid].StartOffset)
-        right = mid;
-      else
-        left = mid;
-    }
-    extentIndex = left;
-  }
+  const unsigned extentIndex = FindExtent(_virtPos);
   
   CExtent &extent = _extents[extentIndex];
 
@@ -607,141 +740,91 @@ Z7_COM7F_IMF(CHandler::Read(void *data, UInt32 size, UInt32 *processedSize))
       if (size > rem)
         size = (UInt32)rem;
     }
+    // we don't use multithreading for first grain that is read by GetImgExt() in Open()
+    const bool isSequential = (cluster != 0
+        && extentIndex == _prevExtent
+        && cluster == _prevCluster + 1);
+    _prevCluster = cluster;
+    _prevExtent = extentIndex;
 
-    if (extentIndex == _cacheExtent && cluster == _cacheCluster)
     {
-      memcpy(data, _cache + lowBits, size);
-      _virtPos += size;
-      if (processedSize)
-        *processedSize = size;
-      return S_OK;
+      const int index = _cache.Find(extentIndex, cluster);
+      if (index >= 0)
+      {
+        memcpy(data, _cache.GetBuf((unsigned)index) + lowBits, size);
+        _virtPos += size;
+        if (processedSize)
+          *processedSize = size;
+        return S_OK;
+      }
     }
     
-    const UInt64 high = cluster >> k_NumMidBits;
- 
-    if (high < extent.Tables.Size())
+    const UInt32 v = extent.GetGrainSector(cluster);
+        
+    if (v != 0 && v != extent.ZeroSector)
     {
-      const CByteBuffer &table = extent.Tables[(unsigned)high];
-    
-      if (table.Size() != 0)
+      if (extent.NeedDeflate)
       {
-        const size_t midBits = (size_t)cluster & ((1 << k_NumMidBits) - 1);
-        const Byte *p = (const Byte *)table + (midBits << 2);
-        const UInt32 v = Get32(p);
+       #ifndef Z7_ST
+        if (isSequential && _numMtThreads > 1)
+        {
+          RINOK(DecodeUnits_Mt(_cache, extentIndex, cluster,
+              (extent.VirtSize + clusterSize - 1) >> clusterBits, clusterBits))
+          continue;
+        }
+       #else
+        UNUSED_VAR(isSequential)
+       #endif
+
+        UInt32 dataSize;
+        RINOK(extent.ReadGrain(cluster, v, _cacheCompressed, dataSize))
         
-        if (v != 0 && v != extent.ZeroSector)
+        const unsigned index = _cache.Alloc_Item(extentIndex, cluster);
+        bool dataError;
+        const HRESULT res = _decoder.Decode(_cacheCompressed + 12, dataSize,
+            _cache.GetBuf(index), clusterSize, dataError);
+        if (res != S_OK)
         {
-          UInt64 offset = (UInt64)v << 9;
-          if (extent.NeedDeflate)
-          {
-            if (offset != extent.PosInArc)
-            {
-              // printf("\n%12x %12x\n", (unsigned)offset, (unsigned)(offset - extent.PosInArc));
-              RINOK(extent.Seek(offset))
-            }
-            
-            const size_t kStartSize = 1 << 9;
-            {
-              size_t curSize = kStartSize;
-              RINOK(extent.Read(_cacheCompressed, &curSize))
-              // _stream_PackSize += curSize;
-              if (curSize != kStartSize)
-                return S_FALSE;
-            }
-
-            if (Get64(_cacheCompressed) != (cluster << (clusterBits - 9)))
-              return S_FALSE;
-
-            UInt32 dataSize = Get32(_cacheCompressed + 8);
-            if (dataSize > ((UInt32)1 << 31))
-              return S_FALSE;
-
-            size_t dataSize2 = (size_t)dataSize + 12;
-            
-            if (dataSize2 > kStartSize)
-            {
-              dataSize2 = (dataSize2 + 511) & ~(size_t)511;
-              if (dataSize2 > _cacheCompressed.Size())
-                return S_FALSE;
-              size_t curSize = dataSize2 - kStartSize;
-              const size_t curSize2 = curSize;
-              RINOK(extent.Read(_cacheCompressed + kStartSize, &curSize))
-              // _stream_PackSize += curSize;
-              if (curSize != curSize2)
-                return S_FALSE;
-            }
-
-            _bufInStreamSpec->Init(_cacheCompressed + 12, dataSize);
-            
-            _cacheCluster = (UInt64)(Int64)-1;
-            _cacheExtent = (unsigned)(int)-1;
-
-            if (_cache.Size() < clusterSize)
-              return E_FAIL;
-            _bufOutStreamSpec->Init(_cache, clusterSize);
-            
-            // Do we need to use smaller block than clusterSize for last cluster?
-            const UInt64 blockSize64 = clusterSize;
-            HRESULT res = _zlibDecoder->Code(_bufInStream, _bufOutStream, NULL, &blockSize64, NULL);
-
-            /*
-            if (_bufOutStreamSpec->GetPos() != clusterSize)
-            {
-              _stream_dataError = true;
-              memset(_cache + _bufOutStreamSpec->GetPos(), 0, clusterSize - _bufOutStreamSpec->GetPos());
-            }
-            */
-
-              if (_bufOutStreamSpec->GetPos() != clusterSize
-                  || _zlibDecoderSpec->GetInputProcessedSize() != dataSize)
-              {
-                _stream_dataError = true;
-                if (res == S_OK)
-                  res = S_FALSE;
-              }
-
-            RINOK(res)
-            
-            _cacheCluster = cluster;
-            _cacheExtent = extentIndex;
-            
-            continue;
-            /*
-            memcpy(data, _cache + lowBits, size);
-            _virtPos += size;
-            if (processedSize)
-              *processedSize = size;
-            return S_OK;
-            */
-          }
-          {
-            offset += lowBits;
-            if (offset != extent.PosInArc)
-            {
-              // printf("\n%12x %12x\n", (unsigned)offset, (unsigned)(offset - extent.PosInArc));
-              RINOK(extent.Seek(offset))
-            }
-            UInt32 size2 = 0;
-            HRESULT res = extent.Stream->Read(data, size, &size2);
-            if (res == S_OK && size2 == 0)
-            {
-              _stream_unavailData = true;
-              /*
-              memset(data, 0, size);
-              _virtPos += size;
-              if (processedSize)
-                *processedSize = size;
-              return S_OK;
-              */
-            }
-            extent.PosInArc += size2;
-            // _stream_PackSize += size2;
-            _virtPos += size2;
-            if (processedSize)
-              *processedSize = size2;
-            return res;
-          }
+          _cache.Free_Item(index);
+          if (dataError)
+            _stream_dataError = true;
+          return res;
+        }
+        continue;
+        /*
+        memcpy(data, _cache + lowBits, size);
+        _virtPos += size;
+        if (processedSize)
+          *processedSize = size;
+        return S_OK;
+        */
+      }
+      {
+        const UInt64 offset = ((UInt64)v << 9) + lowBits;
+        if (offset != extent.PosInArc)
+        {
+          // printf("\n%12x %12x\n", (unsigned)offset, (unsigned)(offset - extent.PosInArc));
+          RINOK(extent.Seek(offset))
+        }
+        UInt32 size2 = 0;
+        HRESULT res = extent.Stream->Read(data, size, &size2);
+        if (res == S_OK && size2 == 0)
+        {
+          _stream_unavailData = true;
+          /*
+          memset(data, 0, size);
+          _virtPos += size;
+          if (processedSize)
+            *processedSize = size;
+          return S_OK;
+          */
         }
+        extent.PosInArc += size2;
+        // _stream_PackSize += size2;
+        _virtPos += size2;
+        if (processedSize)
+          *processedSize = size2;
+        return res;
       }
     }
     
@@ -754,6 +837,59 @@ Z7_COM7F_IMF(CHandler::Read(void *data, UInt32 size, UInt32 *processedSize))
 }
 
 
+Z7_COM7F_IMF(CHandler::GetDataRange(UInt64 pos, UInt64 *dataStart, UInt64 *dataEnd))
+{
+  *dataStart = _size;
+  *dataEnd = _size;
+  bool isData = false;
+  
+  while (pos < _size)
+  {
+    bool data = true;
+    UInt64 next = _size;
+    if (!_extents.IsEmpty())
+    {
+      const CExtent &extent = _extents[FindExtent(pos)];
+      const UInt64 vir = pos - extent.StartOffset;
+      const UInt64 extentEnd = extent.GetEndOffset();
+      if (extentEnd > pos)
+        next = extentEnd;
+      if (extent.IsZero)
+        data = false;
+      else if (extent.IsOK && extent.Stream && !extent.Unsupported
+          && !extent.IsFlat && vir < extent.VirtSize)
+      {
+        const UInt64 cluster = vir >> extent.ClusterBits;
+        const UInt32 v = extent.GetGrainSector(cluster);
+        data = (v != 0 && v != extent.ZeroSector);
+        const UInt64 clusterEnd = extent.StartOffset + ((cluster + 1) << extent.ClusterBits);
+        if (next > clusterEnd)
+          next = clusterEnd;
+      }
+      // other extents are reported as data, and Read() will check them
+    }
+    if (data)
+    {
+      if (!isData)
+      {
+        *dataStart = pos;
+        isData = true;
+      }
+    }
+    else if (isData)
+    {
+      *dataEnd = pos;
+      return S_OK;
+    }
+    if (next > _size)
+      next = _size;
+    pos = next;
+  }
+  
+  return S_OK;
+}
+
+
 static const Byte kProps[] =
 {
   kpidSize,
@@ -1444,8 +1580,9 @@ Z7_COM7F_IMF(CHandler::Close())
 {
   _phySize = 0;
   
-  _cacheCluster = (UInt64)(Int64)-1;
-  _cacheExtent = (unsigned)(int)-1;
+  _cache.Clear();
+  _prevCluster = (UInt64)(Int64)-1;
+  _prevExtent = (unsigned)(int)-1;
 
   _clusterBitsMax = 0;
 
@@ -1484,26 +1621,15 @@ Z7_COM7F_IMF(CHandler::GetStream(UInt32 /* index */, ISequentialInStream **strea
 
   if (_needDeflate)
   {
-    if (!_bufInStream)
-    {
-      _bufInStreamSpec = new CBufInStream;
-      _bufInStream = _bufInStreamSpec;
-    }
-    
-    if (!_bufOutStream)
-    {
-      _bufOutStreamSpec = new CBufPtrSeqOutStream();
-      _bufOutStream = _bufOutStreamSpec;
-    }
-
-    if (!_zlibDecoder)
-    {
-      _zlibDecoderSpec = new NCompress::NZlib::CDecoder;
-      _zlibDecoder = _zlibDecoderSpec;
-    }
-    
+    _decoder.Create();
     const size_t clusterSize = (size_t)1 << _clusterBitsMax;
-    _cache.AllocAtLeast(clusterSize);
+    _numMtThreads = GetNumMtThreads(_clusterBitsMax);
+    unsigned numItems = kNumCachedClusters_Min;
+    if (numItems < _numMtThreads * 2)
+      numItems = _numMtThreads * 2;
+    if (numItems > (k_Cache_Size_MAX >> _clusterBitsMax))
+      numItems = (unsigned)(k_Cache_Size_MAX >> _clusterBitsMax);
+    _cache.Alloc(_clusterBitsMax, numItems);
     _cacheCompressed.AllocAtLeast(clusterSize * 2);
   }
 
@@ -1061,6 +1061,7 @@ Z7_COM7F_IMF(CHandler::Extract(const UInt32 *indices, UInt32 numItems,
   int prevSuccessStreamIndex = -1;
 
   CUnpacker unpacker;
+  unpacker.NumThreads = _numThreads;
 
   CMyComPtr2_Create<ICompressProgressInfo, CLocalProgress> lps;
   lps->Init(extractCallback, false);
@@ -1193,6 +1194,21 @@ Z7_COM7F_IMF(CHandler::SetProperties(const wchar_t * const *names, const PROPVAR
       // some clients write 'x' property. So we support it
       UInt32 level = 0;
       RINOK(ParsePropToUInt32(name.Ptr(1), prop, level))
+      _level = level;
+      if (level == 0)
+        _method = 0;
+    }
+    else if (name.IsEqualTo("m"))
+    {
+      if (prop.vt != VT_BSTR)
+        return E_INVALIDARG;
+      const UString m = prop.bstrVal;
+      if (m.IsEqualTo_Ascii_NoCase("XPRESS"))
+        _method = NMethod::kXPRESS;
+      else if (m.IsEqualTo_Ascii_NoCase("Copy"))
+        _method = 0;
+      else
+        return E_INVALIDARG;
     }
     else if (name.IsEqualTo("is"))
     {
@@ -1207,6 +1223,14 @@ Z7_COM7F_IMF(CHandler::SetProperties(const wchar_t * const *names, const PROPVAR
     }
     else if (name.IsPrefixedBy_Ascii_NoCase("mt"))
     {
+      // "mt" and "mt{N}" set the number of threads.
+      // Other "mt*" properties (like "mtb" of 7z) are not used by WIM handler
+      const UString s = name.Ptr(2);
+      if (s.IsEmpty() || (s[0] >= '0' && s[0] <= '9'))
+      {
+        const UInt32 numProcessors = NWindows::NSystem::GetNumberOfProcessors();
+        RINOK(ParseMtProp(s, prop, numProcessors, _numThreads))
+      }
     }
     else if (name.IsPrefixedBy_Ascii_NoCase("memuse"))
     {
@@ -5,6 +5,8 @@
 
 #include "../../../Common/MyCom.h"
 
+#include "../../../Windows/System.h"
+
 #include "../Common/HandlerOut.h"
 
 #include "WimIn.h"
@@ -50,10 +52,17 @@ Z7_CLASS_IMP_CHandler_IInArchive_5(
   UInt64 _phySize;
   Int32 _firstVolumeIndex;
 
+  UInt32 _numThreads;
+  UInt32 _level;
+  unsigned _method; // compression method for new data streams: NMethod::kXPRESS or 0
+
   CHandlerTimeOptions _timeOptions;
 
   void InitDefaults()
   {
+    _numThreads = NWindows::NSystem::GetNumberOfProcessors();
+    _level = 5;
+    _method = 0;
     _disable_Sha1Check = false;
     _set_use_ShowImageNumber = false;
     _set_showImageNumber = false;
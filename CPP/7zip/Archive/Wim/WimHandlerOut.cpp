@@ -16,6 +16,11 @@
 #include "../../Common/ProgressUtils.h"
 #include "../../Common/StreamUtils.h"
 #include "../../Common/UniqBlocks.h"
+#ifndef Z7_ST
+#include "../../Common/VirtThread.h"
+#endif
+
+#include "../../Compress/XpressEncoder.h"
 
 #include "../../Crypto/RandGen.h"
 #include "../../Crypto/Sha1Cls.h"
@@ -658,16 +663,20 @@ static void AddTag_String_IfEmpty(CXmlItem &parentItem, const char *name, const
 }
 
 
-void CHeader::SetDefaultFields(bool useLZX)
+void CHeader::SetDefaultFields(unsigned method)
 {
   Version = k_Version_NonSolid;
   Flags = NHeaderFlags::kReparsePointFixup;
   ChunkSize = 0;
-  if (useLZX)
+  ChunkSizeBits = kChunkSizeBits;
+  if (method == NMethod::kLZX)
+    Flags |= NHeaderFlags::kLZX;
+  else if (method == NMethod::kXPRESS)
+    Flags |= NHeaderFlags::kXPRESS;
+  if (method != 0)
   {
-    Flags |= NHeaderFlags::kCompression | NHeaderFlags::kLZX;
+    Flags |= NHeaderFlags::kCompression;
     ChunkSize = kChunkSize;
-    ChunkSizeBits = kChunkSizeBits;
   }
   MY_RAND_GEN(Guid, 16);
   PartNumber = 1;
@@ -681,6 +690,249 @@ void CHeader::SetDefaultFields(bool useLZX)
 }
 
 
+// ---------- Compressed resource writer ----------
+
+#ifndef Z7_ST
+static const unsigned k_NumThreads_MAX = 32;
+#endif
+// the size of source data for one job in one pass
+static const unsigned k_JobInSize_Log = 20;
+
+struct CChunkEncodeJob
+{
+  NCompress::NXpress::CEncoder Encoder;
+  const Byte *Src;
+  size_t SrcSize;
+  unsigned ChunkSizeBits;
+  CByteBuffer Dest; // each chunk is stored at (index << ChunkSizeBits) offset
+  CRecordVector<UInt32> PackSizes;
+  HRESULT Result;
+
+  void Encode();
+};
+
+void CChunkEncodeJob::Encode()
+{
+  PackSizes.Clear();
+  Result = S_OK;
+  try
+  {
+    const size_t chunkSize = (size_t)1 << ChunkSizeBits;
+    Byte *dest = Dest;
+    for (size_t pos = 0; pos < SrcSize; pos += chunkSize, dest += chunkSize)
+    {
+      size_t cur = SrcSize - pos;
+      if (cur > chunkSize)
+        cur = chunkSize;
+      // the chunk is stored without compression, if packed chunk is not smaller
+      size_t packSize = Encoder.Encode(Src + pos, cur, dest, cur);
+      if (packSize == 0)
+      {
+        memcpy(dest, Src + pos, cur);
+        packSize = cur;
+      }
+      PackSizes.Add((UInt32)packSize);
+    }
+  }
+  catch(...)
+  {
+    Result = E_OUTOFMEMORY;
+  }
+}
+
+#ifndef Z7_ST
+
+class CEncodeThread Z7_final: public CVirtThread
+{
+public:
+  CChunkEncodeJob *Job;
+
+  ~CEncodeThread() Z7_DESTRUCTOR_override
+  {
+    CVirtThread::WaitThreadFinish();
+  }
+private:
+  virtual void Execute() Z7_override { Job->Encode(); }
+};
+
+#endif
+
+
+class CResourceEncoder
+{
+  CByteBuffer _inBuf;
+  CByteBuffer _sizes;
+  CObjectVector<CChunkEncodeJob> _jobs;
+ #ifndef Z7_ST
+  CObjectVector<CEncodeThread> _threads;
+ #endif
+public:
+  UInt32 NumThreads;
+  UInt32 Level;
+  unsigned ChunkSizeBits;
+
+  /* it writes XPRESS compressed resource: the chunk table and the chunks.
+     (resOffset) is current position in (outStream).
+     it returns S_FALSE, if (inStream) size is not equal to (size),
+     or if compressed resource is not smaller than (size). */
+  HRESULT Write(ISequentialInStream *inStream, UInt64 size,
+      IOutStream *outStream, UInt64 resOffset,
+      ICompressProgressInfo *progress, UInt64 &packSize);
+};
+
+
+HRESULT CResourceEncoder::Write(ISequentialInStream *inStream, UInt64 size,
+    IOutStream *outStream, UInt64 resOffset,
+    ICompressProgressInfo *progress, UInt64 &packSize)
+{
+  packSize = 0;
+  if (size == 0)
+    return S_FALSE;
+  
+  const size_t chunkSize = (size_t)1 << ChunkSizeBits;
+  const UInt64 numChunks = (size + chunkSize - 1) >> ChunkSizeBits;
+  const unsigned entrySizeShifts = (size < ((UInt64)1 << 32) ? 2 : 3);
+  const UInt64 sizesSize64 = (numChunks - 1) << entrySizeShifts;
+  const size_t sizesSize = (size_t)sizesSize64;
+  if (sizesSize != sizesSize64)
+    return E_OUTOFMEMORY;
+  _sizes.AllocAtLeast(sizesSize);
+  memset(_sizes, 0, sizesSize);
+  // we write the chunk table later, when the sizes of chunks are known
+  RINOK(WriteStream(outStream, _sizes, sizesSize))
+
+  unsigned numJobs = 1;
+ #ifndef Z7_ST
+  numJobs = NumThreads;
+  if (numJobs > k_NumThreads_MAX)
+    numJobs = k_NumThreads_MAX;
+  if (numJobs == 0)
+    numJobs = 1;
+ #endif
+
+  size_t numChunksInJob = 1;
+  if (ChunkSizeBits < k_JobInSize_Log)
+    numChunksInJob = (size_t)1 << (k_JobInSize_Log - ChunkSizeBits);
+  const size_t jobSize = numChunksInJob << ChunkSizeBits;
+  {
+    const UInt64 numJobs2 = (size + jobSize - 1) / jobSize;
+    if (numJobs > numJobs2)
+      numJobs = (unsigned)numJobs2;
+  }
+
+  while (_jobs.Size() < numJobs)
+    _jobs.AddNew();
+ #ifndef Z7_ST
+  while (_threads.Size() + 1 < numJobs)
+  {
+    CEncodeThread &t = _threads.AddNew();
+    const WRes wres = t.Create();
+    if (wres != 0)
+    {
+      _threads.DeleteBack();
+      return HRESULT_FROM_WIN32(wres);
+    }
+  }
+ #endif
+
+  _inBuf.AllocAtLeast(jobSize * numJobs);
+  unsigned i;
+  for (i = 0; i < numJobs; i++)
+  {
+    CChunkEncodeJob &job = _jobs[i];
+    job.Encoder.SetLevel(Level);
+    job.ChunkSizeBits = ChunkSizeBits;
+    job.Src = _inBuf + jobSize * i;
+    job.Dest.AllocAtLeast(jobSize);
+  }
+
+  UInt64 inPos = 0;
+  UInt64 outPos = 0; // offset after the chunk table
+  UInt64 chunkIndex = 0;
+
+  while (inPos < size)
+  {
+    size_t cur = jobSize * numJobs;
+    if (cur > size - inPos)
+      cur = (size_t)(size - inPos);
+    size_t processed = cur;
+    RINOK(ReadStream(inStream, _inBuf, &processed))
+    if (processed != cur)
+      return S_FALSE;
+
+    unsigned numActive = 0;
+    for (i = 0; i < numJobs; i++)
+    {
+      CChunkEncodeJob &job = _jobs[i];
+      const size_t offs = jobSize * i;
+      job.SrcSize = 0;
+      if (offs < cur)
+      {
+        job.SrcSize = MyMin(cur - offs, jobSize);
+        numActive = i + 1;
+      }
+    }
+
+    HRESULT res = S_OK;
+   #ifndef Z7_ST
+    unsigned numStarted;
+    for (numStarted = 0; numStarted + 1 < numActive; numStarted++)
+    {
+      CEncodeThread &t = _threads[numStarted];
+      t.Job = &_jobs[numStarted + 1];
+      const WRes wres = t.Start();
+      if (wres != 0)
+      {
+        res = HRESULT_FROM_WIN32(wres);
+        break;
+      }
+    }
+   #endif
+    // the first job is encoded in current thread
+    _jobs[0].Encode();
+   #ifndef Z7_ST
+    for (i = 0; i < numStarted; i++)
+      _threads[i].WaitExecuteFinish();
+   #endif
+    RINOK(res)
+
+    for (i = 0; i < numActive; i++)
+    {
+      const CChunkEncodeJob &job = _jobs[i];
+      RINOK(job.Result)
+      FOR_VECTOR (k, job.PackSizes)
+      {
+        const UInt32 chunkPackSize = job.PackSizes[k];
+        RINOK(WriteStream(outStream, job.Dest + ((size_t)k << ChunkSizeBits), chunkPackSize))
+        outPos += chunkPackSize;
+        if (chunkIndex + 1 < numChunks)
+        {
+          Byte *p = _sizes + ((size_t)chunkIndex << entrySizeShifts);
+          if (entrySizeShifts == 2)
+            SetUi32(p, (UInt32)outPos)
+          else
+            SetUi64(p, outPos)
+        }
+        chunkIndex++;
+      }
+    }
+    
+    inPos += cur;
+    if (progress)
+    {
+      RINOK(progress->SetRatioInfo(&inPos, &outPos))
+    }
+  }
+
+  packSize = sizesSize64 + outPos;
+  if (packSize >= size)
+    return S_FALSE;
+  RINOK(outStream->Seek((Int64)resOffset, STREAM_SEEK_SET, NULL))
+  RINOK(WriteStream(outStream, _sizes, sizesSize))
+  return outStream->Seek((Int64)(resOffset + packSize), STREAM_SEEK_SET, NULL);
+}
+
+
 static void AddTrees(CObjectVector<CDir> &trees, CObjectVector<CMetaItem> &metaItems, const CMetaItem &ri, int curTreeIndex)
 {
   while (curTreeIndex >= (int)trees.Size())
@@ -1355,21 +1607,31 @@ Z7_COM7F_IMF(CHandler::UpdateItems(ISequentialOutStream *outSeqStream, UInt32 nu
 
   complexity = 0;
 
-  // bool useResourceCompression = false;
-  // use useResourceCompression only if CHeader::Flags compression is also set
-
   CHeader header;
-  header.SetDefaultFields(false);
+  header.SetDefaultFields(_method);
 
   if (isUpdate)
   {
     const CHeader &srcHeader = _volumes[1].Header;
-    header.Flags = srcHeader.Flags;
+    if (srcHeader.IsCompressed() || _method == 0)
+    {
+      header.Flags = srcHeader.Flags;
+      header.ChunkSize = srcHeader.ChunkSize;
+      header.ChunkSizeBits = srcHeader.ChunkSizeBits;
+    }
     header.Version = srcHeader.Version;
-    header.ChunkSize = srcHeader.ChunkSize;
-    header.ChunkSizeBits = srcHeader.ChunkSizeBits;
   }
 
+  /* new data streams are compressed only with XPRESS.
+     If source archive uses another method, new streams are stored uncompressed. */
+  const bool useResourceCompression =
+      header.GetMethod() == NMethod::kXPRESS
+      && header.ChunkSizeBits <= NCompress::NXpress::kBlockSizeMax_Log;
+  CResourceEncoder resourceEncoder;
+  resourceEncoder.NumThreads = _numThreads;
+  resourceEncoder.Level = _level;
+  resourceEncoder.ChunkSizeBits = header.ChunkSizeBits;
+
   CMyComPtr<IStreamSetRestriction> setRestriction;
   outSeqStream->QueryInterface(IID_IStreamSetRestriction, (void **)&setRestriction);
   if (setRestriction)
@@ -1697,6 +1959,30 @@ Z7_COM7F_IMF(CHandler::UpdateItems(ISequentialOutStream *outSeqStream, UInt32 nu
           }
         }
         
+        bool isCompressed = false;
+        UInt64 compressedSize = 0;
+        
+        if (needWritePass && useResourceCompression && inSeekStream && size != 0)
+        {
+          // (size) is known from first pass, so we can write the chunk table
+          const HRESULT res = resourceEncoder.Write(inShaStream, size, outStream, curPos, lps, compressedSize);
+          if (res == S_OK)
+          {
+            isCompressed = true;
+            needWritePass = false;
+          }
+          else
+          {
+            if (res != S_FALSE)
+              return res;
+            // we write the stream without compression
+            RINOK(outStream->Seek((Int64)curPos, STREAM_SEEK_SET, NULL))
+            RINOK(outStream->SetSize(curPos))
+            RINOK(InStream_SeekToBegin(inSeekStream))
+            inShaStream->Init();
+          }
+        }
+        
         if (needWritePass)
         {
           RINOK(copyCoder.Interface()->Code(inShaStream, outStream, NULL, NULL, lps))
@@ -1705,10 +1991,10 @@ Z7_COM7F_IMF(CHandler::UpdateItems(ISequentialOutStream *outSeqStream, UInt32 nu
        
         if (size != 0)
         {
-          if (needWritePass)
+          if (needWritePass || isCompressed)
           {
             Byte hash[kHashSize];
-            const UInt64 packSize = offsetBlockSize + size;
+            const UInt64 packSize = isCompressed ? compressedSize : offsetBlockSize + size;
             inShaStream->Final(hash);
             
             index = AddUniqHash(streams.ConstData(), sortedHashes, hash, (int)streams.Size());
@@ -1727,10 +2013,8 @@ Z7_COM7F_IMF(CHandler::UpdateItems(ISequentialOutStream *outSeqStream, UInt32 nu
               s.Resource.Offset = curPos;
               s.Resource.UnpackSize = size;
               s.Resource.Flags = 0;
-              /*
-              if (useResourceCompression)
-              s.Resource.Flags = NResourceFlags::Compressed;
-              */
+              if (isCompressed)
+                s.Resource.Flags = NResourceFlags::kCompressed;
               s.PartNumber = 1;
               s.RefCount = 1;
               memcpy(s.Hash, hash, kHashSize);
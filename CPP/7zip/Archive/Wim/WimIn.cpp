@@ -50,13 +50,11 @@ static bool inline GetLog_val_min_dest(const UInt32 val, unsigned i, unsigned &d
 }
 
 
-HRESULT CUnpacker::UnpackChunk(
-    ISequentialInStream *inStream,
-    unsigned method, unsigned chunkSizeBits,
-    size_t inSize, size_t outSize,
-    ISequentialOutStream *outStream)
+static const unsigned kAdditionalInputSize = 32;
+
+HRESULT CChunkDecoder::Alloc(unsigned method, unsigned chunkSizeBits, bool isPacked)
 {
-  if (inSize == outSize)
+  if (!isPacked)
   {
   }
   else if (method == NMethod::kXPRESS)
@@ -85,70 +83,270 @@ HRESULT CUnpacker::UnpackChunk(
     if (!unpackBuf.Data)
       return E_OUTOFMEMORY;
   }
+
+  if (isPacked)
+  {
+    packBuf.EnsureCapacity(chunkSize + kAdditionalInputSize);
+    if (!packBuf.Data)
+      return E_OUTOFMEMORY;
+  }
+  return S_OK;
+}
+
+
+HRESULT CChunkDecoder::Decode(unsigned method, unsigned chunkSizeBits, size_t inSize, size_t outSize, size_t &unpackedSize)
+{
+  memset(packBuf.Data + inSize, 0xff, kAdditionalInputSize);
+  unpackedSize = 0;
+  HRESULT res;
+
+  if (method == NMethod::kXPRESS)
+  {
+    res = NCompress::NXpress::Decode_WithExceedWrite(packBuf.Data, inSize, unpackBuf.Data, outSize);
+    if (res == S_OK)
+      unpackedSize = outSize;
+  }
+  else if (method == NMethod::kLZX)
+  {
+    res = lzxDecoder->Set_ExternalWindow_DictBits(unpackBuf.Data, chunkSizeBits);
+    if (res != S_OK)
+      return E_NOTIMPL;
+    lzxDecoder->Set_KeepHistoryForNext(false);
+    lzxDecoder->Set_KeepHistory(false);
+    res = lzxDecoder->Code_WithExceedReadWrite(packBuf.Data, inSize, (UInt32)outSize);
+    unpackedSize = lzxDecoder->GetUnpackSize();
+    if (res == S_OK && !lzxDecoder->WasBlockFinished())
+      res = S_FALSE;
+  }
+  else
+  {
+    res = lzmsDecoder->Code(packBuf.Data, inSize, unpackBuf.Data, outSize);
+    unpackedSize = lzmsDecoder->GetUnpackSize();
+  }
+  return res;
+}
+
+
+HRESULT CChunkDecoder::Finish(HRESULT res, size_t unpackedSize, size_t outSize)
+{
+  if (unpackedSize != outSize)
+  {
+    if (res == S_OK)
+      res = S_FALSE;
+    
+    if (unpackedSize > outSize)
+      res = S_FALSE;
+    else
+      memset(unpackBuf.Data + unpackedSize, 0, outSize - unpackedSize);
+  }
+  return res;
+}
+
+
+HRESULT CUnpacker::UnpackChunk(
+    ISequentialInStream *inStream,
+    unsigned method, unsigned chunkSizeBits,
+    size_t inSize, size_t outSize,
+    ISequentialOutStream *outStream)
+{
+  const size_t chunkSize = (size_t)1 << chunkSizeBits;
+  const bool isPacked = (inSize != outSize);
+
+  RINOK(_dec.Alloc(method, chunkSizeBits, isPacked))
   
   HRESULT res = S_FALSE;
   size_t unpackedSize = 0;
   
-  if (inSize == outSize)
+  if (!isPacked)
   {
     unpackedSize = outSize;
-    res = ReadStream(inStream, unpackBuf.Data, &unpackedSize);
+    res = ReadStream(inStream, _dec.unpackBuf.Data, &unpackedSize);
     TotalPacked += unpackedSize;
   }
   else if (inSize < chunkSize)
   {
-    const unsigned kAdditionalInputSize = 32;
-    packBuf.EnsureCapacity(chunkSize + kAdditionalInputSize);
-    if (!packBuf.Data)
-      return E_OUTOFMEMORY;
-    
-    RINOK(ReadStream_FALSE(inStream, packBuf.Data, inSize))
-    memset(packBuf.Data + inSize, 0xff, kAdditionalInputSize);
-
+    RINOK(ReadStream_FALSE(inStream, _dec.packBuf.Data, inSize))
     TotalPacked += inSize;
-    
-    if (method == NMethod::kXPRESS)
+    res = _dec.Decode(method, chunkSizeBits, inSize, outSize, unpackedSize);
+    if (res != S_OK && res != S_FALSE)
+      return res;
+  }
+  
+  res = _dec.Finish(res, unpackedSize, outSize);
+  
+  if (outStream)
+  {
+    RINOK(WriteStream(outStream, _dec.unpackBuf.Data, outSize))
+  }
+  
+  return res;
+}
+
+
+#ifndef Z7_ST
+
+static const unsigned k_NumThreads_MAX = 32;
+// the size of unpacked data for one thread in one pass
+static const unsigned k_ThreadOutSize_Log = 20;
+
+void CUnpackThread::Execute()
+{
+  for (unsigned i = 0; i < NumChunks; i++)
+  {
+    CUnpackChunkInfo &c = Chunks[i];
+    if (c.ReadError)
+      continue;
+    Byte *dest = OutBuf.Data + ((size_t)i << ChunkSizeBits);
+    if (c.PackSize == c.OutSize)
     {
-      res = NCompress::NXpress::Decode_WithExceedWrite(packBuf.Data, inSize, unpackBuf.Data, outSize);
+      memcpy(dest, PackBuf + c.PackOffset, c.PackRead);
+      c.Result = S_OK;
+      if (c.PackRead != c.OutSize)
+      {
+        memset(dest + c.PackRead, 0, c.OutSize - c.PackRead);
+        c.Result = S_FALSE;
+      }
+      continue;
+    }
+    HRESULT res;
+    try
+    {
+      res = Dec.Alloc(Method, ChunkSizeBits, true);
       if (res == S_OK)
-        unpackedSize = outSize;
+      {
+        memcpy(Dec.packBuf.Data, PackBuf + c.PackOffset, c.PackSize);
+        size_t unpackedSize = 0;
+        res = Dec.Decode(Method, ChunkSizeBits, c.PackSize, c.OutSize, unpackedSize);
+        if (res == S_OK || res == S_FALSE)
+        {
+          res = Dec.Finish(res, unpackedSize, c.OutSize);
+          memcpy(dest, Dec.unpackBuf.Data, c.OutSize);
+        }
+      }
     }
-    else if (method == NMethod::kLZX)
+    catch(...)
     {
-      res = lzxDecoder->Set_ExternalWindow_DictBits(unpackBuf.Data, chunkSizeBits);
-      if (res != S_OK)
-        return E_NOTIMPL;
-      lzxDecoder->Set_KeepHistoryForNext(false);
-      lzxDecoder->Set_KeepHistory(false);
-      res = lzxDecoder->Code_WithExceedReadWrite(packBuf.Data, inSize, (UInt32)outSize);
-      unpackedSize = lzxDecoder->GetUnpackSize();
-      if (res == S_OK && !lzxDecoder->WasBlockFinished())
-        res = S_FALSE;
+      res = E_OUTOFMEMORY;
     }
-    else
+    c.Result = res;
+  }
+}
+
+
+/* It unpacks the chunks from (_mtChunks) in parallel threads.
+   The chunks are written to (outStream) in original order,
+   and the errors are reported in the same way as in single-thread code. */
+
+HRESULT CUnpacker::UnpackChunks_Mt(
+    IInStream *inStream,
+    unsigned method, unsigned chunkSizeBits,
+    ISequentialOutStream *outStream,
+    ICompressProgressInfo *progress,
+    UInt64 &offset, UInt64 &outProcessed)
+{
+  const unsigned numChunks = _mtChunks.Size();
+  size_t packAvail;
+  {
+    const CUnpackChunkInfo &last = _mtChunks.Back();
+    const size_t packSize = last.PackOffset + last.PackSize;
+    _mtPackBuf.AllocAtLeast(packSize);
+    packAvail = packSize;
+    RINOK(ReadStream(inStream, _mtPackBuf, &packAvail))
+  }
+
+  FOR_VECTOR (k, _mtChunks)
+  {
+    CUnpackChunkInfo &c = _mtChunks[k];
+    size_t avail = 0;
+    if (packAvail > c.PackOffset)
+      avail = MyMin(packAvail - c.PackOffset, c.PackSize);
+    c.PackRead = avail;
+    c.ReadError = (c.PackSize != c.OutSize && avail != c.PackSize);
+    c.Result = S_OK;
+  }
+
+  unsigned numThreads = NumThreads;
+  if (numThreads > k_NumThreads_MAX)
+    numThreads = k_NumThreads_MAX;
+  if (numThreads > numChunks)
+    numThreads = numChunks;
+  const unsigned numChunksInThread = (numChunks + numThreads - 1) / numThreads;
+  numThreads = (numChunks + numChunksInThread - 1) / numChunksInThread;
+
+  while (_threads.Size() < numThreads)
+  {
+    CUnpackThread &t = _threads.AddNew();
+    const WRes wres = t.Create();
+    if (wres != 0)
     {
-      res = lzmsDecoder->Code(packBuf.Data, inSize, unpackBuf.Data, outSize);
-      unpackedSize = lzmsDecoder->GetUnpackSize();
+      _threads.DeleteBack();
+      return HRESULT_FROM_WIN32(wres);
     }
   }
-  
-  if (unpackedSize != outSize)
+
+  unsigned t;
+  for (t = 0; t < numThreads; t++)
   {
-    if (res == S_OK)
-      res = S_FALSE;
-    
-    if (unpackedSize > outSize)
-      res = S_FALSE;
-    else
-      memset(unpackBuf.Data + unpackedSize, 0, outSize - unpackedSize);
+    CUnpackThread &thread = _threads[t];
+    const unsigned first = t * numChunksInThread;
+    thread.Chunks = &_mtChunks[first];
+    thread.NumChunks = MyMin(numChunksInThread, numChunks - first);
+    thread.PackBuf = _mtPackBuf;
+    thread.Method = method;
+    thread.ChunkSizeBits = chunkSizeBits;
+    thread.OutBuf.EnsureCapacity((size_t)thread.NumChunks << chunkSizeBits);
+    if (!thread.OutBuf.Data)
+      return E_OUTOFMEMORY;
   }
-  
-  if (outStream)
+
+  HRESULT res = S_OK;
+  for (t = 0; t < numThreads; t++)
   {
-    RINOK(WriteStream(outStream, unpackBuf.Data, outSize))
+    const WRes wres = _threads[t].Start();
+    if (wres != 0)
+    {
+      res = HRESULT_FROM_WIN32(wres);
+      break;
+    }
   }
-  
-  return res;
+  for (unsigned k = 0; k < t; k++)
+    _threads[k].WaitExecuteFinish();
+  RINOK(res)
+
+  for (unsigned i = 0; i < numChunks; i++)
+  {
+    const CUnpackChunkInfo &c = _mtChunks[i];
+    if (progress)
+    {
+      RINOK(progress->SetRatioInfo(&offset, &outProcessed))
+    }
+    if (c.ReadError)
+      return S_FALSE;
+    TotalPacked += c.PackRead;
+    if (c.Result != S_OK && c.Result != S_FALSE)
+      return c.Result;
+    if (outStream)
+    {
+      const CUnpackThread &thread = _threads[i / numChunksInThread];
+      RINOK(WriteStream(outStream, thread.OutBuf.Data + ((size_t)(i % numChunksInThread) << chunkSizeBits), c.OutSize))
+    }
+    RINOK(c.Result)
+    outProcessed += c.OutSize;
+    offset += c.PackSize;
+  }
+  return S_OK;
+}
+
+#endif
+
+
+static UInt64 GetChunkEnd(const Byte *sizes, size_t index, size_t numChunks,
+    unsigned entrySizeShifts, UInt64 packDataSize)
+{
+  if (index + 1 >= numChunks)
+    return packDataSize;
+  const Byte *p = sizes + (index << entrySizeShifts);
+  return (entrySizeShifts == 2) ? Get32(p): Get64(p);
 }
 
 
@@ -220,7 +418,7 @@ HRESULT CUnpacker::Unpack2(
       size_t cur = chunkSize - offsetInChunk;
       if (cur > rem)
         cur = (size_t)rem;
-      RINOK(WriteStream(outStream, unpackBuf.Data + offsetInChunk, cur))
+      RINOK(WriteStream(outStream, _dec.unpackBuf.Data + offsetInChunk, cur))
       outProcessed += cur;
       rem -= cur;
       offsetInChunk = 0;
@@ -265,7 +463,7 @@ HRESULT CUnpacker::Unpack2(
       if (cur > rem)
         cur = (size_t)rem;
       
-      RINOK(WriteStream(outStream, unpackBuf.Data + offsetInChunk, cur))
+      RINOK(WriteStream(outStream, _dec.unpackBuf.Data + offsetInChunk, cur))
       
       if (progress)
       {
@@ -322,15 +520,58 @@ HRESULT CUnpacker::Unpack2(
   UInt64 outProcessed = 0;
   UInt64 offset = 0;
   
-  for (size_t i = 0; i < numChunks; i++)
+  const unsigned method = header.GetMethod();
+
+ #ifndef Z7_ST
+  size_t numChunks_Mt_Max = 0;
+  if (NumThreads > 1)
   {
-    UInt64 nextOffset = packDataSize;
-    
-    if (i + 1 < numChunks)
+    const unsigned numThreads = MyMin(NumThreads, (UInt32)k_NumThreads_MAX);
+    size_t numChunksInThread = 1;
+    if (chunkSizeBits < k_ThreadOutSize_Log)
+      numChunksInThread = (size_t)1 << (k_ThreadOutSize_Log - chunkSizeBits);
+    numChunks_Mt_Max = numChunksInThread * numThreads;
+  }
+ #endif
+  
+  for (size_t i = 0; i < numChunks;)
+  {
+   #ifndef Z7_ST
+    if (numChunks_Mt_Max > 1 && numChunks - i > 1)
     {
-      const Byte *p = (const Byte *)sizesBuf + (i << entrySizeShifts);
-      nextOffset = (entrySizeShifts == 2) ? Get32(p): Get64(p);
+      // we collect the chunks that can be unpacked in parallel
+      const size_t chunkSize = (size_t)1 << chunkSizeBits;
+      _mtChunks.Clear();
+      UInt64 end = offset;
+      UInt64 outPos = outProcessed;
+      for (size_t k = i; k < numChunks && _mtChunks.Size() < numChunks_Mt_Max; k++)
+      {
+        const UInt64 next = GetChunkEnd(sizesBuf, k, numChunks, entrySizeShifts, packDataSize);
+        if (next < end || next - end > chunkSize)
+          break;
+        CUnpackChunkInfo c;
+        c.PackOffset = (size_t)(end - offset);
+        c.PackSize = (size_t)(next - end);
+        c.OutSize = chunkSize;
+        if (c.OutSize > unpackSize - outPos)
+          c.OutSize = (size_t)(unpackSize - outPos);
+        if (c.PackSize != c.OutSize && c.PackSize >= chunkSize)
+          break;
+        _mtChunks.Add(c);
+        end = next;
+        outPos += c.OutSize;
+      }
+      if (_mtChunks.Size() > 1)
+      {
+        RINOK(InStream_SeekSet(inStream, baseOffset + offset))
+        RINOK(UnpackChunks_Mt(inStream, method, chunkSizeBits, outStream, progress, offset, outProcessed))
+        i += _mtChunks.Size();
+        continue;
+      }
     }
+   #endif
+
+    const UInt64 nextOffset = GetChunkEnd(sizesBuf, i, numChunks, entrySizeShifts, packDataSize);
     
     if (nextOffset < offset)
       return S_FALSE;
@@ -352,10 +593,11 @@ HRESULT CUnpacker::Unpack2(
     if (outSize > rem)
       outSize = (size_t)rem;
 
-    RINOK(UnpackChunk(inStream, header.GetMethod(), chunkSizeBits, inSize, outSize, outStream))
+    RINOK(UnpackChunk(inStream, method, chunkSizeBits, inSize, outSize, outStream))
 
     outProcessed += outSize;
     offset = nextOffset;
+    i++;
   }
   
   return S_OK;
@@ -15,6 +15,10 @@
 #include "../../Compress/LzmsDecoder.h"
 #include "../../Compress/LzxDecoder.h"
 
+#ifndef Z7_ST
+#include "../../Common/VirtThread.h"
+#endif
+
 #include "../IArchive.h"
 
 namespace NArchive {
@@ -267,7 +271,8 @@ struct CHeader
   CResource MetadataResource;
   CResource IntegrityResource;
 
-  void SetDefaultFields(bool useLZX);
+  // (method) is NMethod::* value or 0 for uncompressed archive
+  void SetDefaultFields(unsigned method);
 
   void WriteTo(Byte *p) const;
   HRESULT Parse(const Byte *p, UInt64 &phySize);
@@ -596,21 +601,85 @@ struct CMidBuf
 };
 
 
-class CUnpacker
+class CChunkDecoder
 {
-  CMyComPtr2<ICompressCoder, NCompress::CCopyCoder> copyCoder;
   CMyUniquePtr<NCompress::NLzx::CDecoder> lzxDecoder;
   CMyUniquePtr<NCompress::NLzms::CDecoder> lzmsDecoder;
-
-  CByteBuffer sizesBuf;
-
+public:
   CMidBuf packBuf;
   CMidBuf unpackBuf;
 
+  // it allocates buffers and creates the decoder for (method), if (isPacked)
+  HRESULT Alloc(unsigned method, unsigned chunkSizeBits, bool isPacked);
+  // it decodes (inSize) bytes from (packBuf) to (unpackBuf). (inSize < chunkSize)
+  HRESULT Decode(unsigned method, unsigned chunkSizeBits, size_t inSize, size_t outSize, size_t &unpackedSize);
+  // it checks (unpackedSize) and fills the tail of (unpackBuf) with zeros
+  HRESULT Finish(HRESULT res, size_t unpackedSize, size_t outSize);
+};
+
+
+#ifndef Z7_ST
+
+struct CUnpackChunkInfo
+{
+  size_t PackOffset; // offset in buffer of packed data
+  size_t PackSize;
+  size_t OutSize;
+  size_t PackRead;   // the number of bytes that were read for this chunk
+  bool ReadError;    // the packed chunk was not read completely
+  HRESULT Result;
+};
+
+class CUnpackThread Z7_final: public CVirtThread
+{
+public:
+  CChunkDecoder Dec;
+  CMidBuf OutBuf;
+  const Byte *PackBuf;
+  CUnpackChunkInfo *Chunks;
+  unsigned NumChunks;
+  unsigned Method;
+  unsigned ChunkSizeBits;
+
+  ~CUnpackThread() Z7_DESTRUCTOR_override
+  {
+    /* WaitThreadFinish() will be called in ~CVirtThread().
+       But we need WaitThreadFinish() call before
+       destructors of this class members.
+    */
+    CVirtThread::WaitThreadFinish();
+  }
+private:
+  virtual void Execute() Z7_override;
+};
+
+#endif
+
+
+class CUnpacker
+{
+  CMyComPtr2<ICompressCoder, NCompress::CCopyCoder> copyCoder;
+  CChunkDecoder _dec;
+
+  CByteBuffer sizesBuf;
+
   // solid resource
   int _solidIndex;
   size_t _unpackedChunkIndex;
 
+ #ifndef Z7_ST
+  CObjectVector<CUnpackThread> _threads;
+  CRecordVector<CUnpackChunkInfo> _mtChunks;
+  CByteBuffer _mtPackBuf;
+
+  HRESULT UnpackChunks_Mt(
+      IInStream *inStream,
+      unsigned method, unsigned chunkSizeBits,
+      ISequentialOutStream *outStream,
+      ICompressProgressInfo *progress,
+      UInt64 &offset, UInt64 &outProcessed);
+ #endif
+
   HRESULT UnpackChunk(
       ISequentialInStream *inStream,
       unsigned method, unsigned chunkSizeBits,
@@ -627,12 +696,13 @@ class CUnpacker
 
 public:
   UInt64 TotalPacked;
+  UInt32 NumThreads;
 
   CUnpacker():
-      lzmsDecoder(NULL),
       _solidIndex(-1),
       _unpackedChunkIndex(0),
-      TotalPacked(0)
+      TotalPacked(0),
+      NumThreads(1)
       {}
 
   HRESULT Unpack(
@@ -865,8 +865,11 @@ class CZipDecoder
 
   CLzmaDecoder *lzmaDecoderSpec;
 public:
+  bool CheckCrc;
+
   CZipDecoder():
-      lzmaDecoderSpec(NULL)
+      lzmaDecoderSpec(NULL),
+      CheckCrc(true)
     {}
 
   HRESULT Decode(
@@ -985,7 +988,8 @@ HRESULT CZipDecoder::Decode(
   CFilterCoder::C_InStream_Releaser inStreamReleaser;
   CFilterCoder::C_Filter_Releaser filterReleaser;
 
-  bool needCRC = true;
+  // (-mcrc-) disables the CRC check. Then stored items can be copied by kernel
+  bool needCRC = CheckCrc;
   bool wzAesMode = false;
   bool pkAesMode = false;
 
@@ -1009,7 +1013,7 @@ HRESULT CZipDecoder::Decode(
         return S_OK;
       }
       wzAesMode = true;
-      needCRC = aesField.NeedCrc();
+      needCRC = CheckCrc && aesField.NeedCrc();
     }
   }
 
@@ -1578,6 +1582,7 @@ Z7_COM7F_IMF(CHandler::Extract(const UInt32 *indices, UInt32 numItems,
   RINOK(extractCallback->SetTotal(total))
 
   CZipDecoder myDecoder;
+  myDecoder.CheckCrc = _checkCrc;
   UInt64 cur_Unpacked, cur_Packed;
   
   CMyComPtr2_Create<ICompressProgressInfo, CLocalProgress> lps;
@@ -580,6 +580,10 @@ Z7_COM7F_IMF(CHandler::SetProperties(const wchar_t * const *names, const PROPVAR
     {
       RINOK(PROPVARIANT_to_bool(prop, _force_OpenSeq))
     }
+    else if (name.IsEqualTo("crc"))
+    {
+      RINOK(PROPVARIANT_to_bool(prop, _checkCrc))
+    }
     else
     {
       if (name.IsEqualTo_Ascii_NoCase("m") && prop.vt == VT_UI4)
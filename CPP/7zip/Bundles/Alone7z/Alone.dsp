@@ -180,6 +180,22 @@ SOURCE=..\..\UI\Console\HashCon.h
 # End Source File
 # Begin Source File
 
+SOURCE=..\..\UI\Console\IoBenchCon.cpp
+# End Source File
+# Begin Source File
+
+SOURCE=..\..\UI\Console\IoBenchCon.h
+# End Source File
+# Begin Source File
+
+SOURCE=..\..\UI\Console\JsonProgress.cpp
+# End Source File
+# Begin Source File
+
+SOURCE=..\..\UI\Console\JsonProgress.h
+# End Source File
+# Begin Source File
+
 SOURCE=..\..\UI\Console\List.cpp
 # End Source File
 # Begin Source File
@@ -234,6 +234,7 @@ COMPRESS_OBJS = \
   $O\RarCodecsRegister.obj \
   $O\ShrinkDecoder.obj \
   $O\XpressDecoder.obj \
+  $O\XpressEncoder.obj \
   $O\XzDecoder.obj \
   $O\XzEncoder.obj \
   $O\ZlibDecoder.obj \
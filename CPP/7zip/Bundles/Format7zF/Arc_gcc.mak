@@ -273,6 +273,7 @@ COMPRESS_OBJS = \
   $O/QuantumDecoder.o \
   $O/ShrinkDecoder.o \
   $O/XpressDecoder.o \
+  $O/XpressEncoder.o \
   $O/XzDecoder.o \
   $O/XzEncoder.o \
   $O/ZlibDecoder.o \
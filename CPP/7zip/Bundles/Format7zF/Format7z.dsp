@@ -1079,6 +1079,24 @@ SOURCE=..\..\Compress\XpressDecoder.h
 # End Source File
 # Begin Source File
 
+SOURCE=..\..\Compress\XpressEncoder.cpp
+
+!IF  "$(CFG)" == "7z - Win32 Release"
+
+# ADD CPP /O2
+# SUBTRACT CPP /YX /Yc /Yu
+
+!ELSEIF  "$(CFG)" == "7z - Win32 Debug"
+
+!ENDIF 
+
+# End Source File
+# Begin Source File
+
+SOURCE=..\..\Compress\XpressEncoder.h
+# End Source File
+# Begin Source File
+
 SOURCE=..\..\Compress\XzDecoder.cpp
 # End Source File
 # Begin Source File
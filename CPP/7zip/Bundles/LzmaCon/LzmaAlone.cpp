@@ -452,7 +452,8 @@ static int main2(int numArgs, const char *args[])
     if (params.Size() != paramIndex)
       IncorrectCommand();
   
-    HRESULT res = BenchCon(props2, numIterations, stdout);
+    CBenchConOptions benchOptions;
+    HRESULT res = BenchCon(props2, numIterations, stdout, benchOptions);
     
     if (res == S_OK)
       return 0;
@@ -789,18 +789,81 @@ Z7_COM7F_IMF(CInFileStream::ReloadProps())
 #endif
 
 
+Z7_COM7F_IMF(CInFileStream::KernelCopy_GetFd(Int32 *fd, UInt64 *limit, Int32 *needData))
+{
+  *fd = -1;
+  *limit = 0;
+  *needData = 0;
+ #ifdef Z7_FILE_STREAMS_USE_WIN_FILE
+  return S_FALSE;
+ #else
+  *fd = File.GetHandle();
+  *limit = (UInt64)(Int64)-1;
+  return S_OK;
+ #endif
+}
+
+Z7_COM7F_IMF(CInFileStream::KernelCopy_Processed(const void * /* data */, UInt32 /* size */))
+{
+  // file offset was changed by kernel already
+  return S_OK;
+}
+
+
 
 
 //////////////////////////
 // COutFileStream
 
+#ifdef Z7_IO_URING
+
+HRESULT COutFileStream::FlushBatchBuf()
+{
+  _batchMode = false;
+  if (_batchPos == 0)
+    return S_OK;
+  const size_t size = _batchPos;
+  _batchPos = 0;
+  return ConvertBoolToHRESULT(File.WriteFull(_batchBuf, size));
+}
+
+#endif
+
 HRESULT COutFileStream::Close()
 {
+ #ifdef Z7_IO_URING
+  if (_batchMode)
+  {
+    _batchMode = false;
+    const size_t size = _batchPos;
+    _batchPos = 0;
+    return ConvertBoolToHRESULT(File.Close_Deferred(*IoBatch, _batchBuf, size));
+  }
+ #endif
   return ConvertBoolToHRESULT(File.Close());
 }
 
 Z7_COM7F_IMF(COutFileStream::Write(const void *data, UInt32 size, UInt32 *processedSize))
 {
+ #ifdef Z7_IO_URING
+  if (_batchMode)
+  {
+    if (size <= IoBatch->MaxFileSize - _batchPos)
+    {
+      if (_batchBuf.Size() < IoBatch->MaxFileSize)
+        _batchBuf.Alloc(IoBatch->MaxFileSize);
+      memcpy(_batchBuf + _batchPos, data, size);
+      _batchPos += size;
+      ProcessedSize += size;
+      if (processedSize)
+        *processedSize = size;
+      return S_OK;
+    }
+    // the file is not small. So we write it directly.
+    RINOK(FlushBatchBuf())
+  }
+ #endif
+
   #ifdef Z7_FILE_STREAMS_USE_WIN_FILE
 
   UInt32 realProcessedSize;
@@ -830,6 +893,10 @@ Z7_COM7F_IMF(COutFileStream::Seek(Int64 offset, UInt32 seekOrigin, UInt64 *newPo
 {
   if (seekOrigin >= 3)
     return STG_E_INVALIDFUNCTION;
+
+ #ifdef Z7_IO_URING
+  RINOK(FlushBatchBuf())
+ #endif
   
   #ifdef Z7_FILE_STREAMS_USE_WIN_FILE
 
@@ -853,14 +920,109 @@ Z7_COM7F_IMF(COutFileStream::Seek(Int64 offset, UInt32 seekOrigin, UInt64 *newPo
 
 Z7_COM7F_IMF(COutFileStream::SetSize(UInt64 newSize))
 {
+ #ifdef Z7_IO_URING
+  RINOK(FlushBatchBuf())
+ #endif
   return ConvertBoolToHRESULT(File.SetLength_KeepPosition(newSize));
 }
 
 HRESULT COutFileStream::GetSize(UInt64 *size)
 {
+ #ifdef Z7_IO_URING
+  RINOK(FlushBatchBuf())
+ #endif
   return ConvertBoolToHRESULT(File.GetLength(*size));
 }
 
+/*
+WriteHole() extends the file with seek and SetLength() instead of writing zeros.
+So the OS can create sparse region in file.
+We can do it only at the end of file, because
+old data of existing file in that region must be replaced by zeros.
+In Windows the file is marked as sparse (FSCTL_SET_SPARSE) at first WriteHole() call.
+If the file system doesn't support sparse files, WriteHole() returns S_FALSE,
+and the caller writes zeros.
+*/
+
+Z7_COM7F_IMF(COutFileStream::WriteHole(UInt64 size))
+{
+  if (size == 0)
+    return S_OK;
+ #ifdef Z7_IO_URING
+  RINOK(FlushBatchBuf())
+ #endif
+  UInt64 pos, fileSize;
+  RINOK(Seek(0, STREAM_SEEK_CUR, &pos))
+  RINOK(GetSize(&fileSize))
+  if (fileSize > pos)
+    return S_FALSE;
+  const UInt64 newPos = pos + size;
+  if (newPos < pos)
+    return E_INVALIDARG;
+ #ifdef Z7_FILE_STREAMS_USE_WIN_FILE
+  if (!_isSparse)
+  {
+    if (_sparseError)
+      return S_FALSE;
+    if (!File.SetSparse())
+    {
+      _sparseError = true;
+      return S_FALSE;
+    }
+    _isSparse = true;
+  }
+ #endif
+  if (!File.SetLength_KeepPosition(newPos))
+    return GetLastError_HRESULT();
+  RINOK(Seek((Int64)newPos, STREAM_SEEK_SET, NULL))
+  ProcessedSize += size;
+  return S_OK;
+}
+
+Z7_COM7F_IMF(COutFileStream::KernelCopy_GetFd(Int32 *fd, UInt64 *limit, Int32 *needData))
+{
+  *fd = -1;
+  *limit = 0;
+  *needData = 0;
+ #ifdef Z7_FILE_STREAMS_USE_WIN_FILE
+  return S_FALSE;
+ #else
+ #ifdef Z7_IO_URING
+  // the caller copies big data, so we don't need batch mode for that file
+  RINOK(FlushBatchBuf())
+ #endif
+  *fd = File.GetHandle();
+  *limit = (UInt64)(Int64)-1;
+  return S_OK;
+ #endif
+}
+
+Z7_COM7F_IMF(COutFileStream::KernelCopy_Processed(const void * /* data */, UInt32 size))
+{
+  ProcessedSize += size;
+  return S_OK;
+}
+
+Z7_COM7F_IMF(CStdOutFileStream::KernelCopy_GetFd(Int32 *fd, UInt64 *limit, Int32 *needData))
+{
+  *fd = -1;
+  *limit = 0;
+  *needData = 0;
+ #ifdef _WIN32
+  return S_FALSE;
+ #else
+  *fd = 1;
+  *limit = (UInt64)(Int64)-1;
+  return S_OK;
+ #endif
+}
+
+Z7_COM7F_IMF(CStdOutFileStream::KernelCopy_Processed(const void * /* data */, UInt32 size))
+{
+  _size += size;
+  return S_OK;
+}
+
 #ifdef UNDER_CE
 
 Z7_COM7F_IMF(CStdOutFileStream::Write(const void *data, UInt32 size, UInt32 *processedSize))
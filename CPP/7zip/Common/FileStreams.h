@@ -29,13 +29,14 @@ Z7_PURE_INTERFACES_END
 
 
 /*
-Z7_CLASS_IMP_COM_5(
+Z7_CLASS_IMP_COM_6(
   CInFileStream
   , IInStream
   , IStreamGetSize
   , IStreamGetProps
   , IStreamGetProps2
   , IStreamGetProp
+  , IStreamKernelCopy
 )
 */
 Z7_class_final(CInFileStream) :
@@ -44,15 +45,17 @@ Z7_class_final(CInFileStream) :
   public IStreamGetProps,
   public IStreamGetProps2,
   public IStreamGetProp,
+  public IStreamKernelCopy,
   public CMyUnknownImp
 {
-  Z7_COM_UNKNOWN_IMP_6(
+  Z7_COM_UNKNOWN_IMP_7(
       IInStream,
       ISequentialInStream,
       IStreamGetSize,
       IStreamGetProps,
       IStreamGetProps2,
-      IStreamGetProp)
+      IStreamGetProp,
+      IStreamKernelCopy)
 
   Z7_IFACE_COM7_IMP(ISequentialInStream)
   Z7_IFACE_COM7_IMP(IInStream)
@@ -63,6 +66,8 @@ private:
 public:
   Z7_IFACE_COM7_IMP(IStreamGetProps2)
   Z7_IFACE_COM7_IMP(IStreamGetProp)
+private:
+  Z7_IFACE_COM7_IMP(IStreamKernelCopy)
 
 private:
   NWindows::NFile::NIO::CInFile File;
@@ -125,6 +130,13 @@ public:
     _info_WasLoaded = false;
     return File.OpenShared(fileName, shareForWrite);
   }
+
+ #ifdef Z7_IO_URING
+  void Close_Deferred(NWindows::NFile::NIO::CIoBatch &batch, const AString &path)
+  {
+    File.Close_Deferred(batch, path);
+  }
+ #endif
 };
 
 // bool CreateStdInStream(CMyComPtr<ISequentialInStream> &str);
@@ -136,36 +148,76 @@ Z7_CLASS_IMP_NOQIB_1(
 };
 
 
-Z7_CLASS_IMP_COM_1(
+Z7_CLASS_IMP_COM_3(
   COutFileStream
   , IOutStream
+  , IStreamKernelCopy
+  , IOutStreamWriteHole
 )
   Z7_IFACE_COM7_IMP(ISequentialOutStream)
+
+ #ifdef Z7_IO_URING
+  bool _batchMode;
+  size_t _batchPos;
+  CByteBuffer _batchBuf;
+  HRESULT FlushBatchBuf();
+  void StartBatch(bool enable) { _batchMode = (enable && IoBatch); _batchPos = 0; }
+ #else
+  void StartBatch(bool) {}
+ #endif
+ #ifdef Z7_FILE_STREAMS_USE_WIN_FILE
+  // NTFS allocates the clusters for extended region, if the file is not marked as sparse
+  bool _isSparse;
+  bool _sparseError;
+  void InitSparse() { _isSparse = false; _sparseError = false; }
+ #else
+  void InitSparse() {}
+ #endif
 public:
 
   NWindows::NFile::NIO::COutFile File;
 
+ #ifdef Z7_IO_URING
+  /* if (IoBatch) is set, the data of small new file is collected in memory,
+     and then the data is written and the file is closed by IoBatch in Close().
+     The errors of these operations are reported later by IoBatch. */
+  NWindows::NFile::NIO::CIoBatch *IoBatch;
+  COutFileStream(): _batchMode(false), _batchPos(0), IoBatch(NULL) {}
+  ~COutFileStream() { FlushBatchBuf(); }
+ #endif
+ #ifdef Z7_FILE_STREAMS_USE_WIN_FILE
+  COutFileStream() { InitSparse(); }
+ #endif
+
   bool Create_NEW(CFSTR fileName)
   {
     ProcessedSize = 0;
+    StartBatch(true);
+    InitSparse();
     return File.Create_NEW(fileName);
   }
 
   bool Create_ALWAYS(CFSTR fileName)
   {
     ProcessedSize = 0;
+    StartBatch(true);
+    InitSparse();
     return File.Create_ALWAYS(fileName);
   }
 
   bool Open_EXISTING(CFSTR fileName)
   {
     ProcessedSize = 0;
+    StartBatch(false);
+    InitSparse();
     return File.Open_EXISTING(fileName);
   }
 
   bool Create_ALWAYS_or_Open_ALWAYS(CFSTR fileName, bool createAlways)
   {
     ProcessedSize = 0;
+    StartBatch(createAlways);
+    InitSparse();
     return File.Create_ALWAYS_or_Open_ALWAYS(fileName, createAlways);
   }
 
@@ -192,9 +244,10 @@ public:
 };
 
 
-Z7_CLASS_IMP_NOQIB_1(
+Z7_CLASS_IMP_NOQIB_2(
   CStdOutFileStream
   , ISequentialOutStream
+  , IStreamKernelCopy
 )
   UInt64 _size;
 public:
@@ -27,6 +27,31 @@ Z7_COM7F_IMF(CLimitedSequentialInStream::Read(void *data, UInt32 size, UInt32 *p
   return result;
 }
 
+Z7_COM7F_IMF(CLimitedSequentialInStream::KernelCopy_GetFd(Int32 *fd, UInt64 *limit, Int32 *needData))
+{
+  *fd = -1;
+  *limit = 0;
+  *needData = 0;
+  Z7_DECL_CMyComPtr_QI_FROM(IStreamKernelCopy, kernelCopy, _stream)
+  if (!kernelCopy)
+    return S_FALSE;
+  RINOK(kernelCopy->KernelCopy_GetFd(fd, limit, needData))
+  const UInt64 rem = _size - _pos;
+  if (*limit > rem)
+    *limit = rem;
+  return S_OK;
+}
+
+Z7_COM7F_IMF(CLimitedSequentialInStream::KernelCopy_Processed(const void *data, UInt32 size))
+{
+  _pos += size;
+  Z7_DECL_CMyComPtr_QI_FROM(IStreamKernelCopy, kernelCopy, _stream)
+  if (!kernelCopy)
+    return E_FAIL;
+  return kernelCopy->KernelCopy_Processed(data, size);
+}
+
+
 Z7_COM7F_IMF(CLimitedInStream::Read(void *data, UInt32 size, UInt32 *processedSize))
 {
   if (processedSize)
@@ -263,6 +288,34 @@ Z7_COM7F_IMF(CLimitedSequentialOutStream::Write(const void *data, UInt32 size, U
 }
 
 
+Z7_COM7F_IMF(CLimitedSequentialOutStream::KernelCopy_GetFd(Int32 *fd, UInt64 *limit, Int32 *needData))
+{
+  *fd = -1;
+  *limit = 0;
+  *needData = 0;
+  if (!_stream || _size == 0)
+    return S_FALSE;
+  Z7_DECL_CMyComPtr_QI_FROM(IStreamKernelCopy, kernelCopy, _stream)
+  if (!kernelCopy)
+    return S_FALSE;
+  RINOK(kernelCopy->KernelCopy_GetFd(fd, limit, needData))
+  if (*limit > _size)
+    *limit = _size;
+  return S_OK;
+}
+
+Z7_COM7F_IMF(CLimitedSequentialOutStream::KernelCopy_Processed(const void *data, UInt32 size))
+{
+  if (size > _size)
+    return E_FAIL;
+  _size -= size;
+  Z7_DECL_CMyComPtr_QI_FROM(IStreamKernelCopy, kernelCopy, _stream)
+  if (!kernelCopy)
+    return E_FAIL;
+  return kernelCopy->KernelCopy_Processed(data, size);
+}
+
+
 Z7_COM7F_IMF(CTailInStream::Read(void *data, UInt32 size, UInt32 *processedSize))
 {
   UInt32 cur;
@@ -10,9 +10,10 @@
 
 #include "StreamUtils.h"
 
-Z7_CLASS_IMP_COM_1(
+Z7_CLASS_IMP_COM_2(
   CLimitedSequentialInStream
   , ISequentialInStream
+  , IStreamKernelCopy
 )
   CMyComPtr<ISequentialInStream> _stream;
   UInt64 _size;
@@ -123,9 +124,10 @@ public:
 
 
 
-Z7_CLASS_IMP_COM_1(
+Z7_CLASS_IMP_COM_2(
   CLimitedSequentialOutStream
   , ISequentialOutStream
+  , IStreamKernelCopy
 )
   CMyComPtr<ISequentialOutStream> _stream;
   UInt64 _size;
@@ -428,12 +428,18 @@ static const CNameToPropID g_NameToPropID[] =
   { VT_UI8, "memuse" },
   { VT_UI8, "aff" },
   { VT_UI4, "offset" },
-  { VT_UI4, "zhb" }
+  { VT_UI4, "zhb" },
   /*
   , { VT_UI4, "tgn" }, // kNumThreadGroups
   , { VT_UI4, "tgi" }, // kThreadGroup
   , { VT_UI8, "tga" }, // kAffinityInGroup
   */
+  // these properties have no names. Empty name is found as kDefaultProp
+  { VT_UI4, "" }, // kNumThreadGroups
+  { VT_UI4, "" }, // kThreadGroup
+  { VT_UI8, "" }, // kAffinityInGroup
+  { VT_UI4, "mfhb" }, // kMtNumHashBlocks
+  { VT_UI4, "mfbb" }  // kMtNumBtBlocks
   /*
   ,
   // { VT_UI4, "zhc" },
@@ -4,8 +4,15 @@
 
 #include "../../Common/MyCom.h"
 
+#include "../../Windows/TimeUtils.h"
+
 #include "StreamBinder.h"
 
+#define WAIT_TIME_BEGIN \
+  const UInt64 waitStartTime = StatMode ? NWindows::NTime::GetMonotonicTime() : 0;
+#define WAIT_TIME_END(waitTime) \
+  if (StatMode) waitTime += NWindows::NTime::GetMonotonicTime() - waitStartTime;
+
 Z7_CLASS_IMP_COM_1(
   CBinderInStream
   , ISequentialInStream
@@ -56,7 +63,30 @@ HRESULT CStreamBinder::Create_ReInit()
   _bufSize = 0;
   _buf = NULL;
   ProcessedSize = 0;
+  ReadWaitTime = 0;
+  WriteWaitTime = 0;
   // WritingWasCut = false;
+
+  _ringSize = 0;
+  if (RingSize != 0)
+  {
+    // (_writeCount - _readCount) must be correct in 32-bit arithmetic
+    if (RingSize > k_StreamBinder_RingSize_MAX)
+      return E_INVALIDARG;
+    RINOK(Event_Create_or_Reset(_ringCanWrite_Event))
+    if (_ring.Size() != RingSize)
+      _ring.Alloc(RingSize);
+    _ringSize = RingSize;
+    _wakeSize = (_ringSize + 3) / 4;
+    _readPos = 0;
+    _writePos = 0;
+    _readCount = 0;
+    _writeCount = 0;
+    _readerIsWaiting = 0;
+    _writerIsWaiting = 0;
+    _ringReadClosed = 0;
+    _ringWriteClosed = 0;
+  }
   return S_OK;
 }
 
@@ -73,11 +103,15 @@ HRESULT CStreamBinder::Read(void *data, UInt32 size, UInt32 *processedSize)
 {
   if (processedSize)
     *processedSize = 0;
+  if (_ringSize != 0)
+    return Ring_Read(data, size, processedSize);
   if (size != 0)
   {
     if (_waitWrite)
     {
+      WAIT_TIME_BEGIN
       WRes wres = _canRead_Event.Lock();
+      WAIT_TIME_END(ReadWaitTime)
       if (wres != 0)
         return HRESULT_FROM_WIN32(wres);
       _waitWrite = false;
@@ -117,6 +151,8 @@ HRESULT CStreamBinder::Write(const void *data, UInt32 size, UInt32 *processedSiz
     *processedSize = 0;
   if (size == 0)
     return S_OK;
+  if (_ringSize != 0)
+    return Ring_Write(data, size, processedSize);
 
   if (!_readingWasClosed2)
   {
@@ -130,7 +166,11 @@ HRESULT CStreamBinder::Write(const void *data, UInt32 size, UInt32 *processedSiz
       _readingWasClosed2 = true;
     */
 
-    _canWrite_Semaphore.Lock();
+    {
+      WAIT_TIME_BEGIN
+      _canWrite_Semaphore.Lock();
+      WAIT_TIME_END(WriteWaitTime)
+    }
 
     // _bufSize : is remain size that was not read
     size -= _bufSize;
@@ -149,3 +189,181 @@ HRESULT CStreamBinder::Write(const void *data, UInt32 size, UInt32 *processedSiz
   // WritingWasCut = true;
   return k_My_HRESULT_WritingWasCut;
 }
+
+
+// ---------- Ring buffer mode ----------
+
+#if defined(_WIN32)
+  #define RING_LOAD_ACQ(a)      ((UInt32)InterlockedCompareExchange((LONG volatile *)(void *)(a), 0, 0))
+  #define RING_STORE_REL(a, v)  InterlockedExchange((LONG volatile *)(void *)(a), (LONG)(v))
+  #define RING_LOAD(a)          RING_LOAD_ACQ(a)
+  #define RING_STORE(a, v)      RING_STORE_REL(a, v)
+  #define RING_XCHG(a, v)       ((UInt32)InterlockedExchange((LONG volatile *)(void *)(a), (LONG)(v)))
+  #define RING_FENCE            MemoryBarrier();
+#elif defined(__GNUC__) || defined(__clang__)
+  #define RING_LOAD_ACQ(a)      __atomic_load_n((a), __ATOMIC_ACQUIRE)
+  #define RING_STORE_REL(a, v)  __atomic_store_n((a), (v), __ATOMIC_RELEASE)
+  #define RING_LOAD(a)          __atomic_load_n((a), __ATOMIC_SEQ_CST)
+  #define RING_STORE(a, v)      __atomic_store_n((a), (v), __ATOMIC_SEQ_CST)
+  #define RING_XCHG(a, v)       __atomic_exchange_n((a), (v), __ATOMIC_SEQ_CST)
+  #define RING_FENCE            __atomic_thread_fence(__ATOMIC_SEQ_CST);
+#else
+  #error Stop_Compiling_Atomic_Operations_Are_Not_Supported
+#endif
+
+/*
+The waiting side sets (xxxIsWaiting) flag and then it checks the counter of another side.
+Another side stores its counter and then it checks the flag.
+We need full memory barrier between these store and load in both sides.
+So at least one side will see the change of another side.
+*/
+
+// it waits for event that was set by another side after reset of (*isWaiting) flag
+
+static WRes Ring_Wait(NWindows::NSynchronization::CAutoResetEvent &event, UInt32 *isWaiting, bool readyNow)
+{
+  if (readyNow)
+  {
+    // the state was changed after we had set the flag.
+    if (RING_XCHG(isWaiting, 0) != 0)
+      return 0;
+    // another side has reset the flag, so it will set the event. We must consume that event.
+  }
+  return event.Lock();
+}
+
+HRESULT CStreamBinder::Ring_Read(void *data, UInt32 size, UInt32 *processedSize)
+{
+  if (size == 0)
+    return S_OK;
+  const UInt32 readCount = _readCount;
+  UInt32 avail;
+  for (unsigned spin = 0;; spin++)
+  {
+    avail = RING_LOAD_ACQ(&_writeCount) - readCount;
+    if (avail != 0)
+      break;
+    if (RING_LOAD_ACQ(&_ringWriteClosed))
+    {
+      // the writer could write data before closing
+      avail = RING_LOAD_ACQ(&_writeCount) - readCount;
+      break;
+    }
+    if (spin < SpinCount)
+      continue;
+    RING_XCHG(&_readerIsWaiting, 1);
+    const bool readyNow =
+        RING_LOAD(&_writeCount) != readCount
+        || RING_LOAD(&_ringWriteClosed);
+    WAIT_TIME_BEGIN
+    const WRes wres = Ring_Wait(_canRead_Event, &_readerIsWaiting, readyNow);
+    WAIT_TIME_END(ReadWaitTime)
+    if (wres != 0)
+      return HRESULT_FROM_WIN32(wres);
+  }
+  
+  // (avail == 0) means that stream is finished.
+  if (avail == 0)
+    return S_OK;
+  
+  if (size > avail)
+    size = avail;
+  // the reader owns (avail) bytes after (_readPos). So we copy data without lock.
+  {
+    const Byte *ring = _ring;
+    UInt32 rem = size;
+    UInt32 cur = _ringSize - _readPos;
+    if (cur > rem)
+      cur = rem;
+    memcpy(data, ring + _readPos, cur);
+    rem -= cur;
+    if (rem != 0)
+      memcpy((Byte *)data + cur, ring, rem);
+    _readPos += size;
+    if (_readPos >= _ringSize)
+      _readPos -= _ringSize;
+  }
+  const UInt32 newReadCount = readCount + size;
+  ProcessedSize += size;
+  if (processedSize)
+    *processedSize = size;
+
+  RING_STORE_REL(&_readCount, newReadCount);
+  RING_FENCE
+  if (RING_LOAD(&_writerIsWaiting)
+      && _ringSize - (RING_LOAD(&_writeCount) - newReadCount) >= _wakeSize
+      && RING_XCHG(&_writerIsWaiting, 0) != 0)
+    _ringCanWrite_Event.Set();
+  return S_OK;
+}
+
+
+HRESULT CStreamBinder::Ring_Write(const void *data, UInt32 size, UInt32 *processedSize)
+{
+  const UInt32 writeCount = _writeCount;
+  UInt32 avail;
+  for (unsigned spin = 0;; spin++)
+  {
+    if (RING_LOAD_ACQ(&_ringReadClosed))
+      return k_My_HRESULT_WritingWasCut;
+    avail = _ringSize - (writeCount - RING_LOAD_ACQ(&_readCount));
+    if (avail != 0)
+      break;
+    if (spin < SpinCount)
+      continue;
+    RING_XCHG(&_writerIsWaiting, 1);
+    const bool readyNow =
+        RING_LOAD(&_readCount) != writeCount - _ringSize
+        || RING_LOAD(&_ringReadClosed);
+    WAIT_TIME_BEGIN
+    const WRes wres = Ring_Wait(_ringCanWrite_Event, &_writerIsWaiting, readyNow);
+    WAIT_TIME_END(WriteWaitTime)
+    if (wres != 0)
+      return HRESULT_FROM_WIN32(wres);
+  }
+
+  if (size > avail)
+    size = avail;
+  // the writer owns (avail) free bytes after (_writePos).
+  {
+    Byte *ring = _ring;
+    UInt32 rem = size;
+    UInt32 cur = _ringSize - _writePos;
+    if (cur > rem)
+      cur = rem;
+    memcpy(ring + _writePos, data, cur);
+    rem -= cur;
+    if (rem != 0)
+      memcpy(ring, (const Byte *)data + cur, rem);
+    _writePos += size;
+    if (_writePos >= _ringSize)
+      _writePos -= _ringSize;
+  }
+  const UInt32 newWriteCount = writeCount + size;
+  if (processedSize)
+    *processedSize = size;
+
+  RING_STORE_REL(&_writeCount, newWriteCount);
+  RING_FENCE
+  if (RING_LOAD(&_readerIsWaiting)
+      && newWriteCount - RING_LOAD(&_readCount) >= _wakeSize
+      && RING_XCHG(&_readerIsWaiting, 0) != 0)
+    _canRead_Event.Set();
+  return S_OK;
+}
+
+
+void CStreamBinder::Ring_CloseRead()
+{
+  RING_STORE(&_ringReadClosed, 1);
+  if (RING_XCHG(&_writerIsWaiting, 0) != 0)
+    _ringCanWrite_Event.Set();
+}
+
+
+void CStreamBinder::Ring_CloseWrite()
+{
+  RING_STORE(&_ringWriteClosed, 1);
+  if (RING_XCHG(&_readerIsWaiting, 0) != 0)
+    _canRead_Event.Set();
+}
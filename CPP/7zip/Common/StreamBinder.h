@@ -3,6 +3,8 @@
 #ifndef ZIP7_INC_STREAM_BINDER_H
 #define ZIP7_INC_STREAM_BINDER_H
 
+#include "../../Common/MyBuffer.h"
+
 #include "../../Windows/Synchronization.h"
 
 #include "../IStream.h"
@@ -27,6 +29,26 @@ The difference for cases where Reading must be closed before Writing closing
   writer thread always will detect closing of reading in latest iteration after all data processing iterations
 */
 
+/*
+Ring buffer mode (RingSize != 0):
+  Write() copies data to internal ring buffer of (RingSize) bytes and returns,
+  so the writer thread can run ahead of the reader thread.
+  The ring is lock-free single-producer / single-consumer queue:
+    (_writeCount) is changed only by writer thread, (_readCount) is changed only by reader thread.
+    Each side stores its counter with release semantics after data copying,
+    and it loads the counter of another side with acquire semantics before data copying.
+  Each side uses event only when the ring is full (writer) or empty (reader).
+  Before waiting, a thread checks the state (SpinCount) times.
+  Then it sets (xxxIsWaiting) flag, checks the state again and waits for event.
+  Another side resets (xxxIsWaiting) flag with atomic exchange, and it sets event
+  only if the flag was set. So each Set() call is paired with one Lock() call.
+  A waiting thread is signaled only when (RingSize / 4) bytes are available
+  (or the other side was closed), so we have one wakeup per big block of data.
+*/
+
+// the counters of ring are 32-bit, so the size of ring is limited
+const UInt32 k_StreamBinder_RingSize_MAX = (UInt32)1 << 30;
+
 class CStreamBinder
 {
   NWindows::NSynchronization::CAutoResetEvent _canRead_Event;
@@ -39,8 +61,35 @@ class CStreamBinder
   bool _waitWrite;         // use it in reader thread
   UInt32 _bufSize;
   const void *_buf;
+
+  // ring buffer mode
+  NWindows::NSynchronization::CAutoResetEvent _ringCanWrite_Event;
+  CByteBuffer _ring;
+  UInt32 _ringSize;
+  UInt32 _wakeSize;
+  UInt32 _readPos;          // use it in reader thread
+  UInt32 _writePos;         // use it in writer thread
+  // the numbers of bytes that were written to ring and read from ring (modulo 2^32)
+  UInt32 _writeCount;       // it's changed only in writer thread
+  UInt32 _readCount;        // it's changed only in reader thread
+  UInt32 _readerIsWaiting;
+  UInt32 _writerIsWaiting;
+  UInt32 _ringReadClosed;
+  UInt32 _ringWriteClosed;
+
+  HRESULT Ring_Read(void *data, UInt32 size, UInt32 *processedSize);
+  HRESULT Ring_Write(const void *data, UInt32 size, UInt32 *processedSize);
+  void Ring_CloseRead();
+  void Ring_CloseWrite();
 public:
   UInt64 ProcessedSize;   // the size that was read by reader thread
+  UInt32 RingSize;        // 0 : synchronous mode without internal buffer
+  unsigned SpinCount;
+  bool StatMode;
+  UInt64 ReadWaitTime;    // use it in reader thread
+  UInt64 WriteWaitTime;   // use it in writer thread
+
+  CStreamBinder(): _ringSize(0), RingSize(0), SpinCount(0), StatMode(false) {}
 
   void CreateStreams2(CMyComPtr<ISequentialInStream> &inStream, CMyComPtr<ISequentialOutStream> &outStream);
   
@@ -53,6 +102,12 @@ public:
   {
     // call it only once: for example, in destructor
     
+    if (_ringSize != 0)
+    {
+      Ring_CloseRead();
+      return;
+    }
+
     /*
     _readingWasClosed = true;
     _canWrite_Event.Set();
@@ -69,6 +124,11 @@ public:
   
   void CloseWrite()
   {
+    if (_ringSize != 0)
+    {
+      Ring_CloseWrite();
+      return;
+    }
     _buf = NULL;
     _bufSize = 0;
     _canRead_Event.Set();
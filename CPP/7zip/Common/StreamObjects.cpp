@@ -174,17 +174,36 @@ Z7_COM7F_IMF(CSequentialOutStreamSizeCount::Write(const void *data, UInt32 size,
 }
 
 static const UInt64 kEmptyTag = (UInt64)(Int64)-1;
+static const size_t kNoSlot = (size_t)(ptrdiff_t)-1;
+
+static const unsigned kNumWaysLog = 2;
+
+CCachedInStream::~CCachedInStream()
+{
+#ifndef Z7_ST
+  StopReadAhead();
+#endif
+  Free();
+}
 
 void CCachedInStream::Free() throw()
 {
+#ifndef Z7_ST
+  WaitAllThreads();
+#endif
   MyFree(_tags);
   _tags = NULL;
+  MyFree(_useStamps);
+  _useStamps = NULL;
   MidFree(_data);
   _data = NULL;
 }
 
 bool CCachedInStream::Alloc(unsigned blockSizeLog, unsigned numBlocksLog) throw()
 {
+#ifndef Z7_ST
+  WaitAllThreads();
+#endif
   unsigned sizeLog = blockSizeLog + numBlocksLog;
   if (sizeLog >= sizeof(size_t) * 8)
     return false;
@@ -200,24 +219,266 @@ bool CCachedInStream::Alloc(unsigned blockSizeLog, unsigned numBlocksLog) throw(
   if (!_tags || numBlocksLog != _numBlocksLog)
   {
     MyFree(_tags);
+    MyFree(_useStamps);
+    _useStamps = NULL;
     _tags = (UInt64 *)MyAlloc(sizeof(UInt64) << numBlocksLog);
     if (!_tags)
       return false;
+    _useStamps = (UInt32 *)MyAlloc(sizeof(UInt32) << numBlocksLog);
+    if (!_useStamps)
+      return false;
     _numBlocksLog = numBlocksLog;
   }
+  _numWaysLog = numBlocksLog < kNumWaysLog ? numBlocksLog : kNumWaysLog;
   _blockSizeLog = blockSizeLog;
   return true;
 }
 
 void CCachedInStream::Init(UInt64 size) throw()
 {
+#ifndef Z7_ST
+  WaitAllThreads();
+  _lastBlockIndex = kEmptyTag;
+#endif
   _size = size;
   _pos = 0;
+  _useStamp = 0;
   const size_t numBlocks = (size_t)1 << _numBlocksLog;
   for (size_t i = 0; i < numBlocks; i++)
+  {
     _tags[i] = kEmptyTag;
+    _useStamps[i] = 0;
+  }
+}
+
+size_t CCachedInStream::FindBlock(UInt64 blockIndex) const throw()
+{
+  const size_t numWays = (size_t)1 << _numWaysLog;
+  const size_t setMask = ((size_t)1 << (_numBlocksLog - _numWaysLog)) - 1;
+  const size_t start = ((size_t)blockIndex & setMask) << _numWaysLog;
+  for (size_t i = start; i < start + numWays; i++)
+    if (_tags[i] == blockIndex)
+      return i;
+  return kNoSlot;
+}
+
+// it returns empty slot or least recently used slot in the set of (blockIndex)
+
+size_t CCachedInStream::GetSlotForNewBlock(UInt64 blockIndex, size_t excludeSlot) const throw()
+{
+  const size_t numWays = (size_t)1 << _numWaysLog;
+  const size_t setMask = ((size_t)1 << (_numBlocksLog - _numWaysLog)) - 1;
+  const size_t start = ((size_t)blockIndex & setMask) << _numWaysLog;
+  size_t best = kNoSlot;
+  UInt32 bestAge = 0;
+  for (size_t i = start; i < start + numWays; i++)
+  {
+    if (i == excludeSlot)
+      continue;
+   #ifndef Z7_ST
+    if (IsSlotPending(i))
+      continue;
+   #endif
+    if (_tags[i] == kEmptyTag)
+      return i;
+    const UInt32 age = _useStamp - _useStamps[i];
+    if (best == kNoSlot || age > bestAge)
+    {
+      best = i;
+      bestAge = age;
+    }
+  }
+  return best;
+}
+
+
+#ifndef Z7_ST
+
+HRESULT CCachedInStream::ReadBlock_Mt(unsigned /* threadIndex */, UInt64 /* blockIndex */, Byte * /* dest */, size_t /* blockSize */)
+{
+  return E_NOTIMPL;
+}
+
+THREAD_FUNC_DECL CReadAheadPool::ThreadFunc(void *param)
+{
+  CThreadItem *t = (CThreadItem *)param;
+  for (;;)
+  {
+    t->StartEvent.Lock();
+    if (t->Exit)
+      return THREAD_FUNC_RET_ZERO;
+    HRESULT res;
+    try
+    {
+      CCachedInStream *s = t->Stream;
+      res = s->ReadBlock_Mt(t->ThreadIndex, t->BlockIndex,
+          s->_data + (t->Slot << s->_blockSizeLog), t->BlockSize);
+    }
+    catch(...) { res = E_FAIL; }
+    t->Result = res;
+    t->Finished = true;
+    t->FinishedEvent.Set();
+  }
+}
+
+HRESULT CReadAheadPool::Create(unsigned numThreads)
+{
+  while (_threads.Size() < numThreads)
+  {
+    CThreadItem &t = _threads.AddNew();
+    t.Stream = NULL;
+    t.ThreadIndex = _threads.Size() - 1;
+    t.Exit = false;
+    t.Finished = false;
+    WRes wres = t.StartEvent.CreateIfNotCreated_Reset();
+    if (wres == 0)
+      wres = t.FinishedEvent.CreateIfNotCreated_Reset();
+    if (wres == 0)
+      wres = t.Thread.Create(ThreadFunc, &t);
+    if (wres != 0)
+    {
+      _threads.DeleteBack();
+      return HRESULT_FROM_WIN32(wres);
+    }
+  }
+  return S_OK;
+}
+
+CReadAheadPool::~CReadAheadPool()
+{
+  FOR_VECTOR (i, _threads)
+  {
+    CThreadItem &t = _threads[i];
+    t.Exit = true;
+    if (t.StartEvent.IsCreated())
+      t.StartEvent.Set();
+    if (t.Thread.IsCreated())
+      t.Thread.Wait_Close();
+  }
 }
 
+void CCachedInStream::SetReadAhead(CReadAheadPool *pool, unsigned numThreads, UInt64 maxAheadSize) throw()
+{
+  StopReadAhead();
+  _lastBlockIndex = kEmptyTag;
+  if (!pool || !_tags)
+    return;
+  if (numThreads > pool->GetNumThreads())
+    numThreads = pool->GetNumThreads();
+  // we keep at least half of cache for blocks that were read already
+  UInt64 maxAhead = ((size_t)1 << _numBlocksLog) / 2;
+  if (maxAhead > (maxAheadSize >> _blockSizeLog))
+    maxAhead = maxAheadSize >> _blockSizeLog;
+  if (maxAhead > (UInt64)numThreads * 2)
+    maxAhead = (UInt64)numThreads * 2;
+  if (numThreads > maxAhead)
+    numThreads = (unsigned)maxAhead;
+  if (numThreads == 0)
+    return;
+  _pool = pool;
+  _maxThreads = numThreads;
+  _maxAhead = (unsigned)maxAhead;
+}
+
+void CCachedInStream::StopReadAhead() throw()
+{
+  WaitAllThreads();
+  _pool = NULL;
+}
+
+bool CCachedInStream::IsSlotPending(size_t slot) const throw()
+{
+  if (!_pool)
+    return false;
+  FOR_VECTOR (i, _pool->_threads)
+  {
+    const CReadAheadPool::CThreadItem &t = _pool->_threads[i];
+    if (t.Stream == this && t.Slot == slot)
+      return true;
+  }
+  return false;
+}
+
+void CCachedInStream::WaitThread(CReadAheadPool::CThreadItem &t) throw()
+{
+  if (t.Stream != this)
+    return;
+  t.FinishedEvent.Lock();
+  t.Stream = NULL;
+  if (t.Result != S_OK)
+    _tags[t.Slot] = kEmptyTag; // the block will be read via ReadBlock()
+}
+
+void CCachedInStream::WaitAllThreads() throw()
+{
+  if (!_pool)
+    return;
+  FOR_VECTOR (i, _pool->_threads)
+    WaitThread(_pool->_threads[i]);
+}
+
+void CCachedInStream::StartReadAhead(UInt64 blockIndex, size_t curSlot) throw()
+{
+  CObjectVector<CReadAheadPool::CThreadItem> &threads = _pool->_threads;
+  unsigned numBusy = 0;
+  {
+    FOR_VECTOR (i, threads)
+    {
+      CReadAheadPool::CThreadItem &t = threads[i];
+      if (t.Stream && t.Finished)
+      {
+        // we release also the finished threads of other streams
+        t.Stream->WaitThread(t);
+      }
+      else if (t.Stream == this)
+        numBusy++;
+    }
+  }
+
+  const UInt64 numBlocksInStream = (_size + ((UInt64)1 << _blockSizeLog) - 1) >> _blockSizeLog;
+
+  for (unsigned k = 1; k <= _maxAhead && numBusy < _maxThreads; k++)
+  {
+    const UInt64 next = blockIndex + k;
+    if (next >= numBlocksInStream)
+      break;
+    if (FindBlock(next) != kNoSlot)
+      continue;
+    unsigned i;
+    for (i = 0; i < threads.Size(); i++)
+      if (!threads[i].Stream)
+        break;
+    if (i == threads.Size())
+      break;
+    const size_t slot = GetSlotForNewBlock(next, curSlot);
+    if (slot == kNoSlot)
+      break;
+    CReadAheadPool::CThreadItem &t = threads[i];
+    const UInt64 rem = _size - (next << _blockSizeLog);
+    size_t blockSize = (size_t)1 << _blockSizeLog;
+    if (blockSize > rem)
+      blockSize = (size_t)rem;
+    _tags[slot] = next;
+    _useStamps[slot] = ++_useStamp;
+    t.Slot = slot;
+    t.BlockIndex = next;
+    t.BlockSize = blockSize;
+    t.Result = E_FAIL;
+    t.Finished = false;
+    t.Stream = this;
+    if (t.StartEvent.Set() != 0)
+    {
+      t.Stream = NULL;
+      _tags[slot] = kEmptyTag;
+      break;
+    }
+    numBusy++;
+  }
+}
+
+#endif
+
+
 Z7_COM7F_IMF(CCachedInStream::Read(void *data, UInt32 size, UInt32 *processedSize))
 {
   if (processedSize)
@@ -236,22 +497,60 @@ Z7_COM7F_IMF(CCachedInStream::Read(void *data, UInt32 size, UInt32 *processedSiz
   while (size != 0)
   {
     const UInt64 cacheTag = _pos >> _blockSizeLog;
-    const size_t cacheIndex = (size_t)cacheTag & (((size_t)1 << _numBlocksLog) - 1);
-    Byte *p = _data + (cacheIndex << _blockSizeLog);
+    size_t cacheIndex = FindBlock(cacheTag);
 
-    if (_tags[cacheIndex] != cacheTag)
+   #ifndef Z7_ST
+    if (cacheIndex != kNoSlot && _pool)
     {
+      FOR_VECTOR (i, _pool->_threads)
+      {
+        CReadAheadPool::CThreadItem &t = _pool->_threads[i];
+        if (t.Stream == this && t.Slot == cacheIndex)
+        {
+          WaitThread(t);
+          if (_tags[cacheIndex] != cacheTag)
+            cacheIndex = kNoSlot;
+          break;
+        }
+      }
+    }
+   #endif
+
+    if (cacheIndex == kNoSlot)
+    {
+      cacheIndex = GetSlotForNewBlock(cacheTag, kNoSlot);
+     #ifndef Z7_ST
+      if (cacheIndex == kNoSlot)
+      {
+        // all slots in set are used by read-ahead threads
+        WaitAllThreads();
+        cacheIndex = GetSlotForNewBlock(cacheTag, kNoSlot);
+      }
+     #endif
       _tags[cacheIndex] = kEmptyTag;
       const UInt64 remInBlock = _size - (cacheTag << _blockSizeLog);
       size_t blockSize = (size_t)1 << _blockSizeLog;
       if (blockSize > remInBlock)
         blockSize = (size_t)remInBlock;
       
-      RINOK(ReadBlock(cacheTag, p, blockSize))
+      RINOK(ReadBlock(cacheTag, _data + (cacheIndex << _blockSizeLog), blockSize))
       
       _tags[cacheIndex] = cacheTag;
     }
-    
+
+    _useStamps[cacheIndex] = ++_useStamp;
+
+   #ifndef Z7_ST
+    if (_pool && cacheTag != _lastBlockIndex)
+    {
+      // read-ahead is used for sequential reading only
+      if (cacheTag == _lastBlockIndex + 1)
+        StartReadAhead(cacheTag, cacheIndex);
+      _lastBlockIndex = cacheTag;
+    }
+   #endif
+
+    const Byte *p = _data + (cacheIndex << _blockSizeLog);
     const size_t kBlockSize = (size_t)1 << _blockSizeLog;
     const size_t offset = (size_t)_pos & (kBlockSize - 1);
     UInt32 cur = size;
@@ -270,8 +569,7 @@ Z7_COM7F_IMF(CCachedInStream::Read(void *data, UInt32 size, UInt32 *processedSiz
 
   return S_OK;
 }
-
- 
+  
 Z7_COM7F_IMF(CCachedInStream::Seek(Int64 offset, UInt32 seekOrigin, UInt64 *newPosition))
 {
   switch (seekOrigin)
@@ -7,6 +7,11 @@
 #include "../../Common/MyCom.h"
 #include "../../Common/MyVector.h"
 
+#ifndef Z7_ST
+#include "../../Windows/Synchronization.h"
+#include "../../Windows/Thread.h"
+#endif
+
 #include "../IStream.h"
 
 Z7_CLASS_IMP_IInStream(
@@ -120,6 +125,57 @@ public:
 };
 
 
+#ifndef Z7_ST
+
+class CCachedInStream;
+
+/*
+CReadAheadPool contains the threads that decode blocks for CCachedInStream objects.
+The handler keeps one pool, and all streams of the handler share the threads of the pool.
+ReadBlock_Mt() gets the index of pool thread, so the handler can use one decoder per thread.
+The pool must be used from one thread only.
+All streams that use the pool must call StopReadAhead() before the pool is destroyed.
+*/
+
+class CReadAheadPool
+{
+  friend class CCachedInStream;
+
+  struct CThreadItem
+  {
+    CCachedInStream *Stream;  // the stream that uses the thread now, or NULL
+    unsigned ThreadIndex;
+    bool Exit;
+    volatile bool Finished;   // it's set by read-ahead thread
+    size_t Slot;
+    UInt64 BlockIndex;
+    size_t BlockSize;
+    HRESULT Result;
+    NWindows::NSynchronization::CAutoResetEvent StartEvent;
+    NWindows::NSynchronization::CAutoResetEvent FinishedEvent;
+    NWindows::CThread Thread;
+  };
+
+  CObjectVector<CThreadItem> _threads;
+
+  static THREAD_FUNC_DECL ThreadFunc(void *param);
+public:
+  ~CReadAheadPool();
+  unsigned GetNumThreads() const { return _threads.Size(); }
+  // it creates new threads, if (numThreads) is larger than the number of threads in pool
+  HRESULT Create(unsigned numThreads);
+};
+
+#endif
+
+
+/*
+CCachedInStream is a set-associative cache of decoded blocks with LRU replacement.
+In read-ahead mode (SetReadAhead()), when the blocks are read in sequential order,
+the next blocks are decoded via ReadBlock_Mt() in the threads of CReadAheadPool.
+The derived class that uses read-ahead must call StopReadAhead() in its destructor.
+*/
+
 class CCachedInStream:
   public IInStream,
   public CMyUnknownImp
@@ -127,20 +183,60 @@ class CCachedInStream:
   Z7_IFACES_IMP_UNK_2(ISequentialInStream, IInStream)
 
   UInt64 *_tags;
+  UInt32 *_useStamps;
   Byte *_data;
   size_t _dataSize;
   unsigned _blockSizeLog;
   unsigned _numBlocksLog;
+  unsigned _numWaysLog;
+  UInt32 _useStamp;
   UInt64 _size;
   UInt64 _pos;
+
+  size_t FindBlock(UInt64 blockIndex) const throw();
+  size_t GetSlotForNewBlock(UInt64 blockIndex, size_t excludeSlot) const throw();
+
+#ifndef Z7_ST
+  friend class CReadAheadPool;
+
+  CReadAheadPool *_pool;
+  unsigned _maxThreads; // the number of pool threads that can be used by this stream
+  unsigned _maxAhead;   // the number of blocks that can be decoded ahead
+  UInt64 _lastBlockIndex;
+
+  bool IsSlotPending(size_t slot) const throw();
+  void WaitThread(CReadAheadPool::CThreadItem &t) throw();
+  void WaitAllThreads() throw();
+  void StartReadAhead(UInt64 blockIndex, size_t curSlot) throw();
+#endif
+
 protected:
   virtual HRESULT ReadBlock(UInt64 blockIndex, Byte *dest, size_t blockSize) = 0;
+#ifndef Z7_ST
+  /* ReadBlock_Mt() is called from the threads of pool.
+     It must be safe for parallel calls with different (threadIndex) values
+     (also for different streams that use same pool)
+     and for parallel call of ReadBlock() from main thread.
+     If it returns error, the block will be read later via ReadBlock(). */
+  virtual HRESULT ReadBlock_Mt(unsigned threadIndex, UInt64 blockIndex, Byte *dest, size_t blockSize);
+#endif
 public:
-  CCachedInStream(): _tags(NULL), _data(NULL) {}
-  virtual ~CCachedInStream() { Free(); } // the destructor must be virtual (Release() calls it) !!!
+  CCachedInStream(): _tags(NULL), _useStamps(NULL), _data(NULL)
+   #ifndef Z7_ST
+    , _pool(NULL)
+   #endif
+    {}
+  virtual ~CCachedInStream(); // the destructor must be virtual (Release() calls it) !!!
   void Free() throw();
   bool Alloc(unsigned blockSizeLog, unsigned numBlocksLog) throw();
   void Init(UInt64 size) throw();
+#ifndef Z7_ST
+  /* it must be called after Alloc().
+     The stream uses up to (numThreads) threads of (pool),
+     and the size of blocks that are decoded ahead is limited by (maxAheadSize). */
+  void SetReadAhead(CReadAheadPool *pool, unsigned numThreads, UInt64 maxAheadSize) throw();
+  void StopReadAhead() throw();
+#endif
 };
 
 #endif
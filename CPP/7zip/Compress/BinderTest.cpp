@@ -0,0 +1,281 @@
+// BinderTest.cpp - tests for synchronous and ring buffer modes of CStreamBinder
+
+#include "StdAfx.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "../../Common/MyBuffer.h"
+#include "../../Common/MyCom.h"
+#include "../../Common/MyInitGuid.h"
+
+#ifndef Z7_ST
+#include "../../Windows/Thread.h"
+
+#include "../Common/StreamBinder.h"
+#endif
+
+#include "../IStream.h"
+
+static unsigned g_TestsPassed = 0;
+static unsigned g_TestsFailed = 0;
+
+#ifndef Z7_ST
+
+static bool g_TestFailed = false;
+
+#define TEST_ASSERT(condition, message) \
+  if (!(condition)) { \
+    printf("FAIL: %s - %s\n", __FUNCTION__, message); \
+    g_TestFailed = true; \
+    g_TestsFailed++; \
+    return false; \
+  }
+
+#define TEST_SUCCESS() \
+  if (!g_TestFailed) { \
+    printf("PASS: %s\n", __FUNCTION__); \
+    g_TestsPassed++; \
+    return true; \
+  } \
+  return false;
+
+static UInt32 GetRandom(UInt32 &v)
+{
+  v = v * 1103515245 + 12345;
+  return v >> 16;
+}
+
+// the writer thread writes (Size) bytes in chunks of random sizes
+
+struct CWriter
+{
+  CMyComPtr<ISequentialOutStream> Stream;
+  const Byte *Data;
+  size_t Size;
+  UInt32 MaxChunk;
+  UInt32 Seed;
+  HRESULT Result;
+  size_t Written;
+  NWindows::CThread Thread;
+
+  void Write()
+  {
+    Result = S_OK;
+    size_t pos = 0;
+    UInt32 v = Seed;
+    while (pos < Size)
+    {
+      UInt32 cur = GetRandom(v) % MaxChunk + 1;
+      if (cur > Size - pos)
+        cur = (UInt32)(Size - pos);
+      UInt32 processed = 0;
+      const HRESULT res = Stream->Write(Data + pos, cur, &processed);
+      if (res != S_OK)
+      {
+        Result = res;
+        break;
+      }
+      if (processed == 0 || processed > cur)
+      {
+        Result = E_FAIL;
+        break;
+      }
+      pos += processed;
+    }
+    Written = pos;
+    // it calls CloseWrite() of binder
+    Stream.Release();
+  }
+
+  static THREAD_FUNC_DECL ThreadFunc(void *p)
+  {
+    ((CWriter *)p)->Write();
+    return THREAD_FUNC_RET_ZERO;
+  }
+};
+
+
+static CByteBuffer g_Data;
+
+static void CreateData(size_t size)
+{
+  g_Data.Alloc(size);
+  UInt32 v = 7;
+  for (size_t i = 0; i < size; i++)
+    g_Data[i] = (Byte)GetRandom(v);
+}
+
+/* it transfers (size) bytes through binder.
+   The reader reads (readLimit) bytes in chunks of random sizes, and then it closes reading.
+   It returns false, if the read data is not equal to written data. */
+
+static bool Transfer(CStreamBinder &binder, UInt32 ringSize, unsigned spinCount,
+    size_t size, size_t readLimit, UInt32 maxChunk, UInt32 seed, CWriter &writer)
+{
+  binder.RingSize = ringSize;
+  binder.SpinCount = spinCount;
+  if (binder.Create_ReInit() != S_OK)
+    return false;
+
+  CMyComPtr<ISequentialInStream> inStream;
+  {
+    CMyComPtr<ISequentialOutStream> outStream;
+    binder.CreateStreams2(inStream, outStream);
+    writer.Stream = outStream;
+  }
+  writer.Data = g_Data;
+  writer.Size = size;
+  writer.MaxChunk = maxChunk;
+  writer.Seed = seed;
+  if (writer.Thread.Create(CWriter::ThreadFunc, &writer) != 0)
+    return false;
+
+  CByteBuffer buf(maxChunk);
+  bool isOK = true;
+  size_t pos = 0;
+  UInt32 v = seed ^ 0x5555;
+  while (pos < readLimit)
+  {
+    UInt32 cur = GetRandom(v) % maxChunk + 1;
+    if (cur > readLimit - pos)
+      cur = (UInt32)(readLimit - pos);
+    UInt32 processed = 0;
+    if (inStream->Read(buf, cur, &processed) != S_OK || processed > cur)
+    {
+      isOK = false;
+      break;
+    }
+    if (processed == 0)
+      break;
+    if (memcmp(buf, g_Data + pos, processed) != 0)
+    {
+      isOK = false;
+      break;
+    }
+    pos += processed;
+  }
+
+  if (isOK && readLimit == size)
+  {
+    // the stream must be finished
+    UInt32 processed = 1;
+    if (inStream->Read(buf, 1, &processed) != S_OK || processed != 0)
+      isOK = false;
+    if (binder.ProcessedSize != size)
+      isOK = false;
+  }
+  if (pos != readLimit)
+    isOK = false;
+
+  // it calls CloseRead_CallOnce() of binder
+  inStream.Release();
+  writer.Thread.Wait_Close();
+  return isOK;
+}
+
+
+// the data is not changed by binder in all modes
+static bool TestRoundTrip()
+{
+  g_TestFailed = false;
+
+  const UInt32 ringSizes[] = { 0, 1, 3, 1000, 1 << 12, 1 << 16, 1 << 20 };
+  const unsigned spinCounts[] = { 0, 64 };
+  CStreamBinder binder;
+  CWriter writer;
+
+  for (unsigned i = 0; i < Z7_ARRAY_SIZE(ringSizes); i++)
+    for (unsigned k = 0; k < Z7_ARRAY_SIZE(spinCounts); k++)
+    {
+      const UInt32 ringSize = ringSizes[i];
+      // each byte can require wakeup for small ring
+      const size_t size = (ringSize != 0 && ringSize < (1 << 12)) ? (1 << 16) : (1 << 22);
+      TEST_ASSERT(Transfer(binder, ringSize, spinCounts[k], size, size, 1 << 15, i * 16 + k, writer), "wrong data")
+      TEST_ASSERT(writer.Result == S_OK && writer.Written == size, "writing error")
+    }
+
+  TEST_SUCCESS()
+}
+
+// the writer gets (k_My_HRESULT_WritingWasCut), if the reader has closed the stream
+static bool TestCloseRead()
+{
+  g_TestFailed = false;
+
+  const UInt32 ringSizes[] = { 0, 1000, 1 << 16 };
+  CStreamBinder binder;
+  CWriter writer;
+
+  for (unsigned i = 0; i < Z7_ARRAY_SIZE(ringSizes); i++)
+  {
+    const size_t size = (size_t)1 << 22;
+    TEST_ASSERT(Transfer(binder, ringSizes[i], 16, size, size / 3, 1 << 12, i, writer), "wrong data")
+    TEST_ASSERT(writer.Result == k_My_HRESULT_WritingWasCut, "writing was not cut")
+    TEST_ASSERT(writer.Written < size, "all data was written")
+  }
+
+  TEST_SUCCESS()
+}
+
+// many short transfers through small ring check the synchronization of waiting sides
+static bool TestStress()
+{
+  g_TestFailed = false;
+
+  CStreamBinder binder;
+  CWriter writer;
+
+  for (unsigned i = 0; i < 300; i++)
+  {
+    const UInt32 ringSize = 1 + i % 97;
+    const size_t size = ((size_t)1 << 14) + i;
+    TEST_ASSERT(Transfer(binder, ringSize, (i & 1) ? 4 : 0, size, size, 1 + i % 200, i, writer), "wrong data")
+    TEST_ASSERT(writer.Result == S_OK && writer.Written == size, "writing error")
+  }
+
+  TEST_SUCCESS()
+}
+
+// the binder doesn't support the ring that is larger than (k_StreamBinder_RingSize_MAX)
+static bool TestRingSizeLimit()
+{
+  g_TestFailed = false;
+
+  CStreamBinder binder;
+  binder.RingSize = k_StreamBinder_RingSize_MAX + 1;
+  TEST_ASSERT(binder.Create_ReInit() == E_INVALIDARG, "big ring was accepted")
+
+  TEST_SUCCESS()
+}
+
+#endif
+
+
+int main(int /* argc */, char * /* argv */[])
+{
+  printf("===========================================\n");
+  printf("Binder Test Suite\n");
+  printf("===========================================\n\n");
+
+ #ifdef Z7_ST
+  printf("CStreamBinder is not used in single-threaded build\n");
+ #else
+  CreateData((size_t)1 << 22);
+
+  TestRoundTrip();
+  TestCloseRead();
+  TestStress();
+  TestRingSizeLimit();
+ #endif
+
+  printf("\n===========================================\n");
+  printf("Test Results\n");
+  printf("===========================================\n");
+  printf("Passed: %u\n", g_TestsPassed);
+  printf("Failed: %u\n", g_TestsFailed);
+  printf("Total:  %u\n", g_TestsPassed + g_TestsFailed);
+  printf("===========================================\n");
+
+  return g_TestsFailed == 0 ? 0 : 1;
+}
@@ -2,6 +2,13 @@
 
 #include "StdAfx.h"
 
+#if defined(__linux__)
+#define Z7_COPY_CODER_USE_KERNEL_COPY
+#include <errno.h>
+#include <unistd.h>
+#include <sys/sendfile.h>
+#endif
+
 #include "../../../C/Alloc.h"
 
 #include "CopyCoder.h"
@@ -15,6 +22,167 @@ CCopyCoder::~CCopyCoder()
   ::MidFree(_buf);
 }
 
+
+#ifdef Z7_COPY_CODER_USE_KERNEL_COPY
+
+// for smaller sizes the copying through user-space buffer is good enough
+static const UInt64 kKernelCopy_MinSize = kBufSize;
+static const size_t kKernelCopy_ChunkSize = (size_t)1 << 22;
+
+static bool IsKernelCopyNotSupportedError(int error)
+{
+  return error == EXDEV
+      || error == EINVAL
+      || error == ENOSYS
+      || error == EOPNOTSUPP
+      || error == EBADF
+      || error == ESPIPE;
+}
+
+static HRESULT GetErrno_HRESULT()
+{
+  const int error = errno;
+  if (error == 0)
+    return E_FAIL;
+  return HRESULT_FROM_WIN32((DWORD)error);
+}
+
+static ssize_t KernelCopy(int inFd, int outFd, size_t size)
+{
+  ssize_t res;
+ #if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 27))
+  do
+    res = copy_file_range(inFd, NULL, outFd, NULL, size, 0);
+  while (res < 0 && errno == EINTR);
+  if (res >= 0 || !IsKernelCopyNotSupportedError(errno))
+    return res;
+ #endif
+  // sendfile() supports any output descriptor (pipe, socket) since Linux 2.6.33
+  do
+    res = sendfile(outFd, inFd, NULL, size);
+  while (res < 0 && errno == EINTR);
+  return res;
+}
+
+
+/*
+  Code_KernelCopy() copies data without user-space buffer,
+  if both streams support IStreamKernelCopy.
+  If some stream requires the data (CRC calculation), we still use kernel copy
+  for output, and then we read the copied chunk back to (_buf) with pread()
+  from input descriptor, and we pass that data to KernelCopy_Processed().
+  The output descriptor is opened for writing only, so we can't read from it.
+  Then we read each byte once, but we don't write it from user-space,
+  and the filesystem can share the extents for copy_file_range().
+  It returns S_OK, if the caller must continue with Read()/Write() copying
+  (end of stream, small rest of data, or unsupported streams).
+*/
+
+HRESULT CCopyCoder::Code_KernelCopy(ISequentialInStream *inStream, ISequentialOutStream *outStream,
+    const UInt64 *outSize, ICompressProgressInfo *progress)
+{
+  Z7_DECL_CMyComPtr_QI_FROM(IStreamKernelCopy, inCopy, inStream)
+  if (!inCopy)
+    return S_OK;
+  Z7_DECL_CMyComPtr_QI_FROM(IStreamKernelCopy, outCopy, outStream)
+  if (!outCopy)
+    return S_OK;
+
+  UInt64 progressPos = TotalSize;
+
+  for (;;)
+  {
+    Int32 inFd, outFd;
+    UInt64 inLimit, outLimit;
+    Int32 inNeedData, outNeedData;
+
+    if (inCopy->KernelCopy_GetFd(&inFd, &inLimit, &inNeedData) != S_OK)
+      return S_OK;
+    UInt64 rem = inLimit;
+    if (outSize)
+    {
+      const UInt64 rem2 = *outSize - TotalSize;
+      if (rem > rem2)
+        rem = rem2;
+    }
+    if (rem < kKernelCopy_MinSize)
+      return S_OK;
+    {
+      const HRESULT res = outCopy->KernelCopy_GetFd(&outFd, &outLimit, &outNeedData);
+      if (res != S_OK)
+        return res == S_FALSE ? S_OK : res;
+    }
+    if (rem > outLimit)
+      rem = outLimit;
+    if (rem < kKernelCopy_MinSize)
+      return S_OK;
+
+    const bool needData = (inNeedData || outNeedData);
+    size_t cur = needData ? kBufSize : kKernelCopy_ChunkSize;
+    if (cur > rem)
+      cur = (size_t)rem;
+
+    off_t inPos = 0;
+    if (needData)
+    {
+      inPos = lseek(inFd, 0, SEEK_CUR);
+      if (inPos == -1)
+        return S_OK;
+    }
+
+    const ssize_t res = KernelCopy(inFd, outFd, cur);
+    if (res < 0)
+    {
+      if (IsKernelCopyNotSupportedError(errno))
+        return S_OK;
+      return GetErrno_HRESULT();
+    }
+    if (res == 0)
+      return S_OK;
+    
+    const UInt32 processed = (UInt32)res;
+    const Byte *data = NULL;
+    if (needData)
+    {
+      // the data was written already, so we can't fall back to Read()/Write() here
+      size_t done = 0;
+      while (done < processed)
+      {
+        const ssize_t res2 = pread(inFd, _buf + done, processed - done, inPos + (off_t)done);
+        if (res2 < 0)
+        {
+          if (errno == EINTR)
+            continue;
+          return GetErrno_HRESULT();
+        }
+        if (res2 == 0)
+          return E_FAIL;
+        done += (size_t)res2;
+      }
+      data = _buf;
+    }
+    RINOK(inCopy->KernelCopy_Processed(data, processed))
+    RINOK(outCopy->KernelCopy_Processed(data, processed))
+    TotalSize += processed;
+
+    if (progress && TotalSize - progressPos >= ((UInt32)1 << 22))
+    {
+      progressPos = TotalSize;
+      RINOK(progress->SetRatioInfo(&TotalSize, &TotalSize))
+    }
+  }
+}
+
+#else
+
+HRESULT CCopyCoder::Code_KernelCopy(ISequentialInStream *, ISequentialOutStream *,
+    const UInt64 *, ICompressProgressInfo *)
+{
+  return S_OK;
+}
+
+#endif
+
 Z7_COM7F_IMF(CCopyCoder::SetFinishMode(UInt32 /* finishMode */))
 {
   return S_OK;
@@ -33,6 +201,11 @@ Z7_COM7F_IMF(CCopyCoder::Code(ISequentialInStream *inStream,
   }
 
   TotalSize = 0;
+
+  if (outStream)
+  {
+    RINOK(Code_KernelCopy(inStream, outStream, outSize, progress))
+  }
   
   for (;;)
   {
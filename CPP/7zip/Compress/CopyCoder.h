@@ -19,6 +19,9 @@ Z7_CLASS_IMP_COM_5(
 )
   Byte *_buf;
   CMyComPtr<ISequentialInStream> _inStream;
+
+  HRESULT Code_KernelCopy(ISequentialInStream *inStream, ISequentialOutStream *outStream,
+      const UInt64 *outSize, ICompressProgressInfo *progress);
 public:
   UInt64 TotalSize;
   
@@ -0,0 +1,375 @@
+// DmgTest.cpp - tests for multithreaded decoding in DMG handler
+
+#include "StdAfx.h"
+
+#include "../../../C/7zCrc.h"
+#include "../../../C/CpuArch.h"
+
+#include "../../Common/MyInitGuid.h"
+
+#include "../../Common/IntToString.h"
+
+#include "../Common/StreamObjects.h"
+#include "../Common/StreamUtils.h"
+
+#include "../ICoder.h"
+
+#include "HandlerTest.h"
+
+/* The test image contains (kNumFiles) partitions (files in handler).
+   Each file contains (kNumBlocks) blocks of (kBlockSize) bytes.
+   Most of blocks use ADC method with literals only, so it's simple to write them.
+   There are also one COPY block and one ZERO block in each file. */
+
+static const UInt32 METHOD_ZERO_0  = 0;
+static const UInt32 METHOD_COPY    = 1;
+static const UInt32 METHOD_ADC     = 0x80000004;
+static const UInt32 METHOD_END     = 0xFFFFFFFF;
+
+static const unsigned kNumFiles = 3;
+static const unsigned kNumBlocks = 24;
+static const unsigned kBlockSizeLog = 16;
+static const size_t kBlockSize = (size_t)1 << kBlockSizeLog;
+static const size_t kFileSize = kBlockSize * kNumBlocks;
+
+// the memory for one thread in handler: packed block + unpacked block + overhead
+static const UInt64 kBlockMem = (kBlockSize + kBlockSize / 128) + kBlockSize + (1 << 16);
+
+static CByteBuffer g_Files[kNumFiles];
+static CByteBuffer g_Image;
+
+static UInt32 GetBlockMethod(unsigned blockIndex)
+{
+  if (blockIndex == 5)
+    return METHOD_COPY;
+  if (blockIndex == 11)
+    return METHOD_ZERO_0;
+  return METHOD_ADC;
+}
+
+static void Base64Encode(AString &s, const Byte *data, size_t size)
+{
+  static const char * const kChars =
+      "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+  for (size_t i = 0; i < size; i += 3)
+  {
+    UInt32 v = (UInt32)data[i] << 16;
+    if (i + 1 < size) v |= (UInt32)data[i + 1] << 8;
+    if (i + 2 < size) v |= data[i + 2];
+    s += kChars[(v >> 18) & 63];
+    s += kChars[(v >> 12) & 63];
+    s += (i + 1 < size) ? kChars[(v >> 6) & 63] : '=';
+    s += (i + 2 < size) ? kChars[v & 63] : '=';
+  }
+}
+
+static void CreateImage()
+{
+  CMyComPtr2_Create<ISequentialOutStream, CDynBufSeqOutStream> out;
+  AString xml;
+  xml += "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+      "<plist version=\"1.0\">\n<dict>\n<key>resource-fork</key>\n<dict>\n"
+      "<key>blkx</key>\n<array>\n";
+
+  UInt64 dataPos = 0;
+  UInt64 startSector = 0;
+
+  for (unsigned f = 0; f < kNumFiles; f++)
+  {
+    CByteBuffer &file = g_Files[f];
+    file.Alloc(kFileSize);
+    UInt32 v = f + 1;
+    for (size_t i = 0; i < kFileSize; i++)
+    {
+      v = v * 1103515245 + 12345;
+      file[i] = (Byte)(v >> 16);
+    }
+    memset(file + ((size_t)11 << kBlockSizeLog), 0, kBlockSize);
+
+    const unsigned kHeadSize = 0xCC;
+    const unsigned kRecordSize = 40;
+    CByteBuffer mish(kHeadSize + (kNumBlocks + 1) * kRecordSize);
+    memset(mish, 0, mish.Size());
+    Byte *p = mish;
+    SetBe32(p, 0x6D697368) // "mish"
+    SetBe32(p + 4, 1)
+    SetBe64(p + 8, startSector)
+    SetBe64(p + 0x10, kFileSize >> 9)
+    SetBe64(p + 0x18, dataPos)
+    SetBe32(p + 0x24, f)
+    SetBe32(p + 0x40, 2) // CRC
+    SetBe32(p + 0x44, 32)
+    SetBe32(p + 0x48, CrcCalc(file, kFileSize))
+    SetBe32(p + 0xC8, kNumBlocks + 1)
+
+    UInt64 packPos = 0;
+    for (unsigned b = 0; b <= kNumBlocks; b++)
+    {
+      Byte *r = p + kHeadSize + b * kRecordSize;
+      if (b == kNumBlocks)
+      {
+        SetBe32(r, METHOD_END)
+        SetBe64(r + 8, kFileSize >> 9)
+        break;
+      }
+      const UInt32 method = GetBlockMethod(b);
+      const Byte *src = file + ((size_t)b << kBlockSizeLog);
+      UInt64 packSize = 0;
+      if (method == METHOD_COPY)
+      {
+        WriteStream(out, src, kBlockSize);
+        packSize = kBlockSize;
+      }
+      else if (method == METHOD_ADC)
+      {
+        for (size_t i = 0; i < kBlockSize; i += 128)
+        {
+          const Byte c = 0x80 + 127;
+          WriteStream(out, &c, 1);
+          WriteStream(out, src + i, 128);
+          packSize += 1 + 128;
+        }
+      }
+      SetBe32(r, method)
+      SetBe64(r + 8, (UInt64)b << (kBlockSizeLog - 9))
+      SetBe64(r + 0x10, (UInt64)1 << (kBlockSizeLog - 9))
+      SetBe64(r + 0x18, packPos)
+      SetBe64(r + 0x20, packSize)
+      packPos += packSize;
+    }
+
+    xml += "<dict>\n<key>Data</key>\n<data>";
+    Base64Encode(xml, mish, mish.Size());
+    xml += "</data>\n<key>Name</key>\n<string>f";
+    xml.Add_UInt32(f);
+    xml += "</string>\n</dict>\n";
+
+    dataPos += packPos;
+    startSector += kFileSize >> 9;
+  }
+
+  xml += "</array>\n</dict>\n</dict>\n</plist>\n";
+  WriteStream(out, xml.Ptr(), xml.Len());
+
+  Byte koly[0x200];
+  memset(koly, 0, sizeof(koly));
+  memcpy(koly, "koly", 4);
+  SetBe32(koly + 4, 4)
+  SetBe32(koly + 8, 0x200)
+  SetBe64(koly + 0x18, 0)
+  SetBe64(koly + 0x20, dataPos)
+  SetBe64(koly + 0xD8, dataPos)
+  SetBe64(koly + 0xE0, xml.Len())
+  SetBe64(koly + 0x1EC, startSector)
+  WriteStream(out, koly, sizeof(koly));
+
+  out->CopyToBuffer(g_Image);
+}
+
+
+class CExtractCallback Z7_final:
+  public IArchiveExtractCallback,
+  public CMyUnknownImp
+{
+  Z7_IFACES_IMP_UNK_1(IArchiveExtractCallback)
+  Z7_IFACE_COM7_IMP(IProgress)
+
+  CMyComPtr2<ISequentialOutStream, CDynBufSeqOutStream> _outStream;
+  UInt32 _index;
+public:
+  CByteBuffer Data[kNumFiles];
+  Int32 OpRes[kNumFiles];
+
+  CExtractCallback()
+  {
+    for (unsigned i = 0; i < kNumFiles; i++)
+      OpRes[i] = -1;
+  }
+};
+
+Z7_COM7F_IMF(CExtractCallback::SetTotal(UInt64 /* total */))
+{
+  return S_OK;
+}
+
+Z7_COM7F_IMF(CExtractCallback::SetCompleted(const UInt64 * /* completeValue */))
+{
+  return S_OK;
+}
+
+Z7_COM7F_IMF(CExtractCallback::GetStream(UInt32 index, ISequentialOutStream **outStream, Int32 /* askExtractMode */))
+{
+  *outStream = NULL;
+  if (index >= kNumFiles)
+    return E_FAIL;
+  _index = index;
+  _outStream.Create_if_Empty();
+  _outStream->Init();
+  CMyComPtr<ISequentialOutStream> temp = _outStream.Interface();
+  *outStream = temp.Detach();
+  return S_OK;
+}
+
+Z7_COM7F_IMF(CExtractCallback::PrepareOperation(Int32 /* askExtractMode */))
+{
+  return S_OK;
+}
+
+Z7_COM7F_IMF(CExtractCallback::SetOperationResult(Int32 opRes))
+{
+  OpRes[_index] = opRes;
+  _outStream->CopyToBuffer(Data[_index]);
+  return S_OK;
+}
+
+
+static HRESULT OpenImage(CMyComPtr<IInArchive> &archive, const wchar_t *memUse)
+{
+  const CArcInfo *arcInfo = FindArc("Dmg");
+  if (!arcInfo)
+    return E_FAIL;
+  archive = arcInfo->CreateInArchive();
+  RINOK(SetHandlerProps(archive, L"4", memUse))
+  CMyComPtr2_Create<IInStream, CBufferInStream> inStream;
+  inStream->Buf.CopyFrom(g_Image, g_Image.Size());
+  inStream->Init();
+  RINOK(archive->Open(inStream, NULL, NULL))
+  UInt32 numItems = 0;
+  RINOK(archive->GetNumberOfItems(&numItems))
+  return numItems == kNumFiles ? S_OK : S_FALSE;
+}
+
+static bool CheckExtract(IInArchive *archive)
+{
+  CMyComPtr2_Create<IArchiveExtractCallback, CExtractCallback> callback;
+  if (archive->Extract(NULL, (UInt32)(Int32)-1, 0, callback) != S_OK)
+    return false;
+  for (unsigned i = 0; i < kNumFiles; i++)
+    if (callback->OpRes[i] != NArchive::NExtract::NOperationResult::kOK
+        || callback->Data[i].Size() != kFileSize
+        || memcmp(callback->Data[i], g_Files[i], kFileSize) != 0)
+      return false;
+  return true;
+}
+
+
+// the threads are created once, and they are kept in handler for next Extract() calls
+static bool TestExtract()
+{
+  g_TestFailed = false;
+
+  const unsigned numThreads0 = GetNumProcessThreads();
+  {
+    CMyComPtr<IInArchive> archive;
+    TEST_ASSERT(OpenImage(archive, NULL) == S_OK, "can't open image")
+    TEST_ASSERT(CheckExtract(archive), "wrong extracted data")
+    TEST_ASSERT(CheckNumNewThreads(numThreads0, 1, 4), "multithreaded decoding was not used")
+    const unsigned numThreads1 = GetNumProcessThreads();
+    TEST_ASSERT(CheckExtract(archive), "wrong extracted data")
+    TEST_ASSERT(CheckNumNewThreads(numThreads1, 0, 0), "new threads were created for second Extract()")
+  }
+  TEST_ASSERT(CheckNumNewThreads(numThreads0, 0, 0), "the threads were not finished with handler")
+
+  TEST_SUCCESS()
+}
+
+/* several streams of same handler are read in turn.
+   The streams keep the decoder threads after the archive object is released. */
+static bool TestStreams()
+{
+  g_TestFailed = false;
+
+  const unsigned numThreads0 = GetNumProcessThreads();
+  CMyComPtr<IInArchive> archive;
+  TEST_ASSERT(OpenImage(archive, NULL) == S_OK, "can't open image")
+  CMyComPtr<ISequentialInStream> streams[kNumFiles];
+  size_t positions[kNumFiles];
+  {
+    Z7_DECL_CMyComPtr_QI_FROM(IInArchiveGetStream, getStream, archive)
+    TEST_ASSERT(getStream, "IInArchiveGetStream is not supported")
+    for (unsigned i = 0; i < kNumFiles; i++)
+    {
+      TEST_ASSERT(getStream->GetStream(i, &streams[i]) == S_OK && streams[i], "GetStream failed")
+      positions[i] = 0;
+    }
+  }
+
+  for (unsigned step = 0;; step++)
+  {
+    bool finished = true;
+    for (unsigned i = 0; i < kNumFiles; i++)
+    {
+      if (positions[i] >= kFileSize)
+        continue;
+      finished = false;
+      size_t cur = 50000 + ((step + i) % 3) * 30000;
+      if (cur > kFileSize - positions[i])
+        cur = kFileSize - positions[i];
+      CByteBuffer buf(cur);
+      size_t processed = cur;
+      TEST_ASSERT(ReadStream(streams[i], buf, &processed) == S_OK && processed == cur, "Read failed")
+      TEST_ASSERT(memcmp(buf, g_Files[i] + positions[i], cur) == 0, "wrong data")
+      positions[i] += cur;
+    }
+    if (finished)
+      break;
+    // the archive object is released before the streams
+    if (step == 1)
+      archive.Release();
+  }
+
+  // the streams share the threads of handler
+  TEST_ASSERT(CheckNumNewThreads(numThreads0, 1, 4), "the threads of handler were not shared")
+  for (unsigned i = 0; i < kNumFiles; i++)
+    streams[i].Release();
+  TEST_ASSERT(CheckNumNewThreads(numThreads0, 0, 0), "the threads were not finished")
+
+  TEST_SUCCESS()
+}
+
+// the number of threads is reduced, if the buffers of threads exceed "memuse" limit
+static bool TestMemLimit()
+{
+  g_TestFailed = false;
+
+  const unsigned numThreads0 = GetNumProcessThreads();
+  {
+    CMyComPtr<IInArchive> archive;
+    wchar_t memUse[32];
+    ConvertUInt64ToString(kBlockMem * 2 + 100, memUse);
+    TEST_ASSERT(OpenImage(archive, memUse) == S_OK, "can't open image")
+    TEST_ASSERT(CheckExtract(archive), "wrong extracted data")
+    TEST_ASSERT(CheckNumNewThreads(numThreads0, 1, 2), "memuse limit was not applied")
+  }
+  {
+    CMyComPtr<IInArchive> archive;
+    wchar_t memUse[32];
+    ConvertUInt64ToString(kBlockMem, memUse);
+    TEST_ASSERT(OpenImage(archive, memUse) == S_OK, "can't open image")
+    TEST_ASSERT(CheckExtract(archive), "wrong extracted data")
+    TEST_ASSERT(CheckNumNewThreads(numThreads0, 0, 0), "multithreaded decoding was not disabled")
+  }
+  {
+    const CArcInfo *arcInfo = FindArc("Dmg");
+    TEST_ASSERT(arcInfo, "handler is not registered")
+    CMyComPtr<IInArchive> archive = arcInfo->CreateInArchive();
+    TEST_ASSERT(CheckWrongProps(archive), "wrong property was accepted")
+  }
+
+  TEST_SUCCESS()
+}
+
+
+int main(int /* argc */, char * /* argv */[])
+{
+  PrintTestSuiteHeader("Dmg");
+
+  CrcGenerateTable();
+  CreateImage();
+
+  TestExtract();
+  TestStreams();
+  TestMemLimit();
+
+  return PrintTestResults();
+}
@@ -0,0 +1,171 @@
+// HandlerTest.h - common code for the tests of archive handlers
+// It is included once in each test program, so it contains the definitions.
+
+#ifndef ZIP7_INC_HANDLER_TEST_H
+#define ZIP7_INC_HANDLER_TEST_H
+
+#include <stdio.h>
+#include <string.h>
+
+#ifdef __linux__
+#include <dirent.h>
+#endif
+
+#include "../../Windows/PropVariant.h"
+
+#include "../Common/RegisterArc.h"
+
+static bool g_TestFailed = false;
+static unsigned g_TestsPassed = 0;
+static unsigned g_TestsFailed = 0;
+
+#define TEST_ASSERT(condition, message) \
+  if (!(condition)) { \
+    printf("FAIL: %s - %s\n", __FUNCTION__, message); \
+    g_TestFailed = true; \
+    g_TestsFailed++; \
+    return false; \
+  }
+
+#define TEST_SUCCESS() \
+  if (!g_TestFailed) { \
+    printf("PASS: %s\n", __FUNCTION__); \
+    g_TestsPassed++; \
+    return true; \
+  } \
+  return false;
+
+inline void PrintTestSuiteHeader(const char *name)
+{
+  printf("===========================================\n");
+  printf("%s Test Suite\n", name);
+  printf("===========================================\n\n");
+}
+
+// it returns the exit code of test program
+inline int PrintTestResults()
+{
+  printf("\n===========================================\n");
+  printf("Test Results\n");
+  printf("===========================================\n");
+  printf("Passed: %u\n", g_TestsPassed);
+  printf("Failed: %u\n", g_TestsFailed);
+  printf("Total:  %u\n", g_TestsPassed + g_TestsFailed);
+  printf("===========================================\n");
+  return g_TestsFailed == 0 ? 0 : 1;
+}
+
+
+// the handlers register themselves via RegisterArc()
+
+static const unsigned kNumArcsMax = 4;
+static const CArcInfo *g_Arcs[kNumArcsMax];
+static unsigned g_NumArcs;
+
+void RegisterArc(const CArcInfo *arcInfo) throw()
+{
+  if (g_NumArcs < kNumArcsMax)
+    g_Arcs[g_NumArcs++] = arcInfo;
+}
+
+inline const CArcInfo *FindArc(const char *name)
+{
+  for (unsigned i = 0; i < g_NumArcs; i++)
+    if (strcmp(g_Arcs[i]->Name, name) == 0)
+      return g_Arcs[i];
+  return NULL;
+}
+
+// HandlerCont.cpp checks the images that contain ext file system. We don't need it here
+
+namespace NArchive {
+namespace NExt {
+API_FUNC_IsArc IsArc_Ext(const Byte *p, size_t size);
+API_FUNC_IsArc IsArc_Ext(const Byte * /* p */, size_t /* size */)
+{
+  return k_IsArc_Res_NO;
+}
+}}
+
+
+// it sets "mt" and "memuse" properties. NULL value means that property is not set
+
+inline HRESULT SetHandlerProps(IInArchive *archive, const wchar_t *numThreads, const wchar_t *memUse)
+{
+  Z7_DECL_CMyComPtr_QI_FROM(ISetProperties, setProperties, archive)
+  if (!setProperties)
+    return E_NOINTERFACE;
+  const wchar_t *names[2];
+  NWindows::NCOM::CPropVariant values[2];
+  UInt32 numProps = 0;
+  if (numThreads)
+  {
+    names[numProps] = L"mt";
+    values[numProps] = numThreads;
+    numProps++;
+  }
+  if (memUse)
+  {
+    names[numProps] = L"memuse";
+    values[numProps] = memUse;
+    numProps++;
+  }
+  return setProperties->SetProperties(names, values, numProps);
+}
+
+// unknown properties and wrong "memuse" values must be rejected by handler
+
+inline bool CheckWrongProps(IInArchive *archive)
+{
+  Z7_DECL_CMyComPtr_QI_FROM(ISetProperties, setProperties, archive)
+  if (!setProperties)
+    return false;
+  const wchar_t *names[] = { L"x" };
+  NWindows::NCOM::CPropVariant values[1];
+  if (setProperties->SetProperties(names, values, 1) != E_INVALIDARG)
+    return false;
+  return SetHandlerProps(archive, NULL, L"bad") == E_INVALIDARG;
+}
+
+
+// it returns the number of threads in process, or 0, if it's not supported
+
+inline unsigned GetNumProcessThreads()
+{
+  unsigned num = 0;
+ #ifdef __linux__
+  DIR *dir = opendir("/proc/self/task");
+  if (!dir)
+    return 0;
+  for (;;)
+  {
+    const struct dirent *de = readdir(dir);
+    if (!de)
+      break;
+    if (de->d_name[0] != '.')
+      num++;
+  }
+  closedir(dir);
+ #endif
+  return num;
+}
+
+/* it checks that the handler has created from (minThreads) to (maxThreads) decoder threads
+   since (numThreads0) was returned by GetNumProcessThreads().
+   The handlers don't create threads in single-threaded build.
+   It returns (true), if the number of threads in process is not supported. */
+
+inline bool CheckNumNewThreads(unsigned numThreads0, unsigned minThreads, unsigned maxThreads)
+{
+  if (numThreads0 == 0)
+    return true;
+ #ifdef Z7_ST
+  minThreads = 0;
+  maxThreads = 0;
+ #endif
+  const unsigned num = GetNumProcessThreads();
+  return num >= numThreads0 + minThreads
+      && num <= numThreads0 + maxThreads;
+}
+
+#endif
@@ -0,0 +1,319 @@
+// ImgTest.cpp - tests for properties and multithreaded decoding in image handlers
+
+#include "StdAfx.h"
+
+#include "../../../C/CpuArch.h"
+
+#include "../../Common/MyInitGuid.h"
+
+#include "../../Common/IntToString.h"
+
+#include "../Common/StreamObjects.h"
+#include "../Common/StreamUtils.h"
+
+#include "../ICoder.h"
+
+#include "HandlerTest.h"
+
+/* The test images are QCOW2 image and VMDK (streamOptimized) image
+   with (kNumClusters) clusters (grains) of same data.
+   Most of clusters are compressed. Compressed cluster is deflate stream
+   with one stored block, so we don't need deflate encoder here.
+   There are also unallocated (zero) clusters, and QCOW2 image contains uncompressed clusters. */
+
+static const unsigned kClusterBits = 12;
+static const size_t kClusterSize = (size_t)1 << kClusterBits;
+static const unsigned kNumClusters = 64;
+static const size_t kImageSize = kClusterSize * kNumClusters;
+
+// size of deflate stream with one stored block
+static const size_t kStoredSize = 5 + kClusterSize;
+static const unsigned kNumPackSectors = (unsigned)((kStoredSize + 511) >> 9);
+
+static CByteBuffer g_Data;
+static CByteBuffer g_Image;
+static CByteBuffer g_ImageVmdk;
+
+static bool IsZeroCluster(unsigned i) { return i % 7 == 3; }
+static bool IsCopyCluster(unsigned i) { return i % 11 == 5; }
+
+// it writes deflate stream with one stored block that contains (kClusterSize) bytes
+static void WriteStoredBlock(Byte *d, const Byte *src)
+{
+  d[0] = 1; // final stored block
+  SetUi16(d + 1, (UInt16)kClusterSize)
+  SetUi16(d + 3, (UInt16)~kClusterSize)
+  memcpy(d + 5, src, kClusterSize);
+}
+
+static void CreateData()
+{
+  g_Data.Alloc(kImageSize);
+  UInt32 v = 1;
+  for (size_t i = 0; i < kImageSize; i++)
+  {
+    v = v * 1103515245 + 12345;
+    g_Data[i] = (Byte)(v >> 16);
+  }
+  for (unsigned i = 0; i < kNumClusters; i++)
+    if (IsZeroCluster(i))
+      memset(g_Data + ((size_t)i << kClusterBits), 0, kClusterSize);
+}
+
+static void CreateImage()
+{
+  // header in cluster 0, L1 table in cluster 1, L2 table in cluster 2
+  const size_t kMaxSize = kClusterSize * 3 + (size_t)kNumClusters * (kClusterSize + kNumPackSectors * 512);
+  CByteBuffer buf(kMaxSize);
+  memset(buf, 0, kMaxSize);
+  Byte *p = buf;
+  SetBe32(p, 0x514649fb) // "QFI\xFB"
+  SetBe32(p + 4, 2)
+  SetBe32(p + 0x14, kClusterBits)
+  SetBe64(p + 0x18, kImageSize)
+  SetBe32(p + 0x24, 1)
+  SetBe64(p + 0x28, kClusterSize)
+  SetBe64(p + kClusterSize, kClusterSize * 2)
+
+  Byte *l2 = p + kClusterSize * 2;
+  size_t pos = kClusterSize * 3;
+  const unsigned numOffsetBits = 62 - (kClusterBits - 8);
+
+  for (unsigned i = 0; i < kNumClusters; i++)
+  {
+    const Byte *src = g_Data + ((size_t)i << kClusterBits);
+    UInt64 rec = 0;
+    if (IsZeroCluster(i))
+    {
+    }
+    else if (IsCopyCluster(i))
+    {
+      pos = (pos + kClusterSize - 1) & ~(kClusterSize - 1);
+      memcpy(p + pos, src, kClusterSize);
+      rec = pos;
+      pos += kClusterSize;
+    }
+    else
+    {
+      // the deflate stream ends at the end of the last sector
+      const size_t offsetInSector = kNumPackSectors * 512 - kStoredSize;
+      WriteStoredBlock(p + pos + offsetInSector, src);
+      rec = ((UInt64)1 << 62)
+          | ((UInt64)(kNumPackSectors - 1) << numOffsetBits)
+          | (pos + offsetInSector);
+      pos += kNumPackSectors * 512;
+    }
+    SetBe64(l2 + (size_t)i * 8, rec)
+  }
+  g_Image.CopyFrom(buf, pos);
+}
+
+
+static UInt32 Adler32(const Byte *data, size_t size)
+{
+  UInt32 a = 1, b = 0;
+  for (size_t i = 0; i < size; i++)
+  {
+    a = (a + data[i]) % 65521;
+    b = (b + a) % 65521;
+  }
+  return (b << 16) | a;
+}
+
+/* VMDK image (without descriptor) with markers:
+     sector 0     : header
+     sector 1     : marker of grain directory
+     sector 2     : grain directory
+     sector 3     : marker of grain table
+     sectors 4-7  : grain table
+     sector 8 ... : grains, each grain is aligned for sector.
+   Grain contains 12 bytes of grain marker and zlib stream. */
+
+static const size_t kZlibSize = 2 + kStoredSize + 4;
+static const size_t kGrainSize = (12 + kZlibSize + 511) & ~(size_t)511;
+
+static void CreateImageVmdk()
+{
+  const unsigned kGrainSectors = (unsigned)(kClusterSize >> 9);
+  const size_t kMaxSize = ((size_t)8 << 9) + (size_t)kNumClusters * kGrainSize;
+  CByteBuffer buf(kMaxSize);
+  memset(buf, 0, kMaxSize);
+  Byte *p = buf;
+  memcpy(p, "KDMV", 4);
+  SetUi32(p + 0x04, 3)
+  SetUi32(p + 0x08, ((UInt32)1 << 16) | ((UInt32)1 << 17)) // compressed grains, markers
+  SetUi64(p + 0x0C, (UInt64)kNumClusters * kGrainSectors) // capacity
+  SetUi64(p + 0x14, kGrainSectors)
+  SetUi32(p + 0x2C, 512) // number of entries in grain table
+  SetUi64(p + 0x38, 2) // grain directory offset
+  SetUi64(p + 0x40, 8) // overHead
+  SetUi16(p + 0x4D, 1) // deflate
+
+  // marker: (NumSectors), (SpecSize = 0), (Type)
+  SetUi64(p + 512 * 1, 1)
+  SetUi32(p + 512 * 1 + 12, 2)
+  SetUi32(p + 512 * 2, 4)
+  SetUi64(p + 512 * 3, 4)
+  SetUi32(p + 512 * 3 + 12, 1)
+
+  Byte *gt = p + 512 * 4;
+  size_t pos = (size_t)8 << 9;
+
+  for (unsigned i = 0; i < kNumClusters; i++)
+  {
+    if (IsZeroCluster(i))
+      continue;
+    const Byte *src = g_Data + ((size_t)i << kClusterBits);
+    Byte *d = p + pos;
+    SetUi64(d, (UInt64)i * kGrainSectors)
+    SetUi32(d + 8, (UInt32)kZlibSize)
+    d += 12;
+    d[0] = 0x78;
+    d[1] = 1;
+    WriteStoredBlock(d + 2, src);
+    SetBe32(d + 2 + kStoredSize, Adler32(src, kClusterSize))
+    SetUi32(gt + (size_t)i * 4, (UInt32)(pos >> 9))
+    pos += kGrainSize;
+  }
+  g_ImageVmdk.CopyFrom(buf, pos);
+}
+
+
+static HRESULT OpenImage(CMyComPtr<IInArchive> &archive, const char *arcName,
+    const wchar_t *numThreads, const wchar_t *memUse)
+{
+  const CArcInfo *arcInfo = FindArc(arcName);
+  if (!arcInfo)
+    return E_FAIL;
+  archive = arcInfo->CreateInArchive();
+  RINOK(SetHandlerProps(archive, numThreads, memUse))
+  CMyComPtr2_Create<IInStream, CBufferInStream> inStream;
+  const CByteBuffer &image = (strcmp(arcName, "VMDK") == 0) ? g_ImageVmdk : g_Image;
+  inStream->Buf.CopyFrom(image, image.Size());
+  inStream->Init();
+  return archive->Open(inStream, NULL, NULL);
+}
+
+static bool CheckStream(IInArchive *archive, size_t chunkSize)
+{
+  CMyComPtr<ISequentialInStream> stream;
+  {
+    Z7_DECL_CMyComPtr_QI_FROM(IInArchiveGetStream, getStream, archive)
+    if (!getStream || getStream->GetStream(0, &stream) != S_OK || !stream)
+      return false;
+  }
+  CByteBuffer buf(chunkSize);
+  for (size_t pos = 0; pos < kImageSize;)
+  {
+    size_t cur = chunkSize;
+    if (cur > kImageSize - pos)
+      cur = kImageSize - pos;
+    size_t processed = cur;
+    if (ReadStream(stream, buf, &processed) != S_OK || processed != cur)
+      return false;
+    if (memcmp(buf, g_Data + pos, cur) != 0)
+      return false;
+    pos += cur;
+  }
+  return true;
+}
+
+
+// only the handlers that support "mt" and "memuse" properties expose ISetProperties
+static bool TestSetPropertiesInterface()
+{
+  g_TestFailed = false;
+
+  const CArcInfo *arcInfo = FindArc("VHD");
+  TEST_ASSERT(arcInfo, "VHD handler is not registered")
+  {
+    CMyComPtr<IInArchive> archive = arcInfo->CreateInArchive();
+    Z7_DECL_CMyComPtr_QI_FROM(ISetProperties, setProperties, archive)
+    TEST_ASSERT(!setProperties, "VHD handler exposes ISetProperties")
+  }
+  const char * const arcNames[] = { "QCOW", "VMDK" };
+  for (unsigned i = 0; i < Z7_ARRAY_SIZE(arcNames); i++)
+  {
+    arcInfo = FindArc(arcNames[i]);
+    TEST_ASSERT(arcInfo, "handler is not registered")
+    CMyComPtr<IInArchive> archive = arcInfo->CreateInArchive();
+    TEST_ASSERT(CheckWrongProps(archive), "wrong property was accepted")
+  }
+
+  TEST_SUCCESS()
+}
+
+/* the compressed clusters are decoded in (mt) threads for sequential reading,
+   and the data is same for any reading pattern */
+static bool TestMtRead(const char *arcName)
+{
+  g_TestFailed = false;
+
+  const unsigned numThreads0 = GetNumProcessThreads();
+  {
+    CMyComPtr<IInArchive> archive;
+    TEST_ASSERT(OpenImage(archive, arcName, L"4", NULL) == S_OK, "can't open image")
+    TEST_ASSERT(CheckStream(archive, 10000), "wrong data")
+    TEST_ASSERT(CheckNumNewThreads(numThreads0, 1, 4), "multithreaded decoding was not used")
+    // unaligned small reads
+    TEST_ASSERT(CheckStream(archive, 777), "wrong data")
+    // cluster by cluster reads: each read continues sequential reading
+    TEST_ASSERT(CheckStream(archive, kClusterSize), "wrong data")
+  }
+  TEST_ASSERT(CheckNumNewThreads(numThreads0, 0, 0), "the threads were not finished with handler")
+  {
+    CMyComPtr<IInArchive> archive;
+    TEST_ASSERT(OpenImage(archive, arcName, L"1", NULL) == S_OK, "can't open image")
+    TEST_ASSERT(CheckStream(archive, 10000), "wrong data")
+    TEST_ASSERT(CheckNumNewThreads(numThreads0, 0, 0), "threads were created for mt1")
+  }
+
+  TEST_SUCCESS()
+}
+
+// the number of threads is reduced, if the buffers of threads exceed "memuse" limit
+static bool TestMemLimit(const char *arcName)
+{
+  g_TestFailed = false;
+
+  const unsigned numThreads0 = GetNumProcessThreads();
+  {
+    CMyComPtr<IInArchive> archive;
+    wchar_t memUse[32];
+    ConvertUInt64ToString((UInt64)(kClusterSize * 4) * 2 + 100, memUse);
+    TEST_ASSERT(OpenImage(archive, arcName, L"4", memUse) == S_OK, "can't open image")
+    TEST_ASSERT(CheckStream(archive, 10000), "wrong data")
+    TEST_ASSERT(CheckNumNewThreads(numThreads0, 1, 2), "memuse limit was not applied")
+  }
+  {
+    CMyComPtr<IInArchive> archive;
+    wchar_t memUse[32];
+    ConvertUInt64ToString((UInt64)kClusterSize, memUse);
+    TEST_ASSERT(OpenImage(archive, arcName, L"4", memUse) == S_OK, "can't open image")
+    TEST_ASSERT(CheckStream(archive, 10000), "wrong data")
+    TEST_ASSERT(CheckNumNewThreads(numThreads0, 0, 0), "multithreaded decoding was not disabled")
+  }
+
+  TEST_SUCCESS()
+}
+
+
+int main(int /* argc */, char * /* argv */[])
+{
+  PrintTestSuiteHeader("Img");
+
+  CreateData();
+  CreateImage();
+  CreateImageVmdk();
+
+  TestSetPropertiesInterface();
+  const char * const arcNames[] = { "QCOW", "VMDK" };
+  for (unsigned i = 0; i < Z7_ARRAY_SIZE(arcNames); i++)
+  {
+    printf("%s:\n", arcNames[i]);
+    TestMtRead(arcNames[i]);
+    TestMemLimit(arcNames[i]);
+  }
+
+  return PrintTestResults();
+}
@@ -0,0 +1,286 @@
+// IoBatchTest.cpp - tests for NIO::CIoBatch (io_uring batch of write and close operations)
+
+#include "StdAfx.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "../../Windows/FileDir.h"
+#include "../../Windows/FileFind.h"
+#include "../../Windows/FileIO.h"
+#include "../../Windows/FileName.h"
+
+using namespace NWindows;
+using namespace NFile;
+
+static bool g_TestFailed = false;
+static unsigned g_TestsPassed = 0;
+static unsigned g_TestsFailed = 0;
+
+#define TEST_ASSERT(condition, message) \
+  if (!(condition)) { \
+    printf("FAIL: %s - %s\n", __FUNCTION__, message); \
+    g_TestFailed = true; \
+    g_TestsFailed++; \
+    return false; \
+  }
+
+#define TEST_SUCCESS() \
+  if (!g_TestFailed) { \
+    printf("PASS: %s\n", __FUNCTION__); \
+    g_TestsPassed++; \
+    return true; \
+  } \
+  return false;
+
+#ifdef Z7_IO_URING
+
+static FString g_TestDir;
+
+static void FillData(CByteBuffer &buf, size_t size, unsigned seed)
+{
+  buf.Alloc(size);
+  for (size_t i = 0; i < size; i++)
+    buf[i] = (Byte)(i * 7 + seed);
+}
+
+static bool CheckFileData(const FString &path, size_t size, unsigned seed)
+{
+  NIO::CInFile file;
+  if (!file.Open(path))
+    return false;
+  CByteBuffer buf(size + 1);
+  size_t processed;
+  if (!file.ReadFull(buf, size + 1, processed) || processed != size)
+    return false;
+  for (size_t i = 0; i < size; i++)
+    if (buf[i] != (Byte)(i * 7 + seed))
+      return false;
+  return true;
+}
+
+static FString GetTestPath(unsigned index)
+{
+  FString path = g_TestDir;
+  path += "f";
+  path.Add_UInt32(index);
+  return path;
+}
+
+// many small files: the data and the times must be written after Flush()
+static bool TestRoundTrip()
+{
+  g_TestFailed = false;
+
+  NIO::CIoBatch batch;
+  TEST_ASSERT(batch.Create(), "Create failed")
+
+  const unsigned kNumFiles = 300;
+  CFiTime mtime;
+  mtime.tv_sec = 1000000000;
+  mtime.tv_nsec = 0;
+
+  for (unsigned i = 0; i < kNumFiles; i++)
+  {
+    NIO::COutFile file;
+    TEST_ASSERT(file.Create_NEW(GetTestPath(i)), "Create_NEW failed")
+    file.SetTime(NULL, NULL, &mtime);
+    CByteBuffer data;
+    const size_t size = 1 + (i * 211) % batch.MaxFileSize;
+    FillData(data, size, i);
+    const Byte *dataPtr = data;
+    TEST_ASSERT(file.Close_Deferred(batch, data, size), "Close_Deferred failed")
+    TEST_ASSERT(file.GetHandle() == -1, "the operation was not queued")
+    // the buffer is passed to batch without copying
+    TEST_ASSERT((const Byte *)data != dataPtr, "the buffer was not passed to batch")
+    // the caller doesn't wait for the file
+    TEST_ASSERT(batch.GetFinishedError(), "unexpected error")
+  }
+  TEST_ASSERT(batch.Flush(), "Flush failed")
+
+  for (unsigned i = 0; i < kNumFiles; i++)
+  {
+    const FString path = GetTestPath(i);
+    TEST_ASSERT(CheckFileData(path, 1 + (i * 211) % batch.MaxFileSize, i), "wrong file data")
+    NFind::CFileInfo fi;
+    TEST_ASSERT(fi.Find(path), "file not found")
+    TEST_ASSERT(fi.MTime.tv_sec == mtime.tv_sec, "wrong file time")
+    TEST_ASSERT(NDir::DeleteFileAlways(path), "can't delete file")
+  }
+
+  TEST_SUCCESS()
+}
+
+/* write error must be reported with the path of failed file, and only once.
+   The operations of other files in the batch are not affected. */
+static bool TestWriteError()
+{
+  g_TestFailed = false;
+
+  NIO::CIoBatch batch;
+  TEST_ASSERT(batch.Create(), "Create failed")
+
+  const unsigned kNumFiles = 100;
+  const unsigned kBadIndex = 40;
+  CByteBuffer data;
+  for (unsigned i = 0; i < kNumFiles; i++)
+  {
+    NIO::COutFile file;
+    if (i == kBadIndex)
+    {
+      if (!file.Open_EXISTING("/dev/full"))
+      {
+        printf("SKIP: %s - /dev/full is not available\n", __FUNCTION__);
+        batch.Flush();
+        return true;
+      }
+    }
+    else
+      TEST_ASSERT(file.Create_NEW(GetTestPath(i)), "Create_NEW failed")
+    FillData(data, 100, i);
+    TEST_ASSERT(file.Close_Deferred(batch, data, 100), "Close_Deferred failed")
+  }
+
+  // the error can be reported by GetFinishedError() or by Flush()
+  unsigned numErrors = 0;
+  for (;;)
+  {
+    errno = 0;
+    if (batch.GetFinishedError())
+      break;
+    TEST_ASSERT(errno == ENOSPC, "wrong error code")
+    TEST_ASSERT(batch.GetErrorPath().IsEqualTo("/dev/full"), "wrong error path")
+    numErrors++;
+  }
+  for (;;)
+  {
+    errno = 0;
+    if (batch.Flush())
+      break;
+    TEST_ASSERT(errno == ENOSPC, "wrong error code")
+    TEST_ASSERT(batch.GetErrorPath().IsEqualTo("/dev/full"), "wrong error path")
+    numErrors++;
+  }
+  TEST_ASSERT(numErrors == 1, "the error was not reported once")
+  TEST_ASSERT(batch.GetFinishedError(), "the error was reported again")
+
+  for (unsigned i = 0; i < kNumFiles; i++)
+    if (i != kBadIndex)
+    {
+      TEST_ASSERT(CheckFileData(GetTestPath(i), 100, i), "wrong file data")
+      TEST_ASSERT(NDir::DeleteFileAlways(GetTestPath(i)), "can't delete file")
+    }
+
+  TEST_SUCCESS()
+}
+
+// the file is deleted before the operations are submitted, so the setting of time fails.
+// The error is ignored, as in COutFile::Close().
+static bool TestTimeError()
+{
+  g_TestFailed = false;
+
+  NIO::CIoBatch batch;
+  TEST_ASSERT(batch.Create(), "Create failed")
+
+  const FString path = GetTestPath(1);
+  NIO::COutFile file;
+  TEST_ASSERT(file.Create_NEW(path), "Create_NEW failed")
+  CFiTime mtime;
+  mtime.tv_sec = 1000000000;
+  mtime.tv_nsec = 0;
+  file.SetTime(NULL, NULL, &mtime);
+  CByteBuffer data;
+  FillData(data, 10, 0);
+  TEST_ASSERT(file.Close_Deferred(batch, data, 10), "Close_Deferred failed")
+  TEST_ASSERT(NDir::DeleteFileAlways(path), "can't delete file")
+
+  TEST_ASSERT(batch.Flush(), "time error was reported")
+
+  TEST_SUCCESS()
+}
+
+// deferred close of input files: the closing error is reported by Flush() with path
+static bool TestClose()
+{
+  g_TestFailed = false;
+
+  NIO::CIoBatch batch;
+  TEST_ASSERT(batch.Create(), "Create failed")
+
+  const FString path = GetTestPath(2);
+  {
+    NIO::COutFile file;
+    TEST_ASSERT(file.Create_NEW(path), "Create_NEW failed")
+    TEST_ASSERT(file.WriteFull("abc", 3), "WriteFull failed")
+  }
+  for (unsigned i = 0; i < 200; i++)
+  {
+    NIO::CInFile file;
+    TEST_ASSERT(file.Open(path), "Open failed")
+    file.Close_Deferred(batch, path);
+    TEST_ASSERT(file.GetHandle() == -1, "the handle was not passed to batch")
+  }
+  TEST_ASSERT(batch.Flush(), "Flush failed")
+
+  // the closing of wrong handle
+  batch.Add_Close(1 << 20, AString("bad_handle"));
+  TEST_ASSERT(!batch.Flush(), "close error was not reported")
+  TEST_ASSERT(batch.GetErrorPath().IsEqualTo("bad_handle"), "wrong error path")
+
+  TEST_ASSERT(NDir::DeleteFileAlways(path), "can't delete file")
+  TEST_SUCCESS()
+}
+
+#endif
+
+int main(int /* argc */, char * /* argv */[])
+{
+  printf("===========================================\n");
+  printf("IoBatch Test Suite\n");
+  printf("===========================================\n\n");
+
+ #ifdef Z7_IO_URING
+  {
+    NIO::CIoBatch batch;
+    if (!batch.Create())
+    {
+      printf("io_uring is not supported. The tests are skipped.\n");
+      return 0;
+    }
+  }
+
+  {
+    FString prefix;
+    if (!NDir::MyGetTempPath(prefix))
+      return 1;
+    NName::NormalizeDirPathPrefix(prefix);
+    prefix += "7zIoBatchTest";
+    AString postfix;
+    if (!NDir::CreateTempFile2(prefix, true, postfix, NULL))
+      return 1;
+    g_TestDir = prefix;
+    g_TestDir += postfix;
+    g_TestDir.Add_PathSepar();
+  }
+
+  TestRoundTrip();
+  TestWriteError();
+  TestTimeError();
+  TestClose();
+
+  NDir::RemoveDirWithSubItems(g_TestDir);
+ #else
+  printf("io_uring is not supported. The tests are skipped.\n");
+ #endif
+
+  printf("\n===========================================\n");
+  printf("Test Results\n");
+  printf("===========================================\n");
+  printf("Passed: %u\n", g_TestsPassed);
+  printf("Failed: %u\n", g_TestsFailed);
+  printf("Total:  %u\n", g_TestsPassed + g_TestsFailed);
+  printf("===========================================\n");
+
+  return g_TestsFailed == 0 ? 0 : 1;
+}
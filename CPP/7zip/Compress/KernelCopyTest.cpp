@@ -0,0 +1,291 @@
+// KernelCopyTest.cpp - tests for kernel-side copy in NCompress::CCopyCoder
+
+#include "StdAfx.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "../../../C/7zCrc.h"
+
+#include "../../Common/MyInitGuid.h"
+
+#include "../../Windows/FileDir.h"
+#include "../../Windows/FileName.h"
+
+#include "../Common/FileStreams.h"
+#include "../Common/LimitedStreams.h"
+
+#include "../Archive/Common/OutStreamWithCRC.h"
+
+#include "CopyCoder.h"
+
+using namespace NWindows;
+using namespace NFile;
+
+static bool g_TestFailed = false;
+static unsigned g_TestsPassed = 0;
+static unsigned g_TestsFailed = 0;
+
+#define TEST_ASSERT(condition, message) \
+  if (!(condition)) { \
+    printf("FAIL: %s - %s\n", __FUNCTION__, message); \
+    g_TestFailed = true; \
+    g_TestsFailed++; \
+    return false; \
+  }
+
+#define TEST_SUCCESS() \
+  if (!g_TestFailed) { \
+    printf("PASS: %s\n", __FUNCTION__); \
+    g_TestsPassed++; \
+    return true; \
+  } \
+  return false;
+
+static FString g_TestDir;
+static const size_t kDataSize = ((size_t)1 << 23) + 12345;
+static CByteBuffer g_Data;
+
+/* the wrapper counts the data that was read through user-space buffer
+   and the data that was transferred by kernel */
+
+Z7_CLASS_IMP_NOQIB_2(
+  CCountingInStream
+  , ISequentialInStream
+  , IStreamKernelCopy
+)
+public:
+  CMyComPtr<ISequentialInStream> Stream;
+  UInt64 ReadSize;
+  UInt64 KernelSize;
+  CCountingInStream(): ReadSize(0), KernelSize(0) {}
+};
+
+Z7_COM7F_IMF(CCountingInStream::Read(void *data, UInt32 size, UInt32 *processedSize))
+{
+  UInt32 processed = 0;
+  const HRESULT res = Stream->Read(data, size, &processed);
+  ReadSize += processed;
+  if (processedSize)
+    *processedSize = processed;
+  return res;
+}
+
+Z7_COM7F_IMF(CCountingInStream::KernelCopy_GetFd(Int32 *fd, UInt64 *limit, Int32 *needData))
+{
+  Z7_DECL_CMyComPtr_QI_FROM(IStreamKernelCopy, kernelCopy, Stream)
+  return kernelCopy->KernelCopy_GetFd(fd, limit, needData);
+}
+
+Z7_COM7F_IMF(CCountingInStream::KernelCopy_Processed(const void *data, UInt32 size))
+{
+  KernelSize += size;
+  Z7_DECL_CMyComPtr_QI_FROM(IStreamKernelCopy, kernelCopy, Stream)
+  return kernelCopy->KernelCopy_Processed(data, size);
+}
+
+
+static FString GetTestPath(const char *name)
+{
+  FString path = g_TestDir;
+  path += name;
+  return path;
+}
+
+static bool CreateSourceFile()
+{
+  g_Data.Alloc(kDataSize);
+  UInt32 v = 1;
+  for (size_t i = 0; i < kDataSize; i++)
+  {
+    v = v * 1103515245 + 12345;
+    g_Data[i] = (Byte)(v >> 16);
+  }
+  COutFileStream *outSpec = new COutFileStream;
+  CMyComPtr<ISequentialOutStream> out = outSpec;
+  if (!outSpec->Create_ALWAYS(GetTestPath("src")))
+    return false;
+  return outSpec->File.WriteFull(g_Data, kDataSize) && outSpec->Close() == S_OK;
+}
+
+static bool CheckDestFile(size_t size)
+{
+  NIO::CInFile file;
+  if (!file.Open(GetTestPath("dest")))
+    return false;
+  CByteBuffer buf(size + 1);
+  size_t processed;
+  if (!file.ReadFull(buf, size + 1, processed) || processed != size)
+    return false;
+  return memcmp(buf, g_Data, size) == 0;
+}
+
+struct CCopyTest
+{
+  CCountingInStream *InSpec;
+  CMyComPtr<ISequentialInStream> In;
+  CInFileStream *FileInSpec;
+  COutFileStream *OutSpec;
+  CMyComPtr<ISequentialOutStream> Out;
+
+  bool Open()
+  {
+    FileInSpec = new CInFileStream;
+    InSpec = new CCountingInStream;
+    In = InSpec;
+    InSpec->Stream = FileInSpec;
+    if (!FileInSpec->Open(GetTestPath("src")))
+      return false;
+    OutSpec = new COutFileStream;
+    Out = OutSpec;
+    return OutSpec->Create_ALWAYS(GetTestPath("dest"));
+  }
+};
+
+
+// the data is copied by kernel, if no stream needs the data
+static bool TestNoCrc()
+{
+  g_TestFailed = false;
+
+  CCopyTest t;
+  TEST_ASSERT(t.Open(), "can't open files")
+  CMyComPtr2_Create<ICompressCoder, NCompress::CCopyCoder> copyCoder;
+  TEST_ASSERT(copyCoder.Interface()->Code(t.In, t.Out, NULL, NULL, NULL) == S_OK, "Code failed")
+  TEST_ASSERT(copyCoder->TotalSize == kDataSize, "wrong TotalSize")
+  TEST_ASSERT(t.InSpec->KernelSize + t.InSpec->ReadSize == kDataSize, "wrong size of processed data")
+  TEST_ASSERT(t.InSpec->KernelSize >= kDataSize / 2, "kernel copy was not used")
+  TEST_ASSERT(t.OutSpec->Close() == S_OK, "Close failed")
+  TEST_ASSERT(CheckDestFile(kDataSize), "wrong data")
+
+  TEST_SUCCESS()
+}
+
+// CRC stream needs the data: the data is copied by kernel, and CRC is calculated for data that was read back
+static bool TestCrc()
+{
+  g_TestFailed = false;
+
+  CCopyTest t;
+  TEST_ASSERT(t.Open(), "can't open files")
+  CMyComPtr2_Create<ISequentialOutStream, COutStreamWithCRC> crcStream;
+  crcStream->SetStream(t.Out);
+  crcStream->Init(true);
+  CMyComPtr2_Create<ICompressCoder, NCompress::CCopyCoder> copyCoder;
+  TEST_ASSERT(copyCoder.Interface()->Code(t.In, crcStream, NULL, NULL, NULL) == S_OK, "Code failed")
+  TEST_ASSERT(copyCoder->TotalSize == kDataSize, "wrong TotalSize")
+  TEST_ASSERT(t.InSpec->KernelSize + t.InSpec->ReadSize == kDataSize, "wrong size of processed data")
+  TEST_ASSERT(t.InSpec->KernelSize >= kDataSize / 2, "kernel copy was not used")
+  TEST_ASSERT(crcStream->GetSize() == kDataSize, "wrong size in CRC stream")
+  TEST_ASSERT(crcStream->GetCRC() == CrcCalc(g_Data, kDataSize), "wrong CRC")
+  TEST_ASSERT(t.OutSpec->Close() == S_OK, "Close failed")
+  TEST_ASSERT(CheckDestFile(kDataSize), "wrong data")
+
+  TEST_SUCCESS()
+}
+
+// the caller disables CRC calculation, so kernel copy can be used
+static bool TestCrcDisabled()
+{
+  g_TestFailed = false;
+
+  CCopyTest t;
+  TEST_ASSERT(t.Open(), "can't open files")
+  CMyComPtr2_Create<ISequentialOutStream, COutStreamWithCRC> crcStream;
+  crcStream->SetStream(t.Out);
+  crcStream->Init(false);
+  CMyComPtr2_Create<ICompressCoder, NCompress::CCopyCoder> copyCoder;
+  TEST_ASSERT(copyCoder.Interface()->Code(t.In, crcStream, NULL, NULL, NULL) == S_OK, "Code failed")
+  TEST_ASSERT(t.InSpec->KernelSize >= kDataSize / 2, "kernel copy was not used")
+  TEST_ASSERT(crcStream->GetSize() == kDataSize, "wrong size in CRC stream")
+  TEST_ASSERT(t.OutSpec->Close() == S_OK, "Close failed")
+  TEST_ASSERT(CheckDestFile(kDataSize), "wrong data")
+
+  TEST_SUCCESS()
+}
+
+// the limits of wrapper streams and (outSize) must be respected,
+// and the position of input stream must be correct after copying
+static bool TestLimits()
+{
+  g_TestFailed = false;
+
+  CCopyTest t;
+  TEST_ASSERT(t.Open(), "can't open files")
+  const UInt64 kLimit = ((UInt64)1 << 22) + 777;
+  const UInt64 kOutSize = ((UInt64)1 << 21) + 333;
+
+  CMyComPtr2_Create<ISequentialInStream, CLimitedSequentialInStream> limitedIn;
+  limitedIn->SetStream(t.In);
+  limitedIn->Init(kLimit);
+
+  CMyComPtr2_Create<ICompressCoder, NCompress::CCopyCoder> copyCoder;
+  TEST_ASSERT(copyCoder.Interface()->Code(limitedIn, t.Out, NULL, &kOutSize, NULL) == S_OK, "Code failed")
+  TEST_ASSERT(copyCoder->TotalSize == kOutSize, "outSize was not respected")
+  TEST_ASSERT(t.InSpec->KernelSize != 0, "kernel copy was not used")
+
+  // the rest of limited stream
+  TEST_ASSERT(copyCoder.Interface()->Code(limitedIn, t.Out, NULL, NULL, NULL) == S_OK, "Code failed")
+  TEST_ASSERT(copyCoder->TotalSize == kLimit - kOutSize, "limit of input stream was not respected")
+  TEST_ASSERT(t.OutSpec->Close() == S_OK, "Close failed")
+  TEST_ASSERT(CheckDestFile((size_t)kLimit), "wrong data")
+
+  // the next Read() must continue from the end of copied data
+  Byte b = 0;
+  UInt32 processed = 0;
+  TEST_ASSERT(t.In->Read(&b, 1, &processed) == S_OK && processed == 1, "Read failed")
+  TEST_ASSERT(b == g_Data[(size_t)kLimit], "wrong position of input stream")
+
+  TEST_SUCCESS()
+}
+
+
+int main(int /* argc */, char * /* argv */[])
+{
+  printf("===========================================\n");
+  printf("KernelCopy Test Suite\n");
+  printf("===========================================\n\n");
+
+  CrcGenerateTable();
+
+  {
+    FString prefix;
+    if (!NDir::MyGetTempPath(prefix))
+      return 1;
+    NName::NormalizeDirPathPrefix(prefix);
+    prefix += "7zKernelCopyTest";
+    AString postfix;
+    if (!NDir::CreateTempFile2(prefix, true, postfix, NULL))
+      return 1;
+    g_TestDir = prefix;
+    g_TestDir += postfix;
+    g_TestDir.Add_PathSepar();
+  }
+
+  if (!CreateSourceFile())
+  {
+    printf("can't create source file\n");
+    return 1;
+  }
+
+ #if defined(__linux__)
+  TestNoCrc();
+  TestCrcDisabled();
+  TestLimits();
+ #else
+  printf("kernel copy is not supported. The kernel copy tests are skipped.\n");
+ #endif
+  TestCrc();
+
+  NDir::RemoveDirWithSubItems(g_TestDir);
+
+  printf("\n===========================================\n");
+  printf("Test Results\n");
+  printf("===========================================\n");
+  printf("Passed: %u\n", g_TestsPassed);
+  printf("Failed: %u\n", g_TestsFailed);
+  printf("Total:  %u\n", g_TestsPassed + g_TestsFailed);
+  printf("===========================================\n");
+
+  return g_TestsFailed == 0 ? 0 : 1;
+}
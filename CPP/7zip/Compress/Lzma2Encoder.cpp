@@ -9,6 +9,16 @@
 
 #include "Lzma2Encoder.h"
 
+#ifndef Z7_ST
+
+#include "../../../C/LzFindMt.h"
+
+EXTERN_C_BEGIN
+void Lzma2Enc_GetMtStat(CLzma2EncHandle p, CMatchFinderMt_Stat *stat);
+EXTERN_C_END
+
+#endif
+
 namespace NCompress {
 
 namespace NLzma {
@@ -130,5 +140,26 @@ Z7_COM7F_IMF(CEncoder::Code(ISequentialInStream *inStream, ISequentialOutStream
 
   return SResToHRESULT(res);
 }
+
+
+#ifndef Z7_ST
+
+// the stall counters are summed for all blocks of latest Code() call
+
+Z7_COM7F_IMF(CEncoder::GetMtStat(UInt64 *values, UInt32 numValues))
+{
+  CMatchFinderMt_Stat st;
+  Lzma2Enc_GetMtStat(_encoder, &st);
+  UInt64 v[NCoderMtStat::kNumValues];
+  v[NCoderMtStat::kHashStalls_Write] = st.hashStalls_Write;
+  v[NCoderMtStat::kHashStalls_Read] = st.hashStalls_Read;
+  v[NCoderMtStat::kBtStalls_Write] = st.btStalls_Write;
+  v[NCoderMtStat::kBtStalls_Read] = st.btStalls_Read;
+  for (UInt32 i = 0; i < numValues; i++)
+    values[i] = (i < NCoderMtStat::kNumValues ? v[i] : 0);
+  return S_OK;
+}
+
+#endif
   
 }}
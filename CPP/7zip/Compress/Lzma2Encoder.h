@@ -12,13 +12,34 @@
 namespace NCompress {
 namespace NLzma2 {
 
-Z7_CLASS_IMP_COM_4(
-  CEncoder
-  , ICompressCoder
-  , ICompressSetCoderProperties
-  , ICompressWriteCoderProperties
-  , ICompressSetCoderPropertiesOpt
-)
+class CEncoder Z7_final:
+  public ICompressCoder,
+  public ICompressSetCoderProperties,
+  public ICompressWriteCoderProperties,
+  public ICompressSetCoderPropertiesOpt,
+ #ifndef Z7_ST
+  public ICompressGetMtStat,
+ #endif
+  public CMyUnknownImp
+{
+  Z7_COM_QI_BEGIN2(ICompressCoder)
+  Z7_COM_QI_ENTRY(ICompressSetCoderProperties)
+  Z7_COM_QI_ENTRY(ICompressWriteCoderProperties)
+  Z7_COM_QI_ENTRY(ICompressSetCoderPropertiesOpt)
+ #ifndef Z7_ST
+  Z7_COM_QI_ENTRY(ICompressGetMtStat)
+ #endif
+  Z7_COM_QI_END
+  Z7_COM_ADDREF_RELEASE
+
+  Z7_IFACE_COM7_IMP(ICompressCoder)
+  Z7_IFACE_COM7_IMP(ICompressSetCoderProperties)
+  Z7_IFACE_COM7_IMP(ICompressWriteCoderProperties)
+  Z7_IFACE_COM7_IMP(ICompressSetCoderPropertiesOpt)
+ #ifndef Z7_ST
+  Z7_IFACE_COM7_IMP(ICompressGetMtStat)
+ #endif
+
   CLzma2EncHandle _encoder;
 public:
   CEncoder();
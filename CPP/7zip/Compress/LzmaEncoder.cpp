@@ -24,6 +24,16 @@ EXTERN_C_END
 
 #endif
 
+#ifndef Z7_ST
+
+#include "../../../C/LzFindMt.h"
+
+EXTERN_C_BEGIN
+void LzmaEnc_GetMtStat(CLzmaEncHandle p, CMatchFinderMt_Stat *stat);
+EXTERN_C_END
+
+#endif
+
 namespace NCompress {
 namespace NLzma {
 
@@ -128,6 +138,19 @@ HRESULT SetLzmaProp(PROPID propID, const PROPVARIANT &prop, CLzmaEncProps &ep)
     return S_OK;
   }
 
+  if (propID == NCoderPropID::kMtNumHashBlocks
+      || propID == NCoderPropID::kMtNumBtBlocks)
+  {
+    // the match finder rounds the depth of queue up to power of 2 in range [2, 64]
+    if (prop.vt != VT_UI4 || prop.ulVal > (1 << 6))
+      return E_INVALIDARG;
+    if (propID == NCoderPropID::kMtNumHashBlocks)
+      ep.mtNumHashBlocks = prop.ulVal;
+    else
+      ep.mtNumBtBlocks = prop.ulVal;
+    return S_OK;
+  }
+
   if (propID > NCoderPropID::kReduceSize)
     return S_OK;
   
@@ -371,4 +394,23 @@ Z7_COM7F_IMF(CEncoder::Code(ISequentialInStream *inStream, ISequentialOutStream
   return SResToHRESULT(res);
 }
 
+
+#ifndef Z7_ST
+
+Z7_COM7F_IMF(CEncoder::GetMtStat(UInt64 *values, UInt32 numValues))
+{
+  CMatchFinderMt_Stat st;
+  LzmaEnc_GetMtStat(_encoder, &st);
+  UInt64 v[NCoderMtStat::kNumValues];
+  v[NCoderMtStat::kHashStalls_Write] = st.hashStalls_Write;
+  v[NCoderMtStat::kHashStalls_Read] = st.hashStalls_Read;
+  v[NCoderMtStat::kBtStalls_Write] = st.btStalls_Write;
+  v[NCoderMtStat::kBtStalls_Read] = st.btStalls_Read;
+  for (UInt32 i = 0; i < numValues; i++)
+    values[i] = (i < NCoderMtStat::kNumValues ? v[i] : 0);
+  return S_OK;
+}
+
+#endif
+
 }}
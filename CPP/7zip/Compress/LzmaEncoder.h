@@ -17,18 +17,29 @@ class CEncoder Z7_final:
   public ICompressSetCoderProperties,
   public ICompressWriteCoderProperties,
   public ICompressSetCoderPropertiesOpt,
+ #ifndef Z7_ST
+  public ICompressGetMtStat,
+ #endif
   public CMyUnknownImp
 {
-  Z7_COM_UNKNOWN_IMP_4(
-      ICompressCoder,
-      ICompressSetCoderProperties,
-      ICompressWriteCoderProperties,
-      ICompressSetCoderPropertiesOpt)
+  Z7_COM_QI_BEGIN2(ICompressCoder)
+  Z7_COM_QI_ENTRY(ICompressSetCoderProperties)
+  Z7_COM_QI_ENTRY(ICompressWriteCoderProperties)
+  Z7_COM_QI_ENTRY(ICompressSetCoderPropertiesOpt)
+ #ifndef Z7_ST
+  Z7_COM_QI_ENTRY(ICompressGetMtStat)
+ #endif
+  Z7_COM_QI_END
+  Z7_COM_ADDREF_RELEASE
+
   Z7_IFACE_COM7_IMP(ICompressCoder)
 public:
   Z7_IFACE_COM7_IMP(ICompressSetCoderProperties)
   Z7_IFACE_COM7_IMP(ICompressWriteCoderProperties)
   Z7_IFACE_COM7_IMP(ICompressSetCoderPropertiesOpt)
+ #ifndef Z7_ST
+  Z7_IFACE_COM7_IMP(ICompressGetMtStat)
+ #endif
 
   CLzmaEncHandle _encoder;
   UInt64 _inputProcessed;
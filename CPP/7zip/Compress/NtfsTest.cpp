@@ -0,0 +1,358 @@
+// NtfsTest.cpp - tests for streams of compressed attributes in NTFS handler
+
+#include "StdAfx.h"
+
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
+#include "../../../C/CpuArch.h"
+
+#include "../../Common/MyInitGuid.h"
+
+#include "../Common/StreamObjects.h"
+#include "../Common/StreamUtils.h"
+
+#include "../ICoder.h"
+
+#include "HandlerTest.h"
+
+using namespace NWindows;
+
+// it returns the size of virtual memory of process, or 0, if it's not supported
+
+static UInt64 GetVirtMemSize()
+{
+  UInt64 size = 0;
+ #ifdef __linux__
+  FILE *f = fopen("/proc/self/statm", "r");
+  if (!f)
+    return 0;
+  unsigned long numPages = 0;
+  if (fscanf(f, "%lu", &numPages) == 1)
+    size = (UInt64)numPages * 4096;
+  fclose(f);
+ #endif
+  return size;
+}
+
+/* The test image contains MFT with two records: $MFT and the file with compressed $DATA.
+   The cluster is 512 bytes, and compression unit is 16 clusters (8 KiB).
+   Each compressed unit contains two LZNT1 chunks in one cluster:
+   16 random literals and the match that repeats these literals.
+   One unit is not compressed (all 16 clusters are allocated). */
+
+static const unsigned kClusterSizeLog = 9;
+static const size_t kClusterSize = (size_t)1 << kClusterSizeLog;
+static const unsigned kUnitSizeLog = kClusterSizeLog + 4;
+static const size_t kUnitSize = (size_t)1 << kUnitSizeLog;
+static const unsigned kNumUnits = 64;
+static const unsigned kCopyUnit = 5;
+static const size_t kFileSize = kUnitSize * kNumUnits - 100;
+
+static const UInt64 kMftCluster = 16;
+static const UInt64 kDataCluster = 32;
+static const UInt64 kNumClusters = kDataCluster + kNumUnits + 16;
+
+static const size_t kRecSize = 1024;
+
+static CByteBuffer g_Data;
+static CByteBuffer g_Image;
+
+static void WriteLznt1Chunk(Byte *dest, const Byte *literals, Byte *unpacked)
+{
+  // compressed chunk: header, flags, 8 literals, flags, 8 literals, flags, match
+  SetUi16(dest, 0xB000 | (21 - 1))
+  Byte *p = dest + 2;
+  *p++ = 0;
+  memcpy(p, literals, 8);
+  p += 8;
+  *p++ = 0;
+  memcpy(p, literals + 8, 8);
+  p += 8;
+  *p++ = 1;
+  // offset 16 (dist = 15) uses 4 bits in 16-bit token, so the length uses 12 bits
+  SetUi16(p, (UInt16)((15 << 12) | (4096 - 16 - 3)))
+  for (unsigned i = 0; i < 4096; i++)
+    unpacked[i] = literals[i & 15];
+}
+
+// it applies update sequence array to record
+
+static void ProtectRecord(Byte *rec)
+{
+  const unsigned kUsaOffset = 0x30;
+  const UInt16 usn = 1;
+  SetUi16(rec + kUsaOffset, usn)
+  for (unsigned i = 1; i <= kRecSize / 512; i++)
+  {
+    Byte *p = rec + i * 512 - 2;
+    memcpy(rec + kUsaOffset + i * 2, p, 2);
+    SetUi16(p, usn)
+  }
+}
+
+static void InitRecord(Byte *rec, UInt32 recNumber)
+{
+  memcpy(rec, "FILE", 4);
+  SetUi16(rec + 4, 0x30)     // usaOffset
+  SetUi16(rec + 6, 1 + kRecSize / 512)
+  SetUi16(rec + 0x10, 1)     // SeqNumber
+  SetUi16(rec + 0x14, 0x38)  // attrOffs
+  SetUi16(rec + 0x16, 1)     // in use
+  SetUi32(rec + 0x1C, kRecSize)
+  SetUi32(rec + 0x2C, recNumber)
+}
+
+// it writes non-resident $DATA attribute and end marker. It returns (bytesInUse)
+
+static UInt32 WriteDataAttr(Byte *rec, unsigned compressionUnit,
+    UInt64 numVcns, UInt64 size, UInt64 packSize,
+    const Byte *runList, unsigned runListSize)
+{
+  Byte *p = rec + 0x38;
+  const unsigned runOffset = compressionUnit ? 0x48 : 0x40;
+  const UInt32 len = (UInt32)((runOffset + runListSize + 1 + 7) & ~7u);
+  SetUi32(p, 0x80)
+  SetUi32(p + 4, len)
+  p[8] = 1; // NonResident
+  SetUi64(p + 0x18, numVcns - 1)
+  SetUi16(p + 0x20, runOffset)
+  p[0x22] = (Byte)compressionUnit;
+  SetUi64(p + 0x28, numVcns << kClusterSizeLog)
+  SetUi64(p + 0x30, size)
+  SetUi64(p + 0x38, size)
+  if (compressionUnit)
+    SetUi64(p + 0x40, packSize)
+  memcpy(p + runOffset, runList, runListSize);
+  p += len;
+  SetUi32(p, 0xFFFFFFFF)
+  return (UInt32)(p + 8 - rec);
+}
+
+static void CreateImage()
+{
+  g_Data.Alloc(kUnitSize * kNumUnits);
+  g_Image.Alloc((size_t)(kNumClusters << kClusterSizeLog));
+  Byte *image = g_Image;
+  memset(image, 0, g_Image.Size());
+
+  {
+    Byte *p = image;
+    p[0] = 0xEB; p[1] = 0x52; p[2] = 0x90;
+    memcpy(p + 3, "NTFS    ", 8);
+    SetUi16(p + 11, 512)
+    p[13] = 1;     // sectors per cluster
+    p[21] = 0xF8;  // MediaType
+    SetUi64(p + 0x28, kNumClusters)
+    SetUi64(p + 0x30, kMftCluster)
+    SetUi32(p + 0x40, 0xF6) // 1024 bytes per record
+    SetUi32(p + 0x44, 1)
+    p[0x1FE] = 0x55;
+    p[0x1FF] = 0xAA;
+  }
+
+  {
+    Byte *rec = image + (kMftCluster << kClusterSizeLog);
+    InitRecord(rec, 0);
+    const Byte runList[] = { 0x11, 4, (Byte)kMftCluster };
+    const UInt32 bytesInUse = WriteDataAttr(rec, 0, 4, kRecSize * 2, 0, runList, sizeof(runList));
+    SetUi32(rec + 0x18, bytesInUse)
+    ProtectRecord(rec);
+  }
+
+  Byte runList[kNumUnits * 8];
+  unsigned runListSize = 0;
+  UInt64 packSize = 0;
+  {
+    UInt32 v = 1;
+    UInt64 lcn = kDataCluster;
+    UInt64 prevLcn = 0;
+    for (unsigned u = 0; u < kNumUnits; u++)
+    {
+      Byte *unpacked = g_Data + ((size_t)u << kUnitSizeLog);
+      Byte *dest = image + (lcn << kClusterSizeLog);
+      const unsigned numClusters = (u == kCopyUnit) ? 16 : 1;
+      if (u == kCopyUnit)
+      {
+        for (size_t i = 0; i < kUnitSize; i++)
+        {
+          v = v * 1103515245 + 12345;
+          unpacked[i] = (Byte)(v >> 16);
+        }
+        memcpy(dest, unpacked, kUnitSize);
+      }
+      else
+        for (unsigned k = 0; k < 2; k++)
+        {
+          Byte literals[16];
+          for (unsigned i = 0; i < 16; i++)
+          {
+            v = v * 1103515245 + 12345;
+            literals[i] = (Byte)(v >> 16);
+          }
+          WriteLznt1Chunk(dest + k * (2 + 21), literals, unpacked + k * 4096);
+        }
+      // run with (numClusters) clusters at (lcn), and sparse run for the rest of unit
+      const UInt16 delta = (UInt16)(lcn - prevLcn);
+      runList[runListSize++] = 0x21;
+      runList[runListSize++] = (Byte)numClusters;
+      SetUi16(runList + runListSize, delta)
+      runListSize += 2;
+      if (numClusters != 16)
+      {
+        runList[runListSize++] = 0x01;
+        runList[runListSize++] = (Byte)(16 - numClusters);
+      }
+      prevLcn = lcn;
+      lcn += numClusters;
+      packSize += (UInt64)numClusters << kClusterSizeLog;
+    }
+  }
+  {
+    Byte *rec = image + (kMftCluster << kClusterSizeLog) + kRecSize;
+    InitRecord(rec, 1);
+    const UInt32 bytesInUse = WriteDataAttr(rec, 4, (UInt64)kNumUnits * 16,
+        kFileSize, packSize, runList, runListSize);
+    SetUi32(rec + 0x18, bytesInUse)
+    ProtectRecord(rec);
+  }
+}
+
+
+static HRESULT OpenImage(CMyComPtr<IInArchive> &archive, const wchar_t *numThreads, const wchar_t *memUse)
+{
+  const CArcInfo *arcInfo = FindArc("NTFS");
+  if (!arcInfo)
+    return E_FAIL;
+  archive = arcInfo->CreateInArchive();
+  RINOK(SetHandlerProps(archive, numThreads, memUse))
+  CMyComPtr2_Create<IInStream, CBufferInStream> inStream;
+  inStream->Buf.CopyFrom(g_Image, g_Image.Size());
+  inStream->Init();
+  return archive->Open(inStream, NULL, NULL);
+}
+
+// it returns the stream of test file
+
+static HRESULT GetFileStream(IInArchive *archive, CMyComPtr<ISequentialInStream> &stream)
+{
+  Z7_DECL_CMyComPtr_QI_FROM(IInArchiveGetStream, getStream, archive)
+  if (!getStream)
+    return E_NOINTERFACE;
+  UInt32 numItems = 0;
+  RINOK(archive->GetNumberOfItems(&numItems))
+  for (UInt32 i = 0; i < numItems; i++)
+  {
+    NCOM::CPropVariant prop;
+    RINOK(archive->GetProperty(i, kpidSize, &prop))
+    if (prop.vt == VT_UI8 && prop.uhVal.QuadPart == kFileSize)
+      return getStream->GetStream(i, &stream);
+  }
+  return S_FALSE;
+}
+
+static bool ReadAndCompare(ISequentialInStream *stream, size_t pos, size_t size)
+{
+  CByteBuffer buf(size);
+  size_t processed = size;
+  if (ReadStream(stream, buf, &processed) != S_OK || processed != size)
+    return false;
+  return memcmp(buf, g_Data + pos, size) == 0;
+}
+
+
+// the units are unpacked in (mt) threads for sequential reading
+static bool TestRead()
+{
+  g_TestFailed = false;
+
+  const unsigned numThreads0 = GetNumProcessThreads();
+  CMyComPtr<IInArchive> archive;
+  TEST_ASSERT(OpenImage(archive, L"4", NULL) == S_OK, "can't open image")
+  {
+    CMyComPtr<ISequentialInStream> stream;
+    TEST_ASSERT(GetFileStream(archive, stream) == S_OK && stream, "can't get stream")
+    TEST_ASSERT(ReadAndCompare(stream, 0, kFileSize), "wrong data")
+  }
+  TEST_ASSERT(CheckNumNewThreads(numThreads0, 1, 4), "multithreaded decoding was not used")
+  archive.Release();
+  TEST_ASSERT(CheckNumNewThreads(numThreads0, 0, 0), "the threads were not finished with handler")
+  {
+    const CArcInfo *arcInfo = FindArc("NTFS");
+    TEST_ASSERT(arcInfo, "handler is not registered")
+    archive = arcInfo->CreateInArchive();
+    TEST_ASSERT(CheckWrongProps(archive), "wrong property was accepted")
+  }
+
+  TEST_SUCCESS()
+}
+
+// the streams of handler use the threads of handler
+static bool TestSharedThreads()
+{
+  g_TestFailed = false;
+
+  const unsigned numThreads0 = GetNumProcessThreads();
+  const unsigned kNumStreams = 3;
+  CMyComPtr<ISequentialInStream> streams[kNumStreams];
+  {
+    CMyComPtr<IInArchive> archive;
+    TEST_ASSERT(OpenImage(archive, L"4", NULL) == S_OK, "can't open image")
+    // the streams of handler share the position in input stream of archive,
+    // so each stream is read to the end before the next stream is created
+    for (unsigned i = 0; i < kNumStreams - 1; i++)
+    {
+      TEST_ASSERT(GetFileStream(archive, streams[i]) == S_OK && streams[i], "can't get stream")
+      TEST_ASSERT(ReadAndCompare(streams[i], 0, kFileSize), "wrong data")
+    }
+    TEST_ASSERT(GetFileStream(archive, streams[kNumStreams - 1]) == S_OK && streams[kNumStreams - 1], "can't get stream")
+    // the archive object is released before the last stream is read
+  }
+  TEST_ASSERT(ReadAndCompare(streams[kNumStreams - 1], 0, kFileSize), "wrong data")
+
+  TEST_ASSERT(CheckNumNewThreads(numThreads0, 1, 4), "the threads of handler were not shared")
+  for (unsigned i = 0; i < kNumStreams; i++)
+    streams[i].Release();
+  TEST_ASSERT(CheckNumNewThreads(numThreads0, 0, 0), "the threads were not finished")
+
+  TEST_SUCCESS()
+}
+
+// the cache of stream is not larger than the stream
+static bool TestCacheSize()
+{
+  g_TestFailed = false;
+
+  CMyComPtr<IInArchive> archive;
+  TEST_ASSERT(OpenImage(archive, L"1", L"1g") == S_OK, "can't open image")
+  const UInt64 memSize0 = GetVirtMemSize();
+  CMyComPtr<ISequentialInStream> stream;
+  TEST_ASSERT(GetFileStream(archive, stream) == S_OK && stream, "can't get stream")
+  const UInt64 memSize1 = GetVirtMemSize();
+  // the limit for cache is (1 << 10) units (8 MiB), but the stream contains only (kNumUnits) units
+  TEST_ASSERT(memSize1 - memSize0 < ((UInt64)1 << 22), "the cache is larger than stream")
+  TEST_ASSERT(ReadAndCompare(stream, 0, kFileSize), "wrong data")
+
+  TEST_SUCCESS()
+}
+
+
+int main(int /* argc */, char * /* argv */[])
+{
+  PrintTestSuiteHeader("Ntfs");
+
+  // large blocks are allocated with mmap() and they are unmapped after free.
+  // So TestCacheSize() can check the size of virtual memory.
+ #ifdef __GLIBC__
+  mallopt(M_MMAP_THRESHOLD, 1 << 20);
+ #endif
+
+  CreateImage();
+
+  TestRead();
+  TestSharedThreads();
+  TestCacheSize();
+
+  return PrintTestResults();
+}
@@ -0,0 +1,559 @@
+// ReadAheadTest.cpp - tests for read-ahead in CCachedInStream with shared CReadAheadPool
+
+#include "StdAfx.h"
+
+#include <stdlib.h>
+
+#include "../../Common/MyInitGuid.h"
+
+#include "../../Windows/FileDir.h"
+#include "../../Windows/FileName.h"
+#include "../../Windows/Synchronization.h"
+
+#include "../Common/FileStreams.h"
+#include "../Common/StreamObjects.h"
+#include "../Common/StreamUtils.h"
+
+#include "../ICoder.h"
+
+#include "HandlerTest.h"
+
+using namespace NWindows;
+using namespace NFile;
+
+
+static Byte GetTestByte(unsigned seed, UInt64 pos)
+{
+  return (Byte)(pos * 31 + (pos >> 9) + seed * 7);
+}
+
+#ifndef Z7_ST
+
+static const unsigned kNumPoolThreads = 4;
+
+/* The state that is shared by all test streams.
+   It checks that one pool thread doesn't decode two blocks at the same time,
+   because the handlers use one decoder per thread of pool. */
+
+struct CTestState
+{
+  NSynchronization::CCriticalSection CS;
+  bool ThreadBusy[kNumPoolThreads];
+  bool ThreadConflict;
+  unsigned NumBlocks_Mt;
+
+  CTestState(): ThreadConflict(false), NumBlocks_Mt(0)
+  {
+    for (unsigned i = 0; i < kNumPoolThreads; i++)
+      ThreadBusy[i] = false;
+  }
+};
+
+static CTestState g_State;
+
+class CTestInStream: public CCachedInStream
+{
+  HRESULT ReadBlock(UInt64 blockIndex, Byte *dest, size_t blockSize) Z7_override;
+  HRESULT ReadBlock_Mt(unsigned threadIndex, UInt64 blockIndex, Byte *dest, size_t blockSize) Z7_override;
+public:
+  unsigned Seed;
+  unsigned BlockSizeLog;
+  unsigned NumBlocks_Mt; // it's changed by pool threads
+  CTestInStream(): NumBlocks_Mt(0) {}
+  ~CTestInStream() { StopReadAhead(); }
+};
+
+HRESULT CTestInStream::ReadBlock(UInt64 blockIndex, Byte *dest, size_t blockSize)
+{
+  const UInt64 pos = blockIndex << BlockSizeLog;
+  for (size_t i = 0; i < blockSize; i++)
+    dest[i] = GetTestByte(Seed, pos + i);
+  return S_OK;
+}
+
+HRESULT CTestInStream::ReadBlock_Mt(unsigned threadIndex, UInt64 blockIndex, Byte *dest, size_t blockSize)
+{
+  {
+    NSynchronization::CCriticalSectionLock lock(g_State.CS);
+    if (threadIndex >= kNumPoolThreads || g_State.ThreadBusy[threadIndex])
+      g_State.ThreadConflict = true;
+    else
+      g_State.ThreadBusy[threadIndex] = true;
+  }
+  const HRESULT res = ReadBlock(blockIndex, dest, blockSize);
+  {
+    NSynchronization::CCriticalSectionLock lock(g_State.CS);
+    if (threadIndex < kNumPoolThreads)
+      g_State.ThreadBusy[threadIndex] = false;
+    g_State.NumBlocks_Mt++;
+    NumBlocks_Mt++;
+  }
+  return res;
+}
+
+static const unsigned kBlockSizeLog = 12;
+static const unsigned kNumCacheBlocksLog = 4;
+
+static CTestInStream *CreateTestStream(CMyComPtr<IInStream> &stream, unsigned seed, UInt64 size)
+{
+  CTestInStream *spec = new CTestInStream;
+  stream = spec;
+  spec->Seed = seed;
+  spec->BlockSizeLog = kBlockSizeLog;
+  if (!spec->Alloc(kBlockSizeLog, kNumCacheBlocksLog))
+    return NULL;
+  spec->Init(size);
+  return spec;
+}
+
+static bool CheckRead(IInStream *stream, unsigned seed, UInt64 pos, size_t size)
+{
+  CByteBuffer buf(size);
+  size_t processed = size;
+  if (ReadStream(stream, buf, &processed) != S_OK || processed != size)
+    return false;
+  for (size_t i = 0; i < size; i++)
+    if (buf[i] != GetTestByte(seed, pos + i))
+      return false;
+  return true;
+}
+
+
+// sequential reading of one stream: the next blocks are decoded by pool threads
+static bool TestSingleStream()
+{
+  g_TestFailed = false;
+
+  CReadAheadPool pool;
+  TEST_ASSERT(pool.Create(kNumPoolThreads) == S_OK, "can't create pool")
+  CMyComPtr<IInStream> stream;
+  CTestInStream *spec = CreateTestStream(stream, 1, ((UInt64)1 << 20) + 123);
+  TEST_ASSERT(spec, "can't create stream")
+  spec->SetReadAhead(&pool, kNumPoolThreads, (UInt64)(Int64)-1);
+
+  UInt64 pos = 0;
+  while (pos + 1000 <= ((UInt64)1 << 20))
+  {
+    TEST_ASSERT(CheckRead(stream, 1, pos, 1000), "wrong data")
+    pos += 1000;
+  }
+  spec->StopReadAhead();
+  TEST_ASSERT(spec->NumBlocks_Mt != 0, "read-ahead was not used")
+  TEST_ASSERT(!g_State.ThreadConflict, "pool thread was used by two blocks at same time")
+
+  TEST_SUCCESS()
+}
+
+// interleaved reading of several streams of same pool:
+// the streams share the threads of pool, and the number of threads is not changed
+static bool TestMultiStream()
+{
+  g_TestFailed = false;
+
+  CReadAheadPool pool;
+  TEST_ASSERT(pool.Create(kNumPoolThreads) == S_OK, "can't create pool")
+  TEST_ASSERT(pool.Create(2) == S_OK, "can't create pool")
+  TEST_ASSERT(pool.GetNumThreads() == kNumPoolThreads, "wrong number of threads in pool")
+
+  const unsigned kNumStreams = 5;
+  const UInt64 kSize = ((UInt64)1 << 19) + 777;
+  CMyComPtr<IInStream> streams[kNumStreams];
+  CTestInStream *specs[kNumStreams];
+  UInt64 positions[kNumStreams];
+  unsigned i;
+  for (i = 0; i < kNumStreams; i++)
+  {
+    specs[i] = CreateTestStream(streams[i], i + 10, kSize + i * 1000);
+    TEST_ASSERT(specs[i], "can't create stream")
+    specs[i]->SetReadAhead(&pool, kNumPoolThreads, (UInt64)(Int64)-1);
+    positions[i] = 0;
+  }
+
+  for (unsigned step = 0;; step++)
+  {
+    bool finished = true;
+    for (i = 0; i < kNumStreams; i++)
+    {
+      const UInt64 size = kSize + i * 1000;
+      if (positions[i] >= size)
+        continue;
+      finished = false;
+      size_t cur = 3000 + (size_t)((step * 7 + i * 13) % 5) * 1000;
+      if (cur > size - positions[i])
+        cur = (size_t)(size - positions[i]);
+      TEST_ASSERT(CheckRead(streams[i], i + 10, positions[i], cur), "wrong data")
+      positions[i] += cur;
+    }
+    if (finished)
+      break;
+    // one stream is released while its blocks can be decoded by pool threads
+    if (step == 20)
+    {
+      streams[2].Release();
+      positions[2] = kSize + 2 * 1000;
+    }
+  }
+
+  for (i = 0; i < kNumStreams; i++)
+    if (streams[i])
+      specs[i]->StopReadAhead();
+  TEST_ASSERT(pool.GetNumThreads() == kNumPoolThreads, "wrong number of threads in pool")
+  TEST_ASSERT(specs[0]->NumBlocks_Mt != 0 && specs[4]->NumBlocks_Mt != 0, "read-ahead was not used")
+  TEST_ASSERT(!g_State.ThreadConflict, "pool thread was used by two blocks at same time")
+
+  TEST_SUCCESS()
+}
+
+// random access reading doesn't start read-ahead, and seeking doesn't break the data
+static bool TestSeek()
+{
+  g_TestFailed = false;
+
+  CReadAheadPool pool;
+  TEST_ASSERT(pool.Create(kNumPoolThreads) == S_OK, "can't create pool")
+  CMyComPtr<IInStream> stream;
+  const UInt64 kSize = (UInt64)1 << 20;
+  CTestInStream *spec = CreateTestStream(stream, 3, kSize);
+  TEST_ASSERT(spec, "can't create stream")
+  spec->SetReadAhead(&pool, kNumPoolThreads, (UInt64)(Int64)-1);
+
+  UInt32 v = 1;
+  for (unsigned k = 0; k < 300; k++)
+  {
+    v = v * 1103515245 + 12345;
+    const UInt64 pos = (v >> 8) % (kSize - 10000);
+    TEST_ASSERT(InStream_SeekSet(stream, pos) == S_OK, "Seek failed")
+    TEST_ASSERT(CheckRead(stream, 3, pos, 1 + (v & 0x1fff)), "wrong data")
+  }
+  spec->StopReadAhead();
+  TEST_ASSERT(!g_State.ThreadConflict, "pool thread was used by two blocks at same time")
+
+  TEST_SUCCESS()
+}
+
+// the size limit for blocks that are decoded ahead ("memuse" property of handlers)
+static bool TestMemLimit()
+{
+  g_TestFailed = false;
+
+  CReadAheadPool pool;
+  TEST_ASSERT(pool.Create(kNumPoolThreads) == S_OK, "can't create pool")
+  const UInt64 kSize = (UInt64)1 << 18;
+  {
+    CMyComPtr<IInStream> stream;
+    CTestInStream *spec = CreateTestStream(stream, 4, kSize);
+    TEST_ASSERT(spec, "can't create stream")
+    // the limit is smaller than one block, so read-ahead is disabled
+    spec->SetReadAhead(&pool, kNumPoolThreads, ((UInt64)1 << kBlockSizeLog) - 1);
+    TEST_ASSERT(CheckRead(stream, 4, 0, (size_t)kSize), "wrong data")
+    TEST_ASSERT(spec->NumBlocks_Mt == 0, "read-ahead was not disabled")
+  }
+  {
+    CMyComPtr<IInStream> stream;
+    CTestInStream *spec = CreateTestStream(stream, 5, kSize);
+    TEST_ASSERT(spec, "can't create stream")
+    spec->SetReadAhead(&pool, kNumPoolThreads, (UInt64)1 << kBlockSizeLog);
+    UInt64 pos = 0;
+    while (pos + 128 <= kSize)
+    {
+      TEST_ASSERT(CheckRead(stream, 5, pos, 128), "wrong data")
+      pos += 128;
+    }
+    spec->StopReadAhead();
+    TEST_ASSERT(spec->NumBlocks_Mt != 0, "read-ahead was not used")
+  }
+
+  TEST_SUCCESS()
+}
+
+#endif
+
+
+// the handler test: several streams of one archive are read in parallel
+
+static FString g_TestDir;
+
+static FString GetTestPath(const char *name)
+{
+  FString path = g_TestDir;
+  path += name;
+  return path;
+}
+
+static const unsigned kNumFiles = 4;
+
+static size_t GetTestFileSize(unsigned index)
+{
+  return ((size_t)1 << 18) + index * 10007;
+}
+
+static bool CreateTestFiles(const FString &dir)
+{
+  if (!NDir::CreateComplexDir(dir))
+    return false;
+  for (unsigned i = 0; i < kNumFiles; i++)
+  {
+    FString path = dir;
+    path.Add_PathSepar();
+    path += "f";
+    path.Add_UInt32(i);
+    COutFileStream *outSpec = new COutFileStream;
+    CMyComPtr<ISequentialOutStream> out = outSpec;
+    if (!outSpec->Create_ALWAYS(path))
+      return false;
+    const size_t size = GetTestFileSize(i);
+    CByteBuffer buf(size);
+    // the data must be compressible, but not too much
+    UInt32 v = i + 1;
+    for (size_t k = 0; k < size; k++)
+    {
+      v = v * 1103515245 + 12345;
+      buf[k] = (Byte)(((v >> 16) & 7) + GetTestByte(i, k / 64));
+    }
+    if (!outSpec->File.WriteFull(buf, size) || outSpec->Close() != S_OK)
+      return false;
+  }
+  return true;
+}
+
+static bool ReadTestFile(unsigned index, CByteBuffer &buf)
+{
+  FString path = GetTestPath("src");
+  path.Add_PathSepar();
+  path += "f";
+  path.Add_UInt32(index);
+  NIO::CInFile file;
+  if (!file.Open(path))
+    return false;
+  const size_t size = GetTestFileSize(index);
+  buf.Alloc(size);
+  size_t processed;
+  return file.ReadFull(buf, size, processed) && processed == size;
+}
+
+static bool TestHandlerMultiStream(const char *arcName, const char *arcFile)
+{
+  g_TestFailed = false;
+
+  const CArcInfo *arcInfo = FindArc(arcName);
+  TEST_ASSERT(arcInfo, "handler is not registered")
+  CMyComPtr<IInArchive> archive = arcInfo->CreateInArchive();
+  TEST_ASSERT(CheckWrongProps(archive), "wrong property was accepted")
+  TEST_ASSERT(SetHandlerProps(archive, L"4", L"64m") == S_OK, "SetProperties failed")
+
+  CInFileStream *inSpec = new CInFileStream;
+  CMyComPtr<IInStream> inStream = inSpec;
+  TEST_ASSERT(inSpec->Open(GetTestPath(arcFile)), "can't open archive file")
+  TEST_ASSERT(archive->Open(inStream, NULL, NULL) == S_OK, "can't open archive")
+
+  Z7_DECL_CMyComPtr_QI_FROM(IInArchiveGetStream, getStream, archive)
+  TEST_ASSERT(getStream, "IInArchiveGetStream is not supported")
+
+  UInt32 numItems = 0;
+  TEST_ASSERT(archive->GetNumberOfItems(&numItems) == S_OK, "GetNumberOfItems failed")
+
+  CMyComPtr<ISequentialInStream> streams[kNumFiles];
+  CByteBuffer expected[kNumFiles];
+  size_t positions[kNumFiles];
+  unsigned numFound = 0;
+
+  for (UInt32 i = 0; i < numItems; i++)
+  {
+    NCOM::CPropVariant prop;
+    TEST_ASSERT(archive->GetProperty(i, kpidPath, &prop) == S_OK, "GetProperty failed")
+    if (prop.vt != VT_BSTR)
+      continue;
+    const wchar_t *name = prop.bstrVal;
+    if (name[0] != 'f' || name[1] < '0' || name[1] >= (wchar_t)('0' + kNumFiles) || name[2] != 0)
+      continue;
+    const unsigned index = (unsigned)(name[1] - '0');
+    TEST_ASSERT(getStream->GetStream(i, &streams[index]) == S_OK && streams[index], "GetStream failed")
+    TEST_ASSERT(ReadTestFile(index, expected[index]), "can't read source file")
+    positions[index] = 0;
+    numFound++;
+  }
+  TEST_ASSERT(numFound == kNumFiles, "the files were not found in archive")
+
+  // interleaved reading: all streams are open at the same time
+  for (unsigned step = 0;; step++)
+  {
+    bool finished = true;
+    for (unsigned i = 0; i < kNumFiles; i++)
+    {
+      const size_t size = expected[i].Size();
+      if (positions[i] >= size)
+        continue;
+      finished = false;
+      size_t cur = 5000 + ((step + i) % 3) * 7000;
+      if (cur > size - positions[i])
+        cur = size - positions[i];
+      CByteBuffer buf(cur);
+      size_t processed = cur;
+      TEST_ASSERT(ReadStream(streams[i], buf, &processed) == S_OK && processed == cur, "Read failed")
+      TEST_ASSERT(memcmp(buf, expected[i] + positions[i], cur) == 0, "wrong data")
+      positions[i] += cur;
+    }
+    if (finished)
+      break;
+  }
+
+  // the archive object is released before the streams
+  getStream.Release();
+  archive.Release();
+  for (unsigned i = 0; i < kNumFiles; i++)
+  {
+    Byte b;
+    UInt32 processed = 1;
+    TEST_ASSERT(streams[i]->Read(&b, 1, &processed) == S_OK && processed == 0, "no end of stream")
+    streams[i].Release();
+  }
+
+  TEST_SUCCESS()
+}
+
+/* the archive is closed, while read-ahead jobs of streams can be in progress.
+   The jobs must not use the data that was freed by Close().
+   If (readAfterClose), the streams must return correct data after Close(). */
+
+static bool TestHandlerClose(const char *arcName, const char *arcFile, bool readAfterClose)
+{
+  g_TestFailed = false;
+
+  const CArcInfo *arcInfo = FindArc(arcName);
+  TEST_ASSERT(arcInfo, "handler is not registered")
+  CMyComPtr<IInArchive> archive = arcInfo->CreateInArchive();
+  TEST_ASSERT(SetHandlerProps(archive, L"4", NULL) == S_OK, "SetProperties failed")
+
+  for (unsigned pass = 0; pass < 10; pass++)
+  {
+    CInFileStream *inSpec = new CInFileStream;
+    CMyComPtr<IInStream> inStream = inSpec;
+    TEST_ASSERT(inSpec->Open(GetTestPath(arcFile)), "can't open archive file")
+    TEST_ASSERT(archive->Open(inStream, NULL, NULL) == S_OK, "can't open archive")
+    inStream.Release();
+
+    Z7_DECL_CMyComPtr_QI_FROM(IInArchiveGetStream, getStream, archive)
+    TEST_ASSERT(getStream, "IInArchiveGetStream is not supported")
+    UInt32 numItems = 0;
+    TEST_ASSERT(archive->GetNumberOfItems(&numItems) == S_OK, "GetNumberOfItems failed")
+
+    CMyComPtr<ISequentialInStream> streams[kNumFiles];
+    CByteBuffer expected[kNumFiles];
+    unsigned numFound = 0;
+    for (UInt32 i = 0; i < numItems; i++)
+    {
+      NCOM::CPropVariant prop;
+      TEST_ASSERT(archive->GetProperty(i, kpidPath, &prop) == S_OK, "GetProperty failed")
+      if (prop.vt != VT_BSTR)
+        continue;
+      const wchar_t *name = prop.bstrVal;
+      if (name[0] != 'f' || name[1] < '0' || name[1] >= (wchar_t)('0' + kNumFiles) || name[2] != 0)
+        continue;
+      const unsigned index = (unsigned)(name[1] - '0');
+      TEST_ASSERT(getStream->GetStream(i, &streams[index]) == S_OK && streams[index], "GetStream failed")
+      TEST_ASSERT(ReadTestFile(index, expected[index]), "can't read source file")
+      numFound++;
+    }
+    TEST_ASSERT(numFound == kNumFiles, "the files were not found in archive")
+
+    // sequential reading of first blocks starts read-ahead in all streams
+    const size_t kStartSize = (size_t)3 << 12;
+    for (unsigned i = 0; i < kNumFiles; i++)
+    {
+      CByteBuffer buf(kStartSize);
+      size_t processed = kStartSize;
+      TEST_ASSERT(ReadStream(streams[i], buf, &processed) == S_OK && processed == kStartSize, "Read failed")
+      TEST_ASSERT(memcmp(buf, expected[i], kStartSize) == 0, "wrong data")
+    }
+
+    TEST_ASSERT(archive->Close() == S_OK, "Close failed")
+
+    if (readAfterClose)
+      for (unsigned i = 0; i < kNumFiles; i++)
+      {
+        const size_t size = expected[i].Size() - kStartSize;
+        CByteBuffer buf(size + 1);
+        size_t processed = size + 1;
+        TEST_ASSERT(ReadStream(streams[i], buf, &processed) == S_OK && processed == size, "Read after Close failed")
+        TEST_ASSERT(memcmp(buf, expected[i] + kStartSize, size) == 0, "wrong data after Close")
+      }
+    // the destructors of streams wait for read-ahead jobs
+  }
+
+  TEST_SUCCESS()
+}
+
+static bool RunCommand(const char *command)
+{
+  return system(command) == 0;
+}
+
+
+int main(int /* argc */, char * /* argv */[])
+{
+  PrintTestSuiteHeader("ReadAhead");
+
+ #ifndef Z7_ST
+  TestSingleStream();
+  TestMultiStream();
+  TestSeek();
+  TestMemLimit();
+ #else
+  printf("read-ahead is not supported in single-thread build. The stream tests are skipped.\n");
+ #endif
+
+  {
+    FString prefix;
+    if (!NDir::MyGetTempPath(prefix))
+      return 1;
+    NName::NormalizeDirPathPrefix(prefix);
+    prefix += "7zReadAheadTest";
+    AString postfix;
+    if (!NDir::CreateTempFile2(prefix, true, postfix, NULL))
+      return 1;
+    g_TestDir = prefix;
+    g_TestDir += postfix;
+    g_TestDir.Add_PathSepar();
+  }
+
+  if (!CreateTestFiles(GetTestPath("src")))
+  {
+    printf("can't create test files\n");
+    return 1;
+  }
+
+  {
+    AString command ("mkfs.cramfs -b 4096 ");
+    command += fs2fas(GetTestPath("src"));
+    command += " ";
+    command += fs2fas(GetTestPath("test.cramfs"));
+    command += " > /dev/null 2>&1";
+    if (RunCommand(command))
+    {
+      TestHandlerMultiStream("CramFS", "test.cramfs");
+      TestHandlerClose("CramFS", "test.cramfs", true);
+    }
+    else
+      printf("SKIP: cramfs - mkfs.cramfs is not available\n");
+  }
+
+  {
+    AString command ("mksquashfs ");
+    command += fs2fas(GetTestPath("src"));
+    command += " ";
+    command += fs2fas(GetTestPath("test.squashfs"));
+    command += " -b 4096 -noappend > /dev/null 2>&1";
+    if (RunCommand(command))
+    {
+      TestHandlerMultiStream("SquashFS", "test.squashfs");
+      // the fragment blocks are cached by handler, so the streams can't be read after Close()
+      TestHandlerClose("SquashFS", "test.squashfs", false);
+    }
+    else
+      printf("SKIP: squashfs - mksquashfs is not available\n");
+  }
+
+  NDir::RemoveDirWithSubItems(g_TestDir);
+
+  return PrintTestResults();
+}
@@ -0,0 +1,270 @@
+// XpressEncoder.cpp
+
+#include "StdAfx.h"
+
+#include "../../../C/CpuArch.h"
+#include "../../../C/HuffEnc.h"
+
+#include "XpressEncoder.h"
+
+namespace NCompress {
+namespace NXpress {
+
+static const unsigned kNumHuffBits = 15;
+static const unsigned kNumLenBits = 4;
+static const unsigned kLenMask = (1 << kNumLenBits) - 1;
+static const unsigned kNumPosSlots = 16;
+static const unsigned kNumSyms = 256 + (kNumPosSlots << kNumLenBits);
+static const unsigned kSym_End = 256;
+
+static const unsigned kMatchMinLen = 3;
+static const unsigned kHashBits = 15;
+
+static const unsigned kBlockSizeMax = (unsigned)1 << kBlockSizeMax_Log;
+
+#define HASH_CALC(p) ((((UInt32)(p)[0] | ((UInt32)(p)[1] << 8) | ((UInt32)(p)[2] << 16)) * 0x9E3779B1) >> (32 - kHashBits))
+
+void CEncoder::SetLevel(unsigned level)
+{
+  if (level < 1)
+    level = 1;
+  if (level > 9)
+    level = 9;
+  // the number of match finder passes: 2 for level 1, ..., 512 for level 9
+  _numPasses = (unsigned)1 << level;
+}
+
+
+unsigned CEncoder::GetMatch(const Byte *src, size_t pos, size_t size, UInt32 &dist)
+{
+  const Byte *cur = src + pos;
+  size_t maxLen = size - pos;
+  unsigned bestLen = 0;
+  UInt32 ref = _hash[HASH_CALC(cur)];
+  for (unsigned numPasses = _numPasses; ref != 0 && numPasses != 0; numPasses--)
+  {
+    const size_t cand = ref - 1;
+    const Byte *p = src + cand;
+    if (p[bestLen] == cur[bestLen])
+    {
+      size_t len = 0;
+      while (len < maxLen && p[len] == cur[len])
+        len++;
+      if (len > bestLen)
+      {
+        bestLen = (unsigned)len;
+        dist = (UInt32)(pos - cand);
+        if (len == maxLen)
+          break;
+      }
+    }
+    ref = _chain[cand];
+  }
+  return bestLen;
+}
+
+
+/*
+  The decoder reads two 16-bit words at start. Then it reads next 16-bit word,
+  when there are less than 16 bits in its 32-bit window.
+  Additional bytes of match length are read from current input position.
+  So the writer reserves the place for next 16-bit word in same order
+  as the decoder reads it.
+*/
+
+struct CBitWriter
+{
+  Byte *Buf;
+  size_t Pos;      // position for next reserved word or length byte
+  size_t Slots[4]; // positions of reserved words that are not filled yet
+  unsigned NumSlots;
+  UInt32 NumWords; // number of reserved words
+  UInt32 Value;
+  unsigned NumBits; // number of bits in (Value) that are not written yet
+  UInt32 TotalBits;
+
+  void Init(Byte *buf, size_t pos)
+  {
+    Buf = buf;
+    Slots[0] = pos;
+    Slots[1] = pos + 2;
+    NumSlots = 2;
+    NumWords = 2;
+    Pos = pos + 4;
+    Value = 0;
+    NumBits = 0;
+    TotalBits = 0;
+  }
+
+  void WriteBits(UInt32 val, unsigned numBits)
+  {
+    Value = (Value << numBits) | val;
+    NumBits += numBits;
+    TotalBits += numBits;
+    if (NumBits >= 16)
+    {
+      NumBits -= 16;
+      SetUi16(Buf + Slots[0], (UInt16)(Value >> NumBits))
+      Slots[0] = Slots[1];
+      Slots[1] = Slots[2];
+      NumSlots--;
+    }
+  }
+
+  // it must be called after each symbol and after each distance.
+  void ReserveWords()
+  {
+    const UInt32 numWords = ((TotalBits + 15) >> 4) + 1;
+    while (NumWords < numWords)
+    {
+      Slots[NumSlots++] = Pos;
+      Pos += 2;
+      NumWords++;
+    }
+  }
+
+  void WriteByte(unsigned b) { Buf[Pos++] = (Byte)b; }
+
+  void Flush()
+  {
+    if (NumBits != 0)
+      WriteBits(0, 16 - NumBits);
+    for (unsigned i = 0; i < NumSlots; i++)
+      SetUi16(Buf + Slots[i], 0)
+    NumSlots = 0;
+  }
+};
+
+
+static unsigned GetDistBits(UInt32 dist)
+{
+  unsigned i = 0;
+  while ((dist >> 1) != 0)
+  {
+    dist >>= 1;
+    i++;
+  }
+  return i;
+}
+
+
+size_t CEncoder::Encode(const Byte *src, size_t size, Byte *dest, size_t destSize)
+{
+  if (size == 0 || size > kBlockSizeMax)
+    return 0;
+  if (!_hash.ConstData())
+  {
+    _hash.Alloc((size_t)1 << kHashBits);
+    _chain.Alloc(kBlockSizeMax);
+    _items.Alloc(kBlockSizeMax + 1);
+  }
+  memset(_hash, 0, ((size_t)1 << kHashBits) * sizeof(UInt32));
+
+  UInt32 freqs[kNumSyms];
+  memset(freqs, 0, sizeof(freqs));
+  UInt32 *items = _items;
+  size_t numItems = 0;
+
+  // ---------- LZ77 parsing ----------
+
+  for (size_t pos = 0; pos < size;)
+  {
+    unsigned len = 0;
+    UInt32 dist = 0;
+    if (size - pos >= kMatchMinLen)
+    {
+      len = GetMatch(src, pos, size, dist);
+      const UInt32 h = HASH_CALC(src + pos);
+      _chain[pos] = _hash[h];
+      _hash[h] = (UInt32)pos + 1;
+    }
+    if (len < kMatchMinLen)
+    {
+      const unsigned b = src[pos++];
+      items[numItems++] = b;
+      freqs[b]++;
+      continue;
+    }
+    items[numItems++] = (dist << 16) | (len - kMatchMinLen);
+    {
+      unsigned lenSlot = len - kMatchMinLen;
+      if (lenSlot > kLenMask)
+        lenSlot = kLenMask;
+      freqs[256 + (GetDistBits(dist) << kNumLenBits) + lenSlot]++;
+    }
+    const size_t end = pos + len;
+    for (pos++; pos < end; pos++)
+      if (size - pos >= kMatchMinLen)
+      {
+        const UInt32 h = HASH_CALC(src + pos);
+        _chain[pos] = _hash[h];
+        _hash[h] = (UInt32)pos + 1;
+      }
+  }
+  freqs[kSym_End]++;
+
+  // ---------- Huffman codes ----------
+
+  UInt32 codes[kNumSyms];
+  Byte lens[kNumSyms];
+  Huffman_Generate(freqs, codes, lens, kNumSyms, kNumHuffBits);
+
+  if (destSize <= kNumSyms / 2 + 8)
+    return 0;
+  for (unsigned i = 0; i < kNumSyms / 2; i++)
+    dest[i] = (Byte)(lens[(size_t)i * 2] | (lens[(size_t)i * 2 + 1] << 4));
+
+  // ---------- Bit stream ----------
+
+  CBitWriter bw;
+  bw.Init(dest, kNumSyms / 2);
+
+  for (size_t i = 0; i < numItems; i++)
+  {
+    // each item requires up to 2 new words and 3 length bytes
+    if (bw.Pos + 8 > destSize)
+      return 0;
+    const UInt32 item = items[i];
+    if (item < 256)
+    {
+      bw.WriteBits(codes[item], lens[item]);
+      bw.ReserveWords();
+      continue;
+    }
+    const UInt32 dist = item >> 16;
+    const unsigned len = (unsigned)(item & 0xFFFF); // (matchLen - kMatchMinLen)
+    const unsigned distBits = GetDistBits(dist);
+    const unsigned lenSlot = (len > kLenMask ? kLenMask : len);
+    const unsigned sym = 256 + (distBits << kNumLenBits) + lenSlot;
+    bw.WriteBits(codes[sym], lens[sym]);
+    bw.ReserveWords();
+    if (lenSlot == kLenMask)
+    {
+      const unsigned rem = len - kLenMask;
+      if (rem < 0xFF)
+        bw.WriteByte(rem);
+      else
+      {
+        bw.WriteByte(0xFF);
+        bw.WriteByte(len & 0xFF);
+        bw.WriteByte(len >> 8);
+      }
+    }
+    if (distBits != 0)
+    {
+      bw.WriteBits(dist - ((UInt32)1 << distBits), distBits);
+      bw.ReserveWords();
+    }
+  }
+
+  if (bw.Pos + 8 > destSize)
+    return 0;
+  bw.WriteBits(codes[kSym_End], lens[kSym_End]);
+  bw.ReserveWords();
+  bw.Flush();
+  if (bw.Pos >= destSize)
+    return 0;
+  return bw.Pos;
+}
+
+}}
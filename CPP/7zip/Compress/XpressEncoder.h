@@ -0,0 +1,43 @@
+// XpressEncoder.h
+
+#ifndef ZIP7_INC_XPRESS_ENCODER_H
+#define ZIP7_INC_XPRESS_ENCODER_H
+
+#include "../../Common/MyBuffer.h"
+#include "../../Common/MyTypes.h"
+
+namespace NCompress {
+namespace NXpress {
+
+// maximum size of data block that can be encoded with one Encode() call
+const unsigned kBlockSizeMax_Log = 16;
+
+/*
+  CEncoder : encoder for XPRESS Huffman (LZ77 + Huffman) format.
+  Each Encode() call writes independent block with own Huffman table.
+  Such blocks are used as chunks in WIM resources.
+*/
+
+class CEncoder
+{
+  CObjArray<UInt32> _hash;
+  CObjArray<UInt32> _chain;
+  CObjArray<UInt32> _items;
+  unsigned _numPasses;
+
+  unsigned GetMatch(const Byte *src, size_t pos, size_t size, UInt32 &dist);
+public:
+  CEncoder(): _numPasses(1 << 5) {}
+
+  // (level) is 1...9
+  void SetLevel(unsigned level);
+
+  /* it returns the size of packed data.
+     it returns 0, if packed data is not smaller than (destSize).
+     (srcSize) must be in range [1, (1 << kBlockSizeMax_Log)] */
+  size_t Encode(const Byte *src, size_t srcSize, Byte *dest, size_t destSize);
+};
+
+}}
+
+#endif
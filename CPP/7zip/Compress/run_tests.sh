@@ -9,6 +9,24 @@ echo "Parallel Compressor Test Runner"
 echo "============================================="
 echo ""
 
+# it runs test executable ($1) of test suite ($2), if that executable exists
+run_suite() {
+    echo ""
+    echo "============================================="
+    echo "Running $2 Tests"
+    echo "============================================="
+    if [ -f "$1" ]; then
+        if ./"$1"; then
+            echo "✓ $2 tests PASSED"
+        else
+            echo "✗ $2 tests FAILED"
+            exit 1
+        fi
+    else
+        echo "⚠ $2 test executable not found, skipping..."
+    fi
+}
+
 # Build tests
 echo "Building test suite..."
 cd /home/runner/work/7zip/7zip/CPP/7zip/Compress
@@ -121,6 +139,11 @@ else
     echo "⚠ Security test executable not found, skipping..."
 fi
 
+# Run the tests of multithreaded I/O and archive handlers
+for suite in IoBatch KernelCopy ReadAhead Dmg Img Ntfs Binder; do
+    run_suite "${suite}Test" "$suite"
+done
+
 # Test with 7z command if available
 echo ""
 echo "============================================="
@@ -139,6 +139,8 @@ namespace NCoderPropID
     kNumThreadGroups,   // VT_UI4
     kThreadGroup,       // VT_UI4
     kAffinityInGroup,   // VT_UI8
+    kMtNumHashBlocks,   // VT_UI4 : the depth of queue between hash and bt threads of LZ match finder
+    kMtNumBtBlocks,     // VT_UI4 : the depth of queue between bt thread of LZ match finder and encoder
     /*
     // kHash3Bits,          // VT_UI4
     // kHash2Bits,          // VT_UI4
@@ -237,6 +239,33 @@ Z7_IFACE_CONSTR_CODER(ICompressSetMemLimit, 0x28)
 Z7_IFACE_CONSTR_CODER(ICompressReadUnusedFromInBuf, 0x29)
 
 
+/*
+  ICompressGetMtStat is supported by encoders that use multithreaded
+  LZ match finder (LZMA, LZMA2). Call GetMtStat() after ICompressCoder::Code().
+  The stall is a sleep of thread, while the ring queue between threads
+  is empty or full (see CMatchFinderMt_Stat in LzFindMt.h).
+  GetMtStat() returns the numbers of stalls for latest Code() call:
+    values[numValues] : (NCoderMtStat::EEnum) values.
+    The value is 0, if the match finder threads were not used.
+*/
+namespace NCoderMtStat
+{
+  enum EEnum
+  {
+    kHashStalls_Write, // hash thread was waiting for free hash block
+    kHashStalls_Read,  // bt thread was waiting for filled hash block
+    kBtStalls_Write,   // bt thread was waiting for free bt block
+    kBtStalls_Read,    // encoder thread was waiting for filled bt block
+
+    kNumValues
+  };
+}
+
+#define Z7_IFACEM_ICompressGetMtStat(x) \
+  x(GetMtStat(UInt64 *values, UInt32 numValues))
+Z7_IFACE_CONSTR_CODER(ICompressGetMtStat, 0x2A)
+
+
 #define Z7_IFACEM_ICompressGetSubStreamSize(x) \
   x(GetSubStreamSize(UInt64 subStream, UInt64 *value))
 Z7_IFACE_CONSTR_CODER(ICompressGetSubStreamSize, 0x30)
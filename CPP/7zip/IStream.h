@@ -206,5 +206,71 @@ inputs:
 
 Z7_IFACE_CONSTR_STREAM(IStreamSetRestriction, 0x10)
 
+
+/*
+IStreamKernelCopy allows kernel-side copy (copy_file_range() / sendfile())
+between streams that are backed by file descriptors.
+Wrapper streams (limited streams, CRC streams) forward these calls to base stream.
+
+KernelCopy_GetFd(Int32 *fd, UInt64 *limit, Int32 *needData)
+  returns S_OK, if the stream is backed by file descriptor (*fd),
+    and current file offset of (*fd) is current position of the stream.
+      (*limit)    : max number of bytes that can be transferred through (*fd)
+                    from current position. (UInt64)(Int64)-1 means no limit.
+      (*needData) : (!= 0), if the stream needs the transferred data itself
+                    (for example, to calculate CRC).
+                    CCopyCoder reads the copied data back from input (fd) for such streams.
+  returns S_FALSE, if direct access to file descriptor is not possible now.
+    The caller must use Read() / Write() in that case.
+
+KernelCopy_Processed(const void *data, UInt32 size)
+  The caller reports that (size) bytes were transferred through (fd).
+  (data) contains these bytes, if some stream has reported (needData).
+  Otherwise (data) can be NULL.
+*/
+
+#define Z7_IFACEM_IStreamKernelCopy(x) \
+  x(KernelCopy_GetFd(Int32 *fd, UInt64 *limit, Int32 *needData)) \
+  x(KernelCopy_Processed(const void *data, UInt32 size)) \
+
+Z7_IFACE_CONSTR_STREAM(IStreamKernelCopy, 0x11)
+
+
+/*
+IStreamGetDataRange allows the caller to skip unallocated regions (holes)
+of sparse stream, like SEEK_DATA / SEEK_HOLE in lseek().
+The data in hole is zeros, if it's read with Read() call.
+
+GetDataRange(UInt64 pos, UInt64 *dataStart, UInt64 *dataEnd)
+  (pos) : the offset in stream.
+  returns:
+    (*dataStart) : the start of first data region that contains data after (pos).
+                   (*dataStart >= pos).
+                   If there is no data after (pos), (*dataStart) is equal to stream size.
+    (*dataEnd)   : the end of that data region (start of next hole or stream size).
+  The callee can report some holes as data regions, if it can't check them.
+*/
+
+#define Z7_IFACEM_IStreamGetDataRange(x) \
+  x(GetDataRange(UInt64 pos, UInt64 *dataStart, UInt64 *dataEnd)) \
+
+Z7_IFACE_CONSTR_STREAM(IStreamGetDataRange, 0x12)
+
+
+/*
+IOutStreamWriteHole::WriteHole(UInt64 size)
+  It works like Write() call for (size) zero bytes.
+  But the callee can skip real writing, and it can create hole in sparse file.
+  returns:
+    S_OK    : if (size) zero bytes were written or skipped.
+    S_FALSE : if the callee can't skip data now.
+              The caller must call Write() with zero bytes in that case.
+*/
+
+#define Z7_IFACEM_IOutStreamWriteHole(x) \
+  x(WriteHole(UInt64 size)) \
+
+Z7_IFACE_CONSTR_STREAM(IOutStreamWriteHole, 0x13)
+
 Z7_PURE_INTERFACES_END
 #endif
@@ -132,6 +132,9 @@ enum Enum
   kDisablePercents,
   kShowTime,
   kLogLevel,
+  kJsonProgress,
+  kBenchFormat,
+  kBenchCompare,
 
   kOutStream,
   kErrStream,
@@ -283,6 +286,9 @@ static const CSwitchForm kSwitchForms[] =
   { "bd", SWFRM_SIMPLE },
   { "bt", SWFRM_SIMPLE },
   { "bb", SWFRM_STRING_SINGL(0) },
+  { "bj", SWFRM_STRING_SINGL(0) },
+  { "bformat", SWFRM_STRING_SINGL(1) },
+  { "bcompare", SWFRM_STRING_SINGL(1) },
 
   { "bso", NSwitchType::kChar, false, 1, k_Stream_PostCharSet },
   { "bse", NSwitchType::kChar, false, 1, k_Stream_PostCharSet },
@@ -1097,6 +1103,51 @@ void CArcCmdLineParser::Parse1(const UStringVector &commandStrings,
     }
   }
 
+  if (parser[NKey::kJsonProgress].ThereIs)
+  {
+    // -bj[{fd}][:{ms}]
+    options.JsonProgress = true;
+    UString s = parser[NKey::kJsonProgress].PostStrings[0];
+    const int colonPos = s.Find(L':');
+    if (colonPos >= 0)
+    {
+      if (!StringToUInt32(s.Ptr((unsigned)colonPos + 1), options.JsonProgress_Interval))
+        throw CArcCmdLineException("Unsupported switch postfix -bj", s);
+      s.DeleteFrom((unsigned)colonPos);
+    }
+    if (!s.IsEmpty())
+    {
+      UInt32 v;
+      if (!StringToUInt32(s, v) || v > (1 << 16))
+        throw CArcCmdLineException("Unsupported switch postfix -bj", s);
+      options.JsonProgress_Fd = (int)v;
+    }
+  }
+
+  if (parser[NKey::kBenchFormat].ThereIs)
+  {
+    // -bformat={json|csv}
+    UString s = parser[NKey::kBenchFormat].PostStrings[0];
+    if (s.IsPrefixedBy(L"="))
+      s.Delete(0);
+    if (s.IsEqualTo_Ascii_NoCase("json"))
+      options.BenchFormat = NBenchFormat::kJson;
+    else if (s.IsEqualTo_Ascii_NoCase("csv"))
+      options.BenchFormat = NBenchFormat::kCsv;
+    else
+      throw CArcCmdLineException("Unsupported switch postfix -bformat", s);
+  }
+  if (parser[NKey::kBenchCompare].ThereIs)
+  {
+    // -bcompare={baseline.json}
+    UString s = parser[NKey::kBenchCompare].PostStrings[0];
+    if (s.IsPrefixedBy(L"="))
+      s.Delete(0);
+    if (s.IsEmpty())
+      throw CArcCmdLineException("Unsupported switch postfix -bcompare", s);
+    options.BenchCompareFile = s;
+  }
+
   if (parser[NKey::kCaseSensitive].ThereIs)
   {
     options.CaseSensitive =
@@ -1449,12 +1500,37 @@ void CArcCmdLineParser::Parse2(CArcCmdLineOptions &options)
     #endif
   }
 
-  nop.Include = true;
-  AddToCensorFromNonSwitchesStrings(isRename ? &options.UpdateOptions.RenamePairs : NULL,
-      curCommandIndex, options.Censor,
-      nonSwitchStrings, parser.StopSwitchIndex,
-      nop,
-      thereAreSwitchIncludes, codePage);
+  if (options.Command.CommandType == NCommandType::kBenchmark)
+  {
+    /* b [number_of_iterations] [files...]
+       the first string is the number of iterations, if it starts with decimal digit.
+       another strings (or -i switches) are the files for benchmark with real data. */
+    options.NumIterations = 1;
+    options.NumIterations_Defined = false;
+    if (curCommandIndex < numNonSwitchStrings
+        && (parser.StopSwitchIndex < 0 || (int)curCommandIndex < parser.StopSwitchIndex))
+    {
+      const UString &s = nonSwitchStrings[curCommandIndex];
+      if (!s.IsEmpty() && s[0] >= '0' && s[0] <= '9')
+      {
+        if (!StringToUInt32(s, options.NumIterations))
+          throw CArcCmdLineException("Incorrect number of benchmark iterations", s);
+        curCommandIndex++;
+        options.NumIterations_Defined = true;
+      }
+    }
+    options.BenchCorpus = (curCommandIndex < numNonSwitchStrings || thereAreSwitchIncludes);
+  }
+
+  if (options.Command.CommandType != NCommandType::kBenchmark || options.BenchCorpus)
+  {
+    nop.Include = true;
+    AddToCensorFromNonSwitchesStrings(isRename ? &options.UpdateOptions.RenamePairs : NULL,
+        curCommandIndex, options.Censor,
+        nonSwitchStrings, parser.StopSwitchIndex,
+        nop,
+        thereAreSwitchIncludes, codePage);
+  }
 
   #ifndef Z7_NO_CRYPTO
   options.PasswordEnabled = parser[NKey::kPassword].ThereIs;
@@ -1722,14 +1798,10 @@ void CArcCmdLineParser::Parse2(CArcCmdLineOptions &options)
   }
   else if (options.Command.CommandType == NCommandType::kBenchmark)
   {
-    options.NumIterations = 1;
-    options.NumIterations_Defined = false;
-    if (curCommandIndex < numNonSwitchStrings)
+    if (options.BenchCorpus)
     {
-      if (!StringToUInt32(nonSwitchStrings[curCommandIndex], options.NumIterations))
-        throw CArcCmdLineException("Incorrect number of benchmark iterations", nonSwitchStrings[curCommandIndex]);
-      curCommandIndex++;
-      options.NumIterations_Defined = true;
+      options.Censor.AddPathsToCensor(censorPathMode);
+      options.Censor.ExtendExclude();
     }
   }
   else if (options.Command.CommandType == NCommandType::kHash)
@@ -46,6 +46,13 @@ enum
   k_OutStream_stderr = 2
 };
 
+namespace NBenchFormat { enum EEnum
+{
+  kText = 0,
+  kJson,
+  kCsv
+};}
+
 struct CArcCmdLineOptions
 {
   bool HelpMode;
@@ -67,6 +74,9 @@ struct CArcCmdLineOptions
   bool ShowDialog;
   bool TechMode;
   bool ShowTime;
+  bool JsonProgress;
+  int JsonProgress_Fd;
+  UInt32 JsonProgress_Interval; // in milliseconds
   CBoolPair ListPathSeparatorSlash;
 
   CBoolPair NtSecurity;
@@ -119,6 +129,9 @@ struct CArcCmdLineOptions
   // Benchmark
   UInt32 NumIterations;
   bool NumIterations_Defined;
+  NBenchFormat::EEnum BenchFormat;
+  UString BenchCompareFile; // baseline results in JSON format
+  bool BenchCorpus;         // (b) command with files: benchmark with real data
 
   CArcCmdLineOptions():
       HelpMode(false),
@@ -140,6 +153,9 @@ struct CArcCmdLineOptions
       ShowDialog(false),
       TechMode(false),
       ShowTime(false),
+      JsonProgress(false),
+      JsonProgress_Fd(2),
+      JsonProgress_Interval(1000),
 
       ConsoleCodePage(-1),
 
@@ -147,7 +163,9 @@ struct CArcCmdLineOptions
       Number_for_Errors(k_OutStream_stderr),
       Number_for_Percents(k_OutStream_stdout),
 
-      LogLevel(0)
+      LogLevel(0),
+      BenchFormat(NBenchFormat::kText),
+      BenchCorpus(false)
   {
     ListPathSeparatorSlash.Val =
 #ifdef _WIN32
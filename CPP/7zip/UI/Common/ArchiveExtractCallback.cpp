@@ -300,8 +300,15 @@ CArchiveExtractCallback::CArchiveExtractCallback():
     // Write_ATime(true),
     // Write_MTime(true),
     Is_elimPrefix_Mode(false),
+   #ifndef Z7_SFX
+    CoderStats(NULL),
+    PhaseTimes(NULL),
+   #endif
     _arc(NULL),
     _multiArchives(false)
+   #ifdef Z7_IO_URING
+    , _ioBatch_WasTried(false)
+   #endif
 {
   #ifdef Z7_USE_SECURITY_CODE
   _saclEnabled = InitLocalPrivileges();
@@ -1191,6 +1198,11 @@ HRESULT CArchiveExtractCallback::CheckExistFile(FString &fullProcessedPath, bool
   {
     if (_overwriteMode == NExtract::NOverwriteMode::kSkip)
       return S_OK;
+
+   #ifdef Z7_IO_URING
+    // the existing file can have pending write operation in batch
+    RINOK(FlushIoBatch())
+   #endif
     
     if (_overwriteMode == NExtract::NOverwriteMode::kAsk)
     {
@@ -1462,6 +1474,16 @@ HRESULT CArchiveExtractCallback::GetExtractStream(CMyComPtr<ISequentialOutStream
 
   _outFileStreamSpec = new COutFileStream;
   CMyComPtr<IOutStream> outFileStream_Loc(_outFileStreamSpec);
+
+ #ifdef Z7_IO_URING
+  if (!_ioBatch_WasTried)
+  {
+    _ioBatch_WasTried = true;
+    _ioBatch.Create();
+  }
+  if (_ioBatch.IsCreated())
+    _outFileStreamSpec->IoBatch = &_ioBatch;
+ #endif
   
   if (!_outFileStreamSpec->Create_ALWAYS_or_Open_ALWAYS(fullProcessedPath, !_isSplit))
   {
@@ -1843,7 +1865,12 @@ Z7_COM7F_IMF(CArchiveExtractCallback::GetStream(UInt32 index, ISequentialOutStre
     else
     {
       bool needExit = true;
-      RINOK(GetExtractStream(outStreamLoc, needExit))
+      {
+       #ifndef Z7_SFX
+        CPhaseTimer phaseTimer(PhaseTimes, NPhase::kFileCreate);
+       #endif
+        RINOK(GetExtractStream(outStreamLoc, needExit))
+      }
       if (needExit)
         return S_OK;
     }
@@ -1930,10 +1957,56 @@ Z7_COM7F_IMF(CArchiveExtractCallback::PrepareOperation(Int32 askExtractMode))
 
 
 
+#ifdef Z7_IO_URING
+
+/* the write and close operations of small files are finished asynchronously.
+   So the error can be reported after the operation result of another file.
+   We report it with the path of failed file, and we stop the extraction,
+   as it's done in the synchronous code. */
+
+HRESULT CArchiveExtractCallback::ReportIoBatchError()
+{
+  const HRESULT errorCode = GetLastError_noZero_HRESULT();
+  RINOK(SendMessageError_with_Error(errorCode, "Cannot write output file", _ioBatch.GetErrorPath()))
+  return errorCode;
+}
+
+// it waits for all queued operations
+HRESULT CArchiveExtractCallback::FlushIoBatch()
+{
+  HRESULT res = S_OK;
+  if (!_ioBatch.Flush())
+    res = ReportIoBatchError();
+  const HRESULT res2 = ReportIoBatchErrors();
+  if (res == S_OK)
+    res = res2;
+  return res;
+}
+
+// it doesn't wait for queued operations, it reports the errors of finished operations
+HRESULT CArchiveExtractCallback::ReportIoBatchErrors()
+{
+  HRESULT res = S_OK;
+  while (!_ioBatch.GetFinishedError())
+  {
+    const HRESULT res2 = ReportIoBatchError();
+    if (res == S_OK)
+      res = res2;
+  }
+  return res;
+}
+
+#endif
+
+
 HRESULT CArchiveExtractCallback::CloseFile()
 {
   if (!_outFileStream)
     return S_OK;
+
+ #ifndef Z7_SFX
+  CPhaseTimer phaseTimer(PhaseTimes, NPhase::kFileClose);
+ #endif
   
   HRESULT hres = S_OK;
   
@@ -2733,6 +2806,10 @@ Z7_COM7F_IMF(CArchiveExtractCallback::SetOperationResult(Int32 opRes))
 
   if (_needSetAttrib)
     SetAttrib();
+
+ #ifdef Z7_IO_URING
+  RINOK(ReportIoBatchErrors())
+ #endif
   
   RINOK(_extractCallback2->SetOperationResult(opRes, BoolToInt(_encrypted)))
   
@@ -2771,6 +2848,18 @@ Z7_COM7F_IMF(CArchiveExtractCallback::ReportExtractResult(UInt32 indexType, UInt
 }
 
 
+#ifndef Z7_SFX
+
+Z7_COM7F_IMF(CArchiveExtractCallback::ReportCoderStat(UInt64 methodId, const UInt64 *values, UInt32 numValues))
+{
+  if (CoderStats)
+    CoderStats->Add(methodId, values, numValues);
+  return S_OK;
+}
+
+#endif
+
+
 Z7_COM7F_IMF(CArchiveExtractCallback::CryptoGetTextPassword(BSTR *password))
 {
   COM_TRY_BEGIN
@@ -3060,6 +3149,13 @@ HRESULT CArchiveExtractCallback::CloseArc()
 {
   // we call CloseReparseAndFile() here because we can have non-closed file in some cases?
   HRESULT res = CloseReparseAndFile();
+#ifdef Z7_IO_URING
+  {
+    const HRESULT res2 = FlushIoBatch();
+    if (res == S_OK)
+      res = res2;
+  }
+#endif
 #ifdef SUPPORT_LINKS
   {
     const HRESULT res2 = SetPostLinks();
@@ -15,6 +15,10 @@
 
 #include "../../Archive/IArchive.h"
 
+#ifndef Z7_SFX
+#include "CoderStat.h"
+#include "PhaseTime.h"
+#endif
 #include "ExtractMode.h"
 #include "IFileExtractCallback.h"
 #include "OpenArchive.h"
@@ -336,6 +340,7 @@ class CArchiveExtractCallback Z7_final:
   public IArchiveUpdateCallbackFile,
   public IArchiveGetDiskProperty,
   public IArchiveRequestMemoryUseCallback,
+  public IArchiveCoderStatCallback,
 #endif
   public CMyUnknownImp
 {
@@ -347,6 +352,9 @@ class CArchiveExtractCallback Z7_final:
   Z7_COM_QI_ENTRY(IArchiveUpdateCallbackFile)
   Z7_COM_QI_ENTRY(IArchiveGetDiskProperty)
   Z7_COM_QI_ENTRY(IArchiveRequestMemoryUseCallback)
+  // the handler collects coder statistics only if it can get that interface
+  else if (iid == IID_IArchiveCoderStatCallback && CoderStats)
+    { IArchiveCoderStatCallback *ti = this;  *outObject = ti; }
 #endif
   Z7_COM_QI_END
   Z7_COM_ADDREF_RELEASE
@@ -360,6 +368,7 @@ class CArchiveExtractCallback Z7_final:
   Z7_IFACE_COM7_IMP(IArchiveUpdateCallbackFile)
   Z7_IFACE_COM7_IMP(IArchiveGetDiskProperty)
   Z7_IFACE_COM7_IMP(IArchiveRequestMemoryUseCallback)
+  Z7_IFACE_COM7_IMP(IArchiveCoderStatCallback)
 #endif
 
   // bool Write_CTime;
@@ -370,6 +379,10 @@ class CArchiveExtractCallback Z7_final:
   bool _removePartsForAltStreams;
 public:
   bool Is_elimPrefix_Mode;
+ #ifndef Z7_SFX
+  CCoderStatSet *CoderStats; // if it's not NULL, the handler is asked to report coder statistics
+  CPhaseTimes *PhaseTimes;   // if it's not NULL, the time of creating and closing of files is added
+ #endif
 private:
 
   const CArc *_arc;
@@ -438,6 +451,15 @@ private:
   COutFileStream *_outFileStreamSpec;
   CMyComPtr<ISequentialOutStream> _outFileStream;
 
+ #ifdef Z7_IO_URING
+  // small output files are written and closed in batches
+  NWindows::NFile::NIO::CIoBatch _ioBatch;
+  bool _ioBatch_WasTried;
+  HRESULT ReportIoBatchError();
+  HRESULT FlushIoBatch();
+  HRESULT ReportIoBatchErrors();
+ #endif
+
   CByteBuffer _outMemBuf;
   CBufPtrSeqOutStream *_bufPtrSeqOutStream_Spec;
   CMyComPtr<ISequentialOutStream> _bufPtrSeqOutStream;
@@ -18,6 +18,14 @@
 #endif
 #endif // USE_POSIX_TIME
 
+#ifdef __linux__
+#include <fcntl.h>
+#include <unistd.h>
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+#endif
+
 #ifdef _WIN32
 #define USE_ALLOCA
 #endif
@@ -3126,6 +3134,13 @@ struct CBenchCallbackToPrint Z7_final: public IBenchCallback
   CTotalBenchRes DecodeRes;
 
   CBenchInfo BenchInfo_Results[2];
+
+  // for structured output of results:
+  IBenchResultCallback *ResultCallback;
+  AString MethodName;
+  UInt64 ResultDictSize;
+  UInt32 NumThreads;
+  UInt32 Pass;
   
   CBenchCallbackToPrint():
       NeedPrint(true),
@@ -3134,7 +3149,11 @@ struct CBenchCallbackToPrint Z7_final: public IBenchCallback
       NameFieldSize(0),
       EncodeWeight(1),
       DecodeWeight(1),
-      CpuFreq(0)
+      CpuFreq(0),
+      ResultCallback(NULL),
+      ResultDictSize(0),
+      NumThreads(1),
+      Pass(0)
       {}
 
   void Init() { EncodeRes.Init(); DecodeRes.Init(); }
@@ -3142,6 +3161,7 @@ struct CBenchCallbackToPrint Z7_final: public IBenchCallback
   void NewLine();
   
   HRESULT SetFreq(bool showFreq, UInt64 cpuFreq);
+  HRESULT AddResult(bool decode, const CBenchInfo &info, UInt64 rating);
   HRESULT SetEncodeResult(const CBenchInfo &info, bool final) Z7_override;
   HRESULT SetDecodeResult(const CBenchInfo &info, bool final) Z7_override;
 };
@@ -3153,20 +3173,44 @@ HRESULT CBenchCallbackToPrint::SetFreq(bool showFreq, UInt64 cpuFreq)
   return S_OK;
 }
 
+HRESULT CBenchCallbackToPrint::AddResult(bool decode, const CBenchInfo &info, UInt64 rating)
+{
+  if (!ResultCallback)
+    return S_OK;
+  CTotalBenchRes t;
+  t.Rating = rating;
+  t.Generate_From_BenchInfo(info);
+  CBenchResult r;
+  r.Method = MethodName;
+  r.DictSize = ResultDictSize;
+  r.NumThreads = NumThreads;
+  r.Pass = Pass;
+  r.Decode = decode;
+  r.Speed = t.Speed;
+  r.Usage = t.Usage;
+  r.RPU = t.RPU;
+  r.Rating = rating;
+  return ResultCallback->AddBenchResult(r);
+}
+
 HRESULT CBenchCallbackToPrint::SetEncodeResult(const CBenchInfo &info, bool final)
 {
   RINOK(_file->CheckBreak())
   if (final)
     BenchInfo_Results[0] = info;
   if (final)
-  if (NeedPrint)
+  if (NeedPrint || ResultCallback)
   {
     const UInt64 rating = BenchProps.GetRating_Enc(DictSize, info.GlobalTime, info.GlobalFreq, info.UnpackSize * info.NumIterations);
-    PrintResults(_file, info,
-        EncodeWeight, rating,
-        ShowFreq, CpuFreq, &EncodeRes);
-    if (!Use2Columns)
-      _file->NewLine();
+    if (NeedPrint)
+    {
+      PrintResults(_file, info,
+          EncodeWeight, rating,
+          ShowFreq, CpuFreq, &EncodeRes);
+      if (!Use2Columns)
+        _file->NewLine();
+    }
+    RINOK(AddResult(false, info, rating))
   }
   return S_OK;
 }
@@ -3179,20 +3223,24 @@ HRESULT CBenchCallbackToPrint::SetDecodeResult(const CBenchInfo &info, bool fina
   if (final)
     BenchInfo_Results[1] = info;
   if (final)
-  if (NeedPrint)
+  if (NeedPrint || ResultCallback)
   {
     const UInt64 rating = BenchProps.GetRating_Dec(info.GlobalTime, info.GlobalFreq, info.UnpackSize, info.PackSize, info.NumIterations);
-    if (Use2Columns)
-      _file->Print(kSep);
-    else
-      PrintSpaces(*_file, NameFieldSize);
     CBenchInfo info2 = info;
     info2.UnpackSize *= info2.NumIterations;
     info2.PackSize *= info2.NumIterations;
     info2.NumIterations = 1;
-    PrintResults(_file, info2,
-        DecodeWeight, rating,
-        ShowFreq, CpuFreq, &DecodeRes);
+    if (NeedPrint)
+    {
+      if (Use2Columns)
+        _file->Print(kSep);
+      else
+        PrintSpaces(*_file, NameFieldSize);
+      PrintResults(_file, info2,
+          DecodeWeight, rating,
+          ShowFreq, CpuFreq, &DecodeRes);
+    }
+    RINOK(AddResult(true, info2, rating))
   }
   return S_OK;
 }
@@ -3253,6 +3301,7 @@ static HRESULT TotalBench(
     if (!DoesWildcardMatchName_NoCase(methodMask.MethodName, bench.Name))
       continue;
     PrintLeft(*callback->_file, bench.Name, kFieldSize_Name);
+    callback->MethodName = bench.Name;
     {
       unsigned keySize = 32;
            if (IsString1PrefixedByString2(bench.Name, "AES128")) keySize = 16;
@@ -3444,6 +3493,136 @@ HRESULT CFreqBench::FreqBench(IBenchPrintCallback *_file
 
 
 
+#ifndef Z7_ST
+
+// ---------- Synchronization benchmark ----------
+
+/* It measures the cost of synchronization objects that are used by
+   multithreaded coders:
+   "ping-pong" tests : two threads pass control to each other,
+   "fast path" tests : one thread sets signaled state and then waits it. */
+
+static const unsigned kSyncBench_NumObjects = 2;
+
+struct CSyncBenchInfo
+{
+  NWindows::NSynchronization::CAutoResetEvent Events[kSyncBench_NumObjects];
+  NWindows::NSynchronization::CSemaphore Semaphores[kSyncBench_NumObjects];
+  NWindows::CThread Thread;
+  bool UseSemaphore;
+  UInt32 NumIterations;
+  WRes Res;
+
+  WRes Signal(unsigned i) { return UseSemaphore ? Semaphores[i].Release() : Events[i].Set(); }
+  WRes Wait(unsigned i) { return UseSemaphore ? Semaphores[i].Lock() : Events[i].Lock(); }
+};
+
+static THREAD_FUNC_DECL SyncThreadFunction(void *param)
+{
+  CSyncBenchInfo *p = (CSyncBenchInfo *)param;
+  WRes res = 0;
+  for (UInt32 i = 0; i < p->NumIterations && res == 0; i++)
+  {
+    res = p->Wait(0);
+    if (res == 0)
+      res = p->Signal(1);
+  }
+  p->Res = res;
+  return THREAD_FUNC_RET_ZERO;
+}
+
+static WRes SyncBench_Run(CSyncBenchInfo &info, bool pingPong, UInt64 &time)
+{
+  for (unsigned k = 0; k < kSyncBench_NumObjects; k++)
+  {
+    RINOK_WRes(info.Events[k].CreateIfNotCreated_Reset())
+    RINOK_WRes(info.Semaphores[k].OptCreateInit(0, 1))
+  }
+  info.Res = 0;
+  const UInt64 startTime = GetTimeCount();
+  WRes res = 0;
+  if (pingPong)
+  {
+    RINOK_WRes(info.Thread.Create(SyncThreadFunction, &info))
+    for (UInt32 i = 0; i < info.NumIterations && res == 0; i++)
+    {
+      res = info.Signal(0);
+      if (res == 0)
+        res = info.Wait(1);
+    }
+    const WRes res2 = info.Thread.Wait_Close();
+    if (res == 0)
+      res = res2;
+    if (res == 0)
+      res = info.Res;
+  }
+  else
+  {
+    for (UInt32 i = 0; i < info.NumIterations && res == 0; i++)
+    {
+      res = info.Signal(0);
+      if (res == 0)
+        res = info.Wait(0);
+    }
+  }
+  time = GetTimeCount() - startTime;
+  return res;
+}
+
+static HRESULT SyncBench(IBenchPrintCallback &f, UInt64 complexInCommands)
+{
+  static const char * const k_SyncTests[] =
+  {
+      "Event"
+    , "Semaphore"
+  };
+
+  const UInt64 freq = GetFreq();
+  f.NewLine();
+  PrintLeft(f, "Sync", kFieldSize_Name);
+  PrintLeft(f, "    ping-pong ns   ops/s", 24);
+  PrintLeft(f, " |   fast path ns   ops/s", 24);
+  f.NewLine();
+
+  for (unsigned t = 0; t < Z7_ARRAY_SIZE(k_SyncTests); t++)
+  {
+    PrintLeft(f, k_SyncTests[t], kFieldSize_Name);
+    for (unsigned mode = 0; mode < 2; mode++)
+    {
+      const bool pingPong = (mode == 0);
+      CSyncBenchInfo info;
+      info.UseSemaphore = (t != 0);
+      // a round trip in ping-pong test is about 1000 times slower than one command
+      UInt64 numIterations = complexInCommands >> (pingPong ? 12 : 6);
+      if (numIterations < 1000)
+        numIterations = 1000;
+      if (numIterations > ((UInt32)1 << 30))
+        numIterations = (UInt32)1 << 30;
+      info.NumIterations = (UInt32)numIterations;
+      UInt64 time = 0;
+      {
+        const WRes wres = SyncBench_Run(info, pingPong, time);
+        if (wres != 0)
+          return HRESULT_FROM_WIN32(wres);
+      }
+      if (time == 0)
+        time = 1;
+      // ping-pong test: one iteration includes two thread switches
+      const UInt64 numOps = (UInt64)info.NumIterations * (pingPong ? 2 : 1);
+      if (mode != 0)
+        f.Print(" |");
+      PrintNumber(f, MyMultDiv64(time, 1000000000, numOps * freq), 13);
+      PrintNumber(f, MyMultDiv64(numOps, freq, time), 9);
+      RINOK(f.CheckBreak())
+    }
+    f.NewLine();
+  }
+  return S_OK;
+}
+
+#endif
+
+
 static HRESULT CrcBench(
     DECL_EXTERNAL_CODECS_LOC_VARS
     UInt64 complexInCommands,
@@ -3453,6 +3632,7 @@ static HRESULT CrcBench(
     
     UInt64 &speed,
     UInt64 &usage,
+    UInt64 &rating,
 
     UInt32 complexity, unsigned benchWeight,
     const UInt32 *checkSum,
@@ -3612,19 +3792,20 @@ static HRESULT CrcBench(
   info.PackSize = unpSizeThreads;
   info.NumIterations = 1;
 
+  {
+    UInt64 unpSizeThreads2 = unpSizeThreads;
+    if (unpSizeThreads2 == 0)
+      unpSizeThreads2 = numIterations * 1 * numThreads;
+    const UInt64 numCommands = unpSizeThreads2 * complexity / 256;
+    rating = info.GetSpeed(numCommands);
+  }
+
   if (_file)
   {
     if (showRating)
-    {
-      UInt64 unpSizeThreads2 = unpSizeThreads;
-      if (unpSizeThreads2 == 0)
-        unpSizeThreads2 = numIterations * 1 * numThreads;
-      const UInt64 numCommands = unpSizeThreads2 * complexity / 256;
-      const UInt64 rating = info.GetSpeed(numCommands);
       PrintResults(_file, info,
           benchWeight, rating,
           showFreq, cpuFreq, encodeRes);
-    }
     RINOK(_file->CheckBreak())
   }
 
@@ -3636,6 +3817,26 @@ static HRESULT CrcBench(
 
 
 
+static HRESULT AddHashResult(CBenchCallbackToPrint *callback,
+    const char *name, UInt64 speed, UInt64 usage, UInt64 rating)
+{
+  if (!callback->ResultCallback)
+    return S_OK;
+  CBenchResult r;
+  r.Method = name;
+  r.DictSize = callback->ResultDictSize;
+  r.NumThreads = callback->NumThreads;
+  r.Pass = callback->Pass;
+  r.Decode = false;
+  r.Speed = speed;
+  r.Usage = usage;
+  r.RPU = 0;
+  if (usage != 0)
+    r.RPU = MyMultDiv64(rating, kBenchmarkUsageMult, usage);
+  r.Rating = rating;
+  return callback->ResultCallback->AddBenchResult(r);
+}
+
 static HRESULT TotalBench_Hash(
     DECL_EXTERNAL_CODECS_LOC_VARS
     const COneMethodInfo &methodMask,
@@ -3665,13 +3866,13 @@ static HRESULT TotalBench_Hash(
     propVariant = bench.Name;
     RINOK(method.ParseMethodFromPROPVARIANT(UString(), propVariant))
 
-    UInt64 speed, usage;
+    UInt64 speed, usage, rating;
 
     const HRESULT res = CrcBench(
         EXTERNAL_CODECS_LOC_VARS
         complexInCommands,
         numThreads, bufSize, fileData,
-        speed, usage,
+        speed, usage, rating,
         bench.Complex, bench.Weight,
         (!fileData && bufSize == (1 << kNumHashDictBits)) ? &bench.CheckSum : NULL,
         method,
@@ -3688,6 +3889,7 @@ static HRESULT TotalBench_Hash(
     else
     {
       RINOK(res)
+      RINOK(AddHashResult(callback, bench.Name, speed, usage, rating))
     }
     callback->NewLine();
   }
@@ -3759,7 +3961,8 @@ HRESULT Bench(
     const CObjectVector<CProperty> &props,
     UInt32 numIterations,
     bool multiDict,
-    IBenchFreqCallback *freqCallback)
+    IBenchFreqCallback *freqCallback,
+    IBenchResultCallback *resultCallback)
 {
   // for (int y = 0; y < 10000; y++)
   if (!CrcInternalTest())
@@ -4255,6 +4458,17 @@ HRESULT Bench(
         kOldLzmaDictBits, printCallback, benchCallback, &benchProps);
   }
 
+  if (methodName.IsEqualTo_Ascii_NoCase("sync"))
+  {
+    if (!printCallback)
+      return S_FALSE;
+   #ifdef Z7_ST
+    return E_NOTIMPL;
+   #else
+    return SyncBench(*printCallback, complexInCommands);
+   #endif
+  }
+
   if (methodName.IsEqualTo_Ascii_NoCase("CRC"))
     methodName = "crc32";
 
@@ -4275,6 +4489,13 @@ HRESULT Bench(
   CBenchCallbackToPrint callback;
   callback.Init();
   callback._file = printCallback;
+  callback.ResultCallback = resultCallback;
+  callback.MethodName = methodName;
+  if (!method.PropsString.IsEmpty())
+  {
+    callback.MethodName.Add_Colon();
+    callback.MethodName += GetAnsiString(method.PropsString);
+  }
 
   if (isHashMethod || codecIndex != -1)
   {
@@ -4478,19 +4699,23 @@ HRESULT Bench(
       {
         Print_Pow(f, pow);
         // PrintNumber(f, bufSize >> 10, 4);
+        callback.ResultDictSize = bufSize;
+        callback.Pass = iter;
  
         FOR_VECTOR (ti, numThreadsVector)
         {
           RINOK(f.CheckBreak())
           const UInt32 numThreads = numThreadsVector[ti];
+          callback.NumThreads = numThreads;
           if (isHashMethod)
           {
             UInt64 speed = 0;
             UInt64 usage = 0;
+            UInt64 rating = 0;
             const HRESULT res = CrcBench(EXTERNAL_CODECS_LOC_VARS complexInCommands,
               numThreads,
               dataSize, (const Byte *)fileDataBuffer,
-              speed, usage,
+              speed, usage, rating,
               (UInt32)complexity,
               1, // benchWeight,
               (pow == kNumHashDictBits && !use_fileData) ? checkSum : NULL,
@@ -4502,6 +4727,7 @@ HRESULT Bench(
               false, // showRating
               NULL, false, 0);
             RINOK(res)
+            RINOK(AddHashResult(&callback, callback.MethodName, speed, usage, rating))
             
             if (ti != 0)
               Print_Delimiter(f);
@@ -4654,6 +4880,7 @@ HRESULT Bench(
   }
  
   IBenchPrintCallback &f = *printCallback;
+  callback.NumThreads = numThreads;
 
   if (threadsPassIndex > 0)
   {
@@ -4780,8 +5007,10 @@ HRESULT Bench(
 
   if (totalBenchMode)
   {
+    callback.ResultDictSize = 0;
     for (UInt32 i = 0; i < numIterations; i++)
     {
+      callback.Pass = i;
       if (i != 0)
         printCallback->NewLine();
 
@@ -4940,6 +5169,7 @@ HRESULT Bench(
 
   for (unsigned i = 0; i < numIterations; i++)
   {
+    callback.Pass = i;
     unsigned pow = (dict < GetDictSizeFromLog(startDicLog)) ? kBenchMinDicLogSize : (unsigned)startDicLog;
     if (!multiDict)
       pow = 32;
@@ -4949,6 +5179,7 @@ HRESULT Bench(
     {
       Print_Pow(f, pow);
       callback.DictSize = (UInt64)1 << pow;
+      callback.ResultDictSize = callback.DictSize;
 
       COneMethodInfo method2 = method;
 
@@ -5024,3 +5255,652 @@ HRESULT Bench(
   }
   return S_OK;
 }
+
+
+
+// ---------- CorpusBench ----------
+
+static const UInt64 kMemUsage_Unknown = (UInt64)(Int64)-1;
+
+#ifdef __linux__
+
+/* (name) is field of /proc/self/status in kB, like "VmRSS:".
+   It returns the value in bytes, or (0) if the field was not found. */
+
+static UInt64 GetProcStatusValue(const char *name)
+{
+  const int fd = open("/proc/self/status", O_RDONLY);
+  if (fd < 0)
+    return 0;
+  char buf[1 << 13];
+  const ssize_t size = read(fd, buf, sizeof(buf) - 1);
+  close(fd);
+  if (size <= 0)
+    return 0;
+  buf[size] = 0;
+  const char *p = strstr(buf, name);
+  if (!p)
+    return 0;
+  p += strlen(name);
+  while (*p == ' ' || *p == '\t')
+    p++;
+  return ConvertStringToUInt64(p, NULL) << 10;
+}
+
+/* The peak of resident memory of process (VmHWM) is reset, if we write "5"
+   to /proc/self/clear_refs (Linux 4.0+). So the memory of coder is
+   (VmHWM after coding) - (VmRSS before coding).
+   Finish() returns (kMemUsage_Unknown), if the peak memory is not supported. */
+
+struct CCorpusMemMeter
+{
+  UInt64 StartRss;
+  bool Defined;
+
+  CCorpusMemMeter(): StartRss(0), Defined(false) {}
+
+  void Start()
+  {
+    Defined = false;
+    #ifdef __GLIBC__
+    // the memory that was freed by previous coders must not be reused without page faults
+    malloc_trim(0);
+    #endif
+    const int fd = open("/proc/self/clear_refs", O_WRONLY);
+    if (fd < 0)
+      return;
+    Defined = (write(fd, "5", 1) == 1);
+    close(fd);
+    StartRss = GetProcStatusValue("VmRSS:");
+    if (StartRss == 0)
+      Defined = false;
+  }
+
+  UInt64 Finish() const
+  {
+    if (!Defined)
+      return kMemUsage_Unknown;
+    const UInt64 peak = GetProcStatusValue("VmHWM:");
+    return peak > StartRss ? peak - StartRss : 0;
+  }
+};
+
+#else
+
+// the peak memory is not supported for another systems
+struct CCorpusMemMeter
+{
+  void Start() {}
+  UInt64 Finish() const { return kMemUsage_Unknown; }
+};
+
+#endif
+
+
+struct CCorpusStream
+{
+  size_t UnpackPos;
+  size_t UnpackSize;
+  size_t PackPos;
+  size_t PackSize;
+  size_t PropsPos;
+  size_t PropsSize;
+};
+
+class CCorpusBench
+{
+  CMidAlignedBuffer _data;
+  CMidAlignedBuffer _unpackBuf;
+  CDynBufSeqOutStream *_packStreamSpec;
+  CMyComPtr<ISequentialOutStream> _packStream;
+  CDynBufSeqOutStream *_propsStreamSpec;
+  CMyComPtr<ISequentialOutStream> _propsStream;
+  CRecordVector<size_t> _fileSizes;
+public:
+  size_t TotalSize;
+  size_t MaxFileSize;
+  CRecordVector<CCorpusStream> Streams;
+  IBenchPrintCallback *PrintCallback;
+
+  unsigned GetNumFiles() const { return _fileSizes.Size(); }
+  UInt64 GetPackSize() const { return _packStreamSpec->GetSize(); }
+
+  HRESULT Load(const FStringVector &filePaths);
+  HRESULT Encode(DECL_EXTERNAL_CODECS_LOC_VARS
+      unsigned codecIndex, const COneMethodInfo &method, bool solid,
+      CBenchInfo &info, UInt64 &memUsage);
+  HRESULT Decode(DECL_EXTERNAL_CODECS_LOC_VARS
+      CMethodId methodId, UInt32 numThreads,
+      CBenchInfo &info, UInt64 &memUsage);
+};
+
+
+HRESULT CCorpusBench::Load(const FStringVector &filePaths)
+{
+  _packStreamSpec = new CDynBufSeqOutStream;
+  _packStream = _packStreamSpec;
+  _propsStreamSpec = new CDynBufSeqOutStream;
+  _propsStream = _propsStreamSpec;
+  _fileSizes.Clear();
+  TotalSize = 0;
+  MaxFileSize = 0;
+
+  CRecordVector<UInt64> sizes;
+  UInt64 total = 0;
+  FOR_VECTOR (i, filePaths)
+  {
+    NFile::NFind::CFileInfo fi;
+    if (!fi.Find(filePaths[i]) || fi.IsDir())
+    {
+      const HRESULT res = GetLastError_noZero_HRESULT();
+      if (PrintCallback)
+      {
+        PrintCallback->Print("Cannot open file: ");
+        PrintCallback->Print(GetAnsiString(fs2us(filePaths[i])));
+        PrintCallback->NewLine();
+      }
+      return res;
+    }
+    sizes.Add(fi.Size);
+    total += fi.Size;
+  }
+  if (total != (size_t)total)
+    return E_OUTOFMEMORY;
+  ALLOC_WITH_HRESULT(&_data, (size_t)total)
+
+  size_t pos = 0;
+  FOR_VECTOR (i, filePaths)
+  {
+    // the file can be changed after Find(), so we read not more than the size from Find()
+    size_t size = (size_t)sizes[i];
+    if (size > (size_t)total - pos)
+      size = (size_t)total - pos;
+    NFile::NIO::CInFile file;
+    size_t processed = 0;
+    if (!file.Open(filePaths[i])
+        || !file.ReadFull((Byte *)_data + pos, size, processed))
+    {
+      const HRESULT res = GetLastError_noZero_HRESULT();
+      if (PrintCallback)
+      {
+        PrintCallback->Print("Cannot read file: ");
+        PrintCallback->Print(GetAnsiString(fs2us(filePaths[i])));
+        PrintCallback->NewLine();
+      }
+      return res;
+    }
+    _fileSizes.Add(processed);
+    pos += processed;
+    if (MaxFileSize < processed)
+      MaxFileSize = processed;
+  }
+  TotalSize = pos;
+
+  /* we allocate and fill the output buffers before benchmark,
+     so the memory of these buffers is not included to the memory of coders */
+  ALLOC_WITH_HRESULT(&_unpackBuf, TotalSize)
+  if (TotalSize != 0)
+    memset((Byte *)_unpackBuf, 0, TotalSize);
+  {
+    const size_t packReserve = TotalSize + TotalSize / 16 + ((size_t)_fileSizes.Size() << 6) + (1 << 16);
+    Byte *buf = _packStreamSpec->GetBufPtrForWriting(packReserve);
+    if (!buf)
+      return E_OUTOFMEMORY;
+    memset(buf, 0, packReserve);
+  }
+  return S_OK;
+}
+
+
+HRESULT CCorpusBench::Encode(DECL_EXTERNAL_CODECS_LOC_VARS
+    unsigned codecIndex, const COneMethodInfo &method, bool solid,
+    CBenchInfo &info, UInt64 &memUsage)
+{
+  _packStreamSpec->Init();
+  _propsStreamSpec->Init();
+  Streams.Clear();
+
+  CBufInStream *inStreamSpec = new CBufInStream;
+  CMyComPtr<ISequentialInStream> inStream = inStreamSpec;
+
+  CCorpusMemMeter memMeter;
+  memMeter.Start();
+  CBenchInfoCalc calc;
+  calc.SetStartTime();
+  {
+    CCreatedCoder cod;
+    RINOK(CreateCoder_Index(EXTERNAL_CODECS_LOC_VARS codecIndex, true, cod))
+    if (!cod.Coder)
+      return E_NOTIMPL;
+    CMyComPtr<ICompressCoder> encoder = cod.Coder;
+
+    CMyComPtr<ICompressSetCoderProperties> scp;
+    encoder.QueryInterface(IID_ICompressSetCoderProperties, &scp);
+    if (!scp && method.AreThereNonOptionalProps())
+      return E_INVALIDARG;
+    CMyComPtr<ICompressWriteCoderProperties> writeCoderProps;
+    encoder.QueryInterface(IID_ICompressWriteCoderProperties, &writeCoderProps);
+
+    const unsigned numStreams = (solid ? 1 : _fileSizes.Size());
+    size_t unpackPos = 0;
+
+    for (unsigned i = 0; i < numStreams; i++)
+    {
+      if (PrintCallback)
+      {
+        RINOK(PrintCallback->CheckBreak())
+      }
+      CCorpusStream stream;
+      stream.UnpackPos = unpackPos;
+      stream.UnpackSize = (solid ? TotalSize : _fileSizes[i]);
+      stream.PackPos = _packStreamSpec->GetSize();
+      stream.PropsPos = _propsStreamSpec->GetSize();
+
+      /* the archiver sets the size of data as (reduceSize) for each new stream.
+         So the encoder can reduce the dictionary for small files. */
+      if (scp)
+      {
+        const UInt64 reduceSize = stream.UnpackSize;
+        RINOK(method.SetCoderProps(scp, &reduceSize))
+      }
+      if (writeCoderProps)
+      {
+        RINOK(writeCoderProps->WriteCoderProperties(_propsStream))
+      }
+
+      inStreamSpec->Init((const Byte *)_data + unpackPos, stream.UnpackSize);
+      const UInt64 inSize = stream.UnpackSize;
+      RINOK(encoder->Code(inStream, _packStream, &inSize, NULL, NULL))
+
+      stream.PackSize = _packStreamSpec->GetSize() - stream.PackPos;
+      stream.PropsSize = _propsStreamSpec->GetSize() - stream.PropsPos;
+      Streams.Add(stream);
+      unpackPos += stream.UnpackSize;
+    }
+  }
+  calc.BenchInfo.UnpackSize = TotalSize;
+  calc.BenchInfo.PackSize = _packStreamSpec->GetSize();
+  calc.BenchInfo.NumIterations = 1;
+  calc.SetFinishTime(info);
+  memUsage = memMeter.Finish();
+  return S_OK;
+}
+
+
+HRESULT CCorpusBench::Decode(DECL_EXTERNAL_CODECS_LOC_VARS
+    CMethodId methodId, UInt32 numThreads,
+    CBenchInfo &info, UInt64 &memUsage)
+{
+  CBufInStream *inStreamSpec = new CBufInStream;
+  CMyComPtr<ISequentialInStream> inStream = inStreamSpec;
+  CBufPtrSeqOutStream *outStreamSpec = new CBufPtrSeqOutStream;
+  CMyComPtr<ISequentialOutStream> outStream = outStreamSpec;
+
+  CCorpusMemMeter memMeter;
+  memMeter.Start();
+  CBenchInfoCalc calc;
+  calc.SetStartTime();
+  {
+    CMyComPtr<ICompressCoder> decoder;
+    {
+      CCreatedCoder cod;
+      RINOK(CreateCoder_Id(EXTERNAL_CODECS_LOC_VARS methodId, false, cod))
+      decoder = cod.Coder;
+    }
+    if (!decoder)
+      return E_NOTIMPL;
+
+    #ifndef Z7_ST
+    {
+      CMyComPtr<ICompressSetCoderMt> setCoderMt;
+      decoder.QueryInterface(IID_ICompressSetCoderMt, &setCoderMt);
+      if (setCoderMt)
+      {
+        RINOK(setCoderMt->SetNumberOfThreads(numThreads))
+      }
+    }
+    #else
+    UNUSED_VAR(numThreads)
+    #endif
+
+    CMyComPtr<ICompressSetDecoderProperties2> setDecProps;
+    decoder.QueryInterface(IID_ICompressSetDecoderProperties2, &setDecProps);
+    CMyComPtr<ICompressSetFinishMode> setFinishMode;
+    decoder.QueryInterface(IID_ICompressSetFinishMode, &setFinishMode);
+
+    FOR_VECTOR (i, Streams)
+    {
+      if (PrintCallback)
+      {
+        RINOK(PrintCallback->CheckBreak())
+      }
+      const CCorpusStream &stream = Streams[i];
+      if (setDecProps)
+      {
+        RINOK(setDecProps->SetDecoderProperties2(
+            _propsStreamSpec->GetBuffer() + stream.PropsPos, (UInt32)stream.PropsSize))
+      }
+      else if (stream.PropsSize != 0)
+        return E_FAIL;
+      if (setFinishMode)
+      {
+        RINOK(setFinishMode->SetFinishMode(BoolToUInt(true)))
+      }
+      inStreamSpec->Init(_packStreamSpec->GetBuffer() + stream.PackPos, stream.PackSize);
+      outStreamSpec->Init((Byte *)_unpackBuf + stream.UnpackPos, stream.UnpackSize);
+      const UInt64 outSize = stream.UnpackSize;
+      RINOK(decoder->Code(inStream, outStream, NULL, &outSize, NULL))
+      if (outStreamSpec->GetPos() != stream.UnpackSize)
+        return S_FALSE;
+    }
+  }
+  calc.BenchInfo.UnpackSize = TotalSize;
+  calc.BenchInfo.PackSize = _packStreamSpec->GetSize();
+  calc.BenchInfo.NumIterations = 1;
+  calc.SetFinishTime(info);
+  memUsage = memMeter.Finish();
+
+  if (TotalSize != 0 && memcmp((const Byte *)_unpackBuf, (const Byte *)_data, TotalSize) != 0)
+    return S_FALSE;
+  return S_OK;
+}
+
+
+static void SplitCorpusList(const UString &s, UStringVector &list)
+{
+  list.Clear();
+  unsigned pos = 0;
+  for (;;)
+  {
+    const int comma = s.Find(L',', pos);
+    if (comma < 0)
+    {
+      list.Add(s.Ptr(pos));
+      return;
+    }
+    list.Add(s.Mid(pos, (unsigned)comma - pos));
+    pos = (unsigned)comma + 1;
+  }
+}
+
+static HRESULT ParseCorpusNumbers(const UString &s, UInt32 maxVal, CRecordVector<UInt32> &numbers)
+{
+  UStringVector list;
+  SplitCorpusList(s, list);
+  numbers.Clear();
+  FOR_VECTOR (i, list)
+  {
+    const wchar_t *end;
+    const UInt32 v = ConvertStringToUInt32(list[i], &end);
+    if (list[i].IsEmpty() || *end != 0 || v > maxVal)
+      return E_INVALIDARG;
+    numbers.Add(v);
+  }
+  return S_OK;
+}
+
+// (val / 100) with 2 digits after the point
+static void AddCorpusFixed2(AString &s, UInt64 val)
+{
+  s.Add_UInt64(val / 100);
+  s.Add_Dot();
+  s.Add_Char((char)('0' + (unsigned)(val / 10 % 10)));
+  s.Add_Char((char)('0' + (unsigned)(val % 10)));
+}
+
+static const unsigned kFieldSize_CorpusMethod = 16;
+static const unsigned kFieldSize_CorpusLayout = 7;
+static const unsigned kFieldSize_CorpusSize = 12;
+static const unsigned kFieldSize_CorpusRatio = 8;
+static const unsigned kFieldSize_CorpusMem = 7;
+
+static void PrintCorpusHeader(IBenchPrintCallback &f)
+{
+  PrintLeft(f, "Method", kFieldSize_CorpusMethod);
+  PrintRight(f, "Thr", 4);
+  f.Print(" ");
+  PrintLeft(f, "Layout", kFieldSize_CorpusLayout);
+  PrintRight(f, "Packed", kFieldSize_CorpusSize);
+  PrintRight(f, "Ratio", kFieldSize_CorpusRatio);
+  f.Print(kSep);
+  PrintRight(f, "Speed", kFieldSize_Speed);
+  PrintRight(f, "Usage", kFieldSize_Usage + 1);
+  PrintRight(f, "Mem", kFieldSize_CorpusMem);
+  f.Print(kSep);
+  PrintRight(f, "Speed", kFieldSize_Speed);
+  PrintRight(f, "Usage", kFieldSize_Usage + 1);
+  PrintRight(f, "Mem", kFieldSize_CorpusMem);
+  f.NewLine();
+
+  PrintLeft(f, "", kFieldSize_CorpusMethod + 4 + 1 + kFieldSize_CorpusLayout + kFieldSize_CorpusSize + kFieldSize_CorpusRatio);
+  for (unsigned i = 0; i < 2; i++)
+  {
+    f.Print(kSep);
+    PrintRight(f, "KiB/s", kFieldSize_Speed);
+    PrintRight(f, "%", kFieldSize_Usage + 1);
+    PrintRight(f, "MiB", kFieldSize_CorpusMem);
+  }
+  f.NewLine();
+  f.NewLine();
+}
+
+static void PrintCorpusMem(IBenchPrintCallback &f, UInt64 memUsage)
+{
+  if (memUsage == kMemUsage_Unknown)
+    PrintRight(f, "-", kFieldSize_CorpusMem);
+  else
+    PrintNumber(f, (memUsage + (1 << 19)) >> 20, kFieldSize_CorpusMem - 1);
+}
+
+static void PrintCorpusCoderResult(IBenchPrintCallback &f, const CBenchInfo &info, UInt64 memUsage)
+{
+  f.Print(kSep);
+  PrintNumber(f, info.GetUnpackSizeSpeed() >> 10, kFieldSize_Speed - 1);
+  PrintUsage(f, info.GetUsage(), kFieldSize_Usage);
+  PrintCorpusMem(f, memUsage);
+}
+
+static HRESULT AddCorpusResult(IBenchResultCallback *callback,
+    const AString &name, UInt32 numThreads, UInt32 pass, const char *layout, bool decode,
+    const CBenchInfo &info, UInt64 memUsage)
+{
+  if (!callback)
+    return S_OK;
+  CBenchResult r;
+  r.Method = name;
+  r.DictSize = 0;
+  r.NumThreads = numThreads;
+  r.Pass = pass;
+  r.Decode = decode;
+  r.Speed = info.GetUnpackSizeSpeed();
+  r.Usage = info.GetUsage();
+  r.RPU = 0;
+  r.Rating = 0;
+  r.Layout = layout;
+  r.UnpackSize = info.UnpackSize;
+  r.PackSize = info.PackSize;
+  r.MemUsage = (memUsage == kMemUsage_Unknown ? 0 : memUsage);
+  return callback->AddBenchResult(r);
+}
+
+
+HRESULT CorpusBench(
+    DECL_EXTERNAL_CODECS_LOC_VARS
+    IBenchPrintCallback *printCallback,
+    const FStringVector &filePaths,
+    const CObjectVector<CProperty> &props,
+    UInt32 numIterations,
+    IBenchResultCallback *resultCallback)
+{
+  UInt32 numCPUs = 1;
+  #ifndef Z7_ST
+  {
+    NSystem::CProcessAffinity threadsInfo;
+    threadsInfo.InitST();
+    if (threadsInfo.Get() && threadsInfo.GetNumProcessThreads() != 0)
+      numCPUs = threadsInfo.GetNumProcessThreads();
+    else
+      numCPUs = NSystem::GetNumberOfProcessors();
+  }
+  #endif
+
+  UStringVector methodNames;
+  CRecordVector<UInt32> levels;
+  CRecordVector<UInt32> threads;
+  CObjectVector<CProperty> methodProps;
+
+  FOR_VECTOR (i, props)
+  {
+    const CProperty &property = props[i];
+    UString name (property.Name);
+    name.MakeLower_Ascii();
+    if (name.IsEqualTo("m"))
+    {
+      if (property.Value.IsEmpty())
+        return E_INVALIDARG;
+      SplitCorpusList(property.Value, methodNames);
+      continue;
+    }
+    if (name.IsPrefixedBy_Ascii_NoCase("mt"))
+    {
+      UString s (name.Ptr(2));
+      s += property.Value;
+      RINOK(ParseCorpusNumbers(s, (UInt32)1 << 16, threads))
+      continue;
+    }
+    if (name.IsPrefixedBy_Ascii_NoCase("x"))
+    {
+      UString s (name.Ptr(1));
+      s += property.Value;
+      RINOK(ParseCorpusNumbers(s, 9, levels))
+      continue;
+    }
+    methodProps.Add(property);
+  }
+
+  if (methodNames.IsEmpty())
+    methodNames.Add(UString("LZMA2"));
+  if (levels.IsEmpty())
+    levels.Add(5);
+  if (threads.IsEmpty())
+    threads.Add(numCPUs);
+  #ifdef Z7_ST
+  threads.Clear();
+  threads.Add(1);
+  #endif
+
+  CCorpusBench bench;
+  bench.PrintCallback = printCallback;
+  RINOK(bench.Load(filePaths))
+
+  if (printCallback)
+  {
+    IBenchPrintCallback &f = *printCallback;
+    AString s;
+    s += "Compiler: ";
+    GetCompiler(s);
+    f.Print(s);
+    f.NewLine();
+    s.Empty();
+    GetSystemInfoText(s);
+    f.Print(s);
+    f.NewLine();
+    f.NewLine();
+    s = "Files: ";
+    s.Add_UInt32(bench.GetNumFiles());
+    s += "  Size: ";
+    s.Add_UInt64(bench.TotalSize);
+    s += "  Max file size: ";
+    s.Add_UInt64(bench.MaxFileSize);
+    f.Print(s);
+    f.NewLine();
+    f.NewLine();
+    PrintCorpusHeader(f);
+  }
+
+  FOR_VECTOR (m, methodNames)
+  {
+    COneMethodInfo baseMethod;
+    RINOK(baseMethod.ParseMethodFromString(methodNames[m]))
+    FOR_VECTOR (k, methodProps)
+    {
+      const CProperty &property = methodProps[k];
+      UString name (property.Name);
+      name.MakeLower_Ascii();
+      NCOM::CPropVariant propVariant;
+      if (!property.Value.IsEmpty())
+        ParseNumberString(property.Value, propVariant);
+      RINOK(baseMethod.ParseMethodFromPROPVARIANT(name, propVariant))
+    }
+
+    CMethodId methodId;
+    UInt32 numStreams;
+    bool isFilter;
+    const int codecIndex = FindMethod_Index(EXTERNAL_CODECS_LOC_VARS
+        baseMethod.MethodName, true, methodId, numStreams, isFilter);
+    if (codecIndex < 0)
+      return E_NOTIMPL;
+    if (numStreams != 1)
+      return E_INVALIDARG;
+
+    FOR_VECTOR (li, levels)
+    FOR_VECTOR (ti, threads)
+    {
+      const UInt32 level = levels[li];
+      const UInt32 numThreads = threads[ti];
+      COneMethodInfo method = baseMethod;
+      if (method.FindProp(NCoderPropID::kLevel) < 0)
+        method.AddProp_Level(level);
+      if (method.FindProp(NCoderPropID::kNumThreads) < 0)
+        method.AddProp_NumThreads(numThreads);
+
+      AString name (method.MethodName);
+      if (!method.PropsString.IsEmpty())
+      {
+        name.Add_Colon();
+        name += GetAnsiString(method.PropsString);
+      }
+      name += ":x";
+      name.Add_UInt32(level);
+
+      for (unsigned solid = 0; solid < 2; solid++)
+      {
+        const char *layout = (solid ? "solid" : "files");
+        for (UInt32 pass = 0; pass < numIterations; pass++)
+        {
+          CBenchInfo encInfo, decInfo;
+          UInt64 encMem = 0, decMem = 0;
+          RINOK(bench.Encode(EXTERNAL_CODECS_LOC_VARS
+              (unsigned)codecIndex, method, solid != 0, encInfo, encMem))
+          RINOK(bench.Decode(EXTERNAL_CODECS_LOC_VARS
+              methodId, numThreads, decInfo, decMem))
+
+          RINOK(AddCorpusResult(resultCallback, name, numThreads, pass, layout, false, encInfo, encMem))
+          RINOK(AddCorpusResult(resultCallback, name, numThreads, pass, layout, true, decInfo, decMem))
+
+          if (!printCallback)
+            continue;
+          IBenchPrintCallback &f = *printCallback;
+          PrintLeft(f, name, kFieldSize_CorpusMethod);
+          PrintNumber(f, numThreads, 3);
+          f.Print(" ");
+          PrintLeft(f, layout, kFieldSize_CorpusLayout);
+          PrintNumber(f, bench.GetPackSize(), kFieldSize_CorpusSize - 1);
+          {
+            AString s;
+            if (bench.TotalSize != 0)
+            {
+              AddCorpusFixed2(s, (bench.GetPackSize() * 10000 + bench.TotalSize / 2) / bench.TotalSize);
+              s.Add_Char('%');
+            }
+            PrintRight(f, s, kFieldSize_CorpusRatio);
+          }
+          PrintCorpusCoderResult(f, encInfo, encMem);
+          PrintCorpusCoderResult(f, decInfo, decMem);
+          f.NewLine();
+        }
+      }
+    }
+  }
+  return S_OK;
+}
@@ -97,6 +97,38 @@ DECLARE_INTERFACE(IBenchFreqCallback)
 };
 Z7_PURE_INTERFACES_END
 
+
+/* CBenchResult is one result line (one column of line) of benchmark table.
+   It's sent to IBenchResultCallback for structured output (JSON / CSV). */
+
+struct CBenchResult
+{
+  AString Method;     // method name with properties
+  UInt64 DictSize;    // dictionary size or buffer size from first column of table, (0) if not applicable
+  UInt32 NumThreads;
+  UInt32 Pass;        // index of iteration
+  bool Decode;
+  UInt64 Speed;       // bytes per second
+  UInt64 Usage;       // in (kBenchmarkUsageMult) units : use Benchmark_GetUsage_Percents()
+  UInt64 RPU;         // instructions per second per usage
+  UInt64 Rating;      // instructions per second, (0) if not applicable
+
+  // for benchmark with real data (CorpusBench):
+  AString Layout;     // "solid" or "files", it's empty for another modes
+  UInt64 UnpackSize;
+  UInt64 PackSize;
+  UInt64 MemUsage;    // peak memory of coder in bytes, (0) if unknown
+
+  CBenchResult(): UnpackSize(0), PackSize(0), MemUsage(0) {}
+};
+
+Z7_PURE_INTERFACES_BEGIN
+DECLARE_INTERFACE(IBenchResultCallback)
+{
+  virtual HRESULT AddBenchResult(const CBenchResult &result) = 0;
+};
+Z7_PURE_INTERFACES_END
+
 HRESULT Bench(
     DECL_EXTERNAL_CODECS_LOC_VARS
     IBenchPrintCallback *printCallback,
@@ -104,7 +136,29 @@ HRESULT Bench(
     const CObjectVector<CProperty> &props,
     UInt32 numIterations,
     bool multiDict,
-    IBenchFreqCallback *freqCallback = NULL);
+    IBenchFreqCallback *freqCallback = NULL,
+    IBenchResultCallback *resultCallback = NULL);
+
+/*
+CorpusBench() is benchmark with real data: the files from (filePaths) are loaded to memory,
+and they are compressed and decompressed for each combination of method, level and number of threads.
+Each combination is tested in two layouts:
+  "solid" : all files are compressed as one stream,
+  "files" : each file is compressed as separate stream (non-solid).
+props:
+  m={method1,method2,...}  : methods with properties, for example: -mm=LZMA2,Deflate
+  x={level1,level2,...}    : compression levels (5 by default)
+  mt={num1,num2,...}       : numbers of threads
+  another properties are sent to each method.
+*/
+
+HRESULT CorpusBench(
+    DECL_EXTERNAL_CODECS_LOC_VARS
+    IBenchPrintCallback *printCallback,
+    const FStringVector &filePaths,
+    const CObjectVector<CProperty> &props,
+    UInt32 numIterations,
+    IBenchResultCallback *resultCallback);
 
 AString GetProcessThreadsInfo(const NWindows::NSystem::CProcessAffinity &ti);
 
@@ -0,0 +1,48 @@
+// CoderStat.h
+
+#ifndef ZIP7_INC_CODER_STAT_H
+#define ZIP7_INC_CODER_STAT_H
+
+#include "../../../Common/MyVector.h"
+
+#include "../../Archive/IArchive.h"
+
+/* CCoderStatSet collects the statistics that are reported by archive handler
+   via IArchiveCoderStatCallback. The values are summed for each method. */
+
+struct CCoderStatItem
+{
+  UInt64 MethodId;
+  UInt64 NumCalls;
+  UInt64 Values[NCoderStat::kNumValues];
+};
+
+struct CCoderStatSet
+{
+  CRecordVector<CCoderStatItem> Items;
+
+  void Add(UInt64 methodId, const UInt64 *values, UInt32 numValues)
+  {
+    unsigned i;
+    for (i = 0; i < Items.Size(); i++)
+      if (Items[i].MethodId == methodId)
+        break;
+    if (i == Items.Size())
+    {
+      CCoderStatItem item;
+      item.MethodId = methodId;
+      item.NumCalls = 0;
+      for (unsigned k = 0; k < NCoderStat::kNumValues; k++)
+        item.Values[k] = 0;
+      Items.Add(item);
+    }
+    CCoderStatItem &item = Items[i];
+    item.NumCalls++;
+    if (numValues > NCoderStat::kNumValues)
+      numValues = NCoderStat::kNumValues;
+    for (unsigned k = 0; k < numValues; k++)
+      item.Values[k] += values[k];
+  }
+};
+
+#endif
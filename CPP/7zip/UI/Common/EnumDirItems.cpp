@@ -1597,6 +1597,8 @@ static void ConvertToLongNames(const UString &prefix, NWildcard::CCensorNode &no
         j++;
     }
   }
+  // names of items and subnodes were changed in place
+  node.InvalidateIndex();
   for (i = 0; i < node.SubNodes.Size(); i++)
   {
     NWildcard::CCensorNode &nextNode = node.SubNodes[i];
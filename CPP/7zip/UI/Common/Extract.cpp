@@ -217,6 +217,10 @@ static HRESULT DecompressArchive(
   HRESULT result;
   const Int32 testMode = (options.TestMode && !calcCrc) ? 1: 0;
 
+  #ifndef Z7_SFX
+  CPhaseTimer phaseTimer(options.PhaseTimes, NPhase::kDecode);
+  #endif
+
   CArchiveExtractCallback_Closer ecsCloser(ecs);
 
   if (options.StdInMode)
@@ -333,6 +337,8 @@ HRESULT Extract(
       );
   #ifndef Z7_SFX
   ecs->SetHashMethods(hash);
+  ecs->CoderStats = options.CoderStats;
+  ecs->PhaseTimes = options.PhaseTimes;
   #endif
 
   if (multi)
@@ -411,6 +417,7 @@ HRESULT Extract(
     COpenOptions op;
     #ifndef Z7_SFX
     op.props = &options.Properties;
+    op.PhaseTimes = options.PhaseTimes;
     #endif
     op.codecs = codecs;
     op.types = &types2;
@@ -419,7 +426,13 @@ HRESULT Extract(
     op.stream = NULL;
     op.filePath = arcPath;
 
-    HRESULT result = arcLink.Open_Strict(op, openCallback);
+    HRESULT result;
+    {
+      #ifndef Z7_SFX
+      CPhaseTimer phaseTimer(options.PhaseTimes, NPhase::kOpen);
+      #endif
+      result = arcLink.Open_Strict(op, openCallback);
+    }
 
     if (result == E_ABORT)
       return result;
@@ -55,6 +55,8 @@ struct CExtractOptions: public CExtractOptionsBase
   // UString Password;
   #ifndef Z7_SFX
   CObjectVector<CProperty> Properties;
+  CCoderStatSet *CoderStats; // if it's not NULL, it collects the statistics of coders
+  CPhaseTimes *PhaseTimes;   // if it's not NULL, it collects the time of operation phases
   #endif
 
   /*
@@ -68,6 +70,10 @@ struct CExtractOptions: public CExtractOptionsBase
       StdOutMode(false),
       YesToAll(false),
       TestMode(false)
+      #ifndef Z7_SFX
+      , CoderStats(NULL)
+      , PhaseTimes(NULL)
+      #endif
       {}
 };
 
@@ -874,11 +874,55 @@ HRESULT CCodecs::Load()
 
   // we sort Formats to get fixed order of Formats after compilation.
   Formats.Sort();
+  #ifndef Z7_SFX
+  SigIndex.Build(Formats);
+  #endif
   return S_OK;
 }
 
 #ifndef Z7_SFX
 
+void CArcSigIndex::Build(const CObjectVector<CArcInfoEx> &formats)
+{
+  const unsigned kNumVals = (unsigned)1 << (kNumBytes * 8);
+  _bitmap.ClearAndSetSize(kNumVals / 32);
+  _heads.ClearAndSetSize(kNumVals);
+  memset(_bitmap.NonConstData(), 0, kNumVals / 8);
+  memset(_heads.NonConstData(), 0, kNumVals * sizeof(UInt32));
+  _next.Clear();
+  Refs.Clear();
+  ShortRefs.Clear();
+
+  // the lists are filled in reverse order to get refs in order of (formatIndex, sigIndex)
+  for (unsigned i = formats.Size(); i != 0;)
+  {
+    i--;
+    const CObjectVector<CByteBuffer> &sigs = formats[i].Signatures;
+    for (unsigned k = sigs.Size(); k != 0;)
+    {
+      k--;
+      const CByteBuffer &sig = sigs[k];
+      CArcSigRef ref;
+      ref.FormatIndex = i;
+      ref.SigIndex = k;
+      if (sig.Size() < kNumBytes)
+      {
+        ShortRefs.Insert(0, ref);
+        continue;
+      }
+      const UInt32 v = GetKey(sig);
+      _next.Add(_heads[v]);
+      Refs.Add(ref);
+      _heads[v] = Refs.Size();
+      _bitmap[v >> 5] |= (UInt32)1 << (v & 31);
+    }
+  }
+}
+
+#endif
+
+#ifndef Z7_SFX
+
 int CCodecs::FindFormatForArchiveName(const UString &arcPath) const
 {
   int dotPos = arcPath.ReverseFind_Dot();
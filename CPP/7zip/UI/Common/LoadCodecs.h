@@ -46,6 +46,8 @@ Z7_EXTERNAL_CODECS
         b) call SetCodecs(compressCodecsInfo) function from DLL file
 */
 
+#include "../../../../C/CpuArch.h"
+
 #include "../../../Common/MyBuffer.h"
 #include "../../../Common/MyCom.h"
 #include "../../../Common/MyString.h"
@@ -232,6 +234,59 @@ struct CArcInfoEx
 };
 
 
+#ifndef Z7_SFX
+
+/*
+CArcSigIndex is index of the signatures of all formats.
+It's built once in CCodecs::Load().
+The parser looks for candidate positions by first two bytes of signatures
+via bitmap, and then it checks only the signatures from the list for these bytes.
+The signatures shorter than (kNumBytes) are not included to index.
+They are stored in (ShortRefs) list.
+*/
+
+struct CArcSigRef
+{
+  unsigned FormatIndex;
+  unsigned SigIndex;
+};
+
+class CArcSigIndex
+{
+  CRecordVector<UInt32> _bitmap; // (1 << 16) bits
+  CRecordVector<UInt32> _heads;  // (refIndex + 1) of first ref for 2 bytes value, or 0
+  CRecordVector<UInt32> _next;   // (refIndex + 1) of next ref with same 2 bytes, or 0
+
+  static UInt32 GetKey(const Byte *p) { return GetUi16(p); }
+public:
+  static const unsigned kNumBytes = 2;
+
+  CRecordVector<CArcSigRef> Refs;
+  CRecordVector<CArcSigRef> ShortRefs;
+
+  void Build(const CObjectVector<CArcInfoEx> &formats);
+
+  bool IsCandidatePos(const Byte *p) const
+  {
+    const UInt32 v = GetKey(p);
+    return ((_bitmap[v >> 5] >> (v & 31)) & 1) != 0;
+  }
+
+  // returns (lim), if there is no candidate position in [p, lim)
+  const Byte *FindCandidatePos(const Byte *p, const Byte *lim) const
+  {
+    for (; p < lim && !IsCandidatePos(p); p++);
+    return p;
+  }
+
+  // refs are returned as (refIndex + 1). 0 means end of list
+  UInt32 GetFirstRef(const Byte *p) const { return _heads[GetKey(p)]; }
+  UInt32 GetNextRef(UInt32 ref) const { return _next[ref - 1]; }
+};
+
+#endif
+
+
 #ifdef Z7_EXTERNAL_CODECS
 
 struct CCodecLib
@@ -355,6 +410,10 @@ public:
   */
 
   CObjectVector<CArcInfoEx> Formats;
+
+  #ifndef Z7_SFX
+  CArcSigIndex SigIndex;
+  #endif
   
   #ifdef Z7_EXTERNAL_CODECS
   CRecordVector<CDllCodecInfo> Codecs;
@@ -1041,9 +1041,48 @@ static inline bool TestSignature(const Byte *p1, const Byte *p2, size_t size)
 }
 
 
+/*
+FindStartSignatures() sets (matched[formatIndex] = true) for formats
+with (SignatureOffset == 0) that have some signature at the start of (data).
+It uses signature index, so it checks only the signatures
+that have same first bytes as (data), instead of all signatures of all formats.
+*/
+
+static void FindStartSignatures(const CCodecs *codecs,
+    const Byte *data, size_t dataSize, CBoolArr &matched)
+{
+  const CArcSigIndex &sigIndex = codecs->SigIndex;
+  FOR_VECTOR (i, codecs->Formats)
+    matched[i] = false;
+  FOR_VECTOR (i, sigIndex.ShortRefs)
+  {
+    const CArcSigRef &sr = sigIndex.ShortRefs[i];
+    const CArcInfoEx &ai = codecs->Formats[sr.FormatIndex];
+    const CByteBuffer &sig = ai.Signatures[sr.SigIndex];
+    if (ai.SignatureOffset == 0
+        && sig.Size() <= dataSize
+        && TestSignature(data, sig, sig.Size()))
+      matched[sr.FormatIndex] = true;
+  }
+  if (dataSize < CArcSigIndex::kNumBytes)
+    return;
+  for (UInt32 ref = sigIndex.GetFirstRef(data); ref != 0; ref = sigIndex.GetNextRef(ref))
+  {
+    const CArcSigRef &sr = sigIndex.Refs[ref - 1];
+    const CArcInfoEx &ai = codecs->Formats[sr.FormatIndex];
+    const CByteBuffer &sig = ai.Signatures[sr.SigIndex];
+    if (ai.SignatureOffset == 0
+        && sig.Size() <= dataSize
+        && TestSignature(data, sig, sig.Size()))
+      matched[sr.FormatIndex] = true;
+  }
+}
+
+
+// (sigMatched == NULL) means empty data
 static void MakeCheckOrder(CCodecs *codecs,
     CIntVector &orderIndices, unsigned numTypes, CIntVector &orderIndices2,
-    const Byte *data, size_t dataSize)
+    const CBoolArr *sigMatched)
 {
   for (unsigned i = 0; i < numTypes; i++)
   {
@@ -1055,36 +1094,18 @@ static void MakeCheckOrder(CCodecs *codecs,
     {
       if (ai.Signatures.IsEmpty())
       {
-        if (dataSize != 0) // 21.04: no Signature means Empty Signature
-          continue;
-      }
-      else
-      {
-        unsigned k;
-        const CObjectVector<CByteBuffer> &sigs = ai.Signatures;
-        for (k = 0; k < sigs.Size(); k++)
-        {
-          const CByteBuffer &sig = sigs[k];
-          if (sig.Size() <= dataSize && TestSignature(data, sig, sig.Size()))
-            break;
-        }
-        if (k == sigs.Size())
+        if (sigMatched) // 21.04: no Signature means Empty Signature
           continue;
       }
+      else if (!sigMatched || !(*sigMatched)[(unsigned)index])
+        continue;
     }
     orderIndices2.Add(index);
     orderIndices[i] = -1;
   }
 }
 
-#ifdef UNDER_CE
-  static const unsigned kNumHashBytes = 1;
-  #define HASH_VAL(buf) ((buf)[0])
-#else
-  static const unsigned kNumHashBytes = 2;
-  // #define HASH_VAL(buf) ((buf)[0] | ((UInt32)(buf)[1] << 8))
-  #define HASH_VAL(buf) GetUi16(buf)
-#endif
+static const unsigned kNumHashBytes = CArcSigIndex::kNumBytes;
 
 static bool IsExeExt(const UString &ext)
 {
@@ -1520,6 +1541,18 @@ HRESULT CArc::CheckZerosTail(const COpenOptions &op, UInt64 offset)
 }
 
 
+static UInt64 GetOpenStartTime(const COpenOptions &op)
+{
+  return op.PhaseTimes ? NWindows::NTime::GetMonotonicTime() : 0;
+}
+
+// it adds the time of successful open call (parsing of headers) to phase times
+static void AddOpenHeadersTime(const COpenOptions &op, UInt64 startTime, HRESULT result)
+{
+  if (op.PhaseTimes && result == S_OK)
+    op.PhaseTimes->Add(NPhase::kOpenHeaders, NWindows::NTime::GetMonotonicTime() - startTime);
+}
+
 
 #ifndef Z7_SFX
 
@@ -1855,10 +1888,12 @@ HRESULT CArc::OpenStream2(const COpenOptions &op)
             }
           }
 
-          MakeCheckOrder(op.codecs, orderIndices, numFinded, orderIndices2, NULL, 0);
-          MakeCheckOrder(op.codecs, orderIndices, numFinded, orderIndices2, byteBuffer, processedSize);
-          // MakeCheckOrder(op.codecs, orderIndices, orderIndices.Size(), orderIndices2, NULL, 0);
-          // MakeCheckOrder(op.codecs, orderIndices, orderIndices.Size(), orderIndices2, byteBuffer, processedSize);
+          CBoolArr sigMatched(op.codecs->Formats.Size());
+          FindStartSignatures(op.codecs, byteBuffer, processedSize, sigMatched);
+          MakeCheckOrder(op.codecs, orderIndices, numFinded, orderIndices2, NULL);
+          MakeCheckOrder(op.codecs, orderIndices, numFinded, orderIndices2, &sigMatched);
+          // MakeCheckOrder(op.codecs, orderIndices, orderIndices.Size(), orderIndices2, NULL);
+          // MakeCheckOrder(op.codecs, orderIndices, orderIndices.Size(), orderIndices2, &sigMatched);
         }
       
         FOR_VECTOR (i, orderIndices)
@@ -1972,7 +2007,9 @@ HRESULT CArc::OpenStream2(const COpenOptions &op)
       if (op.stream)
       {
         UInt64 searchLimit = (!exactOnly && searchMarkerInHandler) ? maxStartOffset: 0;
+        const UInt64 startTime = GetOpenStartTime(op);
         result = archive->Open(op.stream, &searchLimit, op.callback);
+        AddOpenHeadersTime(op, startTime, result);
       }
       else
       {
@@ -1980,7 +2017,9 @@ HRESULT CArc::OpenStream2(const COpenOptions &op)
         archive.QueryInterface(IID_IArchiveOpenSeq, (void **)&openSeq);
         if (!openSeq)
           return E_NOTIMPL;
+        const UInt64 startTime = GetOpenStartTime(op);
         result = openSeq->OpenSeq(op.seqStream);
+        AddOpenHeadersTime(op, startTime, result);
       }
       
       RINOK(ReadBasicProps(archive, 0, result))
@@ -2150,6 +2189,9 @@ HRESULT CArc::OpenStream2(const COpenOptions &op)
     }
     CUIntVector sortedFormats;
 
+    CBoolArr sigMatched(op.codecs->Formats.Size());
+    FindStartSignatures(op.codecs, byteBuffer, processedSize, sigMatched);
+
     unsigned i;
 
     int splitIndex = -1;
@@ -2193,22 +2235,35 @@ HRESULT CArc::OpenStream2(const COpenOptions &op)
     
       if (isNewStyleSignature && !ai.Signatures.IsEmpty())
       {
-        unsigned k;
-        for (k = 0; k < ai.Signatures.Size(); k++)
+        if (ai.SignatureOffset == 0)
         {
-          const CByteBuffer &sig = ai.Signatures[k];
-          if (processedSize < ai.SignatureOffset + sig.Size())
+          // (processedSize < sig.Size()) is possible only for (endOfFile) here
+          // so (sigMatched) from signature index is enough
+          if (sigMatched[form])
           {
-            if (!endOfFile)
-              needCheck = true;
+            sortedFormats.Insert(0, form);
+            continue;
           }
-          else if (TestSignature(sig, byteBuffer + ai.SignatureOffset, sig.Size()))
-            break;
         }
-        if (k != ai.Signatures.Size())
+        else
         {
-          sortedFormats.Insert(0, form);
-          continue;
+          unsigned k;
+          for (k = 0; k < ai.Signatures.Size(); k++)
+          {
+            const CByteBuffer &sig = ai.Signatures[k];
+            if (processedSize < ai.SignatureOffset + sig.Size())
+            {
+              if (!endOfFile)
+                needCheck = true;
+            }
+            else if (TestSignature(sig, byteBuffer + ai.SignatureOffset, sig.Size()))
+              break;
+          }
+          if (k != ai.Signatures.Size())
+          {
+            sortedFormats.Insert(0, form);
+            continue;
+          }
         }
       }
       if (needCheck)
@@ -2243,9 +2298,11 @@ HRESULT CArc::OpenStream2(const COpenOptions &op)
         else
         */
         // if (!CanReturnArc), it's ParserMode, and we need phy size
+        const UInt64 startTime = GetOpenStartTime(op);
         result = OpenArchiveSpec(archive,
             !mode.CanReturnArc, // needPhySize
             op.stream, &searchLimit, op.callback, extractCallback_To_OpenCallback);
+        AddOpenHeadersTime(op, startTime, result);
       }
       
       if (result == S_FALSE)
@@ -2355,18 +2412,16 @@ HRESULT CArc::OpenStream2(const COpenOptions &op)
   
   // ---------- PARSER ----------
 
-  CUIntVector arc2sig; // formatIndex to signatureIndex
-  CUIntVector sig2arc; // signatureIndex to formatIndex;
+  /* we use signature index (op.codecs->SigIndex) that was built at codecs loading.
+     (formatRank[formatIndex] >= 0) for formats that are allowed for signature search here.
+     The signatures are checked in reverse order of (formatRank, sigIndex). */
+
+  const CArcSigIndex &sigIndex = op.codecs->SigIndex;
+  const unsigned numFormats = op.codecs->Formats.Size();
+  CIntArr formatRank(numFormats);
   {
-    unsigned sum = 0;
-    FOR_VECTOR (i, op.codecs->Formats)
-    {
-      arc2sig.Add(sum);
-      const CObjectVector<CByteBuffer> &sigs = op.codecs->Formats[i].Signatures;
-      sum += sigs.Size();
-      FOR_VECTOR (k, sigs)
-        sig2arc.Add(i);
-    }
+    for (unsigned i = 0; i < numFormats; i++)
+      formatRank[i] = -1;
   }
   
   {
@@ -2374,19 +2429,10 @@ HRESULT CArc::OpenStream2(const COpenOptions &op)
     const size_t kAfterSize  = 1 << 20;
     const size_t kBufSize = 1 << 22; // it must be more than kBeforeSize + kAfterSize
 
-    const UInt32 kNumVals = (UInt32)1 << (kNumHashBytes * 8);
-    CByteArr hashBuffer(kNumVals);
-    Byte *hash = hashBuffer;
-    memset(hash, 0xFF, kNumVals);
-    Byte prevs[256];
-    memset(prevs, 0xFF, sizeof(prevs));
-    if (sig2arc.Size() >= 0xFF)
-      return S_FALSE;
-
     CUIntVector difficultFormats;
-    CBoolArr difficultBools(256);
+    CBoolArr difficultBools(numFormats);
     {
-      for (unsigned i = 0; i < 256; i++)
+      for (unsigned i = 0; i < numFormats; i++)
         difficultBools[i] = false;
     }
 
@@ -2424,11 +2470,8 @@ HRESULT CArc::OpenStream2(const COpenOptions &op)
             continue;
           }
           thereAreHandlersForSearch = true;
-          UInt32 v = HASH_VAL(sig);
-          unsigned sigIndex = arc2sig[(unsigned)index] + k;
-          prevs[sigIndex] = hash[v];
-          hash[v] = (Byte)sigIndex;
         }
+        formatRank[(unsigned)index] = (int)i;
       }
       if (isDifficult)
       {
@@ -2470,6 +2513,7 @@ HRESULT CArc::OpenStream2(const COpenOptions &op)
 
     UInt64 callbackPrev = 0;
     bool needCheckStartOpen = true; // = true, if we need to test all archives types for current pos.
+    CUIntVector sigCands; // indexes in (sigIndex.Refs) for current pos
 
     bool endOfFile = false;
     UInt64 bufPhyPos = 0;
@@ -2604,18 +2648,53 @@ HRESULT CArc::OpenStream2(const COpenOptions &op)
       
       if (!needCheckStartOpen)
       {
-        for (; buf < bufLimit && hash[HASH_VAL(buf)] == 0xFF; buf++);
+        for (;;)
+        {
+          buf = sigIndex.FindCandidatePos(buf, bufLimit);
+          if (buf == bufLimit)
+            break;
+          // the index contains the signatures of all formats
+          UInt32 ref;
+          for (ref = sigIndex.GetFirstRef(buf); ref != 0; ref = sigIndex.GetNextRef(ref))
+            if (formatRank[sigIndex.Refs[ref - 1].FormatIndex] >= 0)
+              break;
+          if (ref != 0)
+            break;
+          buf++;
+        }
         ppp = (size_t)(buf - (byteBuffer.ConstData() + (size_t)posInBuf));
         pos += ppp;
         if (buf == bufLimit)
           continue;
       }
       
-      UInt32 v = HASH_VAL(buf);
       bool nextNeedCheckStartOpen = true;
-      unsigned i = hash[v];
       unsigned indexOfDifficult = 0;
 
+      sigCands.Clear();
+      {
+        for (UInt32 ref = sigIndex.GetFirstRef(buf); ref != 0; ref = sigIndex.GetNextRef(ref))
+        {
+          const CArcSigRef &sr = sigIndex.Refs[ref - 1];
+          const int rank = formatRank[sr.FormatIndex];
+          if (rank < 0)
+            continue;
+          // insertion sort in reverse order of (rank, SigIndex)
+          unsigned k = sigCands.Size();
+          sigCands.Add(ref - 1);
+          for (; k != 0; k--)
+          {
+            const CArcSigRef &sr2 = sigIndex.Refs[sigCands[k - 1]];
+            const int rank2 = formatRank[sr2.FormatIndex];
+            if (rank2 > rank || (rank2 == rank && sr2.SigIndex > sr.SigIndex))
+              break;
+            sigCands[k] = sigCands[k - 1];
+          }
+          sigCands[k] = ref - 1;
+        }
+      }
+      unsigned candIndex = 0;
+
       // ---------- Open Loop for Current Pos ----------
       bool wasOpen = false;
       
@@ -2630,11 +2709,10 @@ HRESULT CArc::OpenStream2(const COpenOptions &op)
         }
         else
         {
-          if (i == 0xFF)
+          if (candIndex == sigCands.Size())
             break;
-          index = sig2arc[i];
-          unsigned sigIndex = i - arc2sig[index];
-          i = prevs[i];
+          const CArcSigRef &sr = sigIndex.Refs[sigCands[candIndex++]];
+          index = sr.FormatIndex;
           if (needCheckStartOpen && difficultBools[index])
             continue;
           const CArcInfoEx &ai = op.codecs->Formats[index];
@@ -2648,7 +2726,7 @@ HRESULT CArc::OpenStream2(const COpenOptions &op)
               continue;
           */
   
-          const CByteBuffer &sig = ai.Signatures[sigIndex];
+          const CByteBuffer &sig = ai.Signatures[sr.SigIndex];
 
           if (ppp + sig.Size() > availSize
               || !TestSignature(buf, sig, sig.Size()))
@@ -3470,7 +3548,9 @@ HRESULT CArc::ReOpen(const COpenOptions &op, IArchiveOpenCallback *openCallback_
   IArchiveOpenCallback *openCallback = openCallback_Additional;
   if (!openCallback)
     openCallback = op.callback;
+  const UInt64 startTime = GetOpenStartTime(op);
   HRESULT res = Archive->Open(stream2, &maxStartPosition, openCallback);
+  AddOpenHeadersTime(op, startTime, res);
   
   if (res == S_OK)
   {
@@ -9,6 +9,7 @@
 #include "LoadCodecs.h"
 #include "Property.h"
 #include "DirItem.h"
+#include "PhaseTime.h"
 
 #ifndef Z7_SFX
 
@@ -130,6 +131,7 @@ struct COpenOptions
 
   bool stdInMode;
   UString filePath;
+  CPhaseTimes *PhaseTimes; // if it's not NULL, the time of successful IInArchive::Open() calls is added
 
   COpenOptions():
       codecs(NULL),
@@ -139,7 +141,8 @@ struct COpenOptions
       seqStream(NULL),
       callback(NULL),
       callbackSpec(NULL),
-      stdInMode(false)
+      stdInMode(false),
+      PhaseTimes(NULL)
     {}
 
 };
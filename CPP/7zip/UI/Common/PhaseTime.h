@@ -0,0 +1,76 @@
+// PhaseTime.h
+
+#ifndef ZIP7_INC_PHASE_TIME_H
+#define ZIP7_INC_PHASE_TIME_H
+
+#include "../../../Windows/TimeUtils.h"
+
+/* CPhaseTimes collects the time (monotonic clock, 100-ns units)
+   that was spent in each phase of archive operation (-bt switch).
+   Some phases are parts of another phases:
+     kOpen   : kOpenHeaders + detection of archive type
+     kDecode : kFileCreate + kFileClose + decoding
+     kEncode : kHeaderWrite + encoding */
+
+namespace NPhase
+{
+  enum EEnum
+  {
+    kLoadCodecs,   // loading of codecs and formats
+    kScan,         // enumeration of files in directories
+    kOpen,         // CArchiveLink::Open() calls
+    kOpenHeaders,  // successful IInArchive::Open() calls (parsing of headers)
+    kList,         // listing of items
+    kDecode,       // IInArchive::Extract() calls
+    kFileCreate,   // creation of output files in extract operation
+    kFileClose,    // closing of output files (and setting of attributes and times)
+    kEncode,       // IOutArchive::UpdateItems() calls
+    kHeaderWrite,  // writing of archive headers in UpdateItems()
+    kRename,       // moving of temp archive to the final location
+
+    kNumPhases
+  };
+}
+
+struct CPhaseTimes
+{
+  UInt64 Times[NPhase::kNumPhases];
+  UInt64 Counts[NPhase::kNumPhases];
+
+  CPhaseTimes()
+  {
+    for (unsigned i = 0; i < NPhase::kNumPhases; i++)
+    {
+      Times[i] = 0;
+      Counts[i] = 0;
+    }
+  }
+
+  void Add(unsigned phase, UInt64 time)
+  {
+    Times[phase] += time;
+    Counts[phase]++;
+  }
+};
+
+// CPhaseTimer adds the time of its life to (phaseTimes), if (phaseTimes) is not NULL.
+
+class CPhaseTimer
+{
+  CPhaseTimes *_phaseTimes;
+  unsigned _phase;
+  UInt64 _startTime;
+public:
+  CPhaseTimer(CPhaseTimes *phaseTimes, unsigned phase):
+      _phaseTimes(phaseTimes),
+      _phase(phase),
+      _startTime(phaseTimes ? NWindows::NTime::GetMonotonicTime() : 0)
+    {}
+  ~CPhaseTimer()
+  {
+    if (_phaseTimes)
+      _phaseTimes->Add(_phase, NWindows::NTime::GetMonotonicTime() - _startTime);
+  }
+};
+
+#endif
@@ -23,3 +23,8 @@ void SortFileNames(const UStringVector &strings, CUIntVector &indices)
     vals[i] = i;
   indices.Sort(CompareStrings, (void *)&strings);
 }
+
+void SortFileNames_Indices(const UStringVector &strings, CUIntVector &indices)
+{
+  indices.Sort(CompareStrings, (void *)&strings);
+}
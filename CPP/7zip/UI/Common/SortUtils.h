@@ -6,5 +6,7 @@
 #include "../../../Common/MyString.h"
 
 void SortFileNames(const UStringVector &strings, CUIntVector &indices);
+// it sorts only (indices) that were set by caller
+void SortFileNames_Indices(const UStringVector &strings, CUIntVector &indices);
 
 #endif
@@ -625,6 +625,8 @@ static HRESULT Compress(
   updateCallbackSpec->StopAfterOpenError = options.StopAfterOpenError;
   updateCallbackSpec->StdInMode = options.StdInMode;
   updateCallbackSpec->Callback = callback;
+  updateCallbackSpec->CoderStats = options.CoderStats;
+  updateCallbackSpec->PhaseTimes = options.PhaseTimes;
 
   if (arc)
   {
@@ -850,7 +852,16 @@ static HRESULT Compress(
     volStreamSpec->MTime_Defined = true;
   }
 
-  HRESULT result = outArchive->UpdateItems(tailStream, updatePairs2.Size(), updateCallback);
+  HRESULT result;
+  {
+    CPhaseTimer phaseTimer(options.PhaseTimes, NPhase::kEncode);
+    result = outArchive->UpdateItems(tailStream, updatePairs2.Size(), updateCallback);
+    updateCallbackSpec->Finish_HeaderWrite();
+  }
+ #ifdef Z7_IO_URING
+  if (!updateCallbackSpec->FlushIoBatch() && result == S_OK)
+    return errorInfo.SetFromLastError("cannot close input file", updateCallbackSpec->GetIoBatchErrorPath());
+ #endif
   // callback->Finalize();
   RINOK(result)
 
@@ -1280,10 +1291,15 @@ HRESULT UpdateArchive(
       op.stdInMode = false;
       op.stream = NULL;
       op.filePath = arcPath;
+      op.PhaseTimes = options.PhaseTimes;
 
       RINOK(callback->StartOpenArchive(arcPath))
 
-      HRESULT result = arcLink.Open_Strict(op, openCallback);
+      HRESULT result;
+      {
+        CPhaseTimer phaseTimer(options.PhaseTimes, NPhase::kOpen);
+        result = arcLink.Open_Strict(op, openCallback);
+      }
 
       if (result == E_ABORT)
         return result;
@@ -1394,10 +1410,14 @@ HRESULT UpdateArchive(
       dirItems.StoreOwnerName = options.StoreOwnerName.Val;
      #endif
 
-      const HRESULT res = EnumerateItems(censor,
+      HRESULT res;
+      {
+        CPhaseTimer phaseTimer(options.PhaseTimes, NPhase::kScan);
+        res = EnumerateItems(censor,
           options.PathMode,
           UString(), // options.AddPathPrefix,
           dirItems);
+      }
 
       if (res != S_OK)
       {
@@ -1624,6 +1644,7 @@ HRESULT UpdateArchive(
   {
     try
     {
+      CPhaseTimer phaseTimer(options.PhaseTimes, NPhase::kRename);
       CArchivePath &ap = options.Commands[0].ArchivePath;
       const FString &tempPath = ap.GetTempPath();
       
@@ -121,6 +121,9 @@ struct CUpdateOptions
   CObjectVector<CRenamePair> RenamePairs;
   CRecordVector<UInt64> VolumesSizes;
 
+  CCoderStatSet *CoderStats; // if it's not NULL, it collects the statistics of coders
+  CPhaseTimes *PhaseTimes;   // if it's not NULL, it collects the time of operation phases
+
   bool InitFormatIndex(const CCodecs *codecs, const CObjectVector<COpenType> &types, const UString &arcPath);
   bool SetArcPath(const CCodecs *codecs, const UString &arcPath);
 
@@ -143,8 +146,9 @@ struct CUpdateOptions
     RenameMode(false),
 
     ArcNameMode(k_ArcNameMode_Smart),
-    PathMode(NWildcard::k_RelatPath)
-    
+    PathMode(NWildcard::k_RelatPath),
+    CoderStats(NULL),
+    PhaseTimes(NULL)
     {}
 
   void SetActionCommand_Add()
@@ -92,7 +92,13 @@ CArchiveUpdateCallback::CArchiveUpdateCallback():
     CommentIndex(-1),
     
     ProcessedItemsStatuses(NULL),
+    CoderStats(NULL),
+    PhaseTimes(NULL),
+    HeaderWrite_StartTime(0),
     _hardIndex_From((UInt32)(Int32)-1)
+   #ifdef Z7_IO_URING
+    , _ioBatch_WasTried(false)
+   #endif
 {
   #ifdef Z7_USE_SECURITY_CODE
   _saclEnabled = InitLocalPrivileges();
@@ -815,6 +821,9 @@ Z7_COM7F_IMF(CArchiveUpdateCallback::ReportOperation(UInt32 indexType, UInt32 in
 
   // if (op == NUpdateNotifyOp::kOpFinished) return Callback->ReportFinished(indexType, index);
 
+  if (op == NUpdateNotifyOp::kHeader && PhaseTimes)
+    HeaderWrite_StartTime = NWindows::NTime::GetMonotonicTime();
+
   bool isDir = false;
 
   if (indexType == NArchive::NEventIndexType::kOutArcIndex)
@@ -925,6 +934,16 @@ Z7_COM7F_IMF(CArchiveUpdateCallback::ReportExtractResult(UInt32 indexType, UInt3
 }
 
 
+Z7_COM7F_IMF(CArchiveUpdateCallback::ReportCoderStat(UInt64 methodId, const UInt64 *values, UInt32 numValues))
+{
+  COM_TRY_BEGIN
+  if (CoderStats)
+    CoderStats->Add(methodId, values, numValues);
+  return S_OK;
+  COM_TRY_END
+}
+
+
 /*
 Z7_COM7F_IMF(CArchiveUpdateCallback::DoNeedArcProp(PROPID propID, Int32 *answer))
 {
@@ -1054,6 +1073,15 @@ void CArchiveUpdateCallback::InFileStream_On_Destroy(CInFileStream *stream, UINT
   {
     if (_openFiles_Indexes[i] == index)
     {
+#ifdef Z7_IO_URING
+      if (!_ioBatch_WasTried)
+      {
+        _ioBatch_WasTried = true;
+        _ioBatch.Create(64);
+      }
+      if (_ioBatch.IsCreated())
+        stream->Close_Deferred(_ioBatch, _openFiles_Paths[i]);
+#endif
       _openFiles_Indexes.Delete(i);
       _openFiles_Paths.Delete(i);
       // _openFiles_Streams.Delete(i);
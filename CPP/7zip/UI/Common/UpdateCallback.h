@@ -10,6 +10,8 @@
 #include "../../IPassword.h"
 #include "../../ICoder.h"
 
+#include "../Common/CoderStat.h"
+#include "../Common/PhaseTime.h"
 #include "../Common/UpdatePair.h"
 #include "../Common/UpdateProduce.h"
 
@@ -86,6 +88,7 @@ class CArchiveUpdateCallback Z7_final:
   public ICryptoGetTextPassword,
   public ICompressProgressInfo,
   public IInFileStream_Callback,
+  public IArchiveCoderStatCallback,
   public CMyUnknownImp
 {
   Z7_COM_QI_BEGIN2(IArchiveUpdateCallback2)
@@ -97,6 +100,9 @@ class CArchiveUpdateCallback Z7_final:
     Z7_COM_QI_ENTRY(ICryptoGetTextPassword2)
     Z7_COM_QI_ENTRY(ICryptoGetTextPassword)
     Z7_COM_QI_ENTRY(ICompressProgressInfo)
+    // the handler collects coder statistics only if it can get that interface
+    else if (iid == IID_IArchiveCoderStatCallback && CoderStats)
+      { IArchiveCoderStatCallback *ti = this;  *outObject = ti; }
   Z7_COM_QI_END
   Z7_COM_ADDREF_RELEASE
 
@@ -112,6 +118,7 @@ class CArchiveUpdateCallback Z7_final:
   Z7_IFACE_COM7_IMP(IArchiveGetRootProps)
   Z7_IFACE_COM7_IMP(ICryptoGetTextPassword2)
   Z7_IFACE_COM7_IMP(ICryptoGetTextPassword)
+  Z7_IFACE_COM7_IMP(IArchiveCoderStatCallback)
 
 
   void UpdateProcessedItemStatus(unsigned dirIndex);
@@ -172,9 +179,27 @@ public:
 
   Byte *ProcessedItemsStatuses;
 
+  CCoderStatSet *CoderStats; // if it's not NULL, the handler is asked to report coder statistics
+  CPhaseTimes *PhaseTimes;   // if it's not NULL, the time of writing of headers is added
+  UInt64 HeaderWrite_StartTime; // it's set, when the handler reports NUpdateNotifyOp::kHeader
+
 
   CArchiveUpdateCallback();
 
+  // it must be called after UpdateItems()
+  void Finish_HeaderWrite()
+  {
+    if (PhaseTimes && HeaderWrite_StartTime != 0)
+      PhaseTimes->Add(NPhase::kHeaderWrite, NWindows::NTime::GetMonotonicTime() - HeaderWrite_StartTime);
+    HeaderWrite_StartTime = 0;
+  }
+
+ #ifdef Z7_IO_URING
+  // it waits for the closing of input files. It must be called after UpdateItems()
+  bool FlushIoBatch() { return _ioBatch.Flush(); }
+  const AString &GetIoBatchErrorPath() const { return _ioBatch.GetErrorPath(); }
+ #endif
+
   bool IsDir(const CUpdatePair2 &up) const
   {
     if (up.DirIndex >= 0)
@@ -192,6 +217,12 @@ private:
 
   UInt32 _hardIndex_From;
   UInt32 _hardIndex_To;
+
+ #ifdef Z7_IO_URING
+  // input files are closed in batches
+  NWindows::NFile::NIO::CIoBatch _ioBatch;
+  bool _ioBatch_WasTried;
+ #endif
 };
 
 #endif
@@ -134,6 +134,25 @@ static int CompareArcItems(const unsigned *p1, const unsigned *p2, void *param)
   return MyCompare(i1, i2);
 }
 
+/*
+  GetUpdatePairInfoList() pairs disk items with archive items via hash tables,
+  so only the archive items (if they are not sorted already)
+  and the new disk items must be sorted.
+  The order of (updatePairs) is same as the order of sorted merge
+  of all disk items and all archive items.
+*/
+
+static const unsigned kEmptySlot = 0;
+
+static void BuildNamesHash(NWildcard::CNameHashIndex &index,
+    const CRecordVector<UInt32> &hashes)
+{
+  index.Init(hashes.Size());
+  FOR_VECTOR (i, hashes)
+    index.Insert(hashes[i], i);
+  index.NumObjects = hashes.Size();
+}
+
 void GetUpdatePairInfoList(
     const CDirItems &dirItems,
     const CObjectVector<CArcItem> &arcItems,
@@ -160,8 +179,14 @@ void GetUpdatePairInfoList(
       for (unsigned i = 0; i < numArcItems; i++)
         vals[i] = i;
     }
-    arcIndices.Sort(CompareArcItems, (void *)&arcItems);
-    for (unsigned i = 0; i + 1 < numArcItems; i++)
+    // archives that were created by 7-Zip usually are sorted already
+    unsigned i;
+    for (i = 0; i + 1 < numArcItems; i++)
+      if (CompareArcItemsBase(arcItems[i], arcItems[i + 1]) > 0)
+        break;
+    if (i + 1 < numArcItems)
+      arcIndices.Sort(CompareArcItems, (void *)&arcItems);
+    for (i = 0; i + 1 < numArcItems; i++)
       if (CompareArcItemsBase(
           arcItems[arcIndices[i]],
           arcItems[arcIndices[i + 1]]) == 0)
@@ -171,29 +196,87 @@ void GetUpdatePairInfoList(
       }
   }
 
+  CIntArr arcToDir(numArcItems);
+  {
+    int *vals = &arcToDir[0];
+    for (unsigned i = 0; i < numArcItems; i++)
+      vals[i] = -1;
+  }
+
   UStringVector dirNames;
   {
     dirNames.ClearAndReserve(numDirItems);
     unsigned i;
     for (i = 0; i < numDirItems; i++)
       dirNames.AddInReserved(dirItems.GetLogPath(i));
-    SortFileNames(dirNames, dirIndices);
-    for (i = 0; i + 1 < numDirItems; i++)
+
+    CRecordVector<UInt32> hashes;
+    NWildcard::CNameHashIndex arcIndex;
+    {
+      hashes.ClearAndReserve(numArcItems);
+      for (i = 0; i < numArcItems; i++)
+        hashes.AddInReserved(GetFileNameHash(arcItems[i].Name));
+      BuildNamesHash(arcIndex, hashes);
+    }
+    NWildcard::CNameHashIndex dirIndex;
+    {
+      hashes.ClearAndReserve(numDirItems);
+      for (i = 0; i < numDirItems; i++)
+        hashes.AddInReserved(GetFileNameHash(dirNames[i]));
+      dirIndex.Init(numDirItems);
+    }
+    
+    const unsigned arcMask = arcIndex.Slots.Size() - 1;
+    const unsigned dirMask = dirIndex.Slots.Size() - 1;
+    
+    for (i = 0; i < numDirItems; i++)
     {
-      const UString &s1 = dirNames[dirIndices[i]];
-      const UString &s2 = dirNames[dirIndices[i + 1]];
-      if (CompareFileNames(s1, s2) == 0)
-        ThrowError(k_Duplicate_inDir_Message, s1, s2);
+      const UString &name = dirNames[i];
+      const UInt32 hash = hashes[i];
+      unsigned k;
+      for (k = (unsigned)hash & dirMask;; k = (k + 1) & dirMask)
+      {
+        const unsigned v = dirIndex.Slots[k];
+        if (v == kEmptySlot)
+          break;
+        const UString &name2 = dirNames[v - 1];
+        if (CompareFileNames(name2, name) == 0)
+          ThrowError(k_Duplicate_inDir_Message, name2, name);
+      }
+      dirIndex.Insert(hash, i);
+
+      const bool isDir = dirItems.Items[i].IsDir();
+      for (k = (unsigned)hash & arcMask;; k = (k + 1) & arcMask)
+      {
+        const unsigned v = arcIndex.Slots[k];
+        if (v == kEmptySlot)
+        {
+          dirIndices.Add(i);
+          break;
+        }
+        const CArcItem &ai = arcItems[v - 1];
+        if (ai.IsDir == isDir
+            && arcToDir[v - 1] < 0
+            && CompareFileNames(name, ai.Name) == 0)
+        {
+          arcToDir[v - 1] = (int)i;
+          break;
+        }
+      }
     }
+
+    // we sort only the disk items that have no pair in archive
+    SortFileNames_Indices(dirNames, dirIndices);
   }
   
+  const unsigned numNewDirItems = dirIndices.Size();
   unsigned dirIndex = 0;
   unsigned arcIndex = 0;
 
   int prevHostFile = -1;
   const UString *prevHostName = NULL;
   
-  while (dirIndex < numDirItems || arcIndex < numArcItems)
+  while (dirIndex < numNewDirItems || arcIndex < numArcItems)
   {
     CUpdatePair pair;
     
@@ -205,7 +288,7 @@ void GetUpdatePairInfoList(
     int compareResult = -1;
     const UString *name = NULL;
     
-    if (dirIndex < numDirItems)
+    if (dirIndex < numNewDirItems)
     {
       dirIndex2 = (int)dirIndices[dirIndex];
       di = &dirItems.Items[(unsigned)dirIndex2];
@@ -216,14 +299,12 @@ void GetUpdatePairInfoList(
       arcIndex2 = (int)arcIndices[arcIndex];
       ai = &arcItems[(unsigned)arcIndex2];
       compareResult = 1;
-      if (dirIndex < numDirItems)
+      if (dirIndex < numNewDirItems)
       {
         compareResult = CompareFileNames(dirNames[(unsigned)dirIndex2], ai->Name);
+        // the items with same names and same (IsDir) were paired already
         if (compareResult == 0)
-        {
-          if (di->IsDir() != ai->IsDir)
-            compareResult = (ai->IsDir ? 1 : -1);
-        }
+          compareResult = (ai->IsDir ? 1 : -1);
       }
     }
     
@@ -232,15 +313,17 @@ void GetUpdatePairInfoList(
       name = &dirNames[(unsigned)dirIndex2];
       pair.State = NUpdateArchive::NPairState::kOnlyOnDisk;
       pair.DirIndex = dirIndex2;
+      ai = NULL;
       dirIndex++;
     }
-    else if (compareResult > 0)
+    else if (arcToDir[(unsigned)arcIndex2] < 0)
     {
       name = &ai->Name;
       pair.State = ai->Censored ?
           NUpdateArchive::NPairState::kOnlyInArchive:
           NUpdateArchive::NPairState::kNotMasked;
       pair.ArcIndex = arcIndex2;
+      di = NULL;
       arcIndex++;
     }
     else
@@ -249,6 +332,8 @@ void GetUpdatePairInfoList(
       if (dupl != 0)
         ThrowError(k_Duplicate_inArc_Message, ai->Name, arcItems[arcIndices[(unsigned)((int)arcIndex + dupl)]].Name);
 
+      dirIndex2 = arcToDir[(unsigned)arcIndex2];
+      di = &dirItems.Items[(unsigned)dirIndex2];
       name = &dirNames[(unsigned)dirIndex2];
       if (!ai->Censored)
         ThrowError(k_NotCensoredCollision_Message, *name, ai->Name);
@@ -271,7 +356,6 @@ void GetUpdatePairInfoList(
               NUpdateArchive::NPairState::kUnknowNewerFiles;
       }
       
-      dirIndex++;
       arcIndex++;
     }
     
@@ -2,11 +2,22 @@
 
 #include "StdAfx.h"
 
+#include <math.h>
+
+#include "../../../Common/IntToString.h"
+#include "../../../Common/MyBuffer.h"
+#include "../../../Common/StringConvert.h"
+
+#include "../../../Windows/FileIO.h"
+#include "../../../Windows/SystemInfo.h"
+
 #include "../Common/Bench.h"
 
 #include "BenchCon.h"
 #include "ConsoleClose.h"
 
+using namespace NWindows;
+
 struct CPrintBenchCallback Z7_final: public IBenchPrintCallback
 {
   FILE *_file;
@@ -18,12 +29,14 @@ struct CPrintBenchCallback Z7_final: public IBenchPrintCallback
 
 void CPrintBenchCallback::Print(const char *s)
 {
-  fputs(s, _file);
+  if (_file)
+    fputs(s, _file);
 }
 
 void CPrintBenchCallback::NewLine()
 {
-  fputc('\n', _file);
+  if (_file)
+    fputc('\n', _file);
 }
 
 HRESULT CPrintBenchCallback::CheckBreak()
@@ -31,11 +44,851 @@ HRESULT CPrintBenchCallback::CheckBreak()
   return NConsoleClose::TestBreakSignal() ? E_ABORT: S_OK;
 }
 
+
+/*
+Structured results (-bformat switch):
+  JSON : {"type":"bench","cpu":"...","results":[ {record}, ... ]}
+  CSV  : header line and one line per record.
+Each record is one column of benchmark table:
+  method, dict, threads, pass, op ("encode" / "decode"),
+  speed (bytes/s), usage (%), rpu (MIPS), rating (MIPS).
+The records of benchmark with real data (7z b files) also contain:
+  layout ("solid" / "files"), size, packed (bytes), mem (peak memory of coder in bytes).
+The JSON file can be used later as baseline for -bcompare.
+*/
+
+// names of methods and CPU are ASCII strings, so we just skip control characters
+static void AddJsonString(AString &s, const char *src)
+{
+  s += '\"';
+  for (;;)
+  {
+    const Byte c = (Byte)*src++;
+    if (c == 0)
+      break;
+    if (c == '\"' || c == '\\')
+      s += '\\';
+    else if (c < 0x20)
+      continue;
+    s += (char)c;
+  }
+  s += '\"';
+}
+
+static const char * const k_Csv_Header = "method,dict,threads,pass,op,speed,usage,rpu,rating,layout,size,packed,mem";
+
+static void AddCsvString(AString &s, const char *src)
+{
+  if (!strchr(src, ',') && !strchr(src, '\"') && !strchr(src, '\n'))
+  {
+    s += src;
+    return;
+  }
+  s += '\"';
+  for (;;)
+  {
+    const char c = *src++;
+    if (c == 0)
+      break;
+    if (c == '\"')
+      s += '\"';
+    s += c;
+  }
+  s += '\"';
+}
+
+// quoted fields can contain commas
+static unsigned GetNumCsvFields(const char *s)
+{
+  unsigned num = 1;
+  bool quoted = false;
+  for (;;)
+  {
+    const char c = *s++;
+    if (c == 0)
+      return num;
+    if (c == '\"')
+      quoted = !quoted;
+    else if (c == ',' && !quoted)
+      num++;
+  }
+}
+
+struct CBenchResultsWriter Z7_final: public IBenchResultCallback
+{
+  FILE *_file;
+  NBenchFormat::EEnum _format;
+  unsigned _numRecords;
+  AString _s;
+public:
+  CObjectVector<CBenchResult> Results;
+
+  CBenchResultsWriter(): _file(NULL), _format(NBenchFormat::kText), _numRecords(0) {}
+  void Init(FILE *file, NBenchFormat::EEnum format);
+  void Finish();
+  HRESULT AddBenchResult(const CBenchResult &r) Z7_override;
+};
+
+void CBenchResultsWriter::Init(FILE *file, NBenchFormat::EEnum format)
+{
+  _file = file;
+  _format = format;
+  _numRecords = 0;
+  if (!_file)
+    return;
+  AString &s = _s;
+  s.Empty();
+  if (_format == NBenchFormat::kJson)
+  {
+    AString cpu, registers;
+    GetCpuName_MultiLine(cpu, registers);
+    cpu.Replace('\n', ' ');
+    cpu.Trim();
+    s += "{\"type\":\"bench\",\"cpu\":";
+    AddJsonString(s, cpu);
+    s += ",\"results\":[";
+  }
+  else if (_format == NBenchFormat::kCsv)
+  {
+    s += k_Csv_Header;
+    s.Add_LF();
+  }
+  fputs(s, _file);
+  fflush(_file);
+}
+
+void CBenchResultsWriter::Finish()
+{
+  if (!_file)
+    return;
+  if (_format == NBenchFormat::kJson)
+    fputs("\n]}\n", _file);
+  fflush(_file);
+}
+
+HRESULT CBenchResultsWriter::AddBenchResult(const CBenchResult &r)
+{
+  Results.Add(r);
+  if (!_file)
+    return S_OK;
+
+  const UInt64 usage = Benchmark_GetUsage_Percents(r.Usage);
+  const char *op = (r.Decode ? "decode" : "encode");
+  AString &s = _s;
+  s.Empty();
+
+  if (_format == NBenchFormat::kJson)
+  {
+    if (_numRecords != 0)
+      s.Add_Char(',');
+    s += "\n{\"method\":";
+    AddJsonString(s, r.Method);
+    if (r.DictSize != 0)
+    {
+      s += ",\"dict\":";
+      s.Add_UInt64(r.DictSize);
+    }
+    s += ",\"threads\":";
+    s.Add_UInt32(r.NumThreads);
+    s += ",\"pass\":";
+    s.Add_UInt32(r.Pass);
+    s += ",\"op\":\"";
+    s += op;
+    s += "\",\"speed\":";
+    s.Add_UInt64(r.Speed);
+    s += ",\"usage\":";
+    s.Add_UInt64(usage);
+    if (r.Rating != 0)
+    {
+      s += ",\"rpu\":";
+      s.Add_UInt64(r.RPU / 1000000);
+      s += ",\"rating\":";
+      s.Add_UInt64(r.Rating / 1000000);
+    }
+    if (!r.Layout.IsEmpty())
+    {
+      s += ",\"layout\":";
+      AddJsonString(s, r.Layout);
+      s += ",\"size\":";
+      s.Add_UInt64(r.UnpackSize);
+      s += ",\"packed\":";
+      s.Add_UInt64(r.PackSize);
+      if (r.MemUsage != 0)
+      {
+        s += ",\"mem\":";
+        s.Add_UInt64(r.MemUsage);
+      }
+    }
+    s += '}';
+  }
+  else
+  {
+    AddCsvString(s, r.Method);
+    s.Add_Char(',');
+    s.Add_UInt64(r.DictSize);
+    s.Add_Char(',');
+    s.Add_UInt32(r.NumThreads);
+    s.Add_Char(',');
+    s.Add_UInt32(r.Pass);
+    s.Add_Char(',');
+    s += op;
+    s.Add_Char(',');
+    s.Add_UInt64(r.Speed);
+    s.Add_Char(',');
+    s.Add_UInt64(usage);
+    s.Add_Char(',');
+    s.Add_UInt64(r.RPU / 1000000);
+    s.Add_Char(',');
+    s.Add_UInt64(r.Rating / 1000000);
+    s.Add_Char(',');
+    if (!r.Layout.IsEmpty())
+    {
+      s += r.Layout;
+      s.Add_Char(',');
+      s.Add_UInt64(r.UnpackSize);
+      s.Add_Char(',');
+      s.Add_UInt64(r.PackSize);
+      s.Add_Char(',');
+      if (r.MemUsage != 0)
+        s.Add_UInt64(r.MemUsage);
+    }
+    else
+      s += ",,,";
+    // each record must contain all fields of header
+    if (GetNumCsvFields(s) != GetNumCsvFields(k_Csv_Header))
+      return E_FAIL;
+    s.Add_LF();
+  }
+
+  _numRecords++;
+  fputs(s, _file);
+  fflush(_file);
+  return S_OK;
+}
+
+
+/*
+CBaselineParser reads the results from JSON file that was written with -bformat=json.
+It accepts any JSON document, and it collects all objects that contain
+"method", "op" and "speed" fields.
+*/
+
+static const unsigned kJsonMaxDepth = 64;
+
+class CBaselineParser
+{
+  const char *_p;
+  const char *_end;
+
+  void SkipSpaces()
+  {
+    while (_p != _end && (*_p == ' ' || *_p == '\t' || *_p == '\r' || *_p == '\n'))
+      _p++;
+  }
+  bool ParseString(AString &s);
+  bool ParseNumber(double &v);
+  bool ParseValue(unsigned depth, CBenchResult *r, const AString *name);
+public:
+  CObjectVector<CBenchResult> Results;
+  bool Parse(const char *p, size_t size);
+};
+
+bool CBaselineParser::ParseString(AString &s)
+{
+  s.Empty();
+  if (_p == _end || *_p != '\"')
+    return false;
+  _p++;
+  for (;;)
+  {
+    if (_p == _end)
+      return false;
+    char c = *_p++;
+    if (c == '\"')
+      return true;
+    if (c == '\\')
+    {
+      if (_p == _end)
+        return false;
+      c = *_p++;
+      if (c == 'u')
+      {
+        // we don't need exact values of non-ASCII characters in names of methods
+        for (unsigned i = 0; i < 4; i++)
+        {
+          if (_p == _end)
+            return false;
+          _p++;
+        }
+        c = '?';
+      }
+      else if (c == 'n') c = '\n';
+      else if (c == 't') c = '\t';
+      else if (c == 'r') c = '\r';
+      else if (c == 'b') c = '\b';
+      else if (c == 'f') c = '\f';
+    }
+    s += c;
+  }
+}
+
+bool CBaselineParser::ParseNumber(double &v)
+{
+  const char *start = _p;
+  bool neg = false;
+  if (_p != _end && *_p == '-')
+  {
+    neg = true;
+    _p++;
+  }
+  v = 0;
+  while (_p != _end && *_p >= '0' && *_p <= '9')
+    v = v * 10 + (*_p++ - '0');
+  if (_p != _end && *_p == '.')
+  {
+    _p++;
+    double scale = 1;
+    while (_p != _end && *_p >= '0' && *_p <= '9')
+    {
+      scale /= 10;
+      v += (*_p++ - '0') * scale;
+    }
+  }
+  if (_p != _end && (*_p == 'e' || *_p == 'E'))
+  {
+    _p++;
+    bool expNeg = false;
+    if (_p != _end && (*_p == '+' || *_p == '-'))
+      expNeg = (*_p++ == '-');
+    int e = 0;
+    while (_p != _end && *_p >= '0' && *_p <= '9')
+    {
+      if (e < 1000)
+        e = e * 10 + (*_p - '0');
+      _p++;
+    }
+    v *= pow(10.0, expNeg ? -e : e);
+  }
+  if (neg)
+    v = -v;
+  return _p != start;
+}
+
+/* (r) is not NULL, if the value is the field (name) of object (r).
+   it returns false for incorrect JSON */
+
+bool CBaselineParser::ParseValue(unsigned depth, CBenchResult *r, const AString *name)
+{
+  if (depth > kJsonMaxDepth)
+    return false;
+  SkipSpaces();
+  if (_p == _end)
+    return false;
+  const char c = *_p;
+
+  if (c == '{')
+  {
+    _p++;
+    CBenchResult item;
+    item.DictSize = 0;
+    item.NumThreads = 0;
+    item.Pass = 0;
+    item.Decode = false;
+    item.Speed = 0;
+    item.Usage = 0;
+    item.RPU = 0;
+    item.Rating = 0;
+    bool op_Defined = false;
+    bool speed_Defined = false;
+    AString fieldName;
+    SkipSpaces();
+    if (_p != _end && *_p == '}')
+      _p++;
+    else
+    for (;;)
+    {
+      SkipSpaces();
+      if (!ParseString(fieldName))
+        return false;
+      SkipSpaces();
+      if (_p == _end || *_p != ':')
+        return false;
+      _p++;
+      if (fieldName.IsEqualTo("op"))
+        op_Defined = true;
+      else if (fieldName.IsEqualTo("speed"))
+        speed_Defined = true;
+      if (!ParseValue(depth + 1, &item, &fieldName))
+        return false;
+      SkipSpaces();
+      if (_p == _end)
+        return false;
+      const char c2 = *_p++;
+      if (c2 == '}')
+        break;
+      if (c2 != ',')
+        return false;
+    }
+    if (op_Defined && speed_Defined && !item.Method.IsEmpty())
+      Results.Add(item);
+    return true;
+  }
+
+  if (c == '[')
+  {
+    _p++;
+    SkipSpaces();
+    if (_p != _end && *_p == ']')
+    {
+      _p++;
+      return true;
+    }
+    for (;;)
+    {
+      if (!ParseValue(depth + 1, NULL, NULL))
+        return false;
+      SkipSpaces();
+      if (_p == _end)
+        return false;
+      const char c2 = *_p++;
+      if (c2 == ']')
+        return true;
+      if (c2 != ',')
+        return false;
+    }
+  }
+
+  if (c == '\"')
+  {
+    AString s;
+    if (!ParseString(s))
+      return false;
+    if (r)
+    {
+      if (name->IsEqualTo("method"))
+        r->Method = s;
+      else if (name->IsEqualTo("layout"))
+        r->Layout = s;
+      else if (name->IsEqualTo("op"))
+        r->Decode = s.IsEqualTo("decode");
+    }
+    return true;
+  }
+
+  if (c == '-' || (c >= '0' && c <= '9'))
+  {
+    double v;
+    if (!ParseNumber(v))
+      return false;
+    if (r && v >= 0)
+    {
+      const UInt64 v64 = (UInt64)v;
+           if (name->IsEqualTo("dict"))    r->DictSize = v64;
+      else if (name->IsEqualTo("threads")) r->NumThreads = (UInt32)v64;
+      else if (name->IsEqualTo("pass"))    r->Pass = (UInt32)v64;
+      else if (name->IsEqualTo("speed"))   r->Speed = v64;
+    }
+    return true;
+  }
+
+  const char * const k_Literals[] = { "true", "false", "null" };
+  for (unsigned i = 0; i < Z7_ARRAY_SIZE(k_Literals); i++)
+  {
+    const char *lit = k_Literals[i];
+    const size_t len = strlen(lit);
+    if ((size_t)(_end - _p) >= len && memcmp(_p, lit, len) == 0)
+    {
+      _p += len;
+      return true;
+    }
+  }
+  return false;
+}
+
+bool CBaselineParser::Parse(const char *p, size_t size)
+{
+  _p = p;
+  _end = p + size;
+  Results.Clear();
+  if (!ParseValue(0, NULL, NULL))
+    return false;
+  SkipSpaces();
+  return _p == _end;
+}
+
+
+static const size_t kBaselineSizeMax = (size_t)1 << 26;
+
+static void ReadBaseline(const UString &path, CObjectVector<CBenchResult> &results)
+{
+  NFile::NIO::CInFile file;
+  if (!file.Open(us2fs(path)))
+    throw UString("Cannot open baseline file: ") + path;
+  UInt64 size64;
+  if (!file.GetLength(size64))
+    throw UString("Cannot read baseline file: ") + path;
+  if (size64 > kBaselineSizeMax)
+    throw UString("Baseline file is too big: ") + path;
+  const size_t size = (size_t)size64;
+  CByteBuffer buf(size);
+  size_t processed;
+  if (!file.ReadFull(buf, size, processed) || processed != size)
+    throw UString("Cannot read baseline file: ") + path;
+  CBaselineParser parser;
+  if (!parser.Parse((const char *)(const Byte *)buf, size))
+    throw UString("Incorrect JSON in baseline file: ") + path;
+  if (parser.Results.IsEmpty())
+    throw UString("There are no benchmark results in baseline file: ") + path;
+  results = parser.Results;
+}
+
+
+/*
+Comparison with baseline.
+The results are grouped by (method, dict, threads, op).
+For each group we use the passes (iterations) of benchmark as samples,
+and we compare the mean speeds with one-sided Welch's t-test at 95% level.
+So the test requires 2 or more passes in both baseline and current run:
+  7z b 5 -bformat=json > baseline.json
+  7z b 5 -bcompare=baseline.json
+*/
+
+struct CSamples
+{
+  unsigned Num;
+  double Sum;
+  double Sum2;
+
+  CSamples(): Num(0), Sum(0), Sum2(0) {}
+  void Add(double v)
+  {
+    Num++;
+    Sum += v;
+    Sum2 += v * v;
+  }
+  double GetMean() const { return Num == 0 ? 0 : Sum / Num; }
+  // sample variance
+  double GetVar() const
+  {
+    if (Num < 2)
+      return 0;
+    const double mean = Sum / Num;
+    const double v = (Sum2 - mean * Sum) / (Num - 1);
+    return v < 0 ? 0 : v;
+  }
+};
+
+struct CCompareGroup
+{
+  AString Method;
+  AString Layout;
+  UInt64 DictSize;
+  UInt32 NumThreads;
+  bool Decode;
+  CSamples Samples[2]; // [0] : baseline, [1] : current
+
+  bool IsSameKey(const CBenchResult &r) const
+  {
+    return DictSize == r.DictSize
+        && NumThreads == r.NumThreads
+        && Decode == r.Decode
+        && Method.IsEqualTo_Ascii_NoCase(r.Method)
+        && Layout.IsEqualTo_Ascii_NoCase(r.Layout);
+  }
+};
+
+static void AddToGroups(CObjectVector<CCompareGroup> &groups, const CObjectVector<CBenchResult> &results, unsigned index)
+{
+  FOR_VECTOR (i, results)
+  {
+    const CBenchResult &r = results[i];
+    unsigned k;
+    for (k = 0; k < groups.Size(); k++)
+      if (groups[k].IsSameKey(r))
+        break;
+    if (k == groups.Size())
+    {
+      CCompareGroup &g = groups.AddNew();
+      g.Method = r.Method;
+      g.Layout = r.Layout;
+      g.DictSize = r.DictSize;
+      g.NumThreads = r.NumThreads;
+      g.Decode = r.Decode;
+    }
+    groups[k].Samples[index].Add((double)r.Speed);
+  }
+}
+
+// one-sided 95% critical values of Student's t-distribution for (df = 1 ... 30)
+static const double k_TCrit_95[] =
+{
+  6.314, 2.920, 2.353, 2.132, 2.015, 1.943, 1.895, 1.860, 1.833, 1.812,
+  1.796, 1.782, 1.771, 1.761, 1.753, 1.746, 1.740, 1.734, 1.729, 1.725,
+  1.721, 1.717, 1.714, 1.711, 1.708, 1.706, 1.703, 1.701, 1.699, 1.697
+};
+
+static double GetTCrit(double df)
+{
+  if (df < 1)
+    df = 1;
+  if (df <= Z7_ARRAY_SIZE(k_TCrit_95))
+    return k_TCrit_95[(unsigned)df - 1];
+  // Cornish-Fisher expansion for large (df)
+  const double z = 1.6449;
+  return z + (z * z * z + z) / (4 * df);
+}
+
+static void PrintLeft(AString &s, const char *src, unsigned size)
+{
+  s += src;
+  for (unsigned len = MyStringLen(src); len < size; len++)
+    s.Add_Space();
+}
+
+static void PrintRight(AString &s, const char *src, unsigned size)
+{
+  for (unsigned len = MyStringLen(src); len < size; len++)
+    s.Add_Space();
+  s += src;
+}
+
+static void PrintNum(AString &s, UInt64 v, unsigned size)
+{
+  char temp[32];
+  ConvertUInt64ToString(v, temp);
+  PrintRight(s, temp, size);
+}
+
+// it prints (v / 10) with one digit after the point
+static void PrintFixed1(AString &s, Int64 v, unsigned size)
+{
+  AString temp;
+  if (v < 0)
+  {
+    temp.Add_Minus();
+    v = -v;
+  }
+  else
+    temp.Add_Char('+');
+  temp.Add_UInt64((UInt64)v / 10);
+  temp.Add_Dot();
+  temp.Add_Char((char)('0' + (unsigned)((UInt64)v % 10)));
+  PrintRight(s, temp, size);
+}
+
+static void PrintDict(AString &s, UInt64 dict, unsigned size)
+{
+  AString temp;
+  if (dict != 0)
+  {
+    unsigned i;
+    for (i = 0; i < 64; i++)
+      if (((UInt64)1 << i) == dict)
+        break;
+    if (i != 64)
+    {
+      temp.Add_UInt32(i);
+      temp.Add_Colon();
+    }
+    else
+      temp.Add_UInt64(dict);
+  }
+  PrintRight(s, temp, size);
+}
+
+static unsigned CompareWithBaseline(FILE *f, const UString &path,
+    const CObjectVector<CBenchResult> &baseline,
+    const CObjectVector<CBenchResult> &current)
+{
+  CObjectVector<CCompareGroup> groups;
+  AddToGroups(groups, current, 1);
+  AddToGroups(groups, baseline, 0);
+
+  unsigned numRegressions = 0;
+  unsigned numImprovements = 0;
+  unsigned numUndefined = 0;
+  AString s;
+
+  s.Add_LF();
+  s += "Baseline: ";
+  s += GetOemString(path);
+  s.Add_LF();
+  s.Add_LF();
+  PrintLeft(s, "Method", 16);
+  PrintRight(s, "Dict", 6);
+  PrintRight(s, "Thr", 5);
+  PrintRight(s, "Op", 5);
+  PrintRight(s, "Base", 10);
+  PrintRight(s, "Current", 10);
+  PrintRight(s, "Change", 9);
+  PrintRight(s, "t", 8);
+  s += "  Result";
+  s.Add_LF();
+  PrintLeft(s, "", 16 + 6 + 5 + 5);
+  PrintRight(s, "KiB/s", 10);
+  PrintRight(s, "KiB/s", 10);
+  PrintRight(s, "%", 9);
+  s.Add_LF();
+  s.Add_LF();
+
+  FOR_VECTOR (i, groups)
+  {
+    const CCompareGroup &g = groups[i];
+    const CSamples &b = g.Samples[0];
+    const CSamples &c = g.Samples[1];
+    if (c.Num == 0)
+      continue;
+
+    PrintLeft(s, g.Method, 16);
+    // the results of benchmark with real data have no dictionary column
+    if (!g.Layout.IsEmpty())
+      PrintRight(s, g.Layout, 6);
+    else
+      PrintDict(s, g.DictSize, 6);
+    PrintNum(s, g.NumThreads, 5);
+    PrintRight(s, g.Decode ? "dec" : "enc", 5);
+
+    if (b.Num == 0)
+    {
+      PrintLeft(s, "", 10);
+      PrintNum(s, (UInt64)(c.GetMean() / 1024), 10);
+      PrintLeft(s, "", 9 + 8);
+      s += "  no baseline";
+      s.Add_LF();
+      continue;
+    }
+
+    const double meanB = b.GetMean();
+    const double meanC = c.GetMean();
+    PrintNum(s, (UInt64)(meanB / 1024), 10);
+    PrintNum(s, (UInt64)(meanC / 1024), 10);
+    if (meanB != 0)
+      PrintFixed1(s, (Int64)((meanC - meanB) * 1000 / meanB), 9);
+    else
+      PrintLeft(s, "", 9);
+
+    const char *result;
+    if (b.Num < 2 || c.Num < 2)
+    {
+      PrintLeft(s, "", 8);
+      result = "?";
+      numUndefined++;
+    }
+    else
+    {
+      const double vb = b.GetVar() / b.Num;
+      const double vc = c.GetVar() / c.Num;
+      const double se2 = vb + vc;
+      bool significant;
+      double t = 0;
+      if (se2 <= 0)
+      {
+        significant = (meanC != meanB);
+        PrintLeft(s, "", 8);
+      }
+      else
+      {
+        t = (meanC - meanB) / sqrt(se2);
+        // Welch-Satterthwaite degrees of freedom
+        double df = se2 * se2 /
+            (vb * vb / (b.Num - 1) + vc * vc / (c.Num - 1));
+        significant = (fabs(t) > GetTCrit(df));
+        PrintFixed1(s, (Int64)(t * 10), 8);
+      }
+      if (!significant)
+        result = "-";
+      else if (meanC < meanB)
+      {
+        result = "REGRESSION";
+        numRegressions++;
+      }
+      else
+      {
+        result = "faster";
+        numImprovements++;
+      }
+    }
+    s += "  ";
+    s += result;
+    s.Add_LF();
+  }
+
+  s.Add_LF();
+  s += "Regressions: ";
+  s.Add_UInt32(numRegressions);
+  s += "   Improvements: ";
+  s.Add_UInt32(numImprovements);
+  s.Add_LF();
+  if (numUndefined != 0)
+    s += "The comparison requires 2 or more passes in baseline and in current run: 7z b N\n";
+
+  if (f)
+  {
+    fputs(s, f);
+    fflush(f);
+  }
+  return numRegressions;
+}
+
+
 HRESULT BenchCon(DECL_EXTERNAL_CODECS_LOC_VARS
-    const CObjectVector<CProperty> &props, UInt32 numIterations, FILE *f)
+    const CObjectVector<CProperty> &props, UInt32 numIterations, FILE *f,
+    CBenchConOptions &options)
+{
+  options.NumRegressions = 0;
+
+  CObjectVector<CBenchResult> baseline;
+  const bool compareMode = !options.CompareFile.IsEmpty();
+  if (compareMode)
+    ReadBaseline(options.CompareFile, baseline);
+
+  const bool needResults = compareMode || options.Format != NBenchFormat::kText;
+
+  CPrintBenchCallback callback;
+  callback._file = f;
+  CBenchResultsWriter writer;
+  writer.Init(options.Format != NBenchFormat::kText ? options.ResultsFile : NULL, options.Format);
+
+  const HRESULT res = Bench(EXTERNAL_CODECS_LOC_VARS
+      &callback, NULL, props, numIterations, true, NULL,
+      needResults ? &writer : NULL);
+
+  writer.Finish();
+  RINOK(res)
+
+  if (compareMode)
+    options.NumRegressions = CompareWithBaseline(f, options.CompareFile, baseline, writer.Results);
+  return res;
+}
+
+
+HRESULT CorpusBenchCon(DECL_EXTERNAL_CODECS_LOC_VARS
+    const FStringVector &filePaths,
+    const CObjectVector<CProperty> &props, UInt32 numIterations, FILE *f,
+    CBenchConOptions &options)
 {
+  options.NumRegressions = 0;
+
+  CObjectVector<CBenchResult> baseline;
+  const bool compareMode = !options.CompareFile.IsEmpty();
+  if (compareMode)
+    ReadBaseline(options.CompareFile, baseline);
+
+  const bool needResults = compareMode || options.Format != NBenchFormat::kText;
+
   CPrintBenchCallback callback;
   callback._file = f;
-  return Bench(EXTERNAL_CODECS_LOC_VARS
-      &callback, NULL, props, numIterations, true);
+  CBenchResultsWriter writer;
+  writer.Init(options.Format != NBenchFormat::kText ? options.ResultsFile : NULL, options.Format);
+
+  const HRESULT res = CorpusBench(EXTERNAL_CODECS_LOC_VARS
+      &callback, filePaths, props, numIterations,
+      needResults ? &writer : NULL);
+
+  writer.Finish();
+  RINOK(res)
+
+  if (compareMode)
+    options.NumRegressions = CompareWithBaseline(f, options.CompareFile, baseline, writer.Results);
+  return res;
 }
@@ -6,9 +6,40 @@
 #include <stdio.h>
 
 #include "../../Common/CreateCoder.h"
+#include "../../UI/Common/ArchiveCommandLine.h"
 #include "../../UI/Common/Property.h"
 
+struct CBenchConOptions
+{
+  NBenchFormat::EEnum Format;
+  FILE *ResultsFile;        // JSON or CSV results are written to this file
+  UString CompareFile;      // baseline results in JSON format (-bcompare)
+
+  // out:
+  unsigned NumRegressions;
+
+  CBenchConOptions():
+      Format(NBenchFormat::kText),
+      ResultsFile(NULL),
+      NumRegressions(0)
+    {}
+};
+
+/*
+(f) is the stream for benchmark table and for comparison report.
+    it can be NULL, if the table must not be printed.
+*/
+
 HRESULT BenchCon(DECL_EXTERNAL_CODECS_LOC_VARS
-    const CObjectVector<CProperty> &props, UInt32 numIterations, FILE *f);
+    const CObjectVector<CProperty> &props, UInt32 numIterations, FILE *f,
+    CBenchConOptions &options);
+
+/* CorpusBenchCon() is benchmark with real data from files (filePaths).
+   The results are reported in same way as in BenchCon(). */
+
+HRESULT CorpusBenchCon(DECL_EXTERNAL_CODECS_LOC_VARS
+    const FStringVector &filePaths,
+    const CObjectVector<CProperty> &props, UInt32 numIterations, FILE *f,
+    CBenchConOptions &options);
 
 #endif
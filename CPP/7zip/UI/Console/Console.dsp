@@ -193,6 +193,22 @@ SOURCE=.\HashCon.h
 # End Source File
 # Begin Source File
 
+SOURCE=.\IoBenchCon.cpp
+# End Source File
+# Begin Source File
+
+SOURCE=.\IoBenchCon.h
+# End Source File
+# Begin Source File
+
+SOURCE=.\JsonProgress.cpp
+# End Source File
+# Begin Source File
+
+SOURCE=.\JsonProgress.h
+# End Source File
+# Begin Source File
+
 SOURCE=.\List.cpp
 # End Source File
 # Begin Source File
@@ -10,6 +10,8 @@ CONSOLE_OBJS = \
   $O\ConsoleClose.obj \
   $O\ExtractCallbackConsole.obj \
   $O\HashCon.obj \
+  $O\IoBenchCon.obj \
+  $O\JsonProgress.obj \
   $O\List.obj \
   $O\Main.obj \
   $O\MainAr.obj \
@@ -244,6 +244,13 @@ Z7_COM7F_IMF(CExtractCallbackConsole::SetTotal(UInt64 size))
     _percent.Total = size;
     _percent.Print();
   }
+ #ifndef Z7_SFX
+  if (JsonProgress)
+  {
+    JsonProgress->Total = size;
+    JsonProgress->Print();
+  }
+ #endif
   return CheckBreak2();
 }
 
@@ -257,8 +264,33 @@ Z7_COM7F_IMF(CExtractCallbackConsole::SetCompleted(const UInt64 *completeValue))
       _percent.Completed = *completeValue;
     _percent.Print();
   }
+ #ifndef Z7_SFX
+  if (JsonProgress)
+  {
+    if (completeValue)
+      JsonProgress->Completed = *completeValue;
+    JsonProgress->Print();
+  }
+ #endif
+  return CheckBreak2();
+}
+
+#ifndef Z7_SFX
+Z7_COM7F_IMF(CExtractCallbackConsole::SetRatioInfo(const UInt64 *inSize, const UInt64 *outSize))
+{
+  MT_LOCK
+
+  if (JsonProgress)
+  {
+    if (inSize)
+      JsonProgress->InSize = *inSize;
+    if (outSize)
+      JsonProgress->OutSize = *outSize;
+    JsonProgress->RatioInfo_Defined = true;
+  }
   return CheckBreak2();
 }
+#endif
 
 static const char * const kTab = "  ";
 
@@ -392,6 +424,16 @@ Z7_COM7F_IMF(CExtractCallbackConsole::PrepareOperation(const wchar_t *name, Int3
     _percent.Print();
   }
 
+ #ifndef Z7_SFX
+  if (JsonProgress)
+  {
+    JsonProgress->FileName.Empty();
+    if (name)
+      JsonProgress->FileName = name;
+    JsonProgress->Print();
+  }
+ #endif
+
   return CheckBreak2();
 }
 
@@ -466,6 +508,15 @@ Z7_COM7F_IMF(CExtractCallbackConsole::SetOperationResult(Int32 opRes, Int32 encr
 {
   MT_LOCK
   
+ #ifndef Z7_SFX
+  if (JsonProgress)
+  {
+    JsonProgress->Files++;
+    if (opRes != NArchive::NExtract::NOperationResult::kOK)
+      JsonProgress->NumErrors++;
+  }
+ #endif
+
   if (opRes == NArchive::NExtract::NOperationResult::kOK)
   {
     if (NeedPercents())
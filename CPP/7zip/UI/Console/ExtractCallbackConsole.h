@@ -89,6 +89,9 @@ class CExtractCallbackConsole Z7_final:
   public IExtractCallbackUI,
   // public IArchiveExtractCallbackMessage,
   public IFolderArchiveExtractCallback2,
+ #ifndef Z7_SFX
+  public ICompressProgressInfo,
+ #endif
  #ifndef Z7_NO_CRYPTO
   public ICryptoGetTextPassword,
  #endif
@@ -107,6 +110,9 @@ class CExtractCallbackConsole Z7_final:
  #endif
  #ifndef Z7_SFX
   Z7_COM_QI_ENTRY(IArchiveRequestMemoryUseCallback)
+  // the archive extract callback sends (inSize, outSize) only if it can get that interface
+  else if (iid == IID_ICompressProgressInfo && JsonProgress)
+    { ICompressProgressInfo *ti = this;  *outObject = ti; }
  #endif
 
   Z7_COM_QI_END
@@ -117,6 +123,9 @@ class CExtractCallbackConsole Z7_final:
   Z7_IFACE_IMP(IExtractCallbackUI)
   // Z7_IFACE_COM7_IMP(IArchiveExtractCallbackMessage)
   Z7_IFACE_COM7_IMP(IFolderArchiveExtractCallback2)
+ #ifndef Z7_SFX
+  Z7_IFACE_COM7_IMP(ICompressProgressInfo)
+ #endif
  #ifndef Z7_NO_CRYPTO
   Z7_IFACE_COM7_IMP(ICryptoGetTextPassword)
  #endif
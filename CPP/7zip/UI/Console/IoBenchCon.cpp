@@ -0,0 +1,748 @@
+// IoBenchCon.cpp
+
+#include "StdAfx.h"
+
+#include <math.h>
+
+#include "../../../Common/IntToString.h"
+#include "../../../Common/MyBuffer.h"
+#include "../../../Common/StringConvert.h"
+#include "../../../Common/StringToInt.h"
+
+#include "../../../Windows/FileDir.h"
+#include "../../../Windows/FileFind.h"
+#include "../../../Windows/FileIO.h"
+#include "../../../Windows/FileName.h"
+#include "../../../Windows/TimeUtils.h"
+
+#include "../Common/Extract.h"
+#include "../Common/PhaseTime.h"
+#ifndef Z7_EXTRACT_ONLY
+#include "../Common/Update.h"
+#endif
+
+#include "ConsoleClose.h"
+#include "ExtractCallbackConsole.h"
+#include "IoBenchCon.h"
+#include "OpenCallbackConsole.h"
+#ifndef Z7_EXTRACT_ONLY
+#include "UpdateCallbackConsole.h"
+#endif
+
+using namespace NWindows;
+using namespace NFile;
+
+void PrintPhaseTimes(CStdOutStream &so, const CPhaseTimes &pt, const char *name);
+
+static const unsigned kNumFiles_Default = 1000;
+static const unsigned kDirFiles_Default = 100;
+static const UInt64 kMinSize_Default = (UInt64)1 << 10;
+static const UInt64 kMaxSize_Default = (UInt64)1 << 16;
+
+// the files are the parts of one buffer of pseudo-text
+static const size_t kTextPoolSize = (size_t)1 << 20;
+static const unsigned kNumWords = 1 << 10;
+
+static const char * const kArcName = "bench";
+static const char * const kSrcDirName = "src";
+static const char * const kOutDirName = "out";
+
+
+bool IsIoBenchMode(const CObjectVector<CProperty> &props)
+{
+  FOR_VECTOR (i, props)
+  {
+    const CProperty &prop = props[i];
+    if (StringsAreEqualNoCase_Ascii(prop.Name, "m")
+        && StringsAreEqualNoCase_Ascii(prop.Value, "io"))
+      return true;
+  }
+  return false;
+}
+
+
+struct CIoBenchRandom
+{
+  UInt32 A;
+  UInt32 B;
+  CIoBenchRandom(): A(362436069), B(521288629) {}
+  UInt32 GetRnd()
+  {
+    return
+        ((A = 36969 * (A & 0xffff) + (A >> 16)) << 16) +
+        ((B = 18000 * (B & 0xffff) + (B >> 16)) );
+  }
+  UInt64 GetRnd64() { const UInt32 hi = GetRnd(); return ((UInt64)hi << 32) | GetRnd(); }
+};
+
+
+/* it fills (buf) with the words from random dictionary.
+   The words with small indexes are more frequent, so the data is compressible. */
+
+static void GenerateText(Byte *buf, size_t size, CIoBenchRandom &rg)
+{
+  CByteBuffer words;
+  words.Alloc(kNumWords * 16);
+  for (unsigned w = 0; w < kNumWords; w++)
+  {
+    Byte *word = words + w * 16;
+    const unsigned len = 2 + rg.GetRnd() % 12;
+    word[0] = (Byte)len;
+    for (unsigned k = 1; k <= len; k++)
+      word[k] = (Byte)('a' + rg.GetRnd() % 26);
+  }
+  size_t pos = 0;
+  while (pos < size)
+  {
+    const UInt32 r = rg.GetRnd();
+    const unsigned index = (unsigned)(((r & (kNumWords - 1)) * ((r >> 10) & (kNumWords - 1))) / kNumWords);
+    const Byte *word = words + index * 16;
+    for (unsigned k = 1; k <= word[0] && pos < size; k++)
+      buf[pos++] = word[k];
+    if (pos < size)
+      buf[pos++] = (Byte)(((r >> 20) & 15) == 0 ? '\n' : ' ');
+  }
+}
+
+
+// it parses the size with optional suffix: b, k, m, g
+static bool ParseIoBenchSize(const wchar_t *s, const wchar_t **end, UInt64 &val)
+{
+  const wchar_t *end2;
+  val = ConvertStringToUInt64(s, &end2);
+  if (end2 == s)
+    return false;
+  unsigned numBits = 0;
+  switch (MyCharLower_Ascii(*end2))
+  {
+    case 'b': numBits = 0; end2++; break;
+    case 'k': numBits = 10; end2++; break;
+    case 'm': numBits = 20; end2++; break;
+    case 'g': numBits = 30; end2++; break;
+    default: break;
+  }
+  if (numBits != 0)
+  {
+    if (val >= ((UInt64)1 << (64 - numBits)))
+      return false;
+    val <<= numBits;
+  }
+  *end = end2;
+  return true;
+}
+
+
+struct CIoBenchParams
+{
+  unsigned NumFiles;
+  unsigned DirFiles;
+  UInt64 MinSize;
+  UInt64 MaxSize;
+  bool LogDistribution;
+  FString BaseDir;
+  CObjectVector<CProperty> ArcProps;
+
+  CIoBenchParams():
+      NumFiles(kNumFiles_Default),
+      DirFiles(kDirFiles_Default),
+      MinSize(kMinSize_Default),
+      MaxSize(kMaxSize_Default),
+      LogDistribution(true)
+    {}
+
+  HRESULT Parse(const CObjectVector<CProperty> &props);
+  UInt64 GetFileSize(CIoBenchRandom &rg) const;
+};
+
+
+HRESULT CIoBenchParams::Parse(const CObjectVector<CProperty> &props)
+{
+  FOR_VECTOR (i, props)
+  {
+    const CProperty &prop = props[i];
+    UString name (prop.Name);
+    name.MakeLower_Ascii();
+    const UString &value = prop.Value;
+
+    if (name.IsEqualTo("m") && StringsAreEqualNoCase_Ascii(value, "io"))
+      continue;
+    if (name.IsEqualTo("files") || name.IsEqualTo("dirfiles"))
+    {
+      const wchar_t *end;
+      const UInt32 v = ConvertStringToUInt32(value, &end);
+      if (*end != 0 || v == 0 || v > ((UInt32)1 << 24))
+        return E_INVALIDARG;
+      if (name.IsEqualTo("files"))
+        NumFiles = v;
+      else
+      {
+        if (v < 2)
+          return E_INVALIDARG;
+        DirFiles = v;
+      }
+      continue;
+    }
+    if (name.IsEqualTo("size"))
+    {
+      const wchar_t *end;
+      if (!ParseIoBenchSize(value, &end, MinSize))
+        return E_INVALIDARG;
+      MaxSize = MinSize;
+      if (*end == '-')
+      {
+        if (!ParseIoBenchSize(end + 1, &end, MaxSize))
+          return E_INVALIDARG;
+      }
+      if (*end != 0 || MaxSize < MinSize)
+        return E_INVALIDARG;
+      continue;
+    }
+    if (name.IsEqualTo("dist"))
+    {
+      if (StringsAreEqualNoCase_Ascii(value, "log"))
+        LogDistribution = true;
+      else if (StringsAreEqualNoCase_Ascii(value, "uniform"))
+        LogDistribution = false;
+      else
+        return E_INVALIDARG;
+      continue;
+    }
+    if (name.IsEqualTo("dir"))
+    {
+      if (value.IsEmpty())
+        return E_INVALIDARG;
+      BaseDir = us2fs(value);
+      continue;
+    }
+    ArcProps.Add(prop);
+  }
+  return S_OK;
+}
+
+
+UInt64 CIoBenchParams::GetFileSize(CIoBenchRandom &rg) const
+{
+  if (MinSize == MaxSize)
+    return MinSize;
+  if (!LogDistribution || MinSize == 0)
+    return MinSize + rg.GetRnd64() % (MaxSize - MinSize + 1);
+  const double u = (double)rg.GetRnd() / 4294967296.0;
+  const double lnMin = log((double)MinSize);
+  const double lnMax = log((double)(MaxSize + 1));
+  UInt64 size = (UInt64)exp(lnMin + u * (lnMax - lnMin));
+  if (size < MinSize)
+    size = MinSize;
+  if (size > MaxSize)
+    size = MaxSize;
+  return size;
+}
+
+
+// it removes the scratch directory with all files at exit
+
+struct CScratchDirRemover
+{
+  FString Path;
+  ~CScratchDirRemover()
+  {
+    if (!Path.IsEmpty())
+      NDir::RemoveDirWithSubItems(Path);
+  }
+};
+
+
+static HRESULT GetLastErrorWithPath(CStdOutStream *se, const char *message, const FString &path)
+{
+  const HRESULT res = GetLastError_noZero_HRESULT();
+  if (se)
+  {
+    *se << endl << "ERROR: " << message << " : ";
+    se->NormalizePrint_UString_Path(fs2us(path));
+    *se << endl;
+  }
+  return res;
+}
+
+
+/* The files are placed to tree of directories, where each directory contains (DirFiles) items.
+   The path of file (index) is constructed from digits of (index) in base (DirFiles). */
+
+static HRESULT GenerateTree(const CIoBenchParams &params, const FString &srcDir,
+    CStdOutStream *se, UInt64 &totalSize, UInt64 &numDirs)
+{
+  CIoBenchRandom rg;
+  CByteBuffer pool;
+  pool.Alloc(kTextPoolSize);
+  GenerateText(pool, kTextPoolSize, rg);
+
+  unsigned depth = 0;
+  {
+    UInt64 cap = params.DirFiles;
+    while (cap < params.NumFiles)
+    {
+      cap *= params.DirFiles;
+      depth++;
+    }
+  }
+
+  totalSize = 0;
+  numDirs = 1; // srcDir
+  if (!NDir::CreateComplexDir(srcDir))
+    return GetLastErrorWithPath(se, "Cannot create directory", srcDir);
+
+  CByteBuffer fileBuf;
+  FString path;
+  for (unsigned i = 0; i < params.NumFiles; i++)
+  {
+    if (NConsoleClose::TestBreakSignal())
+      return E_ABORT;
+
+    path = srcDir;
+    path.Add_PathSepar();
+    {
+      unsigned div = 1;
+      for (unsigned k = 0; k < depth; k++)
+        div *= params.DirFiles;
+      for (unsigned level = depth; level != 0; level--)
+      {
+        path += 'd';
+        path.Add_UInt32((i / div) % params.DirFiles);
+        path.Add_PathSepar();
+        div /= params.DirFiles;
+      }
+      // the first file in directory: we create the directory and the new parent directories
+      if (depth != 0 && i % params.DirFiles == 0)
+      {
+        if (!NDir::CreateComplexDir(path))
+          return GetLastErrorWithPath(se, "Cannot create directory", path);
+        numDirs++;
+        unsigned k = i / params.DirFiles;
+        for (unsigned level = 1; level < depth && k % params.DirFiles == 0; level++)
+        {
+          numDirs++;
+          k /= params.DirFiles;
+        }
+      }
+    }
+    path += 'f';
+    path.Add_UInt32(i % params.DirFiles);
+    path += ".txt";
+
+    const UInt64 size64 = params.GetFileSize(rg);
+    const size_t size = (size_t)size64;
+    if (size != size64)
+      return E_OUTOFMEMORY;
+    if (fileBuf.Size() < size)
+      fileBuf.Alloc(size);
+    {
+      size_t pos = (size_t)(rg.GetRnd() % kTextPoolSize);
+      for (size_t k = 0; k < size;)
+      {
+        size_t cur = kTextPoolSize - pos;
+        if (cur > size - k)
+          cur = size - k;
+        memcpy(fileBuf + k, pool + pos, cur);
+        k += cur;
+        pos = 0;
+      }
+    }
+
+    NIO::COutFile file;
+    if (!file.Create_NEW(path))
+      return GetLastErrorWithPath(se, "Cannot create file", path);
+    if (!file.WriteFull(fileBuf, size))
+      return GetLastErrorWithPath(se, "Cannot write file", path);
+    if (!file.Close())
+      return GetLastErrorWithPath(se, "Cannot close file", path);
+    totalSize += size;
+  }
+  return S_OK;
+}
+
+
+#ifndef Z7_EXTRACT_ONLY
+
+static HRESULT IoBench_Create(CCodecs *codecs,
+    const CObjectVector<COpenType> &types,
+    const CObjectVector<CProperty> &arcProps,
+    const FString &srcDir, const UString &arcName,
+    CStdOutStream *se, CPhaseTimes &phaseTimes,
+    UString &arcPath)
+{
+  NWildcard::CCensor censor;
+  // UpdateArchive() calls AddPathsToCensor()
+  censor.AddPreItem_NoWildcard(fs2us(srcDir));
+
+  CUpdateOptions uo;
+  uo.UpdateArchiveItself = true;
+  {
+    CUpdateArchiveCommand cmd;
+    cmd.ActionSet = NUpdateArchive::k_ActionSet_Add;
+    uo.Commands.Add(cmd);
+  }
+  uo.MethodMode.Properties = arcProps;
+  uo.PathMode = NWildcard::k_RelatPath;
+  uo.PhaseTimes = &phaseTimes;
+
+  COpenCallbackConsole openCallback;
+  openCallback.Init(NULL, se, NULL, true);
+  CUpdateCallbackConsole callback;
+  callback.Init(NULL, se, NULL, true);
+
+  CUpdateErrorInfo errorInfo;
+  HRESULT res = UpdateArchive(codecs, types, arcName, censor, uo,
+      errorInfo, &openCallback, &callback, true);
+  if (res == S_OK
+      && (errorInfo.ThereIsError()
+        || callback.FailedFiles.Paths.Size() != 0
+        || callback.ScanErrors.Paths.Size() != 0))
+    res = E_FAIL;
+  if (res != S_OK && se && !errorInfo.Message.IsEmpty())
+    *se << endl << "ERROR: " << errorInfo.Message << endl;
+  arcPath = uo.ArchivePath.GetFinalPath();
+  return res;
+}
+
+#endif
+
+
+// it opens the archive and it reads the main properties of items, like "7z l" command
+
+static HRESULT IoBench_List(CCodecs *codecs,
+    const CObjectVector<COpenType> &types,
+    const CIntVector &excludedFormats,
+    const UString &arcPath,
+    CStdOutStream *se, CPhaseTimes &phaseTimes)
+{
+  CArchiveLink arcLink;
+  COpenCallbackConsole openCallback;
+  openCallback.Init(NULL, se, NULL, true);
+
+  CObjectVector<CProperty> props;
+  COpenOptions options;
+  options.props = &props;
+  options.codecs = codecs;
+  options.types = &types;
+  options.excludedFormats = &excludedFormats;
+  options.stdInMode = false;
+  options.stream = NULL;
+  options.filePath = arcPath;
+  options.PhaseTimes = &phaseTimes;
+  {
+    CPhaseTimer phaseTimer(&phaseTimes, NPhase::kOpen);
+    RINOK(arcLink.Open_Strict(options, &openCallback))
+  }
+
+  CPhaseTimer phaseTimer(&phaseTimes, NPhase::kList);
+  const CArc &arc = arcLink.Arcs.Back();
+  UInt32 numItems;
+  RINOK(arc.Archive->GetNumberOfItems(&numItems))
+  UString path;
+  for (UInt32 i = 0; i < numItems; i++)
+  {
+    if (NConsoleClose::TestBreakSignal())
+      return E_ABORT;
+    RINOK(arc.GetItem_Path2(i, path))
+    bool isDir;
+    RINOK(Archive_IsItem_Dir(arc.Archive, i, isDir))
+    UInt64 size;
+    bool size_Defined;
+    RINOK(arc.GetItem_Size(i, size, size_Defined))
+    CArcTime mtime;
+    RINOK(arc.GetItem_MTime(i, mtime))
+  }
+  return S_OK;
+}
+
+
+// (outDir) is empty for test
+
+static HRESULT IoBench_Extract(CCodecs *codecs,
+    const CObjectVector<COpenType> &types,
+    const CIntVector &excludedFormats,
+    const UString &arcPath, const FString &outDir,
+    CStdOutStream *se, CPhaseTimes &phaseTimes)
+{
+  NWildcard::CCensor censor;
+  censor.AddPreItem_Wildcard();
+  censor.AddPathsToCensor(NWildcard::k_RelatPath);
+
+  UStringVector arcPaths, arcPathsFull;
+  arcPaths.Add(arcPath);
+  {
+    FString fullPath;
+    NDir::MyGetFullPathName(us2fs(arcPath), fullPath);
+    arcPathsFull.Add(fs2us(fullPath));
+  }
+
+  CExtractCallbackConsole *ecs = new CExtractCallbackConsole;
+  CMyComPtr<IFolderArchiveExtractCallback> extractCallback = ecs;
+  ecs->Init(NULL, se, NULL, true);
+
+  CExtractOptions eo;
+  eo.TestMode = outDir.IsEmpty();
+  eo.OutputDir = outDir;
+  eo.PathMode = NExtract::NPathMode::kFullPaths;
+  eo.OverwriteMode = NExtract::NOverwriteMode::kOverwrite;
+  eo.OverwriteMode_Force = true;
+  eo.YesToAll = true;
+  eo.PhaseTimes = &phaseTimes;
+
+  UString errorMessage;
+  CDecompressStat stat;
+  HRESULT res = Extract(codecs, types, excludedFormats,
+      arcPaths, arcPathsFull,
+      censor.Pairs.Front().Head,
+      eo, ecs, ecs, ecs,
+      NULL, // hash
+      errorMessage, stat);
+  if (!errorMessage.IsEmpty() && se)
+    *se << endl << "ERROR: " << errorMessage << endl;
+  if (res == S_OK
+      && (!errorMessage.IsEmpty()
+        || ecs->NumCantOpenArcs != 0
+        || ecs->NumArcsWithError != 0
+        || ecs->NumOpenArcErrors != 0
+        || ecs->NumFileErrors != 0))
+    res = S_FALSE;
+  return res;
+}
+
+
+// it adds (val / 10^numFracDigits) with (numFracDigits) digits after the point
+static void AddFixed(AString &s, UInt64 val, unsigned numFracDigits)
+{
+  UInt64 div = 1;
+  for (unsigned i = 0; i < numFracDigits; i++)
+    div *= 10;
+  s.Add_UInt64(val / div);
+  if (numFracDigits == 0)
+    return;
+  s.Add_Dot();
+  char temp[32];
+  ConvertUInt64ToString(val % div + div, temp);
+  s += temp + 1;
+}
+
+static void AddRight(AString &s, const AString &field, unsigned size)
+{
+  for (unsigned i = field.Len(); i < size; i++)
+    s.Add_Space();
+  s += field;
+}
+
+static void PrintOpHeader(CStdOutStream &so)
+{
+  so << "Operation  Pass         Time      Files/s         MB/s" << endl;
+  so << "                          sec" << endl << endl;
+}
+
+// (time) is in 100-ns units
+static void PrintOpRow(CStdOutStream &so, const char *name, const char *pass,
+    UInt64 time, UInt64 numFiles, UInt64 size)
+{
+  AString s (name);
+  while (s.Len() < 10)
+    s.Add_Space();
+  AString field (pass);
+  AddRight(s, field, 5);
+  field.Empty();
+  AddFixed(field, time / 10000, 3);
+  AddRight(s, field, 13);
+  field.Empty();
+  if (time != 0)
+    field.Add_UInt64((UInt64)((double)numFiles * 10000000 / (double)time));
+  AddRight(s, field, 13);
+  field.Empty();
+  if (time != 0)
+    AddFixed(field, (UInt64)((double)size * 10 / (double)time), 1);
+  AddRight(s, field, 13);
+  so << s << endl;
+}
+
+
+enum EIoBenchOp
+{
+  kOp_Create,
+  kOp_List,
+  kOp_Test,
+  kOp_Extract,
+  kNumOps
+};
+
+static const char * const k_OpNames[kNumOps] =
+{
+    "create"
+  , "list"
+  , "test"
+  , "extract"
+};
+
+
+HRESULT IoBenchCon(
+    CCodecs *codecs,
+    const CObjectVector<COpenType> &types,
+    const CIntVector &excludedFormats,
+    const CObjectVector<CProperty> &props,
+    UInt32 numIterations,
+    CStdOutStream *so,
+    CStdOutStream *se)
+{
+ #ifdef Z7_EXTRACT_ONLY
+  UNUSED_VAR(codecs)
+  UNUSED_VAR(types)
+  UNUSED_VAR(excludedFormats)
+  UNUSED_VAR(props)
+  UNUSED_VAR(numIterations)
+  UNUSED_VAR(so)
+  UNUSED_VAR(se)
+  return E_NOTIMPL;
+ #else
+  CIoBenchParams params;
+  RINOK(params.Parse(props))
+  if (numIterations == 0)
+    numIterations = 1;
+
+  FString baseDir = params.BaseDir;
+  if (baseDir.IsEmpty())
+  {
+    if (!NDir::MyGetTempPath(baseDir))
+      return GetLastError_noZero_HRESULT();
+  }
+  NName::NormalizeDirPathPrefix(baseDir);
+
+  CScratchDirRemover scratchRemover;
+  FString scratchDir;
+  {
+    FString prefix = baseDir;
+    prefix += "7zIoBench";
+    AString postfix;
+    if (!NDir::CreateTempFile2(prefix, true, postfix, NULL))
+      return GetLastErrorWithPath(se, "Cannot create scratch directory", prefix);
+    scratchDir = prefix;
+    scratchDir += postfix;
+    scratchRemover.Path = scratchDir;
+    NName::NormalizeDirPathPrefix(scratchDir);
+  }
+
+  FString srcDir = scratchDir;
+  srcDir += kSrcDirName;
+  FString outDir = scratchDir;
+  outDir += kOutDirName;
+  NName::NormalizeDirPathPrefix(outDir);
+  UString arcName = fs2us(scratchDir);
+  arcName += kArcName;
+
+  if (so)
+  {
+    *so << "Scratch directory: ";
+    so->NormalizePrint_UString_Path(fs2us(scratchDir));
+    *so << endl;
+    *so << "Files: " << params.NumFiles
+        << "  Items per directory: " << params.DirFiles
+        << "  Size: " << params.MinSize;
+    if (params.MaxSize != params.MinSize)
+      *so << " - " << params.MaxSize << (params.LogDistribution ? " (log)" : " (uniform)");
+    *so << endl << endl;
+  }
+
+  UInt64 totalSize = 0;
+  UInt64 numDirs = 0;
+  UInt64 genTime;
+  {
+    const UInt64 startTime = NTime::GetMonotonicTime();
+    RINOK(GenerateTree(params, srcDir, se, totalSize, numDirs))
+    genTime = NTime::GetMonotonicTime() - startTime;
+  }
+
+  if (so)
+  {
+    *so << "Directories: " << numDirs << "  Total size: " << totalSize << endl << endl;
+    PrintOpHeader(*so);
+    PrintOpRow(*so, "generate", "", genTime, params.NumFiles, totalSize);
+  }
+
+  CPhaseTimes phaseTimes[kNumOps];
+  UInt64 opTimes[kNumOps];
+  for (unsigned op = 0; op < kNumOps; op++)
+    opTimes[op] = 0;
+
+  UString arcPath;
+  UInt64 arcSize = 0;
+
+  for (UInt32 pass = 0; pass < numIterations; pass++)
+  {
+    // we delete the results of previous pass, and we don't include that time to results
+    if (!arcPath.IsEmpty())
+      NDir::DeleteFileAlways(us2fs(arcPath));
+    NDir::RemoveDirWithSubItems(outDir);
+
+    for (unsigned op = 0; op < kNumOps; op++)
+    {
+      if (NConsoleClose::TestBreakSignal())
+        return E_ABORT;
+      CPhaseTimes &pt = phaseTimes[op];
+      const UInt64 startTime = NTime::GetMonotonicTime();
+      HRESULT res;
+      switch (op)
+      {
+        case kOp_Create:
+          res = IoBench_Create(codecs, types, params.ArcProps, srcDir, arcName, se, pt, arcPath);
+          break;
+        case kOp_List:
+          res = IoBench_List(codecs, types, excludedFormats, arcPath, se, pt);
+          break;
+        default:
+          res = IoBench_Extract(codecs, types, excludedFormats, arcPath,
+              op == kOp_Test ? FString() : outDir, se, pt);
+          break;
+      }
+      const UInt64 time = NTime::GetMonotonicTime() - startTime;
+      if (res != S_OK)
+      {
+        if (se)
+          *se << endl << "ERROR in " << k_OpNames[op] << " operation" << endl;
+        return res;
+      }
+      opTimes[op] += time;
+      if (so)
+      {
+        char temp[16];
+        ConvertUInt32ToString(pass + 1, temp);
+        PrintOpRow(*so, k_OpNames[op], temp, time, params.NumFiles, totalSize);
+      }
+    }
+    if (pass == 0)
+    {
+      NFind::CFileInfo fi;
+      if (fi.Find(us2fs(arcPath)))
+        arcSize = fi.Size;
+    }
+  }
+
+  if (!so)
+    return S_OK;
+
+  if (numIterations > 1)
+  {
+    *so << endl;
+    for (unsigned op = 0; op < kNumOps; op++)
+      PrintOpRow(*so, k_OpNames[op], "avg", opTimes[op] / numIterations, params.NumFiles, totalSize);
+  }
+
+  *so << endl << "Archive size: " << arcSize;
+  if (totalSize != 0)
+  {
+    AString s;
+    AddFixed(s, (arcSize * 10000 + totalSize / 2) / totalSize, 2);
+    *so << " (" << s << "%)";
+  }
+  *so << endl;
+
+  // the phases are summed for all passes
+  for (unsigned op = 0; op < kNumOps; op++)
+    PrintPhaseTimes(*so, phaseTimes[op], k_OpNames[op]);
+
+  return S_OK;
+ #endif
+}
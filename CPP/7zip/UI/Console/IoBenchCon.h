@@ -0,0 +1,35 @@
+// IoBenchCon.h
+
+#ifndef ZIP7_INC_IO_BENCH_CON_H
+#define ZIP7_INC_IO_BENCH_CON_H
+
+#include "../../../Common/StdOutStream.h"
+
+#include "../Common/LoadCodecs.h"
+#include "../Common/Property.h"
+
+/*
+End-to-end benchmark with file system: 7z b [N] -mm=io
+It generates the tree of files in scratch directory, and it measures
+the time of archive creation, listing, testing and extraction.
+props:
+  files=N         : number of files (1000 by default)
+  dirfiles=N      : number of items per directory (100 by default)
+  size=min[-max]  : the size of files with suffixes (b, k, m, g) (1k-64k by default)
+  dist=log|uniform : the distribution of sizes between min and max (log by default)
+  dir=path        : the directory for scratch directory (temp directory by default)
+  another properties are sent to archive handler for archive creation (-mx, -ms, -mmt, ...).
+*/
+
+bool IsIoBenchMode(const CObjectVector<CProperty> &props);
+
+HRESULT IoBenchCon(
+    CCodecs *codecs,
+    const CObjectVector<COpenType> &types,
+    const CIntVector &excludedFormats,
+    const CObjectVector<CProperty> &props,
+    UInt32 numIterations,
+    CStdOutStream *so,
+    CStdOutStream *se);
+
+#endif
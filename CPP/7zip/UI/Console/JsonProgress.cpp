@@ -0,0 +1,408 @@
+// JsonProgress.cpp
+
+#include "StdAfx.h"
+
+#ifndef _WIN32
+#include <unistd.h>
+#include <sys/times.h>
+#ifdef __linux__
+#include <dirent.h>
+#endif
+#endif
+
+#include "../../../Common/IntToString.h"
+#include "../../../Common/StringToInt.h"
+#include "../../../Common/UTFConvert.h"
+
+#include "../../../Windows/TimeUtils.h"
+
+#include "JsonProgress.h"
+
+using namespace NWindows;
+
+// it adds (val / 10^numFracDigits) with (numFracDigits) digits after the point
+static void AddFixed(AString &s, UInt64 val, unsigned numFracDigits)
+{
+  UInt64 div = 1;
+  for (unsigned i = 0; i < numFracDigits; i++)
+    div *= 10;
+  s.Add_UInt64(val / div);
+  if (numFracDigits == 0)
+    return;
+  s.Add_Dot();
+  char temp[32];
+  ConvertUInt64ToString(val % div + div, temp);
+  s += temp + 1;
+}
+
+static void AddName(AString &s, const char *name)
+{
+  s += ",\"";
+  s += name;
+  s += "\":";
+}
+
+static void AddNum(AString &s, const char *name, UInt64 val)
+{
+  AddName(s, name);
+  s.Add_UInt64(val);
+}
+
+// (t) is in 100-ns units
+static void AddTime(AString &s, const char *name, UInt64 t)
+{
+  AddName(s, name);
+  AddFixed(s, t / 10000, 3);
+}
+
+static void AddJsonString(AString &s, const char *src)
+{
+  s += '\"';
+  for (;;)
+  {
+    const Byte c = (Byte)*src++;
+    if (c == 0)
+      break;
+    if (c == '\"' || c == '\\')
+      s += '\\';
+    else if (c < 0x20)
+    {
+      s += "\\u00";
+      s += (char)GET_HEX_CHAR_UPPER(c >> 4);
+      s += (char)GET_HEX_CHAR_UPPER(c & 15);
+      continue;
+    }
+    s += (char)c;
+  }
+  s += '\"';
+}
+
+
+#ifdef _WIN32
+
+static inline UInt64 GetTime64(const FILETIME &t) { return ((UInt64)t.dwHighDateTime << 32) | t.dwLowDateTime; }
+
+// it returns kernel + user time of process in 100-ns units
+static bool GetProcessCpuTime(UInt64 &t)
+{
+  FILETIME creationTimeFT, exitTimeFT, kernelTimeFT, userTimeFT;
+  if (!
+      #ifdef UNDER_CE
+        ::GetThreadTimes(::GetCurrentThread()
+      #else
+        ::GetProcessTimes(::GetCurrentProcess()
+      #endif
+      , &creationTimeFT, &exitTimeFT, &kernelTimeFT, &userTimeFT))
+    return false;
+  t = GetTime64(kernelTimeFT) + GetTime64(userTimeFT);
+  return true;
+}
+
+#else
+
+static bool GetProcessCpuTime(UInt64 &t)
+{
+  tms ts;
+  if (times(&ts) == (clock_t)-1)
+    return false;
+  const long freq = sysconf(_SC_CLK_TCK);
+  if (freq <= 0)
+    return false;
+  t = ((UInt64)ts.tms_utime + (UInt64)ts.tms_stime) * 10000000 / (UInt64)freq;
+  return true;
+}
+
+#endif
+
+
+#ifdef __linux__
+
+/* it adds the array of {"tid", "cpu"} for all threads of process.
+   (utime) and (stime) are fields 14 and 15 in /proc/self/task/{tid}/stat.
+   The name field (2) is in parentheses, and it can contain spaces.
+   The threads are added to (_threads), so the summary record can report
+   the threads that have exited after previous records. */
+
+void CJsonProgress::AddThreadsCpu(AString &s, bool isSummary)
+{
+  const long freq = sysconf(_SC_CLK_TCK);
+  if (freq <= 0)
+    return;
+  DIR *dir = opendir("/proc/self/task");
+  if (!dir)
+    return;
+  AddName(s, "threads");
+  s += '[';
+  bool isFirst = true;
+  unsigned i;
+  for (i = 0; i < _threads.Size(); i++)
+    _threads[i].Found = false;
+  AString path;
+  for (;;)
+  {
+    const struct dirent *de = readdir(dir);
+    if (!de)
+      break;
+    const char *name = de->d_name;
+    if (name[0] < '0' || name[0] > '9')
+      continue;
+    path = "/proc/self/task/";
+    path += name;
+    path += "/stat";
+    FILE *f = fopen(path, "r");
+    if (!f)
+      continue;
+    char buf[1024];
+    const size_t size = fread(buf, 1, sizeof(buf) - 1, f);
+    fclose(f);
+    buf[size] = 0;
+    const char *p = strrchr(buf, ')');
+    if (!p)
+      continue;
+    p++;
+    UInt64 cpu = 0;
+    bool ok = false;
+    for (unsigned field = 3; field <= 15; field++)
+    {
+      while (*p == ' ')
+        p++;
+      if (*p == 0)
+        break;
+      const char *end = p;
+      if (field >= 14)
+      {
+        cpu += ConvertStringToUInt64(p, &end);
+        if (field == 15)
+          ok = true;
+      }
+      p = end;
+      while (*p != ' ' && *p != 0)
+        p++;
+    }
+    if (!ok)
+      continue;
+    cpu = cpu * 10000000 / (UInt64)freq;
+    {
+      const UInt32 tid = ConvertStringToUInt32(name, NULL);
+      for (i = 0; i < _threads.Size(); i++)
+      {
+        const CJsonThreadCpu &t = _threads[i];
+        if (t.Tid == tid && !t.Exited)
+          break;
+      }
+      // smaller cpu time means that the old thread has exited, and its tid was reused
+      if (i != _threads.Size() && cpu < _threads[i].Cpu)
+      {
+        _threads[i].Exited = true;
+        i = _threads.Size();
+      }
+      if (i == _threads.Size())
+      {
+        CJsonThreadCpu t;
+        t.Tid = tid;
+        t.Exited = false;
+        _threads.Add(t);
+      }
+      CJsonThreadCpu &t = _threads[i];
+      t.Found = true;
+      t.Cpu = cpu;
+    }
+    if (!isFirst)
+      s.Add_Char(',');
+    isFirst = false;
+    s += "{\"tid\":";
+    s += name;
+    AddTime(s, "cpu", cpu);
+    s += '}';
+  }
+  closedir(dir);
+  s += ']';
+
+  UInt64 exitedCpu = 0;
+  unsigned numExited = 0;
+  for (i = 0; i < _threads.Size(); i++)
+  {
+    CJsonThreadCpu &t = _threads[i];
+    if (!t.Found)
+      t.Exited = true;
+    if (t.Exited)
+    {
+      numExited++;
+      exitedCpu += t.Cpu;
+    }
+  }
+  if (isSummary)
+  {
+    AddNum(s, "exited_threads", numExited);
+    AddTime(s, "exited_threads_cpu", exitedCpu);
+  }
+}
+
+#endif
+
+
+void CJsonProgress::Init(CStdOutStream *so, const char *operation, bool encodeMode)
+{
+  _so = so;
+  Operation = operation;
+  EncodeMode = encodeMode;
+  _startTime = NTime::GetMonotonicTime();
+  _prevTime = _startTime;
+  _prevCompleted = 0;
+  _speed = 0;
+  Total = (UInt64)(Int64)-1;
+  Completed = 0;
+  InSize = 0;
+  OutSize = 0;
+  RatioInfo_Defined = false;
+  Files = 0;
+  NumErrors = 0;
+  FileName.Empty();
+  _threads.Clear();
+}
+
+
+void CJsonProgress::PrintRecord(const char *type, UInt64 time, const HRESULT *result)
+{
+  const UInt64 elapsed = time - _startTime;
+  AString &s = _s;
+  s = "{\"type\":";
+  AddJsonString(s, type);
+  AddName(s, "op");
+  AddJsonString(s, Operation);
+  AddTime(s, "time", elapsed);
+
+  const bool totalDefined = (Total != (UInt64)(Int64)-1);
+  if (totalDefined)
+    AddNum(s, "total", Total);
+  AddNum(s, "completed", Completed);
+  if (totalDefined && Total != 0)
+  {
+    AddName(s, "percent");
+    const UInt64 cur = (Completed < Total ? Completed : Total);
+    AddFixed(s, (UInt64)((double)cur * 10000 / (double)Total), 2);
+  }
+
+  if (RatioInfo_Defined)
+  {
+    AddNum(s, "in", InSize);
+    AddNum(s, "out", OutSize);
+    const UInt64 packSize = (EncodeMode ? OutSize : InSize);
+    const UInt64 unpackSize = (EncodeMode ? InSize : OutSize);
+    if (unpackSize != 0)
+    {
+      AddName(s, "ratio");
+      AddFixed(s, (UInt64)((double)packSize * 10000 / (double)unpackSize), 4);
+    }
+  }
+
+  AddNum(s, "items", Files);
+  if (NumErrors != 0)
+    AddNum(s, "errors", NumErrors);
+  if (!FileName.IsEmpty())
+  {
+    AddName(s, "item");
+    ConvertUnicodeToUTF8(FileName, _temp);
+    AddJsonString(s, _temp);
+  }
+
+  if (_speed != 0)
+    AddNum(s, "speed", _speed);
+  UInt64 avgSpeed = 0;
+  if (elapsed != 0)
+    avgSpeed = (UInt64)((double)Completed * 10000000 / (double)elapsed);
+  AddNum(s, "avg_speed", avgSpeed);
+  if (!result && totalDefined && avgSpeed != 0 && Completed <= Total)
+    AddTime(s, "eta", (UInt64)((double)(Total - Completed) * 10000000 / (double)avgSpeed));
+
+  UInt64 cpu;
+  if (GetProcessCpuTime(cpu))
+    AddTime(s, "cpu", cpu);
+  #ifdef __linux__
+  AddThreadsCpu(s, result != NULL);
+  #endif
+
+  if (result)
+  {
+    AddName(s, "ok");
+    s += (*result == S_OK && NumErrors == 0 ? "true" : "false");
+    AddName(s, "result");
+    char temp[16];
+    temp[0] = '0';
+    temp[1] = 'x';
+    ConvertUInt32ToHex8Digits((UInt32)*result, temp + 2);
+    AddJsonString(s, temp);
+  }
+
+  s += '}';
+  *_so << s << endl;
+  _so->Flush();
+}
+
+
+void CJsonProgress::Print()
+{
+  if (!_so)
+    return;
+  const UInt64 time = NTime::GetMonotonicTime();
+  const UInt64 delta = time - _prevTime;
+  if (delta < (UInt64)Interval * 10000)
+    return;
+  _speed = 0;
+  if (delta != 0 && Completed >= _prevCompleted)
+    _speed = (UInt64)((double)(Completed - _prevCompleted) * 10000000 / (double)delta);
+  _prevTime = time;
+  _prevCompleted = Completed;
+  PrintRecord("progress", time, NULL);
+}
+
+
+void CJsonProgress::PrintSummary(HRESULT result)
+{
+  if (!_so)
+    return;
+  _speed = 0;
+  FileName.Empty();
+  PrintRecord("summary", NTime::GetMonotonicTime(), &result);
+}
+
+
+// the names of NPhase::EEnum phases
+static const char * const k_PhaseNames[] =
+{
+    "load_codecs"
+  , "scan"
+  , "open"
+  , "open_headers"
+  , "list"
+  , "decode"
+  , "file_create"
+  , "file_close"
+  , "encode"
+  , "header_write"
+  , "rename"
+};
+
+void CJsonProgress::PrintPhaseTimes(const CPhaseTimes &phaseTimes)
+{
+  if (!_so)
+    return;
+  AString &s = _s;
+  s = "{\"type\":\"phases\"";
+  AddName(s, "op");
+  AddJsonString(s, Operation);
+  for (unsigned i = 0; i < NPhase::kNumPhases; i++)
+  {
+    if (phaseTimes.Counts[i] == 0)
+      continue;
+    AddName(s, k_PhaseNames[i]);
+    s += "{\"count\":";
+    s.Add_UInt64(phaseTimes.Counts[i]);
+    AddName(s, "time");
+    AddFixed(s, phaseTimes.Times[i] / 10, 6);
+    s += '}';
+  }
+  s += '}';
+  *_so << s << endl;
+  _so->Flush();
+}
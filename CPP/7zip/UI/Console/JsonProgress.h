@@ -0,0 +1,84 @@
+// JsonProgress.h
+
+#ifndef ZIP7_INC_JSON_PROGRESS_H
+#define ZIP7_INC_JSON_PROGRESS_H
+
+#include "../../../Common/MyVector.h"
+#include "../../../Common/StdOutStream.h"
+
+#include "../Common/PhaseTime.h"
+
+/*
+CJsonProgress writes the state of operation (-bj switch) as JSON lines.
+Each line is one JSON object:
+  {"type":"progress", ...} : it's written not more often than once per (Interval)
+  {"type":"summary", ...}  : it's written once at the end of operation,
+                             it also contains "ok" (no errors) and "result" (HRESULT code)
+  {"type":"phases", ...}   : the time of operation phases (-bt switch)
+
+  sizes in bytes, times in seconds, speeds in bytes per second.
+  "in" / "out" are the sizes of input / output data of coders.
+  "ratio" is (packSize / unpackSize).
+  "cpu" is CPU time of process.
+  "threads" contains CPU time of each running thread of the process (Linux only).
+  "exited_threads" / "exited_threads_cpu" in "summary" record : the number of threads
+     that were found in previous records and that have exited, and the sum of CPU time
+     of these threads at the time of latest record where they were found (Linux only).
+     The threads that have started and exited between two records are not counted,
+     but the CPU time of these threads is included in "cpu" of process.
+
+The caller must protect the calls by same lock that protects the calls to CPercentPrinter.
+*/
+
+struct CJsonThreadCpu
+{
+  UInt32 Tid;
+  bool Exited;
+  bool Found;  // it was found in current record
+  UInt64 Cpu;  // in 100-ns units
+};
+
+class CJsonProgress
+{
+  CStdOutStream *_so;
+  UInt64 _startTime;
+  UInt64 _prevTime;
+  UInt64 _prevCompleted;
+  UInt64 _speed;
+  AString _s;
+  AString _temp;
+  // the threads that were found in all records of operation
+  CRecordVector<CJsonThreadCpu> _threads;
+
+  void AddThreadsCpu(AString &s, bool isSummary);
+  void PrintRecord(const char *type, UInt64 time, const HRESULT *result);
+public:
+  UInt32 Interval; // in milliseconds
+  const char *Operation;
+  bool EncodeMode;
+
+  UInt64 Total;
+  UInt64 Completed;
+  UInt64 InSize;
+  UInt64 OutSize;
+  bool RatioInfo_Defined;
+  UInt64 Files;
+  UInt64 NumErrors;
+  UString FileName;
+
+  CJsonProgress():
+      _so(NULL),
+      Interval(1000),
+      Operation(""),
+      EncodeMode(false)
+    {}
+
+  void Init(CStdOutStream *so, const char *operation, bool encodeMode);
+
+  // it writes the "progress" record, if (Interval) has passed since previous record.
+  void Print();
+  void PrintSummary(HRESULT result);
+  void PrintPhaseTimes(const CPhaseTimes &phaseTimes);
+};
+
+#endif
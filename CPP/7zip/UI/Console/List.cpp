@@ -1180,6 +1180,7 @@ HRESULT ListArchives(
     options.stdInMode = stdInMode;
     options.stream = NULL;
     options.filePath = arcPath;
+    options.PhaseTimes = listOptions.PhaseTimes;
 
     if (enableHeaders)
     {
@@ -1188,7 +1189,11 @@ HRESULT ListArchives(
       g_StdOut << endl << endl;
     }
     
-    HRESULT result = arcLink.Open_Strict(options, &openCallback);
+    HRESULT result;
+    {
+      CPhaseTimer phaseTimer(listOptions.PhaseTimes, NPhase::kOpen);
+      result = arcLink.Open_Strict(options, &openCallback);
+    }
 
     if (result != S_OK)
     {
@@ -1294,6 +1299,8 @@ HRESULT ListArchives(
  
     CReadArcItem item;
     UStringVector pathParts;
+
+    const UInt64 listStartTime = listOptions.PhaseTimes ? NTime::GetMonotonicTime() : 0;
     
     for (UInt32 i = 0; i < numItems; i++)
     {
@@ -1363,6 +1370,9 @@ HRESULT ListArchives(
       RINOK(fp.PrintItemInfo(i, st))
     }
 
+    if (listOptions.PhaseTimes)
+      listOptions.PhaseTimes->Add(NPhase::kList, NTime::GetMonotonicTime() - listStartTime);
+
     UInt64 numStreams = stat2.GetNumStreams();
     if (!stdInMode
         && !stat2.MainFiles.PackSize.Def
@@ -6,17 +6,20 @@
 #include "../../../Common/Wildcard.h"
 
 #include "../Common/LoadCodecs.h"
+#include "../Common/PhaseTime.h"
 
 struct CListOptions
 {
   bool ExcludeDirItems;
   bool ExcludeFileItems;
   bool DisablePercents;
+  CPhaseTimes *PhaseTimes; // if it's not NULL, it collects the time of operation phases
 
   CListOptions():
     ExcludeDirItems(false),
     ExcludeFileItems(false),
-    DisablePercents(false)
+    DisablePercents(false),
+    PhaseTimes(NULL)
     {}
 };
 
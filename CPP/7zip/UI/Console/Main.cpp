@@ -71,6 +71,8 @@ typedef PROCESS_MEMORY_COUNTERS *PPROCESS_MEMORY_COUNTERS;
 #include "ConsoleClose.h"
 #include "ExtractCallbackConsole.h"
 #include "HashCon.h"
+#include "IoBenchCon.h"
+#include "JsonProgress.h"
 #include "List.h"
 #include "OpenCallbackConsole.h"
 #include "UpdateCallbackConsole.h"
@@ -153,7 +155,10 @@ static const char * const kHelpString =
     "  -ao{a|s|t|u} : set Overwrite mode\n"
     "  -an : disable archive_name field\n"
     "  -bb[0-3] : set output log level\n"
+    "  -bcompare={file} : compare benchmark results with baseline JSON file\n"
     "  -bd : disable progress indicator\n"
+    "  -bformat={json|csv} : write benchmark results in JSON or CSV format to stdout\n"
+    "  -bj[{fd}][:{ms}] : write progress and statistics as JSON lines to stderr or to file descriptor\n"
     "  -bs{o|e|p}{0|1|2} : set output stream for output/error/progress line\n"
     "  -bt : show execution time statistics\n"
     "  -i[r[-|0]][m[-|2]][w[-]]{@listfile|!wildcard} : Include filenames\n"
@@ -528,6 +533,25 @@ static void ThrowException_if_Error(HRESULT res)
     throw CSystemException(res);
 }
 
+// -bj{fd} : the records are written to stderr (default), to stdout or to another file descriptor
+static FILE *GetJsonProgressFile(int fd)
+{
+  if (fd == 1)
+    return stdout;
+  if (fd == 2)
+    return stderr;
+  FILE *file =
+    #ifdef _WIN32
+      _fdopen
+    #else
+      fdopen
+    #endif
+      (fd, "w");
+  if (!file)
+    throw "Cannot open the file descriptor for -bj switch";
+  return file;
+}
+
 static void PrintNum(UInt64 val, unsigned numDigits, char c = ' ')
 {
   char temp[64];
@@ -788,6 +812,164 @@ static void PrintStat(const UInt64 startTime)
 #endif // ! _WIN32
 
 
+#ifndef Z7_SFX
+
+// it prints time value in 100-ns units as seconds
+static void PrintCoderTime(CStdOutStream &so, UInt64 val)
+{
+  char s[32];
+  ConvertUInt64ToString(val / 10000000, s);
+  const UInt32 ms = (UInt32)(val % 10000000) / 10000;
+  char *p = s + MyStringLen(s);
+  *p++ = '.';
+  *p++ = (char)('0' + ms / 100);
+  *p++ = (char)('0' + ms / 10 % 10);
+  *p++ = (char)('0' + ms % 10);
+  *p = 0;
+  PrintStringRight(so, s, 10);
+}
+
+// it returns the hex id for unknown method
+static void GetCoderMethodName(DECL_EXTERNAL_CODECS_LOC_VARS UInt64 methodId, AString &name)
+{
+  if (!FindMethod(EXTERNAL_CODECS_LOC_VARS methodId, name))
+  {
+    char temp[32];
+    ConvertUInt64ToHex(methodId, temp);
+    name = temp;
+  }
+}
+
+static void PrintCoderStats(DECL_EXTERNAL_CODECS_LOC_VARS
+    CStdOutStream &so, const CCoderStatSet &stats)
+{
+  so << endl << "Coders (time in seconds, Active = Time - In wait - Out wait," << endl
+      << "  Caller CPU = cpu time of the thread that called the coder, without internal threads of coder):" << endl
+      << "Method        Count            In           Out      Time    Active Caller CPU   In wait  Out wait"
+      << endl;
+  FOR_VECTOR (i, stats.Items)
+  {
+    const CCoderStatItem &item = stats.Items[i];
+    const UInt64 *v = item.Values;
+    AString name;
+    GetCoderMethodName(EXTERNAL_CODECS_LOC_VARS item.MethodId, name);
+    so << name;
+    for (unsigned k = name.Len(); k < 12; k++)
+      so << ' ';
+    char temp[32];
+    ConvertUInt64ToString(item.NumCalls, temp);
+    PrintStringRight(so, temp, 7);
+    ConvertUInt64ToString(v[NCoderStat::kInSize], temp);
+    PrintStringRight(so, temp, 14);
+    ConvertUInt64ToString(v[NCoderStat::kOutSize], temp);
+    PrintStringRight(so, temp, 14);
+    const UInt64 time = v[NCoderStat::kTime];
+    const UInt64 wait = v[NCoderStat::kInWaitTime] + v[NCoderStat::kOutWaitTime];
+    PrintCoderTime(so, time);
+    PrintCoderTime(so, time > wait ? time - wait : 0);
+    // cpu time is not available for coders of single-threaded mixer
+    if (v[NCoderStat::kCpuTime] != 0)
+      PrintCoderTime(so, v[NCoderStat::kCpuTime]);
+    else
+      PrintStringRight(so, "-", 10);
+    PrintCoderTime(so, v[NCoderStat::kInWaitTime]);
+    PrintCoderTime(so, v[NCoderStat::kOutWaitTime]);
+    so << endl;
+  }
+
+  // the stalls of LZ match finder threads are reported by LZMA and LZMA2 encoders
+  bool stallsWereReported = false;
+  FOR_VECTOR (i, stats.Items)
+  {
+    const CCoderStatItem &item = stats.Items[i];
+    UInt64 sum = 0;
+    for (unsigned k = NCoderStat::kHashStalls_Write; k <= NCoderStat::kBtStalls_Read; k++)
+      sum += item.Values[k];
+    if (sum == 0)
+      continue;
+    if (!stallsWereReported)
+    {
+      stallsWereReported = true;
+      so << endl << "Match finder stalls (sleeps of threads, while the queue is full or empty):" << endl
+          << "Method      Hash full Hash empty   Bt full  Bt empty" << endl;
+    }
+    AString name;
+    GetCoderMethodName(EXTERNAL_CODECS_LOC_VARS item.MethodId, name);
+    so << name;
+    for (unsigned k = name.Len(); k < 10; k++)
+      so << ' ';
+    for (unsigned k = NCoderStat::kHashStalls_Write; k <= NCoderStat::kBtStalls_Read; k++)
+    {
+      char temp[32];
+      ConvertUInt64ToString(item.Values[k], temp);
+      PrintStringRight(so, temp, 10);
+    }
+    so << endl;
+  }
+}
+
+// the names of NPhase::EEnum phases. The nested phases are indented.
+static const char * const k_PhaseNames[] =
+{
+    "Load codecs"
+  , "Scan"
+  , "Open archive"
+  , "  Headers"
+  , "List items"
+  , "Decode"
+  , "  File create"
+  , "  File close"
+  , "Encode"
+  , "  Header write"
+  , "Rename"
+};
+
+// (time) is in 100-ns units. It's printed as seconds with microsecond precision
+static void PrintPhaseRow(CStdOutStream &so, const char *name, const char *count, UInt64 time)
+{
+  so << name;
+  for (unsigned k = MyStringLen(name); k < 16; k++)
+    so << ' ';
+  PrintStringRight(so, count, 8);
+  char s[32];
+  ConvertUInt64ToString(time / 10000000, s);
+  char *p = s + MyStringLen(s);
+  *p++ = '.';
+  ConvertUInt32ToString((UInt32)(time % 10000000) / 10 + 1000000, p);
+  // we replace leading '1' of (1000000 + us) value
+  memmove(p, p + 1, 7);
+  PrintStringRight(so, s, 13);
+  so << endl;
+}
+
+// (name) is the name of operation or NULL
+void PrintPhaseTimes(CStdOutStream &so, const CPhaseTimes &pt, const char *name);
+void PrintPhaseTimes(CStdOutStream &so, const CPhaseTimes &pt, const char *name)
+{
+  so << endl << "Phases";
+  if (name)
+    so << " of " << name;
+  so << " (time in seconds):" << endl
+      << "Phase              Count         Time"
+      << endl;
+  for (unsigned i = 0; i < NPhase::kNumPhases; i++)
+  {
+    if (pt.Counts[i] == 0)
+      continue;
+    char temp[32];
+    ConvertUInt64ToString(pt.Counts[i], temp);
+    PrintPhaseRow(so, k_PhaseNames[i], temp, pt.Times[i]);
+    if (i == NPhase::kOpenHeaders)
+    {
+      // the remaining time of open operation is spent for detection of archive type
+      const UInt64 open = pt.Times[NPhase::kOpen];
+      const UInt64 headers = pt.Times[NPhase::kOpenHeaders];
+      PrintPhaseRow(so, "  Detection", "-", open > headers ? open - headers : 0);
+    }
+  }
+}
+
+#endif
 
 
 
@@ -899,6 +1081,10 @@ int Main2(
   CStdOutStream *percentsStream = NULL;
   if (options.Number_for_Percents != k_OutStream_disabled)
     percentsStream = (options.Number_for_Percents == k_OutStream_stderr) ? &g_StdErr : &g_StdOut;
+
+  CStdOutStream jsonStream(options.JsonProgress ? GetJsonProgressFile(options.JsonProgress_Fd) : NULL);
+  CJsonProgress jsonProgress;
+  jsonProgress.Interval = options.JsonProgress_Interval;
   
   if (options.HelpMode)
   {
@@ -908,11 +1094,13 @@ int Main2(
 
   if (options.EnableHeaders)
   {
-    if (g_StdStream)
+    // stdout is reserved for benchmark results in JSON / CSV format
+    CStdOutStream *headerStream = (options.BenchFormat == NBenchFormat::kText ? g_StdStream : g_ErrStream);
+    if (headerStream)
     {
-      ShowCopyrightAndHelp(g_StdStream, false);
+      ShowCopyrightAndHelp(headerStream, false);
       if (!parser.Parse1Log.IsEmpty())
-        *g_StdStream << parser.Parse1Log;
+        *headerStream << parser.Parse1Log;
     }
   }
 
@@ -985,6 +1173,11 @@ int Main2(
     #endif
   }
 
+  // -bt : the time of operation phases
+  CPhaseTimes phaseTimes;
+  CPhaseTimes *phaseTimesPtr = options.ShowTime ? &phaseTimes : NULL;
+  const UInt64 loadCodecsStartTime = NTime::GetMonotonicTime();
+
   CREATE_CODECS_OBJECT
 
   codecs->CaseSensitive_Change = options.CaseSensitive_Change;
@@ -1052,9 +1245,18 @@ int Main2(
     ThrowException_if_Error(_externalCodecs.Load());
   #endif
 
+  if (phaseTimesPtr)
+    phaseTimesPtr->Add(NPhase::kLoadCodecs, NTime::GetMonotonicTime() - loadCodecsStartTime);
+
   int retCode = NExitCode::kSuccess;
   HRESULT hresultMain = S_OK;
 
+  #ifndef Z7_SFX
+  // -bt : the archive handlers report the statistics of coders
+  CCoderStatSet coderStats;
+  CCoderStatSet *coderStatsPtr = options.ShowTime ? &coderStats : NULL;
+  #endif
+
   // bool showStat = options.ShowTime;
   
   /*
@@ -1258,8 +1460,51 @@ int Main2(
   else if (options.Command.CommandType == NCommandType::kBenchmark)
   {
     CStdOutStream &so = (g_StdStream ? *g_StdStream : g_StdOut);
-    hresultMain = BenchCon(EXTERNAL_CODECS_VARS_L
-        options.Properties, options.NumIterations, (FILE *)so);
+    CBenchConOptions benchOptions;
+    benchOptions.Format = options.BenchFormat;
+    benchOptions.CompareFile = options.BenchCompareFile;
+    FILE *tableFile = (FILE *)so;
+    if (options.BenchFormat != NBenchFormat::kText)
+    {
+      // the results are written to stdout, so we move the table to stderr
+      benchOptions.ResultsFile = (FILE *)so;
+      tableFile = (g_ErrStream ? (FILE *)*g_ErrStream : NULL);
+    }
+    if (IsIoBenchMode(options.Properties))
+    {
+      // end-to-end benchmark with file system: 7z b [N] -mm=io
+      if (options.BenchCorpus)
+        throw CMessagePathException("-mm=io benchmark doesn't use files");
+      hresultMain = IoBenchCon(codecs, types, excludedFormats,
+          options.Properties, options.NumIterations, g_StdStream, g_ErrStream);
+    }
+    else if (options.BenchCorpus)
+    {
+      // benchmark with real data from files: 7z b [N] files
+      FStringVector filePaths;
+      {
+        CExtractScanConsole scan;
+        scan.Init(NULL, g_ErrStream, NULL, true);
+        CDirItems dirItems;
+        dirItems.Callback = &scan;
+        {
+          CPhaseTimer phaseTimer(phaseTimesPtr, NPhase::kScan);
+          ThrowException_if_Error(EnumerateItems(options.Censor, NWildcard::k_RelatPath, UString(), dirItems));
+        }
+        FOR_VECTOR (i, dirItems.Items)
+          if (!dirItems.Items[i].IsDir())
+            filePaths.Add(dirItems.GetPhyPath(i));
+      }
+      if (filePaths.IsEmpty())
+        throw CMessagePathException("There are no files for benchmark");
+      hresultMain = CorpusBenchCon(EXTERNAL_CODECS_VARS_L
+          filePaths, options.Properties, options.NumIterations, tableFile, benchOptions);
+    }
+    else
+      hresultMain = BenchCon(EXTERNAL_CODECS_VARS_L
+          options.Properties, options.NumIterations, tableFile, benchOptions);
+    if (hresultMain == S_OK && benchOptions.NumRegressions != 0)
+      retCode = NExitCode::kWarning;
     if (hresultMain == S_FALSE)
     {
       so << endl;
@@ -1295,7 +1540,9 @@ int Main2(
 
       scan.StartScanning();
 
-      hresultMain = EnumerateDirItemsAndSort(
+      {
+        CPhaseTimer phaseTimer(phaseTimesPtr, NPhase::kScan);
+        hresultMain = EnumerateDirItemsAndSort(
           options.arcCensor,
           NWildcard::k_RelatPath,
           UString(), // addPathPrefix
@@ -1303,6 +1550,7 @@ int Main2(
           ArchivePathsFullSorted,
           st,
           &scan);
+      }
 
       scan.CloseScanning();
 
@@ -1344,6 +1592,12 @@ int Main2(
       if (percentsStream)
         ecs->SetWindowWidth(consoleWidth);
 
+      if (options.JsonProgress)
+      {
+        jsonProgress.Init(&jsonStream, options.Command.IsTestCommand() ? "test" : "extract", false);
+        ecs->JsonProgress = &jsonProgress;
+      }
+
       /*
       COpenCallbackConsole openCallback;
       openCallback.Init(g_StdStream, g_ErrStream);
@@ -1364,6 +1618,8 @@ int Main2(
       
       #ifndef Z7_SFX
       eo.Properties = options.Properties;
+      eo.CoderStats = coderStatsPtr;
+      eo.PhaseTimes = phaseTimesPtr;
       #endif
 
       UString errorMessage;
@@ -1391,6 +1647,8 @@ int Main2(
           hashCalc, errorMessage, stat);
       
       ecs->ClosePercents();
+      if (ecs->JsonProgress)
+        jsonProgress.PrintSummary(hresultMain);
 
       if (!errorMessage.IsEmpty())
       {
@@ -1500,6 +1758,10 @@ int Main2(
       lo.ExcludeDirItems = options.Censor.ExcludeDirItems;
       lo.ExcludeFileItems = options.Censor.ExcludeFileItems;
       lo.DisablePercents = options.DisablePercents;
+      lo.PhaseTimes = phaseTimesPtr;
+
+      if (options.JsonProgress)
+        jsonProgress.Init(&jsonStream, "list", false);
 
       hresultMain = ListArchives(
           lo,
@@ -1521,6 +1783,9 @@ int Main2(
           &options.Properties,
           numErrors, numWarnings);
 
+      jsonProgress.NumErrors = numErrors;
+      jsonProgress.PrintSummary(hresultMain);
+
       if (options.EnableHeaders)
         if (numWarnings > 0)
           g_StdOut << endl << "Warnings: " << numWarnings << endl;
@@ -1542,6 +1807,8 @@ int Main2(
     CUpdateOptions &uo = options.UpdateOptions;
     if (uo.SfxMode && uo.SfxModule.IsEmpty())
       uo.SfxModule = kDefaultSfxModule;
+    uo.CoderStats = coderStatsPtr;
+    uo.PhaseTimes = phaseTimesPtr;
 
     COpenCallbackConsole openCallback;
     openCallback.Init(g_StdStream, g_ErrStream, percentsStream, options.DisablePercents);
@@ -1571,6 +1838,12 @@ int Main2(
       // NULL,
       g_StdStream, g_ErrStream, percentsStream, options.DisablePercents);
 
+    if (options.JsonProgress)
+    {
+      jsonProgress.Init(&jsonStream, "update", true);
+      callback.JsonProgress = &jsonProgress;
+    }
+
     CUpdateErrorInfo errorInfo;
 
     /*
@@ -1585,6 +1858,8 @@ int Main2(
         errorInfo, &openCallback, &callback, true);
 
     callback.ClosePercents2();
+    if (callback.JsonProgress)
+      jsonProgress.PrintSummary(hresultMain);
 
     CStdOutStream *se = g_StdStream;
     if (!se)
@@ -1622,6 +1897,17 @@ int Main2(
   else
     ShowMessageAndThrowException(kUserErrorMessage, NExitCode::kUserError);
 
+  #ifndef Z7_SFX
+  if (phaseTimesPtr)
+  {
+    if (g_StdStream)
+      PrintPhaseTimes(*g_StdStream, phaseTimes, NULL);
+    jsonProgress.PrintPhaseTimes(phaseTimes);
+  }
+  if (g_StdStream && !coderStats.Items.IsEmpty())
+    PrintCoderStats(EXTERNAL_CODECS_VARS_L *g_StdStream, coderStats);
+  #endif
+
   if (options.ShowTime && g_StdStream)
     PrintStat(
       #ifndef _WIN32
@@ -7,6 +7,7 @@
 
 #include "../Common/ArchiveOpenCallback.h"
 
+#include "JsonProgress.h"
 #include "PercentPrinter.h"
 
 class COpenCallbackConsole: public IOpenCallbackUI
@@ -27,6 +28,9 @@ protected:
 public:
 
   bool MultiArcMode;
+ #ifndef Z7_SFX
+  CJsonProgress *JsonProgress;
+ #endif
 
   void ClosePercents()
   {
@@ -39,6 +43,9 @@ public:
       _totalFilesDefined(false),
       // _totalBytesDefined(false),
       MultiArcMode(false)
+     #ifndef Z7_SFX
+      , JsonProgress(NULL)
+     #endif
       
       #ifndef Z7_NO_CRYPTO
       , PasswordIsDefined(false)
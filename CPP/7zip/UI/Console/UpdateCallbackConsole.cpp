@@ -229,6 +229,8 @@ HRESULT CCallbackConsoleBase::OpenFileError_Base(const FString &path, DWORD syst
   MT_LOCK
   FailedFiles.AddError(path, systemError);
   NumNonOpenFiles++;
+  if (JsonProgress)
+    JsonProgress->NumErrors++;
   /*
   if (systemError == ERROR_SHARING_VIOLATION)
   {
@@ -244,6 +246,8 @@ HRESULT CCallbackConsoleBase::OpenFileError_Base(const FString &path, DWORD syst
 HRESULT CCallbackConsoleBase::ReadingFileError_Base(const FString &path, DWORD systemError)
 {
   MT_LOCK
+  if (JsonProgress)
+    JsonProgress->NumErrors++;
   CommonError(path, systemError, false);
   return HRESULT_FROM_WIN32(systemError);
 }
@@ -586,6 +590,11 @@ HRESULT CUpdateCallbackConsole::SetTotal(UInt64 size)
     _percent.Total = size;
     _percent.Print();
   }
+  if (JsonProgress)
+  {
+    JsonProgress->Total = size;
+    JsonProgress->Print();
+  }
   return S_OK;
 }
 
@@ -599,12 +608,26 @@ HRESULT CUpdateCallbackConsole::SetCompleted(const UInt64 *completeValue)
       _percent.Completed = *completeValue;
       _percent.Print();
     }
+    if (JsonProgress)
+    {
+      JsonProgress->Completed = *completeValue;
+      JsonProgress->Print();
+    }
   }
   return CheckBreak2();
 }
 
-HRESULT CUpdateCallbackConsole::SetRatioInfo(const UInt64 * /* inSize */, const UInt64 * /* outSize */)
+HRESULT CUpdateCallbackConsole::SetRatioInfo(const UInt64 *inSize, const UInt64 *outSize)
 {
+  if (JsonProgress)
+  {
+    MT_LOCK
+    if (inSize)
+      JsonProgress->InSize = *inSize;
+    if (outSize)
+      JsonProgress->OutSize = *outSize;
+    JsonProgress->RatioInfo_Defined = true;
+  }
   return CheckBreak2();
 }
 
@@ -652,6 +675,14 @@ HRESULT CCallbackConsoleBase::PrintProgress(const wchar_t *name, bool isDir, con
     }
     _percent.Print();
   }
+
+  if (JsonProgress)
+  {
+    JsonProgress->FileName.Empty();
+    if (name)
+      JsonProgress->FileName = name;
+    JsonProgress->Print();
+  }
   
   return CheckBreak2();
 }
@@ -725,6 +756,8 @@ HRESULT CUpdateCallbackConsole::SetOperationResult(Int32 /* opRes */)
 {
   MT_LOCK
   _percent.Files++;
+  if (JsonProgress)
+    JsonProgress->Files++;
   /*
   if (opRes != NArchive::NUpdate::NOperationResult::kOK)
   {
@@ -7,6 +7,7 @@
 
 #include "../Common/Update.h"
 
+#include "JsonProgress.h"
 #include "PercentPrinter.h"
 
 struct CErrorPathCodes
@@ -54,13 +55,15 @@ public:
   CErrorPathCodes FailedFiles;
   CErrorPathCodes ScanErrors;
   UInt64 NumNonOpenFiles;
+  CJsonProgress *JsonProgress;
 
   CCallbackConsoleBase():
       StdOutMode(false),
       NeedFlush(false),
       PercentsNameLevel(1),
       LogLevel(0),
-      NumNonOpenFiles(0)
+      NumNonOpenFiles(0),
+      JsonProgress(NULL)
       {}
   
   bool NeedPercents() const { return _percent._so != NULL; }
@@ -107,6 +107,24 @@ int CompareFileNames(const wchar_t *s1, const wchar_t *s2) STRING_UNICODE_THROW
   return MyStringCompareNoCase_Path(s1, s2);
 }
 
+UInt32 GetFileNameHash(const wchar_t *s) throw()
+{
+  // FNV-1a
+  UInt32 hash = 0x811c9dc5;
+  const bool caseSensitive = g_CaseSensitive;
+  for (;;)
+  {
+    wchar_t c = *s++;
+    if (c == 0)
+      return hash;
+    if (IS_PATH_SEPAR(c))
+      c = WCHAR_PATH_SEPARATOR;
+    else if (!caseSensitive)
+      c = MyCharUpper(c);
+    hash = (hash ^ (UInt32)c) * 0x01000193;
+  }
+}
+
 #ifndef USE_UNICODE_FSTRING
 int CompareFileNames(const char *s1, const char *s2)
 {
@@ -259,48 +277,64 @@ bool CItem::AreAllAllowed() const
       && PathParts.Size() == 1 && PathParts.Front().IsEqualTo("*");
 }
 
-bool CItem::CheckPath(const UStringVector &pathParts, bool isFile) const
+/*
+  GetCheckRange() returns the range [start, finish] of positions in (pathParts)
+  where the mask parts must be compared.
+  It returns false, if the item can't match the path.
+*/
+
+static bool GetCheckRange(bool recursive, bool forFile, bool forDir,
+    unsigned numMaskParts, unsigned numTestParts, bool isFile,
+    int &start, int &finish)
 {
-  if (!isFile && !ForDir)
+  if (!isFile && !forDir)
     return false;
-
-  /*
-  if (PathParts.IsEmpty())
-  {
-    // PathParts.IsEmpty() means all items (universal wildcard)
-    if (!isFile)
-      return true;
-    if (pathParts.Size() <= 1)
-      return ForFile;
-    return (ForDir || Recursive && ForFile);
-  }
-  */
-
-  int delta = (int)pathParts.Size() - (int)PathParts.Size();
+  const int delta = (int)numTestParts - (int)numMaskParts;
   if (delta < 0)
     return false;
-  int start = 0;
-  int finish = 0;
+  start = 0;
+  finish = 0;
   
   if (isFile)
   {
-    if (!ForDir)
+    if (!forDir)
     {
-      if (Recursive)
+      if (recursive)
         start = delta;
-      else if (delta !=0)
+      else if (delta != 0)
         return false;
     }
-    if (!ForFile && delta == 0)
+    if (!forFile && delta == 0)
       return false;
   }
   
-  if (Recursive)
+  if (recursive)
   {
     finish = delta;
-    if (isFile && !ForFile)
+    if (isFile && !forFile)
       finish = delta - 1;
   }
+  return true;
+}
+
+bool CItem::CheckPath(const UStringVector &pathParts, bool isFile) const
+{
+  /*
+  if (PathParts.IsEmpty())
+  {
+    // PathParts.IsEmpty() means all items (universal wildcard)
+    if (!isFile)
+      return true;
+    if (pathParts.Size() <= 1)
+      return ForFile;
+    return (ForDir || Recursive && ForFile);
+  }
+  */
+
+  int start, finish;
+  if (!GetCheckRange(Recursive, ForFile, ForDir,
+      PathParts.Size(), pathParts.Size(), isFile, start, finish))
+    return false;
   
   for (int d = start; d <= finish; d++)
   {
@@ -334,18 +368,107 @@ bool CCensorNode::AreAllAllowed() const
   return IncludeItems.Front().AreAllAllowed();
 }
 
-int CCensorNode::FindSubNode(const UString &name) const
+// ---------- CNameHashIndex ----------
+
+// the lists shorter than that limit are checked in linear order
+static const unsigned kNumObjects_for_Index = 16;
+
+void CNameHashIndex::Init(unsigned numObjects)
 {
+  Invalidate();
+  unsigned size = 16;
+  while (size < numObjects * 2)
+    size <<= 1;
+  Slots.ClearAndSetSize(size);
+  memset(Slots.NonConstData(), 0, size * sizeof(unsigned));
+  CaseSensitive = g_CaseSensitive;
+  IsBuilt = true;
+}
+
+void CNameHashIndex::Insert(UInt32 hash, unsigned objectIndex)
+{
+  const unsigned mask = Slots.Size() - 1;
+  unsigned i = (unsigned)hash & mask;
+  while (Slots[i] != 0)
+    i = (i + 1) & mask;
+  Slots[i] = objectIndex + 1;
+  NumInSlots++;
+}
+
+
+void CCensorNode::BuildSubNodesIndex()
+{
+  CNameHashIndex &index = _subNodesIndex;
+  index.Init(SubNodes.Size());
   FOR_VECTOR (i, SubNodes)
-    if (CompareFileNames(SubNodes[i].Name, name) == 0)
-      return (int)i;
-  return -1;
+    index.Insert(GetFileNameHash(SubNodes[i].Name), i);
+  index.NumObjects = SubNodes.Size();
+}
+
+int CCensorNode::FindSubNode(const UString &name) const
+{
+  if (SubNodes.Size() < kNumObjects_for_Index)
+  {
+    FOR_VECTOR (i, SubNodes)
+      if (CompareFileNames(SubNodes[i].Name, name) == 0)
+        return (int)i;
+    return -1;
+  }
+  const CNameHashIndex &index = _subNodesIndex;
+  if (!index.IsBuilt
+      || index.NumObjects != SubNodes.Size()
+      || index.CaseSensitive != g_CaseSensitive)
+  {
+    FOR_VECTOR (i, SubNodes)
+      if (CompareFileNames(SubNodes[i].Name, name) == 0)
+        return (int)i;
+    return -1;
+  }
+  const unsigned mask = index.Slots.Size() - 1;
+  for (unsigned i = (unsigned)GetFileNameHash(name) & mask;; i = (i + 1) & mask)
+  {
+    const unsigned v = index.Slots[i];
+    if (v == 0)
+      return -1;
+    if (CompareFileNames(SubNodes[v - 1].Name, name) == 0)
+      return (int)(v - 1);
+  }
+}
+
+CCensorNode &CCensorNode::Find_SubNode_Or_Add_New(const UString &name)
+{
+  CNameHashIndex &index = _subNodesIndex;
+  if (SubNodes.Size() >= kNumObjects_for_Index
+      && (!index.IsBuilt
+        || index.NumObjects != SubNodes.Size()
+        || index.CaseSensitive != g_CaseSensitive))
+    BuildSubNodesIndex();
+  const int i = FindSubNode(name);
+  if (i >= 0)
+    return SubNodes[(unsigned)i];
+  // return SubNodes.Add(CCensorNode(name, this));
+  CCensorNode &node = SubNodes.AddNew();
+  node.Parent = this;
+  node.Name = name;
+  // we update the index here to avoid full rebuilding for each new node
+  if (index.IsBuilt && index.NumObjects == SubNodes.Size() - 1)
+  {
+    if (index.NeedGrow())
+      BuildSubNodesIndex();
+    else
+    {
+      index.Insert(GetFileNameHash(name), SubNodes.Size() - 1);
+      index.NumObjects++;
+    }
+  }
+  return node;
 }
 
 void CCensorNode::AddItemSimple(bool include, CItem &item)
 {
   CObjectVector<CItem> &items = include ? IncludeItems : ExcludeItems;
   items.Add(item);
+  _itemsIndex[include ? 1 : 0].Invalidate();
 }
 
 void CCensorNode::AddItem(bool include, CItem &item, int ignoreWildcardIndex)
@@ -410,12 +533,110 @@ bool CCensorNode::AreThereIncludeItems() const
   return false;
 }
 
-bool CCensorNode::CheckPathCurrent(bool include, const UStringVector &pathParts, bool isFile) const
+static bool IsItemForIndex(const CItem &item)
+{
+  return !item.WildcardMatching && item.PathParts.Size() == 1;
+}
+
+static unsigned GetItemGroup(const CItem &item)
+{
+  return (item.Recursive ? 1 : 0) | (item.ForFile ? 2 : 0) | (item.ForDir ? 4 : 0);
+}
+
+static UInt32 GetItemHash(const UString &name, unsigned group)
+{
+  return GetFileNameHash(name) + (UInt32)group * 0x9e3779b1;
+}
+
+void CCensorNode::BuildItemsIndex(bool include)
 {
   const CObjectVector<CItem> &items = include ? IncludeItems : ExcludeItems;
+  CNameHashIndex &index = _itemsIndex[include ? 1 : 0];
+  if (items.Size() < kNumObjects_for_Index)
+  {
+    index.Invalidate();
+    return;
+  }
+  index.Init(items.Size());
   FOR_VECTOR (i, items)
-    if (items[i].CheckPath(pathParts, isFile))
-      return true;
+  {
+    const CItem &item = items[i];
+    if (IsItemForIndex(item))
+    {
+      const unsigned group = GetItemGroup(item);
+      index.GroupsMask |= (unsigned)1 << group;
+      index.Insert(GetItemHash(item.PathParts[0], group), i);
+    }
+    else
+      index.Others.Add(i);
+  }
+  index.NumObjects = items.Size();
+}
+
+void CCensorNode::BuildIndex()
+{
+  if (SubNodes.Size() >= kNumObjects_for_Index)
+    BuildSubNodesIndex();
+  else
+    _subNodesIndex.Invalidate();
+  BuildItemsIndex(false);
+  BuildItemsIndex(true);
+  FOR_VECTOR (i, SubNodes)
+    SubNodes[i].BuildIndex();
+}
+
+bool CCensorNode::CheckPathCurrent(bool include, const UStringVector &pathParts, bool isFile) const
+{
+  const CObjectVector<CItem> &items = include ? IncludeItems : ExcludeItems;
+  if (items.Size() < kNumObjects_for_Index)
+  {
+    FOR_VECTOR (i, items)
+      if (items[i].CheckPath(pathParts, isFile))
+        return true;
+    return false;
+  }
+
+  const CNameHashIndex &index = _itemsIndex[include ? 1 : 0];
+  if (!index.IsBuilt
+      || index.NumObjects != items.Size()
+      || index.CaseSensitive != g_CaseSensitive)
+  {
+    FOR_VECTOR (i, items)
+      if (items[i].CheckPath(pathParts, isFile))
+        return true;
+    return false;
+  }
+
+  {
+    FOR_VECTOR (i, index.Others)
+      if (items[index.Others[i]].CheckPath(pathParts, isFile))
+        return true;
+  }
+
+  const unsigned mask = index.Slots.Size() - 1;
+  for (unsigned group = 0; group < 8; group++)
+  {
+    if ((index.GroupsMask & ((unsigned)1 << group)) == 0)
+      continue;
+    int start, finish;
+    if (!GetCheckRange((group & 1) != 0, (group & 2) != 0, (group & 4) != 0,
+        1, pathParts.Size(), isFile, start, finish))
+      continue;
+    for (int d = start; d <= finish; d++)
+    {
+      const UString &name = pathParts[(unsigned)d];
+      for (unsigned i = (unsigned)GetItemHash(name, group) & mask;; i = (i + 1) & mask)
+      {
+        const unsigned v = index.Slots[i];
+        if (v == 0)
+          break;
+        const CItem &item = items[v - 1];
+        if (GetItemGroup(item) == group
+            && CompareFileNames(item.PathParts[0], name) == 0)
+          return true;
+      }
+    }
+  }
   return false;
 }
 
@@ -508,6 +729,7 @@ bool CCensorNode::CheckPathToRoot(bool include, const UString &path, bool isFile
 void CCensorNode::ExtendExclude(const CCensorNode &fromNodes)
 {
   ExcludeItems += fromNodes.ExcludeItems;
+  _itemsIndex[0].Invalidate();
   FOR_VECTOR (i, fromNodes.SubNodes)
   {
     const CCensorNode &node = fromNodes.SubNodes[i];
@@ -515,11 +737,36 @@ void CCensorNode::ExtendExclude(const CCensorNode &fromNodes)
   }
 }
 
-int CCensor::FindPairForPrefix(const UString &prefix) const
+int CCensor::FindPairForPrefix(const UString &prefix)
 {
-  FOR_VECTOR (i, Pairs)
-    if (CompareFileNames(Pairs[i].Prefix, prefix) == 0)
-      return (int)i;
+  if (Pairs.Size() < kNumObjects_for_Index)
+  {
+    FOR_VECTOR (i, Pairs)
+      if (CompareFileNames(Pairs[i].Prefix, prefix) == 0)
+        return (int)i;
+    return -1;
+  }
+  CNameHashIndex &index = _pairsIndex;
+  if (!index.IsBuilt
+      || index.NumObjects != Pairs.Size()
+      || index.CaseSensitive != g_CaseSensitive
+      || index.NeedGrow())
+  {
+    index.Init(Pairs.Size() * 2);
+    FOR_VECTOR (i, Pairs)
+      index.Insert(GetFileNameHash(Pairs[i].Prefix), i);
+    index.NumObjects = Pairs.Size();
+  }
+  const UInt32 hash = GetFileNameHash(prefix);
+  const unsigned mask = index.Slots.Size() - 1;
+  for (unsigned i = (unsigned)hash & mask;; i = (i + 1) & mask)
+  {
+    const unsigned v = index.Slots[i];
+    if (v == 0)
+      break;
+    if (CompareFileNames(Pairs[v - 1].Prefix, prefix) == 0)
+      return (int)(v - 1);
+  }
   return -1;
 }
 
@@ -700,6 +947,13 @@ void CCensor::AddItem(ECensorPathMode pathMode, bool include, const UString &pat
   {
     index = (int)Pairs.Size();
     Pairs.AddNew().Prefix = prefix;
+    if (_pairsIndex.IsBuilt
+        && _pairsIndex.NumObjects == (unsigned)index
+        && !_pairsIndex.NeedGrow())
+    {
+      _pairsIndex.Insert(GetFileNameHash(prefix), (unsigned)index);
+      _pairsIndex.NumObjects++;
+    }
   }
 
   if (pathMode != k_AbsPath)
@@ -766,6 +1020,7 @@ void CCensor::ExtendExclude()
   for (i = 0; i < Pairs.Size(); i++)
     if (index != i)
       Pairs[i].Head.ExtendExclude(Pairs[index].Head);
+  BuildIndex();
 }
 
 void CCensor::AddPathsToCensor(ECensorPathMode censorPathMode)
@@ -776,6 +1031,13 @@ void CCensor::AddPathsToCensor(ECensorPathMode censorPathMode)
     AddItem(censorPathMode, cp.Include, cp.Path, cp.Props);
   }
   CensorPaths.Clear();
+  BuildIndex();
+}
+
+void CCensor::BuildIndex()
+{
+  FOR_VECTOR(i, Pairs)
+    Pairs[i].Head.BuildIndex();
 }
 
 void CCensor::AddPreItem(bool include, const UString &path, const CCensorPathProps &props)
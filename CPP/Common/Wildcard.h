@@ -10,6 +10,9 @@ int CompareFileNames(const wchar_t *s1, const wchar_t *s2) STRING_UNICODE_THROW;
   int CompareFileNames(const char *s1, const char *s2);
 #endif
 
+// names that are equal for CompareFileNames() have same hash
+UInt32 GetFileNameHash(const wchar_t *s) throw();
+
 bool IsPath1PrefixedByPath2(const wchar_t *s1, const wchar_t *s2);
 
 void SplitPathToParts(const UString &path, UStringVector &pathParts);
@@ -53,6 +56,45 @@ struct CItem
 
 
 
+/*
+CNameHashIndex is hash index for fast search of names in long lists
+(long include / exclude lists from list files).
+Names are compared with CompareFileNames() rules.
+So the index must be rebuilt, if (g_CaseSensitive) was changed.
+*/
+
+struct CNameHashIndex
+{
+  CRecordVector<unsigned> Slots;  // (objectIndex + 1), or 0 for empty slot
+  CRecordVector<unsigned> Others; // indexes of objects that are not in hash table
+  unsigned NumObjects;  // number of objects that were processed by index
+  unsigned NumInSlots;
+  unsigned GroupsMask;
+  bool IsBuilt;
+  bool CaseSensitive;
+
+  CNameHashIndex():
+      NumObjects(0),
+      NumInSlots(0),
+      GroupsMask(0),
+      IsBuilt(false),
+      CaseSensitive(false)
+      {}
+  void Invalidate()
+  {
+    IsBuilt = false;
+    NumObjects = 0;
+    NumInSlots = 0;
+    GroupsMask = 0;
+    Slots.Clear();
+    Others.Clear();
+  }
+  void Init(unsigned numObjects);
+  void Insert(UInt32 hash, unsigned objectIndex);
+  bool NeedGrow() const { return (NumInSlots + 1) * 2 > Slots.Size(); }
+};
+
+
 const Byte kMark_FileOrDir = 0;
 const Byte kMark_StrictFile = 1;
 const Byte kMark_StrictFile_IfWildcard = 2;
@@ -74,7 +116,18 @@ struct CCensorPathProps
 class CCensorNode  MY_UNCOPYABLE
 {
   CCensorNode *Parent;
-  
+
+  /* The indexes are used for long lists.
+     The index of (SubNodes) is updated by Find_SubNode_Or_Add_New().
+     The indexes of items are built by BuildIndex(), when the node is final.
+     Items without wildcards that contain one path part are placed to hash table.
+     Other items are checked in linear order.
+     Any change of node via methods invalidates the index of items. */
+  CNameHashIndex _subNodesIndex;
+  CNameHashIndex _itemsIndex[2]; // [include]
+
+  void BuildSubNodesIndex();
+  void BuildItemsIndex(bool include);
   bool CheckPathCurrent(bool include, const UStringVector &pathParts, bool isFile) const;
   void AddItemSimple(bool include, CItem &item);
 public:
@@ -96,18 +149,20 @@ public:
   CObjectVector<CItem> IncludeItems;
   CObjectVector<CItem> ExcludeItems;
 
-  CCensorNode &Find_SubNode_Or_Add_New(const UString &name)
+  CCensorNode &Find_SubNode_Or_Add_New(const UString &name);
+
+  // it must be called, if (SubNodes), (IncludeItems) or (ExcludeItems) were changed directly
+  void InvalidateIndex()
   {
-    int i = FindSubNode(name);
-    if (i >= 0)
-      return SubNodes[(unsigned)i];
-    // return SubNodes.Add(CCensorNode(name, this));
-    CCensorNode &node = SubNodes.AddNew();
-    node.Parent = this;
-    node.Name = name;
-    return node;
+    _subNodesIndex.Invalidate();
+    _itemsIndex[0].Invalidate();
+    _itemsIndex[1].Invalidate();
   }
 
+  // it builds the indexes of this node and all sub nodes.
+  // Call it after last change of node. Checks without index use linear search.
+  void BuildIndex();
+
   bool AreAllAllowed() const;
 
   int FindSubNode(const UString &path) const;
@@ -184,7 +239,9 @@ struct CCensorPath
 
 class CCensor  MY_UNCOPYABLE
 {
-  int FindPairForPrefix(const UString &prefix) const;
+  CNameHashIndex _pairsIndex;
+
+  int FindPairForPrefix(const UString &prefix);
 public:
   CObjectVector<CPair> Pairs;
 
@@ -205,7 +262,9 @@ public:
   // bool CheckPath(bool isAltStream, const UString &path, bool isFile) const;
   void ExtendExclude();
 
+  // AddPathsToCensor() and ExtendExclude() call BuildIndex() for all pairs
   void AddPathsToCensor(NWildcard::ECensorPathMode censorPathMode);
+  void BuildIndex();
   void AddPreItem(bool include, const UString &path, const CCensorPathProps &props);
 
   void AddPreItem_NoWildcard(const UString &path)
@@ -1131,6 +1131,50 @@ bool DeleteFileAlways(CFSTR path)
   return (remove(path) == 0);
 }
 
+// symbolic links to directories are removed as links, without their targets
+bool RemoveDirWithSubItems(const FString &path)
+{
+  {
+    FString s (path);
+    s.Add_PathSepar();
+    const unsigned prefixSize = s.Len();
+    NFind::CEnumerator enumerator;
+    enumerator.SetDirPrefix(s);
+    NFind::CDirEntry de;
+    bool isError = false;
+    int lastError = 0;
+    for (;;)
+    {
+      bool found;
+      if (!enumerator.Next(de, found))
+        return false;
+      if (!found)
+        break;
+      s.DeleteFrom(prefixSize);
+      s += de.Name;
+      if (enumerator.DirEntry_IsDir(de, false)) // followLink
+      {
+        if (!RemoveDirWithSubItems(s))
+        {
+          lastError = errno;
+          isError = true;
+        }
+      }
+      else if (!DeleteFileAlways(s))
+      {
+        lastError = errno;
+        isError = true;
+      }
+    }
+    if (isError)
+    {
+      errno = lastError;
+      return false;
+    }
+  }
+  return RemoveDir(path);
+}
+
 bool SetCurrentDir(CFSTR path)
 {
   return (chdir(path) == 0);
@@ -618,6 +618,13 @@ bool COutFile::SetLength_KeepPosition(UInt64 length) throw()
   return (result && result2);
 }
 
+bool COutFile::SetSparse() throw()
+{
+  // (inBuffer == NULL) is same as FILE_SET_SPARSE_BUFFER with (SetSparse == TRUE)
+  DWORD bytesReturned;
+  return DeviceIoControl(my_FSCTL_SET_SPARSE, NULL, 0, NULL, 0, &bytesReturned);
+}
+
 }}}
 
 #else // _WIN32
@@ -628,6 +635,14 @@ bool COutFile::SetLength_KeepPosition(UInt64 length) throw()
 #include <fcntl.h>
 #include <unistd.h>
 
+#ifdef Z7_IO_URING
+#include <errno.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#endif
+
 namespace NWindows {
 namespace NFile {
 
@@ -948,6 +963,476 @@ bool COutFile::SetMTime(const CFiTime *mTime) throw()
   return true;
 }
 
+
+#ifdef Z7_IO_URING
+
+void CInFile::Close_Deferred(CIoBatch &batch, const AString &path)
+{
+  if (_handle == -1)
+    return;
+  const int fd = _handle;
+  _handle = -1;
+  batch.Add_Close(fd, path);
+}
+
+bool COutFile::Close_Deferred(CIoBatch &batch, CByteBuffer &data, size_t size)
+{
+  return batch.Add_WriteAndClose(*this, data, size);
+}
+
+
+/////////////////////////
+// CIoBatch
+
+/*
+  We use raw system calls instead of liburing,
+  so there is no additional dependency.
+  Each slot is (write + close) linked pair or single (close) operation.
+  Number of slots is (_numSqEntries / 2), so SQ and CQ can't overflow.
+  The caller doesn't wait for each file: the operations stay queued,
+  and they are submitted when (kIoBatch_SubmitThreshold) entries are collected.
+  The errors of finished slots are stored with path in (_failed)
+  until GetFinishedError() or Flush().
+*/
+
+static const unsigned kIoBatch_SubmitThreshold = 32;
+static const size_t kIoBatch_MaxDataSize = (size_t)1 << 25;
+
+static int my_io_uring_setup(unsigned entries, struct io_uring_params *p)
+{
+  return (int)syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int my_io_uring_enter(int fd, unsigned toSubmit, unsigned minComplete, unsigned flags)
+{
+  return (int)syscall(__NR_io_uring_enter, fd, toSubmit, minComplete, flags, NULL, 0);
+}
+
+#define IO_BATCH_PTR(base, offset)  ((unsigned *)(void *)((Byte *)(base) + (offset)))
+
+CIoBatch::CIoBatch():
+    _ringFd(-1),
+    _sqRing(NULL),
+    _cqRing(NULL),
+    _sqes(NULL),
+    _numSqEntries(0),
+    _numToSubmit(0),
+    _numInFlight(0),
+    _dataSize(0),
+    _errorCode(0),
+    MaxFileSize(1 << 16)
+    {}
+
+CIoBatch::~CIoBatch()
+{
+  Flush();
+  Free();
+}
+
+void CIoBatch::Free()
+{
+  if (_sqes)
+    munmap(_sqes, _sqesSize);
+  if (_cqRing && _cqRing != _sqRing)
+    munmap(_cqRing, _cqRingSize);
+  if (_sqRing)
+    munmap(_sqRing, _sqRingSize);
+  _sqes = NULL;
+  _cqRing = NULL;
+  _sqRing = NULL;
+  if (_ringFd != -1)
+    close(_ringFd);
+  _ringFd = -1;
+  _numToSubmit = 0;
+  _numInFlight = 0;
+  _slots.Clear();
+  _freeSlots.Clear();
+  _failed.Clear();
+}
+
+bool CIoBatch::Create(unsigned numEntries)
+{
+  if (IsCreated())
+    return true;
+  struct io_uring_params p;
+  memset(&p, 0, sizeof(p));
+  const int fd = my_io_uring_setup(numEntries, &p);
+  if (fd < 0)
+    return false;
+  _ringFd = fd;
+
+  _sqRingSize = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+  _cqRingSize = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+  const bool singleMap = (p.features & IORING_FEAT_SINGLE_MMAP) != 0;
+  if (singleMap && _sqRingSize < _cqRingSize)
+    _sqRingSize = _cqRingSize;
+
+  void *sq = mmap(NULL, _sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+  if (sq == MAP_FAILED)
+  {
+    Free();
+    return false;
+  }
+  _sqRing = sq;
+  if (singleMap)
+    _cqRing = sq;
+  else
+  {
+    void *cq = mmap(NULL, _cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+    if (cq == MAP_FAILED)
+    {
+      Free();
+      return false;
+    }
+    _cqRing = cq;
+  }
+  _sqesSize = p.sq_entries * sizeof(struct io_uring_sqe);
+  void *sqes = mmap(NULL, _sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+  if (sqes == MAP_FAILED)
+  {
+    Free();
+    return false;
+  }
+  _sqes = sqes;
+
+  _sqHead  = IO_BATCH_PTR(_sqRing, p.sq_off.head);
+  _sqTail  = IO_BATCH_PTR(_sqRing, p.sq_off.tail);
+  _sqMask  = IO_BATCH_PTR(_sqRing, p.sq_off.ring_mask);
+  _sqArray = IO_BATCH_PTR(_sqRing, p.sq_off.array);
+  _cqHead  = IO_BATCH_PTR(_cqRing, p.cq_off.head);
+  _cqTail  = IO_BATCH_PTR(_cqRing, p.cq_off.tail);
+  _cqMask  = IO_BATCH_PTR(_cqRing, p.cq_off.ring_mask);
+  _cqes = (Byte *)_cqRing + p.cq_off.cqes;
+  _numSqEntries = p.sq_entries;
+
+  // we need (off == -1) support to write at current file position
+  if ((p.features & IORING_FEAT_RW_CUR_POS) == 0 || _numSqEntries < 2)
+  {
+    Free();
+    return false;
+  }
+
+  const unsigned numSlots = _numSqEntries / 2;
+  _slots.ClearAndReserve(numSlots);
+  _freeSlots.ClearAndReserve(numSlots);
+  for (unsigned i = 0; i < numSlots; i++)
+  {
+    CSlot &slot = _slots.AddNew();
+    slot.Fd = -1;
+    slot.DataSize = 0;
+    _freeSlots.AddInReserved(numSlots - 1 - i);
+  }
+
+  /* seccomp filters in some containers allow io_uring_setup(), but block io_uring_enter().
+     So we check that the ring really works with NOP operation. */
+  {
+    const unsigned tail = *_sqTail;
+    const unsigned index = tail & *_sqMask;
+    struct io_uring_sqe *sqe = (struct io_uring_sqe *)_sqes + index;
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = IORING_OP_NOP;
+    sqe->user_data = (UInt64)(Int64)-1;
+    _sqArray[index] = index;
+    __atomic_store_n(_sqTail, tail + 1, __ATOMIC_RELEASE);
+    int res;
+    do
+      res = my_io_uring_enter(_ringFd, 1, 1, IORING_ENTER_GETEVENTS);
+    while (res < 0 && errno == EINTR);
+    if (res != 1)
+    {
+      Free();
+      return false;
+    }
+    unsigned head = *_cqHead;
+    while (head != __atomic_load_n(_cqTail, __ATOMIC_ACQUIRE))
+      head++;
+    __atomic_store_n(_cqHead, head, __ATOMIC_RELEASE);
+  }
+  return true;
+}
+
+void CIoBatch::SetError(int errorCode, const AString &path)
+{
+  if (_errorCode != 0)
+    return;
+  _errorCode = errorCode;
+  _errorPath = path;
+}
+
+bool CIoBatch::PrepareSqe(unsigned slotIndex, bool isClose, bool linkNext)
+{
+  const CSlot &slot = _slots[slotIndex];
+  const unsigned tail = *_sqTail;
+  if (tail - __atomic_load_n(_sqHead, __ATOMIC_ACQUIRE) >= _numSqEntries)
+    return false;
+  const unsigned index = tail & *_sqMask;
+  struct io_uring_sqe *sqe = (struct io_uring_sqe *)_sqes + index;
+  memset(sqe, 0, sizeof(*sqe));
+  sqe->fd = slot.Fd;
+  if (isClose)
+    sqe->opcode = IORING_OP_CLOSE;
+  else
+  {
+    sqe->opcode = IORING_OP_WRITE;
+    sqe->addr = (UInt64)(size_t)(const Byte *)slot.Data;
+    sqe->len = (UInt32)slot.DataSize;
+    sqe->off = (UInt64)(Int64)-1;
+  }
+  if (linkNext)
+    sqe->flags = IOSQE_IO_LINK;
+  sqe->user_data = ((UInt64)slotIndex << 1) | (isClose ? 1 : 0);
+  _sqArray[index] = index;
+  __atomic_store_n(_sqTail, tail + 1, __ATOMIC_RELEASE);
+  _numToSubmit++;
+  return true;
+}
+
+bool CIoBatch::Submit(unsigned minComplete)
+{
+  for (;;)
+  {
+    const int res = my_io_uring_enter(_ringFd, _numToSubmit, minComplete,
+        minComplete ? IORING_ENTER_GETEVENTS : 0);
+    if (res >= 0)
+    {
+      _numToSubmit -= (unsigned)res;
+      _numInFlight += (unsigned)res;
+      return true;
+    }
+    if (errno == EINTR)
+      continue;
+    if (errno == EAGAIN || errno == EBUSY)
+    {
+      // the kernel can't accept new requests now. We reap completions and try again.
+      if (_numInFlight == 0)
+        return false;
+      ProcessCqes();
+      minComplete = 1;
+      continue;
+    }
+    return false;
+  }
+}
+
+void CIoBatch::FinishSlot(unsigned slotIndex, bool closed)
+{
+  CSlot &slot = _slots[slotIndex];
+  if (!closed)
+  {
+    // close operation was canceled or it's not supported by kernel
+    if (close(slot.Fd) != 0 && slot.ErrorCode == 0)
+      slot.ErrorCode = errno;
+  }
+  if (slot.ErrorCode == 0 && slot.WriteDone && slot.TimesDefined)
+  {
+    // we ignore the error here, as COutFile::Close() does
+    /* bool res2 = */ NDir::SetDirTime(slot.Path,
+        slot.CTime_defined ? &slot.CTime : NULL,
+        slot.ATime_defined ? &slot.ATime : NULL,
+        slot.MTime_defined ? &slot.MTime : NULL);
+  }
+  if (slot.ErrorCode != 0)
+  {
+    CFailed &f = _failed.AddNew();
+    f.ErrorCode = slot.ErrorCode;
+    f.Path = slot.Path;
+  }
+  _dataSize -= slot.DataSize;
+  slot.DataSize = 0;
+  slot.Path.Empty();
+  slot.Fd = -1;
+  _freeSlots.Add(slotIndex);
+}
+
+void CIoBatch::ProcessCqes()
+{
+  unsigned head = *_cqHead;
+  for (;;)
+  {
+    const unsigned tail = __atomic_load_n(_cqTail, __ATOMIC_ACQUIRE);
+    if (head == tail)
+      break;
+    const struct io_uring_cqe *cqe = (const struct io_uring_cqe *)_cqes + (head & *_cqMask);
+    const UInt64 userData = cqe->user_data;
+    const int res = cqe->res;
+    head++;
+    __atomic_store_n(_cqHead, head, __ATOMIC_RELEASE);
+    _numInFlight--;
+
+    const unsigned slotIndex = (unsigned)(userData >> 1);
+    CSlot &slot = _slots[slotIndex];
+    if (userData & 1)
+    {
+      if (res < 0 && res != -ECANCELED && res != -EINVAL)
+      {
+        // the state of file descriptor is unspecified after failed close()
+        if (slot.ErrorCode == 0)
+          slot.ErrorCode = -res;
+        slot.Fd = -1;
+        FinishSlot(slotIndex, true);
+      }
+      else
+        FinishSlot(slotIndex, res == 0);
+      continue;
+    }
+
+    // write operation
+    const size_t size = slot.DataSize;
+    size_t done = 0;
+    if (res > 0)
+      done = (size_t)res;
+    else if (res < 0 && res != -EINVAL && res != -EOPNOTSUPP)
+    {
+      slot.ErrorCode = -res;
+      continue;
+    }
+    // short write or unsupported operation: the linked close was canceled,
+    // so we write the rest synchronously here.
+    while (done < size)
+    {
+      const ssize_t written = ::write(slot.Fd, slot.Data + done, size - done);
+      if (written <= 0)
+      {
+        slot.ErrorCode = (written < 0 ? errno : ENOSPC);
+        break;
+      }
+      done += (size_t)written;
+    }
+    slot.WriteDone = (done == size);
+  }
+}
+
+bool CIoBatch::GetFreeSlot(unsigned &slotIndex)
+{
+  if (_freeSlots.IsEmpty())
+  {
+    if (!Submit(1))
+      return false;
+    ProcessCqes();
+    if (_freeSlots.IsEmpty())
+      return false;
+  }
+  slotIndex = _freeSlots.Back();
+  _freeSlots.DeleteBack();
+  return true;
+}
+
+bool CIoBatch::Add_Close(int fd, const AString &path)
+{
+  unsigned slotIndex;
+  if (!IsCreated() || !GetFreeSlot(slotIndex))
+  {
+    if (close(fd) == 0)
+      return true;
+    SetError(errno, path);
+    return false;
+  }
+  CSlot &slot = _slots[slotIndex];
+  slot.Fd = fd;
+  slot.ErrorCode = 0;
+  slot.WriteDone = true;
+  slot.TimesDefined = false;
+  slot.DataSize = 0;
+  slot.Path = path;
+  PrepareSqe(slotIndex, true, false);
+  if (_numToSubmit >= kIoBatch_SubmitThreshold)
+  {
+    Submit(0);
+    ProcessCqes();
+  }
+  return true;
+}
+
+bool CIoBatch::Add_WriteAndClose(COutFile &file, CByteBuffer &data, size_t size)
+{
+  unsigned slotIndex;
+  if (!IsCreated() || size == 0 || size > MaxFileSize
+      || _numSqEntries - _numToSubmit < 2
+      || !GetFreeSlot(slotIndex))
+  {
+    if (size != 0 && !file.WriteFull(data, size))
+      return false;
+    return file.Close();
+  }
+
+  CSlot &slot = _slots[slotIndex];
+  slot.Fd = file._handle;
+  slot.ErrorCode = 0;
+  slot.WriteDone = false;
+  // we pass the buffer to slot without copying, and the caller gets the free buffer of slot
+  slot.Data.Swap(data);
+  slot.DataSize = size;
+  slot.Path = file.Path;
+  slot.CTime_defined = file.CTime_defined;
+  slot.ATime_defined = file.ATime_defined;
+  slot.MTime_defined = file.MTime_defined;
+  slot.TimesDefined = file.CTime_defined || file.ATime_defined || file.MTime_defined;
+  slot.CTime = file.CTime;
+  slot.ATime = file.ATime;
+  slot.MTime = file.MTime;
+  file._handle = -1;
+  file.CTime_defined = false;
+  file.ATime_defined = false;
+  file.MTime_defined = false;
+  _dataSize += size;
+
+  PrepareSqe(slotIndex, false, true);
+  PrepareSqe(slotIndex, true, false);
+
+  if (_dataSize > kIoBatch_MaxDataSize)
+    return Drain();
+  if (_numToSubmit >= kIoBatch_SubmitThreshold)
+  {
+    if (!Submit(0))
+      return Drain();
+    ProcessCqes();
+  }
+  return true;
+}
+
+bool CIoBatch::GetFinishedError()
+{
+  // the completion ring is mapped to our memory, so we don't need system call here
+  if (IsCreated())
+    ProcessCqes();
+  if (_failed.IsEmpty())
+    return true;
+  const CFailed &f = _failed[0];
+  _errorPath = f.Path;
+  errno = f.ErrorCode;
+  _failed.Delete(0);
+  return false;
+}
+
+bool CIoBatch::Drain()
+{
+  if (IsCreated())
+  {
+    while (_numToSubmit != 0 || _numInFlight != 0)
+    {
+      if (!Submit(_numToSubmit + _numInFlight))
+      {
+        SetError(errno, AString());
+        return false;
+      }
+      ProcessCqes();
+    }
+  }
+  return true;
+}
+
+bool CIoBatch::Flush()
+{
+  Drain();
+  if (_errorCode == 0)
+    return GetFinishedError();
+  errno = _errorCode;
+  _errorCode = 0;
+  return false;
+}
+
+#endif // Z7_IO_URING
+
 }}}
 
 
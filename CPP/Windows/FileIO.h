@@ -24,6 +24,12 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 
+#if defined(__linux__) && !defined(Z7_NO_IO_URING) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#define Z7_IO_URING
+#endif
+#endif
+
 #endif
 
 #include "../Common/MyString.h"
@@ -38,6 +44,7 @@ HRESULT GetLastError_noZero_HRESULT();
 #define my_FSCTL_SET_REPARSE_POINT     CTL_CODE(FILE_DEVICE_FILE_SYSTEM, 41, METHOD_BUFFERED, FILE_SPECIAL_ACCESS) // REPARSE_DATA_BUFFER
 #define my_FSCTL_GET_REPARSE_POINT     CTL_CODE(FILE_DEVICE_FILE_SYSTEM, 42, METHOD_BUFFERED, FILE_ANY_ACCESS)     // REPARSE_DATA_BUFFER
 #define my_FSCTL_DELETE_REPARSE_POINT  CTL_CODE(FILE_DEVICE_FILE_SYSTEM, 43, METHOD_BUFFERED, FILE_SPECIAL_ACCESS) // REPARSE_DATA_BUFFER
+#define my_FSCTL_SET_SPARSE            CTL_CODE(FILE_DEVICE_FILE_SYSTEM, 49, METHOD_BUFFERED, FILE_SPECIAL_ACCESS) // FILE_SET_SPARSE_BUFFER
 
 namespace NWindows {
 namespace NFile {
@@ -331,6 +338,8 @@ public:
   bool SetEndOfFile() throw();
   bool SetLength(UInt64 length) throw();
   bool SetLength_KeepPosition(UInt64 length) throw();
+  // it marks the file as sparse. It returns false, if the file system doesn't support sparse files
+  bool SetSparse() throw();
 };
 
 }
@@ -348,6 +357,10 @@ bool SetSymLink(CFSTR from, CFSTR to);
 bool SetSymLink_UString(CFSTR from, const UString &to);
 
 
+#ifdef Z7_IO_URING
+class CIoBatch;
+#endif
+
 class CFileBase
 {
 protected:
@@ -380,6 +393,7 @@ public:
   off_t seekToCur() const throw();
   // bool SeekToBegin() throw();
   int my_fstat(struct stat *st) const  { return fstat(_handle, st); }
+  int GetHandle() const { return _handle; }
   /*
   int my_ioctl_BLKGETSIZE64(unsigned long long *val);
   int GetDeviceSize_InBytes(UInt64 &size);
@@ -404,6 +418,10 @@ public:
   ssize_t read_part(void *data, size_t size) throw();
   // ssize_t read_full(void *data, size_t size, size_t &processed);
   bool ReadFull(void *data, size_t size, size_t &processedSize) throw();
+ #ifdef Z7_IO_URING
+  // the handle is passed to (batch) and it will be closed asynchronously
+  void Close_Deferred(CIoBatch &batch, const AString &path);
+ #endif
 };
 
 class COutFile: public CFileBase
@@ -455,8 +473,121 @@ public:
   }
   bool SetTime(const CFiTime *cTime, const CFiTime *aTime, const CFiTime *mTime) throw();
   bool SetMTime(const CFiTime *mTime) throw();
+ #ifdef Z7_IO_URING
+  /* (size) bytes from (data) are written at current position of file, and then the file is closed.
+     These operations can be executed asynchronously by (batch).
+     The buffer is passed to (batch): (data) gets some another buffer or empty buffer.
+     File times are set after the write operation is finished.
+     The errors of asynchronous operations are reported later by
+     CIoBatch::GetFinishedError() or CIoBatch::Flush(). */
+  bool Close_Deferred(CIoBatch &batch, CByteBuffer &data, size_t size);
+  friend class CIoBatch;
+ #endif
+};
+
+
+#ifdef Z7_IO_URING
+
+/*
+  CIoBatch collects write and close operations for small files
+  and submits them to the kernel in batches via io_uring.
+  If io_uring is not supported (old kernel, seccomp filter),
+  Create() returns false and all operations are executed synchronously.
+  Errors of asynchronous operations are reported by GetFinishedError() and Flush().
+  As in COutFile::Close(), the errors of setting of file times are ignored.
+*/
+
+class CIoBatch
+{
+  struct CSlot
+  {
+    int Fd;
+    int ErrorCode;
+    bool WriteDone;
+    bool TimesDefined;
+    bool CTime_defined;
+    bool ATime_defined;
+    bool MTime_defined;
+    size_t DataSize;
+    CByteBuffer Data; // the buffer is not freed after operation, it's reused by next Add_WriteAndClose()
+    AString Path;
+    CFiTime CTime;
+    CFiTime ATime;
+    CFiTime MTime;
+  };
+
+  // the result of finished slot with error
+  struct CFailed
+  {
+    int ErrorCode;
+    AString Path;
+  };
+
+  int _ringFd;
+  void *_sqRing;
+  void *_cqRing;
+  void *_sqes;
+  size_t _sqRingSize;
+  size_t _cqRingSize;
+  size_t _sqesSize;
+  unsigned *_sqHead;
+  unsigned *_sqTail;
+  unsigned *_sqMask;
+  unsigned *_sqArray;
+  unsigned *_cqHead;
+  unsigned *_cqTail;
+  unsigned *_cqMask;
+  void *_cqes;
+  unsigned _numSqEntries;
+  unsigned _numToSubmit;
+  unsigned _numInFlight;
+  size_t _dataSize;
+
+  CObjectVector<CSlot> _slots;
+  CRecordVector<unsigned> _freeSlots;
+  CObjectVector<CFailed> _failed;
+
+  int _errorCode;
+  AString _errorPath;
+
+  void SetError(int errorCode, const AString &path);
+  bool PrepareSqe(unsigned slotIndex, bool isClose, bool linkNext);
+  bool Submit(unsigned minComplete);
+  void ProcessCqes();
+  void FinishSlot(unsigned slotIndex, bool closed);
+  bool GetFreeSlot(unsigned &slotIndex);
+  // it waits for all queued operations, but it doesn't report the errors of slots
+  bool Drain();
+  void Free();
+
+  Z7_CLASS_NO_COPY(CIoBatch)
+public:
+  unsigned MaxFileSize;
+
+  CIoBatch();
+  ~CIoBatch();
+  bool Create(unsigned numEntries = 256);
+  bool IsCreated() const { return _ringFd != -1; }
+
+  bool Add_Close(int fd, const AString &path);
+  bool Add_WriteAndClose(COutFile &file, CByteBuffer &data, size_t size);
+
+  /* it doesn't wait for queued operations. It only checks the operations that are finished already.
+     returns false, if some finished operation has failed.
+     (errno) is set to error code, and GetErrorPath() returns the path of that file.
+     Each error is reported only once, so the caller can call it in loop to get all errors. */
+  bool GetFinishedError();
+
+  /* waits for all queued operations.
+     returns false, if some operation has failed. (errno) is set to error code.
+     Only one error is reported per call. So the caller can call Flush()
+     in loop until it returns true to get the errors for all files. */
+  bool Flush();
+  const AString &GetErrorPath() const { return _errorPath; }
 };
 
+#endif
+
 }
 
 #endif  // _WIN32
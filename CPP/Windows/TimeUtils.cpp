@@ -346,6 +346,55 @@ void GetCurUtcFileTime(FILETIME &ft) throw()
 #endif
 
 
+#ifdef _WIN32
+
+UInt64 GetMonotonicTime() throw()
+{
+  LARGE_INTEGER freq, v;
+  if (!::QueryPerformanceFrequency(&freq) || freq.QuadPart == 0
+      || !::QueryPerformanceCounter(&v))
+    return 0;
+  const UInt64 f = (UInt64)freq.QuadPart;
+  const UInt64 c = (UInt64)v.QuadPart;
+  return c / f * kNumTimeQuantumsInSecond + c % f * kNumTimeQuantumsInSecond / f;
+}
+
+UInt64 GetCurThreadCpuTime() throw()
+{
+  FILETIME creationTime, exitTime, kernelTime, userTime;
+  if (!::GetThreadTimes(::GetCurrentThread(), &creationTime, &exitTime, &kernelTime, &userTime))
+    return 0;
+  return FILETIME_To_UInt64(kernelTime) + FILETIME_To_UInt64(userTime);
+}
+
+#else
+
+UInt64 GetMonotonicTime() throw()
+{
+#ifdef CLOCK_MONOTONIC
+  timespec ts;
+  if (clock_gettime(CLOCK_MONOTONIC, &ts) == 0)
+    return (UInt64)ts.tv_sec * kNumTimeQuantumsInSecond + (UInt64)ts.tv_nsec / 100;
+#endif
+  struct timeval now;
+  if (gettimeofday(&now, NULL) == 0)
+    return (UInt64)now.tv_sec * kNumTimeQuantumsInSecond + (UInt64)now.tv_usec * 10;
+  return 0;
+}
+
+UInt64 GetCurThreadCpuTime() throw()
+{
+#ifdef CLOCK_THREAD_CPUTIME_ID
+  timespec ts;
+  if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) == 0)
+    return (UInt64)ts.tv_sec * kNumTimeQuantumsInSecond + (UInt64)ts.tv_nsec / 100;
+#endif
+  return 0;
+}
+
+#endif
+
+
 }}
 
 
@@ -106,6 +106,11 @@ void GetCurUtc_FiTime(CFiTime &ft) throw();
 void GetCurUtcFileTime(FILETIME &ft) throw();
 #endif
 
+/* these functions are used to measure time intervals.
+   They return values in 100-ns units, or 0, if the clock is not supported */
+UInt64 GetMonotonicTime() throw();     // monotonic clock with arbitrary start point
+UInt64 GetCurThreadCpuTime() throw();  // kernel + user time of current thread
+
 }}
 
 inline void PropVariant_SetFrom_UnixTime(NWindows::NCOM::CPropVariant &prop, UInt32 unixTime)